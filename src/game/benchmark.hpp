@@ -0,0 +1,1503 @@
+#pragma once
+
+#include "fluids.hpp"
+#include "generation.hpp"
+#include "lighting.hpp"
+#include "meshes.hpp"
+#include "navigation.hpp"
+#include "physics.hpp"
+#include "server.hpp"
+#include "ticks.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace abradinjapan::voxelize {
+    // benchmarks run without a window, they only touch cpu side systems
+    double get_microseconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // sorts the samples in place
+    void print_timings(const char* name, double* samples, unsigned long long sample_count) {
+        double total = 0.0;
+
+        std::sort(samples, samples + sample_count);
+
+        for (unsigned long long i = 0; i < sample_count; i++) {
+            total += samples[i];
+        }
+
+        printf("%s: %llu samples, mean %.2f us, median %.2f us, p99 %.2f us, max %.2f us\n", name, sample_count, total / (double)sample_count, samples[sample_count / 2], samples[(sample_count * 99) / 100], samples[sample_count - 1]);
+        fflush(stdout);
+    }
+
+    void benchmark_lighting() {
+        const unsigned long long edit_count = 2000;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        std::mt19937 random_number_generator(1);
+        std::chrono::steady_clock::time_point start;
+        double* samples = new double[edit_count];
+        long long x, y, z;
+
+        pool.initialize(32 * 32, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 32, 32, 1);
+        lighting.initialize(&w);
+
+        // full flood
+        start = std::chrono::steady_clock::now();
+        lighting.light_world();
+        printf("lighting: full world (%lld blocks) lit in %.2f ms\n", w.get_width() * w.get_length() * w.get_height() * 512, get_microseconds_since(start) / 1000.0);
+
+        // single edits on the surface, alternating digging, placing lamps and filling back in
+        for (unsigned long long i = 0; i < edit_count; i++) {
+            x = random_number_generator() % (w.get_width() * 8);
+            y = random_number_generator() % (w.get_length() * 8);
+            z = w.get_surface_height(x, y);
+
+            start = std::chrono::steady_clock::now();
+            if (i % 3 == 0 && z >= 0) {
+                lighting.set_block_at(x, y, z, bt::bt_air);
+            } else if (i % 3 == 1 && z + 1 < w.get_height() * 8) {
+                lighting.set_block_at(x, y, z + 1, bt::bt_lamp);
+            } else if (z + 1 < w.get_height() * 8) {
+                lighting.set_block_at(x, y, z + 1, bt::bt_stone);
+            }
+            samples[i] = get_microseconds_since(start);
+        }
+
+        print_timings("lighting: single block edit", samples, edit_count);
+
+        delete[] samples;
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // the surface as it was found before the heightmap, scanning down the column a block at a time
+    long long scan_surface_height(world* w, long long x, long long y) {
+        for (long long z = (w->get_height() * 8) - 1; z >= 0; z--) {
+            if (w->get_block_at(x, y, z) != bt::bt_air) {
+                return z;
+            }
+        }
+
+        return -1;
+    }
+
+    // surface queries on a world four chunks tall, scanned against read from the heightmap, then the heightmap's part in lighting it from scratch
+    void benchmark_surface() {
+        const unsigned long long query_count = 1 << 20;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        std::mt19937 random_number_generator(48);
+        std::chrono::steady_clock::time_point start;
+        long long* columns = new long long[query_count * 2];
+        double scan_time, heightmap_time;
+        long long scan_total = 0, heightmap_total = 0;
+
+        pool.initialize(32 * 32 * 4, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 32, 32, 4);
+        lighting.initialize(&w);
+
+        for (unsigned long long i = 0; i < query_count; i++) {
+            columns[i * 2] = random_number_generator() % (w.get_width() * 8);
+            columns[(i * 2) + 1] = random_number_generator() % (w.get_length() * 8);
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < query_count; i++) {
+            scan_total += scan_surface_height(&w, columns[i * 2], columns[(i * 2) + 1]);
+        }
+        scan_time = get_microseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < query_count; i++) {
+            heightmap_total += w.get_surface_height(columns[i * 2], columns[(i * 2) + 1]);
+        }
+        heightmap_time = get_microseconds_since(start);
+
+        printf("surface: %llu queries, column scan %.2f ns each, heightmap %.2f ns each, %s\n", query_count, scan_time * 1000.0 / (double)query_count, heightmap_time * 1000.0 / (double)query_count, scan_total == heightmap_total ? "same heights" : "HEIGHTS DIFFER");
+
+        start = std::chrono::steady_clock::now();
+        lighting.light_world();
+        printf("surface: full world (%lld blocks) lit in %.2f ms\n", w.get_width() * w.get_length() * w.get_height() * 512, get_microseconds_since(start) / 1000.0);
+        fflush(stdout);
+
+        delete[] columns;
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    void benchmark_collision() {
+        const unsigned long long body_count = 4096;
+        const unsigned long long tick_count = 600;
+        const float tick_seconds = 1.0f / 60.0f;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        body* bodies = new body[body_count];
+        double* samples = new double[tick_count];
+        std::mt19937 random_number_generator(1);
+        std::chrono::steady_clock::time_point start;
+        unsigned long long tunnelled = 0;
+        double total = 0.0;
+        long long x, y;
+
+        pool.initialize(32 * 32, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 32, 32, 1);
+
+        // scatter bodies above the terrain, a quarter of them fast enough to cross the whole world in one tick
+        for (unsigned long long i = 0; i < body_count; i++) {
+            x = 1 + (random_number_generator() % ((w.get_width() * 8) - 2));
+            y = 1 + (random_number_generator() % ((w.get_length() * 8) - 2));
+
+            bodies[i].p_position = glm::vec3((float)x + 0.5f, (float)y + 0.5f, (float)(w.get_surface_height(x, y) + 1) + bodies[i].p_half_size.z + 0.5f);
+            bodies[i].p_velocity = glm::vec3((float)(random_number_generator() % 17) - 8.0f, (float)(random_number_generator() % 17) - 8.0f, 0.0f);
+
+            if (i % 4 == 0) {
+                bodies[i].p_velocity = bodies[i].p_velocity * 2000.0f;
+                bodies[i].p_velocity.z = -2000.0f;
+            }
+        }
+
+        for (unsigned long long i = 0; i < tick_count; i++) {
+            start = std::chrono::steady_clock::now();
+            for (unsigned long long j = 0; j < body_count; j++) {
+                bodies[j].p_velocity.z -= 32.0f * tick_seconds;
+                if (bodies[j].p_on_ground && i % 30 == 0) {
+                    bodies[j].p_velocity.z = 9.0f;
+                }
+
+                move_body(&w, &bodies[j], tick_seconds);
+            }
+            samples[i] = get_microseconds_since(start);
+            total += samples[i];
+        }
+
+        // nothing should have ended up inside a block
+        for (unsigned long long i = 0; i < body_count; i++) {
+            if (w.is_box_solid((long long)floorf(bodies[i].p_position.x - bodies[i].p_half_size.x), (long long)floorf(bodies[i].p_position.y - bodies[i].p_half_size.y), (long long)floorf(bodies[i].p_position.z - bodies[i].p_half_size.z), (long long)ceilf(bodies[i].p_position.x + bodies[i].p_half_size.x) - 1, (long long)ceilf(bodies[i].p_position.y + bodies[i].p_half_size.y) - 1, (long long)ceilf(bodies[i].p_position.z + bodies[i].p_half_size.z) - 1)) {
+                tunnelled++;
+            }
+        }
+
+        print_timings("collision: 4096 body tick", samples, tick_count);
+        printf("collision: %.0f bodies per second on one core, %llu bodies inside blocks\n", (double)(body_count * tick_count) / (total / 1000000.0), tunnelled);
+        fflush(stdout);
+
+        delete[] samples;
+        delete[] bodies;
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    void benchmark_ticks() {
+        const unsigned long long tick_count = 600;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        worker_pool workers;
+        tick_scheduler ticks = tick_scheduler();
+        std::mt19937 random_number_generator(1);
+        std::chrono::steady_clock::time_point start;
+        double* samples = new double[tick_count];
+        unsigned long long active_blocks;
+        long long x, y, z;
+
+        pool.initialize(32 * 32, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 32, 32, 1);
+        workers.initialize(0);
+
+        // the same loaded volume twice, first with nothing active
+        for (x = 0; x < w.get_width() * 8; x++) {
+            for (y = 0; y < w.get_length() * 8; y++) {
+                z = w.get_surface_height(x, y);
+
+                if (z >= 0) {
+                    w.set_block_at(x, y, z, bt::bt_dirt);
+                }
+            }
+        }
+
+        lighting.initialize(&w);
+        lighting.light_world();
+        ticks.initialize(&w, &lighting, &workers);
+
+        for (unsigned long long i = 0; i < tick_count; i++) {
+            start = std::chrono::steady_clock::now();
+            ticks.tick();
+            samples[i] = get_microseconds_since(start);
+        }
+
+        print_timings("ticks: idle world tick", samples, tick_count);
+        ticks.uninitialize();
+
+        // then with grass on every other column, free to spread onto the bare dirt between
+        for (x = 0; x < w.get_width() * 8; x++) {
+            for (y = 0; y < w.get_length() * 8; y++) {
+                z = w.get_surface_height(x, y);
+
+                if (z >= 0 && (x + y) % 2 == 0) {
+                    w.set_block_at(x, y, z, bt::bt_grass);
+                }
+            }
+        }
+
+        lighting.light_world();
+        ticks.initialize(&w, &lighting, &workers);
+        ticks.set_random_tick_chance(1.0f / 64.0f);
+        active_blocks = ticks.get_active_block_count();
+
+        // and sand dropped from the top of the world, falling on the timing wheel
+        for (unsigned long long i = 0; i < 1024; i++) {
+            x = random_number_generator() % (w.get_width() * 8);
+            y = random_number_generator() % (w.get_length() * 8);
+
+            lighting.set_block_at(x, y, (w.get_height() * 8) - 1, bt::bt_sand);
+        }
+
+        for (unsigned long long i = 0; i < tick_count; i++) {
+            start = std::chrono::steady_clock::now();
+            ticks.tick();
+            samples[i] = get_microseconds_since(start);
+        }
+
+        print_timings("ticks: active world tick", samples, tick_count);
+        printf("ticks: %u threads, %llu active blocks grew to %llu in %lld chunks, %llu edits applied, %llu delayed ticks pending\n", workers.get_thread_count() + 1, active_blocks, ticks.get_active_block_count(), ticks.get_active_chunk_count(), ticks.get_edits_applied(), ticks.get_scheduled_tick_count());
+        fflush(stdout);
+
+        delete[] samples;
+        ticks.uninitialize();
+        lighting.uninitialize();
+        workers.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    void benchmark_fluids() {
+        const unsigned long long max_steps = 4000;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        worker_pool workers;
+        fluid_solver fluids = fluid_solver();
+        std::chrono::steady_clock::time_point start;
+        double* samples = new double[max_steps];
+        unsigned long long step_count = 0;
+        unsigned long long volumes[2] = { 0, 0 };
+        double total = 0.0;
+
+        pool.initialize(16 * 16, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 16, 16, 1);
+        workers.initialize(0);
+
+        // a walled basin with a stone floor
+        for (long long x = 0; x < w.get_width() * 8; x++) {
+            for (long long y = 0; y < w.get_length() * 8; y++) {
+                for (long long z = 0; z < w.get_height() * 8; z++) {
+                    if (z == 0 || x == 0 || y == 0 || x == (w.get_width() * 8) - 1 || y == (w.get_length() * 8) - 1) {
+                        w.set_block_at(x, y, z, bt::bt_stone);
+                    } else {
+                        w.set_block_at(x, y, z, bt::bt_air);
+                    }
+                }
+            }
+        }
+
+        fluids.initialize(&w, &workers);
+
+        // a full tank of water in one corner, let go all at once
+        for (long long x = 1; x <= 40; x++) {
+            for (long long y = 1; y <= 40; y++) {
+                for (long long z = 1; z < w.get_height() * 8; z++) {
+                    fluids.set_fluid_at(x, y, z, ft::ft_water, fluid_max_level, false);
+                    volumes[0] += fluid_max_level;
+                }
+            }
+        }
+
+        while (step_count < max_steps) {
+            start = std::chrono::steady_clock::now();
+            if (!fluids.step()) {
+                break;
+            }
+            samples[step_count] = get_microseconds_since(start);
+            total += samples[step_count];
+            step_count++;
+        }
+
+        for (long long x = 0; x < w.get_width() * 8; x++) {
+            for (long long y = 0; y < w.get_length() * 8; y++) {
+                for (long long z = 0; z < w.get_height() * 8; z++) {
+                    volumes[1] += get_fluid_level(w.get_fluid_at(x, y, z));
+                }
+            }
+        }
+
+        print_timings("fluids: basin flood step", samples, step_count);
+        printf("fluids: %u threads, %s after %llu steps, %llu cells updated (%.0f per second), %llu changed, volume %llu before and %llu after\n", workers.get_thread_count() + 1, fluids.is_settled() ? "settled" : "still moving", step_count, fluids.get_cells_updated(), (double)fluids.get_cells_updated() / (total / 1000000.0), fluids.get_cells_changed(), volumes[0], volumes[1]);
+        fflush(stdout);
+
+        delete[] samples;
+        fluids.uninitialize();
+        workers.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    void benchmark_edits() {
+        const unsigned long long repeat_count = 20;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        block_region region = block_region();
+        std::chrono::steady_clock::time_point start;
+        double samples[repeat_count];
+        long long size = 32 * 8;
+
+        pool.initialize(32 * 32, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 32, 32, 1);
+
+        // the same whole world fill, a block at a time and in bulk
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < size; x++) {
+            for (long long y = 0; y < size; y++) {
+                for (long long z = 0; z < 8; z++) {
+                    w.set_block_at(x, y, z, bt::bt_stone);
+                }
+            }
+        }
+        printf("edits: %lld blocks set one at a time in %.2f ms\n", size * size * 8, get_microseconds_since(start) / 1000.0);
+
+        for (unsigned long long i = 0; i < repeat_count; i++) {
+            start = std::chrono::steady_clock::now();
+            w.fill_box(0, 0, 0, size - 1, size - 1, 7, i % 2 == 0 ? bt::bt_dirt : bt::bt_stone);
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("edits: whole world fill_box", samples, repeat_count);
+
+        // boxes that cut through chunks
+        for (unsigned long long i = 0; i < repeat_count; i++) {
+            start = std::chrono::steady_clock::now();
+            w.fill_box(3, 5, 1, size - 6, size - 4, 6, i % 2 == 0 ? bt::bt_air : bt::bt_stone);
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("edits: unaligned fill_box", samples, repeat_count);
+
+        for (unsigned long long i = 0; i < repeat_count; i++) {
+            start = std::chrono::steady_clock::now();
+            w.fill_sphere((float)size / 2.0f, (float)size / 2.0f, 4.0f, 100.0f, i % 2 == 0 ? bt::bt_air : bt::bt_dirt);
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("edits: fill_sphere radius 100", samples, repeat_count);
+
+        for (unsigned long long i = 0; i < repeat_count; i++) {
+            start = std::chrono::steady_clock::now();
+            w.replace_box(0, 0, 0, size - 1, size - 1, 7, i % 2 == 0 ? bt::bt_dirt : bt::bt_sand, i % 2 == 0 ? bt::bt_sand : bt::bt_dirt);
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("edits: whole world replace_box", samples, repeat_count);
+
+        for (unsigned long long i = 0; i < repeat_count; i++) {
+            start = std::chrono::steady_clock::now();
+            w.copy_box(13, 21, 0, 140, 148, 7, &region);
+            w.paste_box(&region, 101 + i, 93, 0);
+            samples[i] = get_microseconds_since(start);
+            region.uninitialize();
+        }
+        print_timings("edits: 128 x 128 x 8 copy and paste", samples, repeat_count);
+
+        // with relighting
+        lighting.initialize(&w);
+        lighting.light_world();
+        for (unsigned long long i = 0; i < repeat_count; i++) {
+            start = std::chrono::steady_clock::now();
+            w.fill_sphere(64.0f + (float)i, 64.0f, 7.0f, 6.0f, i % 2 == 0 ? bt::bt_air : bt::bt_stone);
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("edits: relit fill_sphere radius 6", samples, repeat_count);
+
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // walk the loaded window around a square twice, the first lap generates every chunk it meets and the second should find them all in the cold cache
+    void benchmark_streaming() {
+        const long long side = 32;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        chunk_cache cache = chunk_cache();
+        std::chrono::steady_clock::time_point start;
+        double* samples = new double[side * 4];
+        long long centre_x, centre_y;
+        unsigned long long hits, misses;
+        double generate_time, cache_time;
+        chunk_888* chunk;
+        bool kept;
+
+        pool.initialize((16 * 16) + 1, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 16, 16, 1);
+        cache.initialize(8 * 1024 * 1024, 8192);
+        lighting.initialize(&w);
+        lighting.light_world();
+
+        // an edit that has to survive leaving and coming back
+        lighting.set_block_at(70, 70, 7, bt::bt_lamp);
+
+        for (unsigned int lap = 0; lap < 2; lap++) {
+            centre_x = 8;
+            centre_y = 8;
+            hits = cache.get_hits();
+            misses = cache.get_misses();
+
+            for (long long i = 0; i < side * 4; i++) {
+                centre_x += i < side ? 1 : (i >= side * 2 && i < side * 3 ? -1 : 0);
+                centre_y += i >= side && i < side * 2 ? 1 : (i >= side * 3 ? -1 : 0);
+
+                start = std::chrono::steady_clock::now();
+                w.recentre(&pool, &cache, centre_x, centre_y);
+                samples[i] = get_microseconds_since(start);
+            }
+
+            printf("streaming: lap %u, %llu chunks generated, %llu decompressed\n", lap + 1, cache.get_misses() - misses, cache.get_hits() - hits);
+            print_timings(lap == 0 ? "streaming: recentre by one chunk, generating" : "streaming: recentre by one chunk, from the cold cache", samples, side * 4);
+        }
+
+        kept = w.get_block_at(70, 70, 7) == bt::bt_lamp;
+        printf("streaming: %llu chunks cold in %llu bytes, %.1f bytes per chunk, edit kept: %s\n", cache.get_count(), cache.get_bytes(), (double)cache.get_bytes() / (double)cache.get_count(), kept ? "yes" : "no");
+
+        // most of a recentre is relighting, so the two ways of getting a chunk back are also timed on their own
+        start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < 1000; i++) {
+            chunk = generate_chunk(&pool, 1000 + i, 0, 0);
+            pool.deallocate(chunk);
+        }
+        generate_time = get_microseconds_since(start) / 1000.0;
+
+        start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < 1000; i++) {
+            chunk = cache.load(&pool, 16 + (i % 16), (i / 16) % 16, 0);
+            cache.store(chunk, 16 + (i % 16), (i / 16) % 16, 0);
+            pool.deallocate(chunk);
+        }
+        cache_time = get_microseconds_since(start) / 1000.0;
+        printf("streaming: generate_chunk %.2f us per chunk, cold cache load and store back %.2f us per chunk\n", generate_time, cache_time);
+        fflush(stdout);
+
+        delete[] samples;
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        cache.uninitialize();
+        pool.uninitialize();
+    }
+
+    // the same square of columns generated in batches across the worker pool and one column at a time on the calling thread
+    void benchmark_generation() {
+        const long long view_radius = 12;
+        const long long column_count = ((view_radius * 2) + 1) * ((view_radius * 2) + 1);
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        worker_pool workers;
+        generation_pipeline pipeline = generation_pipeline();
+        std::chrono::steady_clock::time_point start;
+        double samples[64];
+        double parallel_time, serial_time;
+        unsigned long long cancelled;
+
+        workers.initialize(0);
+        pipeline.initialize(&pool, &workers, view_radius, 1);
+        pool.initialize(pipeline.get_chunk_capacity(), mtt::mtt_chunks);
+
+        pipeline.set_camera(4.0f, 4.0f);
+        start = std::chrono::steady_clock::now();
+        pipeline.finish_view();
+        parallel_time = get_microseconds_since(start) / 1000.0;
+
+        // taking columns before they are ready finishes them on the spot, one after another
+        pipeline.set_camera(100004.0f, 4.0f);
+        start = std::chrono::steady_clock::now();
+        for (long long x = 12500 - view_radius; x <= 12500 + view_radius; x++) {
+            for (long long y = -view_radius; y <= view_radius; y++) {
+                pool.deallocate(pipeline.take(x, y, 0));
+            }
+        }
+        serial_time = get_microseconds_since(start) / 1000.0;
+
+        printf("generation: %lld columns in %.2f ms over %u threads, %.2f ms on one thread\n", column_count, parallel_time, workers.get_thread_count() + 1, serial_time);
+
+        // walking a column per step, work for columns left behind is dropped
+        cancelled = pipeline.get_columns_cancelled();
+        for (unsigned int i = 0; i < 64; i++) {
+            pipeline.set_camera(100004.0f + (float)(i * 8), 4.0f);
+
+            start = std::chrono::steady_clock::now();
+            pipeline.update();
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("generation: one batch while walking", samples, 64);
+        printf("generation: %llu columns cancelled while walking\n", pipeline.get_columns_cancelled() - cancelled);
+        fflush(stdout);
+
+        pipeline.uninitialize();
+        pool.uninitialize();
+        workers.uninitialize();
+    }
+
+    // the terrain as it was before biomes, what blending is measured against
+    void generate_single_biome(chunk_888* output, long long x, long long, long long z) {
+        long long height;
+        long long block_z;
+
+        for (unsigned int i = 0; i < 8; i++) {
+            for (unsigned int j = 0; j < 8; j++) {
+                height = (long long)(4.0f * sin(2 * 3.14159 + (((x * 8) + i) & 7)) + 4.0f);
+
+                for (unsigned int k = 0; k < 8; k++) {
+                    block_z = (z * 8) + k;
+
+                    if (block_z >= height) {
+                        output->set_block_at(i, j, k, bt::bt_air);
+                    } else if (block_z + 1 == height) {
+                        output->set_block_at(i, j, k, bt::bt_grass);
+                    } else if (block_z + 3 >= height) {
+                        output->set_block_at(i, j, k, bt::bt_dirt);
+                    } else {
+                        output->set_block_at(i, j, k, bt::bt_stone);
+                    }
+                }
+            }
+        }
+    }
+
+    // a square of 64 by 64 chunk columns, 8 by 8 climate regions, generated with and without biomes
+    void benchmark_biomes() {
+        const long long side = 64;
+        const long long region_side = (side * 8) / climate_region_size;
+        chunk_888* chunk = new chunk_888();
+        climate_map climates = climate_map();
+        climate_map unprepared = climate_map();
+        std::chrono::steady_clock::time_point start;
+        double fill_time, single_time, cached_time, direct_time;
+        unsigned long long surfaces[bmt_count];
+        unsigned int top;
+
+        climates.initialize(region_side * region_side);
+
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < region_side; x++) {
+            for (long long y = 0; y < region_side; y++) {
+                climates.prepare(x * climate_region_size, y * climate_region_size);
+            }
+        }
+        fill_time = get_microseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                generate_single_biome(chunk, x, y, 0);
+            }
+        }
+        single_time = get_microseconds_since(start);
+
+        for (unsigned int i = 0; i < bmt_count; i++) {
+            surfaces[i] = 0;
+        }
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                generate_terrain(chunk, &climates, x, y, 0);
+
+                // every biome has its own surface block
+                for (top = 7; top > 0 && chunk->get_block_at(0, 0, top) == bt::bt_air; top--) {
+                }
+                for (unsigned int i = 0; i < bmt_count; i++) {
+                    surfaces[i] += chunk->get_block_at(0, 0, top) == biomes[i].surface_block ? 1 : 0;
+                }
+            }
+        }
+        cached_time = get_microseconds_since(start);
+
+        // what every chunk would pay if samples were not kept
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                generate_terrain(chunk, &unprepared, x, y, 0);
+            }
+        }
+        direct_time = get_microseconds_since(start);
+
+        printf("biomes: %lld regions filled in %.2f ms, %.2f us each\n", region_side * region_side, fill_time / 1000.0, fill_time / (double)(region_side * region_side));
+        printf("biomes: %.3f us per chunk with one biome, %.3f us with cached climate (%.3f us counting region fills), %.3f us sampling noise for every chunk\n", single_time / (double)(side * side), cached_time / (double)(side * side), (cached_time + fill_time) / (double)(side * side), direct_time / (double)(side * side));
+        printf("biomes: chunks with plains at their first column %llu, desert %llu, highlands %llu\n", surfaces[bmt_plains], surfaces[bmt_desert], surfaces[bmt_highlands]);
+        fflush(stdout);
+
+        climates.uninitialize();
+        delete chunk;
+    }
+
+    // meshing a whole world against loading the same meshes back out of the mesh cache file after a restart
+    void benchmark_meshes() {
+        const char* path = "benchmark_meshes.bin";
+        const long long side = 32;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        mesh_cache meshes = mesh_cache();
+        std::chrono::steady_clock::time_point start;
+        double mesh_time, store_time, open_time, load_time;
+        float* destination = new float[mesh_arena_size / sizeof(float)]; // stands in for the gpu buffers
+        float* vertices;
+        unsigned long long body_length, seam_lengths[6];
+        unsigned long long found = 0, changed = 0;
+        mesh_record* record;
+        chunk_888* chunk;
+
+        pool.initialize(side * side, mtt::mtt_chunks);
+        w.initialize(&pool, 0, side, side, 1);
+        lighting.initialize(&w);
+        lighting.light_world();
+        unlink(path);
+
+        // what every chunk costs without the cache
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                for (unsigned int i = 0; i < ldt_count; i++) {
+                    w.get_chunk(x, y, 0)->mesh_to_memory((ldt)i, (float)x - 8.0f, (float)y - 8.0f, 0.0f, &vertices, &body_length, seam_lengths);
+                    get_mesh_arena()->reset();
+                }
+            }
+        }
+        mesh_time = get_microseconds_since(start);
+
+        meshes.initialize(path, 1 << 16);
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                meshes.store(w.get_chunk(x, y, 0), x, y, 0, (float)x - 8.0f, (float)y - 8.0f, 0.0f);
+            }
+        }
+        store_time = get_microseconds_since(start);
+        meshes.uninitialize();
+
+        // a fresh start, the file is indexed and mapped again
+        start = std::chrono::steady_clock::now();
+        meshes.initialize(path, 1 << 16);
+        open_time = get_microseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                chunk = w.get_chunk(x, y, 0);
+                record = meshes.find_mesh(x, y, 0, chunk->get_mesh_hash((float)x - 8.0f, (float)y - 8.0f, 0.0f));
+                if (record == 0) {
+                    continue;
+                }
+
+                vertices = (float*)(record + 1);
+                for (unsigned int i = 0; i < ldt_count; i++) {
+                    memcpy(destination, vertices, record->vertex_counts[i] * chunk_vertex_length * sizeof(float));
+                    vertices += record->vertex_counts[i] * chunk_vertex_length;
+                }
+                found++;
+            }
+        }
+        load_time = get_microseconds_since(start);
+
+        // a lamp on the surface relights its surroundings, every chunk it reached has to be meshed again
+        lighting.set_block_at(100, 100, w.get_surface_height(100, 100) + 1, bt::bt_lamp);
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                if (meshes.find_mesh(x, y, 0, w.get_chunk(x, y, 0)->get_mesh_hash((float)x - 8.0f, (float)y - 8.0f, 0.0f)) == 0) {
+                    changed++;
+                }
+            }
+        }
+
+        printf("meshes: %lld chunks meshed in %.2f ms, %.2f us each\n", side * side, mesh_time / 1000.0, mesh_time / (double)(side * side));
+        printf("meshes: meshed and written to disk in %.2f ms, %llu bytes\n", store_time / 1000.0, meshes.get_file_length());
+        printf("meshes: file reopened in %.2f ms, %llu of %lld chunks hashed and copied out in %.2f ms, %.2f us each\n", open_time / 1000.0, found, side * side, load_time / 1000.0, load_time / (double)(side * side));
+        printf("meshes: one lamp placed, %llu chunks no longer match their stored meshes\n", changed);
+        fflush(stdout);
+
+        meshes.uninitialize();
+        unlink(path);
+        delete[] destination;
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // every level of every chunk remeshed the way send_to_gpu used to do it and the way it does now, counting the bytes the cpu writes on the way to the gpu buffers
+    // the copy path meshed into a scratch buffer, copied the vertices and indices into staging storage, then glBufferData copied them again
+    // the mapped path writes the vertices and indices once, destination stands in for the mapped buffers
+    void benchmark_upload() {
+        const long long side = 32;
+        const unsigned int rounds = 4;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        std::chrono::steady_clock::time_point start;
+        float* staging = new float[mesh_arena_size / sizeof(float)];
+        unsigned int* staging_indices = new unsigned int[mesh_arena_size / sizeof(unsigned int)];
+        float* destination = new float[mesh_arena_size / sizeof(float)];
+        unsigned int* destination_indices = new unsigned int[mesh_arena_size / sizeof(unsigned int)];
+        float* vertices;
+        unsigned long long body_length, seam_lengths[6];
+        unsigned long long vertex_count;
+        unsigned long long copy_bytes = 0, mapped_bytes = 0;
+        double copy_time, mapped_time;
+
+        pool.initialize(side * side, mtt::mtt_chunks);
+        w.initialize(&pool, 0, side, side, 1);
+        lighting.initialize(&w);
+        lighting.light_world();
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < rounds; r++) {
+            for (long long x = 0; x < side; x++) {
+                for (long long y = 0; y < side; y++) {
+                    for (unsigned int i = 0; i < ldt_count; i++) {
+                        vertex_count = w.get_chunk(x, y, 0)->mesh_to_memory((ldt)i, (float)x - 8.0f, (float)y - 8.0f, 0.0f, &vertices, &body_length, seam_lengths);
+                        for (unsigned long long j = 0; j < vertex_count * chunk_vertex_length; j++) {
+                            staging[j] = vertices[j];
+                        }
+                        for (unsigned long long j = 0; j < vertex_count; j++) {
+                            staging_indices[j] = (unsigned int)j;
+                        }
+                        memcpy(destination, staging, vertex_count * chunk_vertex_length * sizeof(float));
+                        memcpy(destination_indices, staging_indices, vertex_count * sizeof(unsigned int));
+                        get_mesh_arena()->reset();
+
+                        copy_bytes += vertex_count * ((3 * chunk_vertex_length * sizeof(float)) + (2 * sizeof(unsigned int)));
+                    }
+                }
+            }
+        }
+        copy_time = get_microseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < rounds; r++) {
+            for (long long x = 0; x < side; x++) {
+                for (long long y = 0; y < side; y++) {
+                    for (unsigned int i = 0; i < ldt_count; i++) {
+                        vertex_count = w.get_chunk(x, y, 0)->mesh_to_memory((ldt)i, (float)x - 8.0f, (float)y - 8.0f, 0.0f, &vertices, &body_length, seam_lengths);
+                        for (unsigned long long j = 0; j < vertex_count; j++) {
+                            destination_indices[j] = (unsigned int)j;
+                        }
+                        get_mesh_arena()->reset();
+
+                        mapped_bytes += vertex_count * ((chunk_vertex_length * sizeof(float)) + sizeof(unsigned int));
+                    }
+                }
+            }
+        }
+        mapped_time = get_microseconds_since(start);
+
+        printf("upload: copy path %.1f KiB written per chunk remesh in %.2f us\n", (double)copy_bytes / (double)(side * side * rounds) / 1024.0, copy_time / (double)(side * side * rounds));
+        printf("upload: mapped path %.1f KiB written per chunk remesh in %.2f us\n", (double)mapped_bytes / (double)(side * side * rounds) / 1024.0, mapped_time / (double)(side * side * rounds));
+        printf("upload: %.2fx fewer bytes written, %.2fx faster, times are machine dependent and leave out the driver\n", (double)copy_bytes / (double)mapped_bytes, copy_time / mapped_time);
+        fflush(stdout);
+
+        delete[] destination_indices;
+        delete[] destination;
+        delete[] staging_indices;
+        delete[] staging;
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // triangles drawn with the camera in the middle of a large world as the view distance doubles, with the levels of detail the game picks and with every chunk at full detail
+    void benchmark_lod() {
+        const long long side = 128;
+        const float lod_distance = 4.0f;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        glm::vec3 camera = glm::vec3((float)side / 2.0f, (float)side / 2.0f, 1.0f);
+        ldt* chunk_lods = new ldt[side * side];
+        float* distances = new float[side * side];
+        unsigned long long chunk_count, triangles, full_triangles;
+        unsigned long long level_counts[ldt_count];
+
+        pool.initialize(side * side, mtt::mtt_chunks);
+        w.initialize(&pool, 0, side, side, 1);
+
+        for (long long x = 0; x < side; x++) {
+            for (long long y = 0; y < side; y++) {
+                distances[x + (y * side)] = glm::distance(camera, glm::vec3((float)x + 0.5f, (float)y + 0.5f, 0.5f));
+                chunk_lods[x + (y * side)] = select_lod(distances[x + (y * side)], lod_distance);
+            }
+        }
+
+        for (float view_distance = lod_distance; view_distance <= (float)side / 2.0f; view_distance *= 2.0f) {
+            chunk_count = 0;
+            triangles = 0;
+            full_triangles = 0;
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                level_counts[i] = 0;
+            }
+
+            for (long long x = 0; x < side; x++) {
+                for (long long y = 0; y < side; y++) {
+                    if (distances[x + (y * side)] >= view_distance) {
+                        continue;
+                    }
+
+                    chunk_count++;
+                    level_counts[chunk_lods[x + (y * side)]]++;
+                    triangles += w.get_chunk(x, y, 0)->triangle_count(chunk_lods[x + (y * side)], get_seam_mask(chunk_lods, side, side, x, y));
+                    full_triangles += w.get_chunk(x, y, 0)->triangle_count(ldt::ldt_full, 0);
+                }
+            }
+
+            printf("lod: view distance %3.0f chunks, %5llu chunks (%llu / %llu / %llu / %llu by level), %8llu triangles, %9llu at full detail\n", view_distance, chunk_count, level_counts[ldt::ldt_full], level_counts[ldt::ldt_half], level_counts[ldt::ldt_quarter], level_counts[ldt::ldt_eighth], triangles, full_triangles);
+        }
+        fflush(stdout);
+
+        delete[] distances;
+        delete[] chunk_lods;
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // the same chunks meshed for both render paths, every level of detail
+    void benchmark_faces() {
+        const long long side = 32;
+        const unsigned int rounds = 4;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        light_engine lighting = light_engine();
+        std::chrono::steady_clock::time_point start;
+        double vertex_time, face_time;
+        float* vertices;
+        face_record* faces;
+        unsigned long long body_length, seam_lengths[6];
+        unsigned long long vertex_bytes = 0, face_bytes = 0;
+
+        pool.initialize(side * side, mtt::mtt_chunks);
+        w.initialize(&pool, 0, side, side, 1);
+        lighting.initialize(&w);
+        lighting.light_world();
+
+        // vertices and their indices, as chunk_888::send_to_gpu uploads them
+        start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < rounds; r++) {
+            for (long long x = 0; x < side; x++) {
+                for (long long y = 0; y < side; y++) {
+                    for (unsigned int i = 0; i < ldt_count; i++) {
+                        vertex_bytes += w.get_chunk(x, y, 0)->mesh_to_memory((ldt)i, (float)x - 8.0f, (float)y - 8.0f, 0.0f, &vertices, &body_length, seam_lengths) * ((chunk_vertex_length * sizeof(float)) + sizeof(unsigned int));
+                        get_mesh_arena()->reset();
+                    }
+                }
+            }
+        }
+        vertex_time = get_microseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < rounds; r++) {
+            for (long long x = 0; x < side; x++) {
+                for (long long y = 0; y < side; y++) {
+                    for (unsigned int i = 0; i < ldt_count; i++) {
+                        face_bytes += w.get_chunk(x, y, 0)->faces_to_memory((ldt)i, &faces, &body_length, seam_lengths) * sizeof(face_record);
+                        get_mesh_arena()->reset();
+                    }
+                }
+            }
+        }
+        face_time = get_microseconds_since(start);
+
+        vertex_bytes /= rounds;
+        face_bytes /= rounds;
+
+        printf("faces: %lld chunks, vertices meshed in %.2f us per chunk into %llu bytes\n", side * side, vertex_time / (double)(side * side * rounds), vertex_bytes);
+        printf("faces: %lld chunks, face records meshed in %.2f us per chunk into %llu bytes\n", side * side, face_time / (double)(side * side * rounds), face_bytes);
+        printf("faces: %.1fx less mesh memory, meshing face records takes %.2fx as long as vertices\n", (double)vertex_bytes / (double)face_bytes, face_time / vertex_time);
+        fflush(stdout);
+
+        lighting.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // the face writer as it was before the face tables, what emit_face is measured against
+    void write_vertex_branching(float* vertices, unsigned int index, float x, float y, float z, tvt texture_coord, unsigned char light, unsigned char ambient_occlusion) {
+        vertices[index] = x;
+        vertices[index + 1] = y;
+        vertices[index + 2] = z;
+
+        if (texture_coord == tvt::tvt_bottom_left) {
+            vertices[index + 3] = 0.0f;
+            vertices[index + 4] = 0.0f;
+        } else if (texture_coord == tvt::tvt_bottom_right) {
+            vertices[index + 3] = 1.0f;
+            vertices[index + 4] = 0.0f;
+        } else if (texture_coord == tvt::tvt_top_left) {
+            vertices[index + 3] = 0.0f;
+            vertices[index + 4] = 1.0f;
+        } else if (texture_coord == tvt::tvt_top_right) {
+            vertices[index + 3] = 1.0f;
+            vertices[index + 4] = 1.0f;
+        }
+
+        vertices[index + 5] = (float)get_sunlight(light) / 15.0f;
+        vertices[index + 6] = (float)get_block_light(light) / 15.0f;
+        vertices[index + 7] = (float)ambient_occlusion / 3.0f;
+    }
+
+    void write_vertex_on_cube_branching(float* vertices, unsigned int* index, float x, float y, float z, float l, tvt texture_vertex_type, cvt cube_vertex_type, unsigned char light, unsigned char ambient_occlusion) {
+        if (cube_vertex_type == cvt::cvt_bottom_left_front) {
+            write_vertex_branching(vertices, *index, x, y, z, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_bottom_right_front) {
+            write_vertex_branching(vertices, *index, x + l, y, z, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_top_left_front) {
+            write_vertex_branching(vertices, *index, x, y + l, z, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_top_right_front) {
+            write_vertex_branching(vertices, *index, x + l, y + l, z, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_bottom_left_back) {
+            write_vertex_branching(vertices, *index, x, y, z - l, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_bottom_right_back) {
+            write_vertex_branching(vertices, *index, x + l, y, z - l, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_top_left_back) {
+            write_vertex_branching(vertices, *index, x, y + l, z - l, texture_vertex_type, light, ambient_occlusion);
+        } else if (cube_vertex_type == cvt::cvt_top_right_back) {
+            write_vertex_branching(vertices, *index, x + l, y + l, z - l, texture_vertex_type, light, ambient_occlusion);
+        }
+
+        *index += chunk_vertex_length;
+    }
+
+    void write_face_branching(float* vertices, unsigned int* index, float x, float y, float z, float l, st2 surface_type, unsigned char light, unsigned char* ambient_occlusion) {
+        const cvt* corners = st2_corners[surface_type];
+        tvt order[] = {
+            tvt::tvt_bottom_left,
+            tvt::tvt_bottom_right,
+            tvt::tvt_top_left,
+            tvt::tvt_top_right,
+            tvt::tvt_bottom_right,
+            tvt::tvt_top_left
+        };
+        tvt flipped_order[] = {
+            tvt::tvt_bottom_left,
+            tvt::tvt_bottom_right,
+            tvt::tvt_top_right,
+            tvt::tvt_bottom_left,
+            tvt::tvt_top_right,
+            tvt::tvt_top_left
+        };
+        tvt* vertex_order = order;
+
+        if (ambient_occlusion[tvt::tvt_bottom_left] + ambient_occlusion[tvt::tvt_top_right] > ambient_occlusion[tvt::tvt_bottom_right] + ambient_occlusion[tvt::tvt_top_left]) {
+            vertex_order = flipped_order;
+        }
+
+        for (unsigned int i = 0; i < 6; i++) {
+            write_vertex_on_cube_branching(vertices, index, x, y, z, l, vertex_order[i], corners[vertex_order[i]], light, ambient_occlusion[vertex_order[i]]);
+        }
+    }
+
+    // a shuffled stream of faces, every surface, light and occlusion, written with the old branching writer and with the face tables
+    // both have to write exactly the same floats
+    void benchmark_emit() {
+        const unsigned int face_count = 1 << 16;
+        const unsigned int rounds = 32;
+        unsigned char* surfaces = new unsigned char[face_count];
+        unsigned char* lights = new unsigned char[face_count];
+        unsigned char* occlusions = new unsigned char[face_count * 4];
+        float* positions = new float[face_count * 3];
+        float* branching_vertices = new float[face_count * 6 * chunk_vertex_length];
+        float* table_vertices = new float[face_count * 6 * chunk_vertex_length];
+        std::mt19937 random(47);
+        std::chrono::steady_clock::time_point start;
+        double branching_time, table_time;
+        unsigned int index;
+
+        for (unsigned int i = 0; i < face_count; i++) {
+            surfaces[i] = random() % 6;
+            lights[i] = random() & 0xFF;
+            for (unsigned int j = 0; j < 4; j++) {
+                occlusions[(i * 4) + j] = random() % 4;
+            }
+            for (unsigned int j = 0; j < 3; j++) {
+                positions[(i * 3) + j] = (float)(random() % 8) / 8.0f - 8.0f;
+            }
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < rounds; r++) {
+            index = 0;
+            for (unsigned int i = 0; i < face_count; i++) {
+                write_face_branching(branching_vertices, &index, positions[i * 3], positions[(i * 3) + 1], positions[(i * 3) + 2], 1.0f / 8.0f, (st2)surfaces[i], lights[i], &occlusions[i * 4]);
+            }
+        }
+        branching_time = get_microseconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned int r = 0; r < rounds; r++) {
+            index = 0;
+            for (unsigned int i = 0; i < face_count; i++) {
+                lit_face_emitters[surfaces[i]](table_vertices, &index, positions[i * 3], positions[(i * 3) + 1], positions[(i * 3) + 2], 1.0f / 8.0f, lights[i], &occlusions[i * 4]);
+            }
+        }
+        table_time = get_microseconds_since(start);
+
+        printf("emit: %u faces, branching writer %.2f ns per face\n", face_count, branching_time * 1000.0 / (double)(face_count * rounds));
+        printf("emit: %u faces, face tables %.2f ns per face\n", face_count, table_time * 1000.0 / (double)(face_count * rounds));
+        printf("emit: %.2fx faster, output %s\n", branching_time / table_time, memcmp(branching_vertices, table_vertices, face_count * 6 * chunk_vertex_length * sizeof(float)) == 0 ? "identical" : "DIFFERS");
+        fflush(stdout);
+
+        delete[] table_vertices;
+        delete[] branching_vertices;
+        delete[] positions;
+        delete[] occlusions;
+        delete[] lights;
+        delete[] surfaces;
+    }
+
+    // the agent rules from navigation.hpp checked block by block on the world
+    bool is_walkable_reference(world* w, long long x, long long y, long long z) {
+        return w->is_solid_at(x, y, z - 1) && !w->is_solid_at(x, y, z) && !w->is_solid_at(x, y, z + 1);
+    }
+
+    bool can_step_reference(world* w, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+        long long distance = (x1 < x2 ? x2 - x1 : x1 - x2) + (y1 < y2 ? y2 - y1 : y1 - y2);
+
+        if (distance != 1 || z2 < z1 - 1 || z2 > z1 + 1 || !is_walkable_reference(w, x1, y1, z1) || !is_walkable_reference(w, x2, y2, z2)) {
+            return false;
+        }
+
+        if (z2 == z1 + 1) {
+            return !w->is_solid_at(x1, y1, z1 + 2);
+        }
+        if (z2 == z1 - 1) {
+            return !w->is_solid_at(x2, y2, z2 + 2);
+        }
+
+        return true;
+    }
+
+    // plain a* over every block of the world, the fewest steps between two cells or -1
+    // open entries are (f << 32) | cell in a min heap, stale ones are skipped when popped
+    long long find_path_reference(world* w, unsigned int* g, unsigned int* stamps, unsigned int stamp, unsigned long long* heap, unsigned long long heap_capacity, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+        long long width = w->get_width() * 8;
+        long long length = w->get_length() * 8;
+        long long origin_x = w->get_origin_x() * 8;
+        long long origin_y = w->get_origin_y() * 8;
+        unsigned long long heap_count = 0;
+        unsigned long long entry;
+        unsigned int cell, next, f;
+        long long x, y, z, next_x, next_y;
+
+        cell = (unsigned int)((x1 - origin_x) + ((y1 - origin_y) * width) + (z1 * width * length));
+        g[cell] = 0;
+        stamps[cell] = stamp;
+        heap[0] = ((unsigned long long)((x1 < x2 ? x2 - x1 : x1 - x2) + (y1 < y2 ? y2 - y1 : y1 - y2)) << 32) | cell;
+        heap_count = 1;
+
+        while (heap_count > 0) {
+            std::pop_heap(heap, heap + heap_count, std::greater<unsigned long long>());
+            heap_count--;
+            entry = heap[heap_count];
+            cell = (unsigned int)entry;
+            x = origin_x + (cell % width);
+            y = origin_y + ((cell / width) % length);
+            z = cell / (width * length);
+            if ((entry >> 32) != g[cell] + (unsigned long long)((x < x2 ? x2 - x : x - x2) + (y < y2 ? y2 - y : y - y2))) {
+                continue;
+            }
+            if (x == x2 && y == y2 && z == z2) {
+                return g[cell];
+            }
+
+            for (unsigned int i = 0; i < 4; i++) {
+                next_x = x + st2_offsets[navigation_sides[i]][0];
+                next_y = y + st2_offsets[navigation_sides[i]][1];
+
+                for (long long next_z = z - 1; next_z <= z + 1; next_z++) {
+                    if (!can_step_reference(w, x, y, z, next_x, next_y, next_z)) {
+                        continue;
+                    }
+
+                    next = (unsigned int)((next_x - origin_x) + ((next_y - origin_y) * width) + (next_z * width * length));
+                    if (stamps[next] == stamp && g[next] <= g[cell] + 1) {
+                        continue;
+                    }
+                    if (heap_count == heap_capacity) {
+                        return -1;
+                    }
+
+                    stamps[next] = stamp;
+                    g[next] = g[cell] + 1;
+                    f = g[next] + (unsigned int)((next_x < x2 ? x2 - next_x : next_x - x2) + (next_y < y2 ? y2 - next_y : next_y - y2));
+                    heap[heap_count] = ((unsigned long long)f << 32) | next;
+                    heap_count++;
+                    std::push_heap(heap, heap + heap_count, std::greater<unsigned long long>());
+                }
+            }
+        }
+
+        return -1;
+    }
+
+    // a flat world with walls agents have to go around and platforms they can step onto, then random trips 32 to 128 blocks long
+    // every path is walked with the reference rules, and some are checked against plain a* for how many steps they waste
+    void benchmark_navigation() {
+        const unsigned long long trip_count = 4000;
+        const unsigned long long reference_count = 200;
+        const unsigned long long edit_count = 500;
+        slab_pool<chunk_888> pool = slab_pool<chunk_888>();
+        world w = world();
+        navigator navigation = navigator();
+        std::mt19937 random(49);
+        std::chrono::steady_clock::time_point start;
+        long long* trips = new long long[trip_count * 6];
+        long long* lengths = new long long[trip_count];
+        double* samples = new double[edit_count];
+        unsigned int* g;
+        unsigned int* stamps;
+        unsigned long long* heap;
+        unsigned long long cell_count, heap_capacity;
+        long long requests[max_path_requests];
+        unsigned long long submitted, found = 0, invalid = 0, total_steps = 0, reference_found = 0, reference_steps = 0, hierarchical_steps = 0, mismatched = 0;
+        double build_time, hierarchical_time, reference_time;
+        long long size, x, y, z, x2, y2, distance, steps;
+        long long cell[3], previous[3];
+        unsigned int batch;
+
+        pool.initialize(32 * 32 * 2, mtt::mtt_chunks);
+        w.initialize(&pool, 0, 32, 32, 2);
+        size = w.get_width() * 8;
+
+        // ground at 3, walls 3 high, platforms 1 high with a few second tiers on top
+        w.fill_box(0, 0, 0, size - 1, size - 1, 3, bt::bt_stone);
+        w.fill_box(0, 0, 4, size - 1, size - 1, (w.get_height() * 8) - 1, bt::bt_air);
+        for (unsigned int i = 0; i < 400; i++) {
+            x = random() % size;
+            y = random() % size;
+            distance = 4 + (random() % 21);
+            if (i % 2 == 0) {
+                w.fill_box(x, y, 4, x + distance, y, 6, bt::bt_stone);
+            } else {
+                w.fill_box(x, y, 4, x, y + distance, 6, bt::bt_stone);
+            }
+        }
+        for (unsigned int i = 0; i < 300; i++) {
+            x = random() % size;
+            y = random() % size;
+            distance = 3 + (random() % 8);
+            w.fill_box(x, y, 4, x + distance, y + distance, 4, bt::bt_dirt);
+            if (i % 3 == 0) {
+                w.fill_box(x + 1, y + 1, 5, x + distance - 1, y + distance - 1, 5, bt::bt_dirt);
+            }
+        }
+
+        start = std::chrono::steady_clock::now();
+        navigation.initialize(&w);
+        build_time = get_microseconds_since(start) / 1000.0;
+
+        for (unsigned long long i = 0; i < trip_count; i++) {
+            do {
+                x = random() % size;
+                y = random() % size;
+                x2 = random() % size;
+                y2 = random() % size;
+                distance = (x < x2 ? x2 - x : x - x2) + (y < y2 ? y2 - y : y - y2);
+            } while (distance < 32 || distance > 128);
+
+            trips[(i * 6) + 0] = x;
+            trips[(i * 6) + 1] = y;
+            trips[(i * 6) + 2] = w.get_surface_height(x, y) + 1;
+            trips[(i * 6) + 3] = x2;
+            trips[(i * 6) + 4] = y2;
+            trips[(i * 6) + 5] = w.get_surface_height(x2, y2) + 1;
+        }
+
+        // a batch at a time through the search thread, every path is walked step by step
+        start = std::chrono::steady_clock::now();
+        for (submitted = 0; submitted < trip_count; submitted += batch) {
+            batch = trip_count - submitted < max_path_requests ? (unsigned int)(trip_count - submitted) : max_path_requests;
+            for (unsigned int i = 0; i < batch; i++) {
+                requests[i] = navigation.request_path(trips[(submitted + i) * 6], trips[((submitted + i) * 6) + 1], trips[((submitted + i) * 6) + 2], trips[((submitted + i) * 6) + 3], trips[((submitted + i) * 6) + 4], trips[((submitted + i) * 6) + 5]);
+            }
+            navigation.update();
+            navigation.wait();
+            navigation.update();
+
+            for (unsigned int i = 0; i < batch; i++) {
+                lengths[submitted + i] = -1;
+                if (navigation.get_path_status(requests[i]) == pst::pst_found) {
+                    lengths[submitted + i] = navigation.get_path_length(requests[i]) - 1;
+                }
+            }
+            for (unsigned int i = 0; i < batch; i++) {
+                navigation.release_path(requests[i]);
+            }
+        }
+        hierarchical_time = get_microseconds_since(start);
+
+        // walk every path again, which means searching them all a second time outside the timing
+        for (submitted = 0; submitted < trip_count; submitted += batch) {
+            batch = trip_count - submitted < max_path_requests ? (unsigned int)(trip_count - submitted) : max_path_requests;
+            for (unsigned int i = 0; i < batch; i++) {
+                requests[i] = navigation.request_path(trips[(submitted + i) * 6], trips[((submitted + i) * 6) + 1], trips[((submitted + i) * 6) + 2], trips[((submitted + i) * 6) + 3], trips[((submitted + i) * 6) + 4], trips[((submitted + i) * 6) + 5]);
+            }
+            navigation.update();
+            navigation.wait();
+            navigation.update();
+
+            for (unsigned int i = 0; i < batch; i++) {
+                if (navigation.get_path_status(requests[i]) == pst::pst_found) {
+                    found++;
+                    total_steps += navigation.get_path_length(requests[i]) - 1;
+                    navigation.get_path_cell(requests[i], 0, &previous[0], &previous[1], &previous[2]);
+                    if (previous[0] != trips[(submitted + i) * 6] || previous[1] != trips[((submitted + i) * 6) + 1] || previous[2] != trips[((submitted + i) * 6) + 2]) {
+                        invalid++;
+                    }
+
+                    for (unsigned int j = 1; j < navigation.get_path_length(requests[i]); j++) {
+                        navigation.get_path_cell(requests[i], j, &cell[0], &cell[1], &cell[2]);
+                        if (!can_step_reference(&w, previous[0], previous[1], previous[2], cell[0], cell[1], cell[2])) {
+                            invalid++;
+
+                            break;
+                        }
+
+                        previous[0] = cell[0];
+                        previous[1] = cell[1];
+                        previous[2] = cell[2];
+                    }
+
+                    if (previous[0] != trips[((submitted + i) * 6) + 3] || previous[1] != trips[((submitted + i) * 6) + 4] || previous[2] != trips[((submitted + i) * 6) + 5]) {
+                        invalid++;
+                    }
+                }
+
+                navigation.release_path(requests[i]);
+            }
+        }
+
+        printf("navigation: %lld x %lld x %lld block world, graph of %llu portals built in %.2f ms\n", size, size, w.get_height() * 8, navigation.get_portal_count(), build_time);
+        printf("navigation: %llu trips 32 to 128 blocks apart, %.0f paths/sec on the search thread, %.1f%% found, mean %.1f steps, %s\n", trip_count, (double)trip_count * 1000000.0 / hierarchical_time, (double)found * 100.0 / (double)trip_count, found > 0 ? (double)total_steps / (double)found : 0.0, invalid == 0 ? "every path walkable" : "INVALID PATHS");
+
+        // plain a* on the first few trips
+        cell_count = (unsigned long long)(size * size * w.get_height() * 8);
+        heap_capacity = cell_count * 2;
+        g = new unsigned int[cell_count];
+        stamps = new unsigned int[cell_count];
+        heap = new unsigned long long[heap_capacity];
+        for (unsigned long long i = 0; i < cell_count; i++) {
+            stamps[i] = 0;
+        }
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < reference_count; i++) {
+            steps = find_path_reference(&w, g, stamps, (unsigned int)(i + 1), heap, heap_capacity, trips[i * 6], trips[(i * 6) + 1], trips[(i * 6) + 2], trips[(i * 6) + 3], trips[(i * 6) + 4], trips[(i * 6) + 5]);
+            if ((steps >= 0) != (lengths[i] >= 0)) {
+                mismatched++;
+            }
+            if (steps >= 0 && lengths[i] >= 0) {
+                reference_found++;
+                reference_steps += steps;
+                hierarchical_steps += lengths[i];
+            }
+        }
+        reference_time = get_microseconds_since(start);
+
+        printf("navigation: plain a* %.0f paths/sec, hierarchical %.1fx faster, paths %.1f%% longer, %llu of %llu trips disagree on reachability, times are machine dependent\n", (double)reference_count * 1000000.0 / reference_time, (reference_time / (double)reference_count) / (hierarchical_time / (double)trip_count), reference_steps > 0 ? ((double)hierarchical_steps - (double)reference_steps) * 100.0 / (double)reference_steps : 0.0, mismatched, reference_count);
+
+        // one block changes, then the next update rebuilds what it touched
+        for (unsigned long long i = 0; i < edit_count; i++) {
+            x = random() % size;
+            y = random() % size;
+            z = 4 + (random() % 3);
+            w.set_block_at(x, y, z, w.is_solid_at(x, y, z) ? bt::bt_air : bt::bt_stone);
+
+            start = std::chrono::steady_clock::now();
+            navigation.update();
+            samples[i] = get_microseconds_since(start);
+        }
+        print_timings("navigation: rebuild after one block edit", samples, edit_count);
+        navigation.print();
+
+        delete[] heap;
+        delete[] stamps;
+        delete[] g;
+        delete[] samples;
+        delete[] lengths;
+        delete[] trips;
+        navigation.uninitialize();
+        w.uninitialize(&pool);
+        pool.uninitialize();
+    }
+
+    // a server and a few clients in one process over loopback, chunks stream under a tight bandwidth budget then random edits are replicated as deltas
+    // every client's copy of the world is checked against the server's at the end
+    void benchmark_network() {
+        const unsigned int client_count = 4;
+        const unsigned long long edit_ticks = 120;
+        const unsigned long long edits_per_tick = 32;
+        world_server server = world_server();
+        slab_pool<chunk_888> pools[client_count];
+        world worlds[client_count];
+        light_engine lightings[client_count];
+        server_connection clients[client_count];
+        std::mt19937 random_number_generator(1);
+        std::chrono::steady_clock::time_point start;
+        double stream_time, edit_time;
+        unsigned long long stream_ticks = 0;
+        unsigned long long mismatches = 0;
+        unsigned long long changes = 0;
+        long long x, y, z;
+        bool done = false;
+
+        server.set_bandwidth(64.0 * 1024.0);
+        if (server.initialize(0) != et::et_no_error) {
+            server.uninitialize();
+            return;
+        }
+
+        for (unsigned int i = 0; i < client_count; i++) {
+            pools[i].initialize(64, mtt::mtt_chunks);
+            worlds[i].set_remote(true);
+            worlds[i].initialize(&pools[i], 0, 8, 8, 1);
+            lightings[i].initialize(&worlds[i]);
+            lightings[i].light_world();
+            clients[i].initialize("127.0.0.1", server.get_port(), &worlds[i]);
+        }
+
+        // stream every client's window
+        start = std::chrono::steady_clock::now();
+        while (!done && stream_ticks < 10000) {
+            server.tick();
+            stream_ticks++;
+
+            done = true;
+            for (unsigned int i = 0; i < client_count; i++) {
+                clients[i].receive(&worlds[i], &lightings[i]);
+                done = done && clients[i].get_held_count() == worlds[i].get_width() * worlds[i].get_length();
+            }
+        }
+        stream_time = get_microseconds_since(start);
+
+        // edits all over the clients' windows, each tick's edits reach the clients as one batch
+        start = std::chrono::steady_clock::now();
+        for (unsigned long long tick = 0; tick < edit_ticks + 4; tick++) {
+            for (unsigned long long i = 0; i < edits_per_tick && tick < edit_ticks; i++) {
+                x = random_number_generator() % 64;
+                y = random_number_generator() % 64;
+                z = random_number_generator() % 8;
+                server.set_block_at(x, y, z, random_number_generator() % 2 == 0 ? bt::bt_air : bt::bt_stone);
+            }
+
+            server.tick();
+            for (unsigned int i = 0; i < client_count; i++) {
+                clients[i].receive(&worlds[i], &lightings[i]);
+            }
+        }
+        edit_time = get_microseconds_since(start);
+
+        for (unsigned int i = 0; i < client_count; i++) {
+            for (x = 0; x < 64; x++) {
+                for (y = 0; y < 64; y++) {
+                    for (z = 0; z < 8; z++) {
+                        if (worlds[i].get_block_at(x, y, z) != server.get_world()->get_block_at(x, y, z) || worlds[i].get_fluid_at(x, y, z) != server.get_world()->get_fluid_at(x, y, z)) {
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+            changes += clients[i].get_changes_received();
+        }
+
+        printf("network: %u clients streamed %lld chunks each in %llu ticks (%.2f simulated seconds at 64 KiB/s), %.2f ms\n", client_count, worlds[0].get_width() * worlds[0].get_length(), stream_ticks, (double)stream_ticks / 60.0, stream_time / 1000.0);
+        printf("network: %llu edits over %llu ticks, %llu changes received across clients, %.2f us per tick\n", edit_ticks * edits_per_tick, edit_ticks, changes, edit_time / (double)(edit_ticks + 4));
+        printf("network: %llu blocks differ between the clients and the server\n", mismatches);
+        fflush(stdout);
+        server.print();
+
+        for (unsigned int i = 0; i < client_count; i++) {
+            clients[i].uninitialize();
+            lightings[i].uninitialize();
+            worlds[i].uninitialize(&pools[i]);
+            pools[i].uninitialize();
+        }
+        server.uninitialize();
+    }
+
+    // returns false when no benchmark has that name
+    bool run_benchmark(char* name) {
+        bool all = strcmp(name, "all") == 0;
+        bool found = all;
+
+        if (all || strcmp(name, "lighting") == 0) {
+            benchmark_lighting();
+            found = true;
+        }
+        if (all || strcmp(name, "surface") == 0) {
+            benchmark_surface();
+            found = true;
+        }
+        if (all || strcmp(name, "collision") == 0) {
+            benchmark_collision();
+            found = true;
+        }
+        if (all || strcmp(name, "ticks") == 0) {
+            benchmark_ticks();
+            found = true;
+        }
+        if (all || strcmp(name, "fluids") == 0) {
+            benchmark_fluids();
+            found = true;
+        }
+        if (all || strcmp(name, "edits") == 0) {
+            benchmark_edits();
+            found = true;
+        }
+        if (all || strcmp(name, "streaming") == 0) {
+            benchmark_streaming();
+            found = true;
+        }
+        if (all || strcmp(name, "generation") == 0) {
+            benchmark_generation();
+            found = true;
+        }
+        if (all || strcmp(name, "biomes") == 0) {
+            benchmark_biomes();
+            found = true;
+        }
+        if (all || strcmp(name, "meshes") == 0) {
+            benchmark_meshes();
+            found = true;
+        }
+        if (all || strcmp(name, "upload") == 0) {
+            benchmark_upload();
+            found = true;
+        }
+        if (all || strcmp(name, "lod") == 0) {
+            benchmark_lod();
+            found = true;
+        }
+        if (all || strcmp(name, "faces") == 0) {
+            benchmark_faces();
+            found = true;
+        }
+        if (all || strcmp(name, "emit") == 0) {
+            benchmark_emit();
+            found = true;
+        }
+        if (all || strcmp(name, "navigation") == 0) {
+            benchmark_navigation();
+            found = true;
+        }
+        if (all || strcmp(name, "network") == 0) {
+            benchmark_network();
+            found = true;
+        }
+
+        return found;
+    }
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace abradinjapan::voxelize {
+    // blocks between climate samples, columns in between are interpolated
+    const long long climate_spacing = 4;
+
+    // blocks along each side of a cached region of samples, a multiple of both the spacing and a chunk
+    const long long climate_region_size = 64;
+
+    // samples along each side of a region, the last row and column are shared with the next region over
+    const long long climate_region_samples = (climate_region_size / climate_spacing) + 1;
+
+    // how far apart climates change, in blocks
+    const float climate_scale = 1.0f / 192.0f;
+
+    // each value runs from -1 to 1
+    struct climate {
+        float temperature;
+        float humidity;
+        float continentalness;
+    };
+
+    // biome type
+    enum bmt {
+        bmt_plains,
+        bmt_desert,
+        bmt_highlands,
+        bmt_count
+    };
+
+    struct biome {
+        climate centre; // where the biome is strongest
+        float base_height; // in blocks
+        float height_range; // how far the rolling ground goes above and below the base
+        unsigned short surface_block;
+        unsigned short filler_block; // the few layers under the surface
+    };
+
+    // plains on their own give the terrain as it was before biomes
+    const biome biomes[bmt_count] = {
+        { { 0.0f, 0.2f, -0.1f }, 4.0f, 4.0f, bt::bt_grass, bt::bt_dirt },
+        { { 0.7f, -0.6f, -0.1f }, 3.0f, 1.0f, bt::bt_sand, bt::bt_sand },
+        { { -0.3f, 0.0f, 0.7f }, 6.0f, 2.0f, bt::bt_stone, bt::bt_stone },
+    };
+
+    // how much further than the nearest biome's centre another biome can be and still blend in, in climate units
+    // anywhere further from a border than this is a single biome, which terrain generates without blending
+    const float biome_blend_width = 0.25f;
+
+    // the noise behind one climate sample, the same grid point and seed always give the same climate
+    climate get_climate_sample(long long grid_x, long long grid_y, unsigned long long seed) {
+        glm::vec2 position = glm::vec2((float)(grid_x * climate_spacing), (float)(grid_y * climate_spacing)) * climate_scale;
+        glm::vec2 offset = glm::vec2((float)((seed >> 8) & 0xFFF), (float)((seed >> 20) & 0xFFF));
+        climate output;
+
+        // each field is offset by its own distance so they do not line up
+        output.temperature = glm::simplex(position + offset);
+        output.humidity = glm::simplex(position + offset + glm::vec2(317.0f, 89.0f));
+        output.continentalness = glm::simplex((position * 0.5f) + offset + glm::vec2(-151.0f, 443.0f));
+
+        return output;
+    }
+
+    // weights for every biome at a climate, they add up to 1 and the nearest biome always has some
+    void get_biome_weights(climate* input, float* weights) {
+        float distances[bmt_count];
+        float nearest = 0.0f;
+        float total = 0.0f;
+
+        for (unsigned int i = 0; i < bmt_count; i++) {
+            distances[i] = glm::length(glm::vec3(input->temperature - biomes[i].centre.temperature, input->humidity - biomes[i].centre.humidity, input->continentalness - biomes[i].centre.continentalness));
+
+            if (i == 0 || distances[i] < nearest) {
+                nearest = distances[i];
+            }
+        }
+
+        for (unsigned int i = 0; i < bmt_count; i++) {
+            weights[i] = distances[i] - nearest < biome_blend_width ? 1.0f - ((distances[i] - nearest) / biome_blend_width) : 0.0f;
+            total += weights[i];
+        }
+
+        for (unsigned int i = 0; i < bmt_count; i++) {
+            weights[i] /= total;
+        }
+    }
+
+    // everything terrain needs from a climate, worked out at the samples only and interpolated for the columns between them
+    struct biome_blend {
+        float weights[bmt_count];
+        float base_height;
+        float height_range;
+    };
+
+    void get_biome_blend(climate* input, biome_blend* output) {
+        get_biome_weights(input, output->weights);
+
+        output->base_height = 0.0f;
+        output->height_range = 0.0f;
+        for (unsigned int i = 0; i < bmt_count; i++) {
+            output->base_height += output->weights[i] * biomes[i].base_height;
+            output->height_range += output->weights[i] * biomes[i].height_range;
+        }
+    }
+
+    // the samples of one region, filled all at once the first time a chunk in it is generated
+    struct climate_region {
+        long long x, y; // region coordinates
+        bool present;
+        unsigned long long last_used;
+        biome_blend samples[climate_region_samples * climate_region_samples]; // blended once at fill time, chunks only copy them
+    };
+
+    // climate noise is only evaluated every few blocks and kept per region, so generating a chunk costs a few lerps per block column instead of noise
+    // regions are filled and dropped on the calling thread only, reading samples never changes the map so generation jobs can read it together
+    class climate_map {
+        climate_region* m_regions = 0;
+        unsigned long long m_region_count = 0;
+        keyed_table m_table; // region coordinates to region indices
+        unsigned long long m_clock = 0;
+        unsigned long long m_seed = 1;
+        unsigned long long m_hits = 0;
+        unsigned long long m_fills = 0;
+
+        long long get_region_coordinate(long long block) {
+            return block >= 0 ? block / climate_region_size : ((block + 1) / climate_region_size) - 1;
+        }
+
+        // returns 0 when the region is not filled
+        climate_region* find(long long x, long long y) {
+            long long index = m_table.find(x, y, 0);
+
+            return index == -1 ? 0 : &m_regions[index];
+        }
+
+    public:
+        // keep at least as many regions as one batch of generation touches, so preparing a batch never drops a region the same batch reads
+        void initialize(unsigned long long region_count) {
+            m_region_count = region_count;
+            m_regions = new climate_region[region_count];
+            m_clock = 0;
+            m_hits = 0;
+            m_fills = 0;
+
+            m_table.initialize(region_count);
+
+            for (unsigned long long i = 0; i < region_count; i++) {
+                m_regions[i].present = false;
+            }
+        }
+
+        // drops every region, they were filled with the old seed
+        void set_seed(unsigned long long seed) {
+            m_seed = seed;
+
+            m_table.clear();
+            for (unsigned long long i = 0; i < m_region_count; i++) {
+                m_regions[i].present = false;
+            }
+        }
+
+        unsigned long long get_seed() {
+            return m_seed;
+        }
+
+        // make sure the region holding a block column is filled, the least recently prepared region makes way
+        void prepare(long long block_x, long long block_y) {
+            long long x = get_region_coordinate(block_x);
+            long long y = get_region_coordinate(block_y);
+            climate_region* region = find(x, y);
+            climate sample;
+
+            if (region != 0) {
+                region->last_used = ++m_clock;
+                m_hits++;
+
+                return;
+            }
+
+            if (m_region_count == 0) {
+                return;
+            }
+
+            region = &m_regions[0];
+            for (unsigned long long i = 0; i < m_region_count && region->present; i++) {
+                if (!m_regions[i].present || m_regions[i].last_used < region->last_used) {
+                    region = &m_regions[i];
+                }
+            }
+
+            if (region->present) {
+                m_table.remove(region->x, region->y, 0);
+            }
+
+            region->x = x;
+            region->y = y;
+            region->present = true;
+            region->last_used = ++m_clock;
+            m_table.insert(x, y, 0, region - m_regions);
+            for (long long j = 0; j < climate_region_samples; j++) {
+                for (long long i = 0; i < climate_region_samples; i++) {
+                    sample = get_climate_sample((x * (climate_region_samples - 1)) + i, (y * (climate_region_samples - 1)) + j, m_seed);
+                    get_biome_blend(&sample, &region->samples[i + (j * climate_region_samples)]);
+                }
+            }
+            m_fills++;
+        }
+
+        // the blends at the 3 by 3 samples spanning a chunk column, in chunk coordinates, x first
+        // regions that were not prepared are sampled and blended directly, which gives the same numbers
+        void get_chunk_blends(long long x, long long y, biome_blend* output) {
+            const long long per_chunk = 8 / climate_spacing;
+            climate_region* region = find(get_region_coordinate(x * 8), get_region_coordinate(y * 8));
+            long long grid_x, grid_y;
+            climate sample;
+
+            for (long long j = 0; j <= per_chunk; j++) {
+                for (long long i = 0; i <= per_chunk; i++) {
+                    grid_x = (x * per_chunk) + i;
+                    grid_y = (y * per_chunk) + j;
+
+                    if (region != 0) {
+                        output[i + (j * (per_chunk + 1))] = region->samples[(grid_x - (region->x * (climate_region_samples - 1))) + ((grid_y - (region->y * (climate_region_samples - 1))) * climate_region_samples)];
+                    } else {
+                        sample = get_climate_sample(grid_x, grid_y, m_seed);
+                        get_biome_blend(&sample, &output[i + (j * (per_chunk + 1))]);
+                    }
+                }
+            }
+        }
+
+        void print() {
+            printf("Climate map:\n");
+            printf("\tregions filled: %llu, reused: %llu, kept: %llu\n", m_fills, m_hits, m_region_count);
+            fflush(stdout);
+        }
+
+        void uninitialize() {
+            delete[] m_regions;
+            m_table.uninitialize();
+
+            m_regions = 0;
+            m_region_count = 0;
+        }
+    };
+
+    void mix_biome_blends(biome_blend* a, biome_blend* b, float fraction, biome_blend* output) {
+        for (unsigned int i = 0; i < bmt_count; i++) {
+            output->weights[i] = glm::mix(a->weights[i], b->weights[i], fraction);
+        }
+        output->base_height = glm::mix(a->base_height, b->base_height, fraction);
+        output->height_range = glm::mix(a->height_range, b->height_range, fraction);
+    }
+}
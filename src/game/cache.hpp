@@ -0,0 +1,332 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace abradinjapan::voxelize {
+    // worst case size of one compressed chunk, every block and fluid run one long
+    const unsigned long long compressed_chunk_capacity = (512 * 3) + (512 * 2);
+
+    // run length encode a chunk's blocks then its fluid, returns the number of bytes written
+    // light is left out, it is rebuilt when the chunk comes back since its neighbours may have changed
+    unsigned long long compress_chunk(chunk_888* chunk, unsigned char* output) {
+        unsigned long long length = 0;
+        unsigned int run;
+        unsigned short block;
+        unsigned char fluid;
+
+        for (unsigned int i = 0; i < 512; i += run) {
+            block = chunk->get_block_at(i & 7, (i >> 3) & 7, i >> 6);
+
+            for (run = 1; i + run < 512 && run < 255 && chunk->get_block_at((i + run) & 7, ((i + run) >> 3) & 7, (i + run) >> 6) == block; run++) {
+            }
+
+            output[length] = (unsigned char)run;
+            output[length + 1] = (unsigned char)(block & 0xFF);
+            output[length + 2] = (unsigned char)(block >> 8);
+            length += 3;
+        }
+
+        for (unsigned int i = 0; i < 512; i += run) {
+            fluid = chunk->get_fluid_at(i & 7, (i >> 3) & 7, i >> 6);
+
+            for (run = 1; i + run < 512 && run < 255 && chunk->get_fluid_at((i + run) & 7, ((i + run) >> 3) & 7, (i + run) >> 6) == fluid; run++) {
+            }
+
+            output[length] = (unsigned char)run;
+            output[length + 1] = fluid;
+            length += 2;
+        }
+
+        return length;
+    }
+
+    // the runs are checked before anything is written, they must fill exactly 512 blocks then 512 fluid levels without reading past length
+    // returns false when they do not, the chunk is then left as it was
+    bool decompress_chunk(unsigned char* input, unsigned long long length, chunk_888* chunk) {
+        unsigned long long position = 0;
+        unsigned int i = 0;
+        unsigned short block;
+
+        while (i < 512) {
+            if (position + 3 > length || input[position] == 0 || i + input[position] > 512) {
+                return false;
+            }
+
+            i += input[position];
+            position += 3;
+        }
+
+        i = 0;
+        while (i < 512) {
+            if (position + 2 > length || input[position] == 0 || i + input[position] > 512) {
+                return false;
+            }
+
+            i += input[position];
+            position += 2;
+        }
+
+        i = 0;
+        while (i < 512) {
+            block = input[1] | (input[2] << 8);
+
+            for (unsigned int j = 0; j < input[0]; j++, i++) {
+                chunk->set_block_at(i & 7, (i >> 3) & 7, i >> 6, block);
+            }
+
+            input += 3;
+        }
+
+        i = 0;
+        while (i < 512) {
+            for (unsigned int j = 0; j < input[0]; j++, i++) {
+                chunk->set_fluid_at(i & 7, (i >> 3) & 7, i >> 6, input[1]);
+            }
+
+            input += 2;
+        }
+
+        return true;
+    }
+
+    // compressed chunks are stored in chains of fixed size blocks carved out up front, so storing and loading never touch the heap
+    const unsigned long long cold_block_size = 64;
+
+    // one compressed chunk in the cold tier
+    struct cold_chunk {
+        long long x, y, z; // chunk coordinates
+        long long first_block; // -1 when the entry is unused
+        unsigned long long size; // compressed bytes
+        long long newer, older; // least recently used order, -1 ends the list, the free list runs through older
+    };
+
+    // chunks that left the loaded area, compressed and kept in ram so coming back does not mean generating them again
+    // bounded by both bytes and count, the least recently stored chunk is dropped first
+    class chunk_cache {
+        cold_chunk* m_entries = 0;
+        unsigned long long m_max_entries = 0;
+        keyed_table m_table; // chunk coordinates to entry indices
+        long long m_free = -1;
+        long long m_newest = -1;
+        long long m_oldest = -1;
+        unsigned char* m_blocks = 0;
+        long long* m_next_blocks = 0; // chains blocks together, the free blocks included
+        unsigned long long m_block_count = 0;
+        long long m_free_block = -1;
+        unsigned long long m_free_block_count = 0;
+        unsigned long long m_count = 0;
+        unsigned long long m_hits = 0;
+        unsigned long long m_misses = 0;
+        unsigned long long m_stores = 0;
+        unsigned long long m_evictions = 0;
+        unsigned char m_scratch[compressed_chunk_capacity];
+
+        void unlink(long long index) {
+            cold_chunk* entry = &m_entries[index];
+
+            if (entry->newer != -1) {
+                m_entries[entry->newer].older = entry->older;
+            } else {
+                m_newest = entry->older;
+            }
+            if (entry->older != -1) {
+                m_entries[entry->older].newer = entry->newer;
+            } else {
+                m_oldest = entry->newer;
+            }
+        }
+
+        // drop an entry entirely, table slot included
+        void remove(long long index) {
+            long long block = m_entries[index].first_block;
+            long long next;
+
+            m_table.remove(m_entries[index].x, m_entries[index].y, m_entries[index].z);
+            unlink(index);
+
+            // hand the blocks back
+            while (block != -1) {
+                next = m_next_blocks[block];
+                m_next_blocks[block] = m_free_block;
+                m_free_block = block;
+                m_free_block_count++;
+                g_memory_accounts.remove(mtt::mtt_cold_chunks, cold_block_size);
+                block = next;
+            }
+            m_count--;
+
+            m_entries[index].first_block = -1;
+            m_entries[index].older = m_free;
+            m_free = index;
+        }
+
+    public:
+        // max_bytes is rounded down to whole blocks
+        void initialize(unsigned long long max_bytes, unsigned long long max_entries) {
+            m_max_entries = max_entries;
+            m_entries = new cold_chunk[max_entries];
+            m_block_count = max_bytes / cold_block_size;
+            m_blocks = new unsigned char[m_block_count * cold_block_size];
+            m_next_blocks = new long long[m_block_count];
+
+            m_table.initialize(max_entries);
+
+            for (unsigned long long i = 0; i < max_entries; i++) {
+                m_entries[i].first_block = -1;
+                m_entries[i].older = (i + 1 < max_entries) ? (long long)(i + 1) : -1;
+            }
+            for (unsigned long long i = 0; i < m_block_count; i++) {
+                m_next_blocks[i] = (i + 1 < m_block_count) ? (long long)(i + 1) : -1;
+            }
+            m_free = max_entries > 0 ? 0 : -1;
+            m_free_block = m_block_count > 0 ? 0 : -1;
+            m_free_block_count = m_block_count;
+            m_newest = -1;
+            m_oldest = -1;
+            m_count = 0;
+        }
+
+        // compress a chunk that is leaving the hot tier, the chunk itself is left untouched
+        void store(chunk_888* chunk, long long x, long long y, long long z) {
+            unsigned long long size = compress_chunk(chunk, m_scratch);
+            unsigned long long blocks_needed = (size + cold_block_size - 1) / cold_block_size;
+            long long index = m_table.find(x, y, z);
+            long long block;
+            long long* link;
+
+            if (index != -1) {
+                remove(index);
+            }
+
+            if (blocks_needed > m_block_count || m_max_entries == 0) {
+                return;
+            }
+
+            // make room
+            while (m_count == m_max_entries || m_free_block_count < blocks_needed) {
+                remove(m_oldest);
+                m_evictions++;
+            }
+
+            index = m_free;
+            m_free = m_entries[index].older;
+
+            m_entries[index].x = x;
+            m_entries[index].y = y;
+            m_entries[index].z = z;
+            m_entries[index].size = size;
+
+            // copy into a chain of free blocks
+            link = &m_entries[index].first_block;
+            for (unsigned long long i = 0; i < blocks_needed; i++) {
+                block = m_free_block;
+                m_free_block = m_next_blocks[block];
+                m_free_block_count--;
+                g_memory_accounts.add(mtt::mtt_cold_chunks, cold_block_size);
+
+                memcpy(&m_blocks[block * cold_block_size], &m_scratch[i * cold_block_size], (i + 1 < blocks_needed) ? cold_block_size : size - (i * cold_block_size));
+
+                *link = block;
+                link = &m_next_blocks[block];
+            }
+            *link = -1;
+
+            // newest end of the list
+            m_entries[index].newer = -1;
+            m_entries[index].older = m_newest;
+            if (m_newest != -1) {
+                m_entries[m_newest].newer = index;
+            } else {
+                m_oldest = index;
+            }
+            m_newest = index;
+
+            m_table.insert(x, y, z, index);
+
+            m_count++;
+            m_stores++;
+        }
+
+        // decompress a chunk back into the hot tier, it leaves the cold tier
+        // returns 0 on a miss or when the pool is full
+        chunk_888* load(slab_pool<chunk_888>* pool, long long x, long long y, long long z) {
+            long long index = m_table.find(x, y, z);
+            cold_chunk* entry;
+            chunk_888* output;
+            long long block;
+
+            if (index == -1) {
+                m_misses++;
+
+                return 0;
+            }
+
+            output = pool->allocate();
+            if (output == 0) {
+                return 0;
+            }
+
+            // gather the chain back into one run of bytes
+            entry = &m_entries[index];
+            block = entry->first_block;
+            for (unsigned long long i = 0; block != -1; i++) {
+                memcpy(&m_scratch[i * cold_block_size], &m_blocks[block * cold_block_size], (m_next_blocks[block] != -1) ? cold_block_size : entry->size - (i * cold_block_size));
+                block = m_next_blocks[block];
+            }
+
+            decompress_chunk(m_scratch, entry->size, output);
+            remove(index);
+            m_hits++;
+
+            return output;
+        }
+
+        unsigned long long get_hits() {
+            return m_hits;
+        }
+
+        unsigned long long get_misses() {
+            return m_misses;
+        }
+
+        unsigned long long get_evictions() {
+            return m_evictions;
+        }
+
+        unsigned long long get_count() {
+            return m_count;
+        }
+
+        // bytes held in blocks, including the unused tail of each chain
+        unsigned long long get_bytes() {
+            return (m_block_count - m_free_block_count) * cold_block_size;
+        }
+
+        void print() {
+            printf("Cold chunk cache:\n");
+            printf("\tchunks: %llu of %llu, %llu of %llu bytes\n", m_count, m_max_entries, get_bytes(), m_block_count * cold_block_size);
+            printf("\thits: %llu, misses: %llu, stores: %llu, evictions: %llu\n", m_hits, m_misses, m_stores, m_evictions);
+            fflush(stdout);
+        }
+
+        void uninitialize() {
+            g_memory_accounts.remove(mtt::mtt_cold_chunks, (long long)get_bytes());
+            delete[] m_entries;
+            m_table.uninitialize();
+            delete[] m_blocks;
+            delete[] m_next_blocks;
+
+            m_entries = 0;
+            m_blocks = 0;
+            m_next_blocks = 0;
+            m_max_entries = 0;
+            m_block_count = 0;
+            m_free = -1;
+            m_free_block = -1;
+            m_free_block_count = 0;
+            m_newest = -1;
+            m_oldest = -1;
+            m_count = 0;
+        }
+    };
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+#include "ticks.hpp"
+
+#include <algorithm>
+
+namespace abradinjapan::voxelize {
+    // how much of the level difference flows sideways per step is one over this, it must be at least 5 so a cell never gives away more than it holds
+    unsigned char get_fluid_spread_divisor(ft type) {
+        if (type == ft::ft_lava) {
+            return 10;
+        }
+
+        return 5;
+    }
+
+    // a cellular automaton over the fluid levels of a world
+    // fluid falls as far as the block below has room, then what stays levels out with the four blocks beside it, so mass is kept and basins fill flat
+    // every cell's next level depends only on the current levels around it, so all chunks step in parallel against an unchanged world and the changes are applied afterwards
+    // only cells near a change are stepped again, once the fluid settles the frontier is empty and a step costs nothing
+    class fluid_solver {
+        world* m_world = 0;
+        worker_pool* m_workers = 0;
+        unsigned long long* m_frontiers[2] = { 0, 0 }; // 8 masks per chunk with bit (x + (y * 8)) per z layer, one being stepped and one collecting the next
+        unsigned char* m_frontier_flags[2] = { 0, 0 }; // whether each chunk is listed in the frontier
+        long long* m_frontier_chunks[2] = { 0, 0 };
+        long long m_frontier_chunk_counts[2] = { 0, 0 };
+        unsigned int m_pending = 0; // which frontier collects marks
+        block_edit_queue* m_change_queues = 0; // one per partition, expected and value hold the old and new fluid
+        unsigned long long* m_partition_cell_counts = 0;
+        unsigned int m_partition_count = 0;
+        unsigned int m_ticks_per_step = 4;
+        unsigned long long m_tick_count = 0;
+        unsigned long long m_step_count = 0;
+        unsigned long long m_cells_updated = 0;
+        unsigned long long m_cells_changed = 0;
+
+        static void on_block_changed(void* context, long long x, long long y, long long z, unsigned short, unsigned short) {
+            // fluid may now flow into or around the block
+            ((fluid_solver*)context)->mark_around(x, y, z);
+        }
+
+        static void on_region_changed(void* context, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            fluid_solver* fluids = (fluid_solver*)context;
+
+            for (long long x = x1 - 1; x <= x2 + 1; x++) {
+                for (long long y = y1 - 1; y <= y2 + 1; y++) {
+                    for (long long z = z1 - 1; z <= z2 + 1; z++) {
+                        fluids->mark_cell(x, y, z);
+                    }
+                }
+            }
+        }
+
+        static void step_partition_job(void* context, unsigned long long index) {
+            ((fluid_solver*)context)->step_partition((unsigned int)index);
+        }
+
+        void mark_cell(long long x, long long y, long long z) {
+            long long chunk;
+
+            if (!m_world->contains_block(x, y, z)) {
+                return;
+            }
+
+            chunk = m_world->get_chunk_slot(x >> 3, y >> 3, z >> 3);
+
+            m_frontiers[m_pending][(chunk * 8) + (z & 7)] |= 1ull << ((x & 7) + ((y & 7) * 8));
+
+            if (m_frontier_flags[m_pending][chunk] == 0) {
+                m_frontier_flags[m_pending][chunk] = 1;
+                m_frontier_chunks[m_pending][m_frontier_chunk_counts[m_pending]] = chunk;
+                m_frontier_chunk_counts[m_pending]++;
+            }
+        }
+
+        // every cell whose next level reads this one, the cell and its column neighbours, the four beside it and their column neighbours
+        void mark_around(long long x, long long y, long long z) {
+            for (long long dz = -1; dz <= 1; dz++) {
+                mark_cell(x, y, z + dz);
+
+                for (unsigned int i = 0; i < 6; i++) {
+                    if (st2_offsets[i][2] == 0) {
+                        mark_cell(x + st2_offsets[i][0], y + st2_offsets[i][1], z + dz);
+                    }
+                }
+            }
+        }
+
+        bool is_open(long long x, long long y, long long z) {
+            return m_world->contains_block(x, y, z) && m_world->get_block_at(x, y, z) == bt::bt_air;
+        }
+
+        unsigned char get_fluid(long long x, long long y, long long z) {
+            if (!is_open(x, y, z)) {
+                return 0;
+            }
+
+            return m_world->get_fluid_at(x, y, z);
+        }
+
+        // different fluids never flow into each other
+        bool can_mix(unsigned char fluid_1, unsigned char fluid_2) {
+            return fluid_1 == 0 || fluid_2 == 0 || get_fluid_type(fluid_1) == get_fluid_type(fluid_2);
+        }
+
+        // how much falls out of a block into the one below it this step
+        unsigned char get_fall(long long x, long long y, long long z) {
+            unsigned char fluid = get_fluid(x, y, z);
+            unsigned char below;
+
+            if (fluid == 0 || !is_open(x, y, z - 1)) {
+                return 0;
+            }
+
+            below = m_world->get_fluid_at(x, y, z - 1);
+            if (!can_mix(fluid, below)) {
+                return 0;
+            }
+
+            return std::min(get_fluid_level(fluid), (unsigned char)(fluid_max_level - get_fluid_level(below)));
+        }
+
+        // what a block holds after falling, before levelling out sideways
+        // writes the fluid type it ends up as, ft_none when it is empty
+        int get_settled_level(long long x, long long y, long long z, ft* type) {
+            unsigned char fluid = get_fluid(x, y, z);
+            unsigned char fall_in = get_fall(x, y, z + 1);
+
+            *type = get_fluid_type(fluid);
+            if (fluid == 0 && fall_in > 0) {
+                *type = get_fluid_type(m_world->get_fluid_at(x, y, z + 1));
+            }
+
+            return (int)get_fluid_level(fluid) - (int)get_fall(x, y, z) + (int)fall_in;
+        }
+
+        // the next value of one cell, read only
+        unsigned char step_cell(long long x, long long y, long long z) {
+            unsigned char fluid;
+            ft type, neighbour_type, pair_type;
+            int level, neighbour_level, flow;
+            int inflows[3] = { 0, 0, 0 };
+            long long nx, ny;
+
+            if (!is_open(x, y, z)) {
+                return 0;
+            }
+
+            fluid = m_world->get_fluid_at(x, y, z);
+            level = get_settled_level(x, y, z, &type);
+
+            // level out with the blocks beside, the flow between two blocks is the same number seen from either side
+            for (unsigned int i = 0; i < 6; i++) {
+                if (st2_offsets[i][2] != 0) {
+                    continue;
+                }
+
+                nx = x + st2_offsets[i][0];
+                ny = y + st2_offsets[i][1];
+                if (!is_open(nx, ny, z)) {
+                    continue;
+                }
+
+                neighbour_level = get_settled_level(nx, ny, z, &neighbour_type);
+                if (type != ft::ft_none && neighbour_type != ft::ft_none && type != neighbour_type) {
+                    continue;
+                }
+
+                pair_type = type != ft::ft_none ? type : neighbour_type;
+                if (pair_type == ft::ft_none) {
+                    continue;
+                }
+
+                flow = (neighbour_level - level) / (int)get_fluid_spread_divisor(pair_type);
+                inflows[pair_type] += flow;
+            }
+
+            // an empty block filled from two kinds of fluid keeps the larger, the other boils away
+            if (type == ft::ft_none) {
+                type = inflows[ft::ft_lava] > inflows[ft::ft_water] ? ft::ft_lava : ft::ft_water;
+            }
+            level += inflows[type];
+
+            // sources never run dry
+            if (is_fluid_source(fluid)) {
+                return pack_fluid(get_fluid_type(fluid), fluid_max_level, true);
+            }
+
+            return pack_fluid(type, (unsigned char)std::clamp(level, 0, (int)fluid_max_level), false);
+        }
+
+        // step the dirty cells of one contiguous share of the frontier chunks
+        void step_partition(unsigned int partition) {
+            unsigned int working = m_pending ^ 1;
+            block_edit_queue* changes = &m_change_queues[partition];
+            long long first = (m_frontier_chunk_counts[working] * partition) / m_partition_count;
+            long long last = (m_frontier_chunk_counts[working] * (partition + 1)) / m_partition_count;
+            unsigned long long cell_count = 0;
+            unsigned long long mask;
+            unsigned int bit;
+            long long chunk, chunk_x, chunk_y, chunk_z, x, y, z;
+            unsigned char old_fluid, new_fluid;
+
+            changes->clear();
+
+            for (long long i = first; i < last; i++) {
+                chunk = m_frontier_chunks[working][i];
+                m_world->get_slot_chunk(chunk, &chunk_x, &chunk_y, &chunk_z);
+
+                for (unsigned int layer = 0; layer < 8; layer++) {
+                    mask = m_frontiers[working][(chunk * 8) + layer];
+
+                    while (mask != 0) {
+                        bit = (unsigned int)__builtin_ctzll(mask);
+                        mask &= mask - 1;
+
+                        x = (chunk_x * 8) + (bit & 7);
+                        y = (chunk_y * 8) + (bit >> 3);
+                        z = (chunk_z * 8) + layer;
+
+                        old_fluid = m_world->get_fluid_at(x, y, z);
+                        new_fluid = step_cell(x, y, z);
+                        cell_count++;
+
+                        if (new_fluid != old_fluid) {
+                            changes->push(x, y, z, old_fluid, new_fluid);
+                        }
+                    }
+                }
+            }
+
+            m_partition_cell_counts[partition] = cell_count;
+        }
+
+    public:
+        void initialize(world* w, worker_pool* workers) {
+            long long chunk_count = w->get_width() * w->get_length() * w->get_height();
+
+            m_world = w;
+            m_workers = workers;
+            m_pending = 0;
+            m_tick_count = 0;
+            m_step_count = 0;
+            m_cells_updated = 0;
+            m_cells_changed = 0;
+
+            for (unsigned int i = 0; i < 2; i++) {
+                m_frontiers[i] = new unsigned long long[chunk_count * 8];
+                m_frontier_flags[i] = new unsigned char[chunk_count];
+                m_frontier_chunks[i] = new long long[chunk_count];
+                m_frontier_chunk_counts[i] = 0;
+
+                for (long long j = 0; j < chunk_count * 8; j++) {
+                    m_frontiers[i][j] = 0;
+                }
+                for (long long j = 0; j < chunk_count; j++) {
+                    m_frontier_flags[i][j] = 0;
+                }
+            }
+
+            m_partition_count = (workers->get_thread_count() + 1) * 4;
+            m_change_queues = new block_edit_queue[m_partition_count];
+            m_partition_cell_counts = new unsigned long long[m_partition_count];
+            for (unsigned int i = 0; i < m_partition_count; i++) {
+                m_change_queues[i].initialize(256);
+            }
+
+            w->add_block_listener(on_block_changed, this);
+            w->add_region_listener(on_region_changed, this);
+        }
+
+        // game ticks per fluid step, fluid moves slower than everything else
+        void set_ticks_per_step(unsigned int ticks) {
+            m_ticks_per_step = ticks;
+        }
+
+        // puts fluid into an air block, sources refill themselves forever
+        void set_fluid_at(long long x, long long y, long long z, ft type, unsigned char level, bool source) {
+            if (!is_open(x, y, z)) {
+                return;
+            }
+
+            m_world->set_fluid_at(x, y, z, pack_fluid(type, level, source));
+            mark_around(x, y, z);
+        }
+
+        void tick() {
+            m_tick_count++;
+
+            if (m_tick_count % m_ticks_per_step == 0) {
+                step();
+            }
+        }
+
+        // one step of the automaton over the frontier, returns false when there was nothing to step
+        bool step() {
+            unsigned int working = m_pending ^ 1;
+            block_edit_queue* changes;
+            block_edit* change;
+            long long chunk;
+
+            // swap frontiers, new marks collect while the old ones are stepped
+            m_pending = working;
+            working ^= 1;
+
+            if (m_frontier_chunk_counts[working] == 0) {
+                return false;
+            }
+
+            m_workers->run(step_partition_job, this, m_partition_count);
+
+            // clear the stepped frontier
+            for (long long i = 0; i < m_frontier_chunk_counts[working]; i++) {
+                chunk = m_frontier_chunks[working][i];
+
+                for (unsigned int j = 0; j < 8; j++) {
+                    m_frontiers[working][(chunk * 8) + j] = 0;
+                }
+                m_frontier_flags[working][chunk] = 0;
+            }
+            m_frontier_chunk_counts[working] = 0;
+
+            // apply changes in chunk order, touched chunks are marked for remeshing by the world
+            for (unsigned int i = 0; i < m_partition_count; i++) {
+                changes = &m_change_queues[i];
+
+                for (unsigned long long j = 0; j < changes->get_count(); j++) {
+                    change = changes->get(j);
+
+                    m_world->set_fluid_at(change->x, change->y, change->z, (unsigned char)change->value);
+                    mark_around(change->x, change->y, change->z);
+                }
+
+                m_cells_changed += changes->get_count();
+                m_cells_updated += m_partition_cell_counts[i];
+                changes->clear();
+            }
+
+            m_step_count++;
+
+            return true;
+        }
+
+        bool is_settled() {
+            return m_frontier_chunk_counts[m_pending] == 0;
+        }
+
+        unsigned long long get_step_count() {
+            return m_step_count;
+        }
+
+        // cells stepped, whether or not they changed
+        unsigned long long get_cells_updated() {
+            return m_cells_updated;
+        }
+
+        unsigned long long get_cells_changed() {
+            return m_cells_changed;
+        }
+
+        void uninitialize() {
+            // play can fail before initialize and still calls this
+            if (m_world != 0) {
+                m_world->remove_block_listener(on_block_changed, this);
+                m_world->remove_region_listener(on_region_changed, this);
+            }
+
+            for (unsigned int i = 0; i < m_partition_count; i++) {
+                m_change_queues[i].uninitialize();
+            }
+
+            for (unsigned int i = 0; i < 2; i++) {
+                delete[] m_frontiers[i];
+                delete[] m_frontier_flags[i];
+                delete[] m_frontier_chunks[i];
+
+                m_frontiers[i] = 0;
+                m_frontier_flags[i] = 0;
+                m_frontier_chunks[i] = 0;
+                m_frontier_chunk_counts[i] = 0;
+            }
+
+            delete[] m_change_queues;
+            delete[] m_partition_cell_counts;
+
+            m_change_queues = 0;
+            m_partition_cell_counts = 0;
+            m_partition_count = 0;
+            m_world = 0;
+            m_workers = 0;
+        }
+    };
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace abradinjapan::voxelize {
+    // an hour of keyframes at 60 ticks a second, recording stops after that
+    const unsigned long long max_camera_keyframes = 60 * 60 * 60;
+
+    // timings kept for live runs, whose length is not known up front, about an hour at 240 frames a second
+    const unsigned long long max_timed_frames = 240 * 60 * 60;
+
+    // where the camera is at one moment of a path, the position is the eye in blocks
+    struct camera_keyframe {
+        double time; // seconds from the start of the path
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+    };
+
+    // a camera path kept as keyframes, recorded once a tick while playing or written by hand
+    // the file is text, one keyframe a line as "time x y z yaw pitch", lines starting with # are skipped
+    class camera_path {
+        camera_keyframe* m_keyframes = 0;
+        unsigned long long m_count = 0;
+        unsigned long long m_capacity = 0;
+        unsigned long long m_cursor = 0; // the keyframe sample started looking from last time
+
+    public:
+        void initialize(unsigned long long capacity) {
+            m_keyframes = new camera_keyframe[capacity];
+            m_count = 0;
+            m_capacity = capacity;
+            m_cursor = 0;
+        }
+
+        // keyframes must come in time order, false when the file is missing, malformed or too long
+        bool load(const char* path) {
+            FILE* f = fopen(path, "r");
+            char line[256];
+            camera_keyframe keyframe;
+
+            if (f == 0) {
+                return false;
+            }
+
+            m_count = 0;
+            m_cursor = 0;
+            while (fgets(line, sizeof(line), f) != 0) {
+                if (line[0] == '#' || line[0] == '\n') {
+                    continue;
+                }
+
+                if (sscanf(line, "%lf %f %f %f %f %f", &keyframe.time, &keyframe.position.x, &keyframe.position.y, &keyframe.position.z, &keyframe.yaw, &keyframe.pitch) != 6 || m_count == m_capacity || (m_count > 0 && keyframe.time < m_keyframes[m_count - 1].time)) {
+                    fclose(f);
+                    m_count = 0;
+
+                    return false;
+                }
+
+                m_keyframes[m_count] = keyframe;
+                m_count++;
+            }
+            fclose(f);
+
+            return m_count > 0;
+        }
+
+        bool save(const char* path) {
+            FILE* f = fopen(path, "w");
+
+            if (f == 0) {
+                return false;
+            }
+
+            fprintf(f, "# time x y z yaw pitch\n");
+            for (unsigned long long i = 0; i < m_count; i++) {
+                // enough digits to read back the exact same numbers
+                fprintf(f, "%.17g %.9g %.9g %.9g %.9g %.9g\n", m_keyframes[i].time, m_keyframes[i].position.x, m_keyframes[i].position.y, m_keyframes[i].position.z, m_keyframes[i].yaw, m_keyframes[i].pitch);
+            }
+
+            return fclose(f) == 0;
+        }
+
+        // recording stops quietly once the path is full
+        void add(double time, glm::vec3 position, float yaw, float pitch) {
+            if (m_count == m_capacity) {
+                return;
+            }
+
+            m_keyframes[m_count].time = time;
+            m_keyframes[m_count].position = position;
+            m_keyframes[m_count].yaw = yaw;
+            m_keyframes[m_count].pitch = pitch;
+            m_count++;
+        }
+
+        unsigned long long get_count() {
+            return m_count;
+        }
+
+        double get_duration() {
+            return m_count > 0 ? m_keyframes[m_count - 1].time : 0.0;
+        }
+
+        // the camera between the two keyframes around a time, linearly, held at either end
+        // playback only moves forward, so the search carries on from the last keyframe found
+        void sample(double time, glm::vec3* position, float* yaw, float* pitch) {
+            camera_keyframe* a;
+            camera_keyframe* b;
+            float fraction;
+
+            if (m_cursor >= m_count || m_keyframes[m_cursor].time > time) {
+                m_cursor = 0;
+            }
+            while (m_cursor + 1 < m_count && m_keyframes[m_cursor + 1].time <= time) {
+                m_cursor++;
+            }
+
+            a = &m_keyframes[m_cursor];
+            b = m_cursor + 1 < m_count ? &m_keyframes[m_cursor + 1] : a;
+            fraction = b->time > a->time ? glm::clamp((float)((time - a->time) / (b->time - a->time)), 0.0f, 1.0f) : 0.0f;
+
+            *position = glm::mix(a->position, b->position, fraction);
+            *yaw = glm::mix(a->yaw, b->yaw, fraction);
+            *pitch = glm::mix(a->pitch, b->pitch, fraction);
+        }
+
+        void uninitialize() {
+            delete[] m_keyframes;
+
+            m_keyframes = 0;
+            m_count = 0;
+            m_capacity = 0;
+        }
+    };
+
+    // how long one frame took and what it did
+    struct frame_timing {
+        double time; // simulated seconds when the frame was drawn
+        double frame_seconds; // from the start of this frame to the start of the next
+        double work_seconds; // from the start of this frame until it was presented, without the wait for the next one
+        unsigned int chunks_remeshed;
+    };
+
+    // per frame timings kept in ram for the whole run and written out at the end, so the run itself never touches the file or the heap
+    class frame_timing_log {
+        frame_timing* m_frames = 0;
+        unsigned long long m_count = 0;
+        unsigned long long m_capacity = 0;
+
+    public:
+        void initialize(unsigned long long capacity) {
+            m_frames = new frame_timing[capacity];
+            m_count = 0;
+            m_capacity = capacity;
+        }
+
+        // frames past the capacity are dropped
+        void record(double time, double frame_seconds, double work_seconds, unsigned int chunks_remeshed) {
+            if (m_count == m_capacity) {
+                return;
+            }
+
+            m_frames[m_count].time = time;
+            m_frames[m_count].frame_seconds = frame_seconds;
+            m_frames[m_count].work_seconds = work_seconds;
+            m_frames[m_count].chunks_remeshed = chunks_remeshed;
+            m_count++;
+        }
+
+        unsigned long long get_count() {
+            return m_count;
+        }
+
+        // one row a frame, times in milliseconds
+        bool write_csv(const char* path) {
+            FILE* f = fopen(path, "w");
+
+            if (f == 0) {
+                return false;
+            }
+
+            fprintf(f, "frame,time,frame_ms,work_ms,chunks_remeshed\n");
+            for (unsigned long long i = 0; i < m_count; i++) {
+                fprintf(f, "%llu,%.6f,%.4f,%.4f,%u\n", i, m_frames[i].time, m_frames[i].frame_seconds * 1000.0, m_frames[i].work_seconds * 1000.0, m_frames[i].chunks_remeshed);
+            }
+
+            return fclose(f) == 0;
+        }
+
+        void uninitialize() {
+            delete[] m_frames;
+
+            m_frames = 0;
+            m_count = 0;
+            m_capacity = 0;
+        }
+    };
+}
@@ -1,15 +1,103 @@
 #pragma once
 
 #include "types.hpp"
-#include "terrain.hpp"
+#include "flythrough.hpp"
+#include "fluids.hpp"
+#include "headless.hpp"
+#include "lighting.hpp"
+#include "meshes.hpp"
+#include "network.hpp"
+#include "physics.hpp"
+#include "ticks.hpp"
+#include "timing.hpp"
+#include "translucency.hpp"
 
 namespace abradinjapan::voxelize {
     class game {
         user_input m_ui = user_input();
         SDL_Window* m_window = 0;
         SDL_GLContext m_context = 0;
+        int m_width = 720;
+        int m_height = 480;
+        bool m_headless = false;
+        unsigned long long m_headless_frames = 0;
+        const char* m_capture_path = 0;
+        const char* m_reference_path = 0;
+        offscreen_context m_offscreen = offscreen_context();
+        float m_lod_distance = 4.0f;
+        rpt m_render_path = rpt::rpt_vertices;
+        slab_pool<chunk_888> m_chunk_pool = slab_pool<chunk_888>();
+        world m_world = world();
+        chunk_cache m_cold_chunks = chunk_cache();
+        unsigned long long m_cold_cache_bytes = 16 * 1024 * 1024;
+        mesh_cache m_mesh_cache = mesh_cache();
+        const char* m_mesh_cache_path = 0;
+        server_connection m_server = server_connection();
+        const char* m_server_address = 0; // 0 generates and simulates the world here
+        unsigned short m_server_port = 0;
+        light_engine m_lighting = light_engine();
+        worker_pool m_workers;
+        generation_pipeline m_generator = generation_pipeline();
+        tick_scheduler m_ticks = tick_scheduler();
+        fluid_solver m_fluids = fluid_solver();
+        translucency_sorter m_translucency = translucency_sorter();
+        unsigned long long m_frames_with_heap_allocations = 0;
+        pmt m_pacing_mode = pmt::pmt_adaptive_sync;
+        double m_frame_cap = 240.0;
+        double m_tick_rate = 60.0;
+        fixed_timestep m_timestep = fixed_timestep();
+        frame_limiter m_frame_limiter = frame_limiter();
+        frame_statistics m_frame_statistics = frame_statistics();
+        frame_statistics m_input_latency_statistics = frame_statistics();
+        body m_player = body();
+        float m_player_yaw = 0.0f;
+        float m_player_pitch = 0.0f;
+        unsigned long long m_seed = 1;
+        long long m_flood_height = 0; // water fills open blocks below it when play starts
+        camera_path m_camera_path = camera_path(); // played back
+        camera_path m_recorded_path = camera_path();
+        const char* m_record_path = 0;
+        const char* m_play_path = 0;
+        frame_timing_log m_frame_timings = frame_timing_log();
+        const char* m_timings_path = 0;
+        const char* m_memory_log_path = 0;
+        bool m_print_memory_held = false;
+
+        // glew 2.1 and later report a missing glx display under egl, the entry points still load
+        bool initialize_glew() {
+            GLenum result = glewInit();
+
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+            if (result == GLEW_ERROR_NO_GLX_DISPLAY) {
+                return true;
+            }
+#endif
+
+            return result == GLEW_OK;
+        }
+
+        // no sdl at all, so no window and no display server
+        et initialize_headless_libraries() {
+            et error = m_offscreen.create_context(m_width, m_height);
+
+            if (error != et::et_no_error) {
+                return error;
+            }
+
+            if (!initialize_glew()) {
+                printf("Error: GLEW could not be initialized!\n");
+                fflush(stdout);
+                return et::et_could_not_initialize_glew;
+            }
+
+            return m_offscreen.create_framebuffer();
+        }
 
         et initialize_libraries() {
+            if (m_headless) {
+                return initialize_headless_libraries();
+            }
+
             // initialize sdl2
             if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
                 printf("Error: SDL2 could not be intialized!\n");
@@ -18,7 +106,7 @@ namespace abradinjapan::voxelize {
             }
 
             // create the window
-            m_window = SDL_CreateWindow("Voxel Based Game! YEAH!", 0, 0, 720, 480, SDL_WINDOW_OPENGL);
+            m_window = SDL_CreateWindow("Voxel Based Game! YEAH!", 0, 0, m_width, m_height, SDL_WINDOW_OPENGL);
             if (m_window == NULL) {
                 printf("Error: SDL2 window could not be created!\n");
                 fflush(stdout);
@@ -34,16 +122,295 @@ namespace abradinjapan::voxelize {
             }
 
             // initilize glew
-            if (glewInit() != GLEW_OK) {
+            if (!initialize_glew()) {
                 printf("Error: GLEW could not be initialized!\n");
                 fflush(stdout);
                 return et::et_could_not_initialize_glew;
             }
 
+            // setup frame pacing
+            apply_frame_pacing();
+
             return et::et_no_error;
         }
 
+        void apply_frame_pacing() {
+            switch (m_pacing_mode) {
+            case pmt::pmt_adaptive_sync:
+                // late frames tear instead of waiting a whole refresh, not every driver supports it
+                if (SDL_GL_SetSwapInterval(-1) != 0) {
+                    SDL_GL_SetSwapInterval(1);
+                }
+                // keep the cap as a backstop for drivers that ignore the swap interval
+                m_frame_limiter.initialize(m_frame_cap);
+                break;
+            case pmt::pmt_vsync:
+                SDL_GL_SetSwapInterval(1);
+                m_frame_limiter.initialize(m_frame_cap);
+                break;
+            case pmt::pmt_capped:
+                SDL_GL_SetSwapInterval(0);
+                m_frame_limiter.initialize(m_frame_cap);
+                break;
+            case pmt::pmt_uncapped:
+                SDL_GL_SetSwapInterval(0);
+                m_frame_limiter.initialize(0.0);
+                break;
+            }
+        }
+
+        // eyes sit just under the top of the player
+        glm::vec3 get_eye_offset() {
+            return glm::vec3(0.0f, 0.0f, m_player.p_half_size.z - 0.2f);
+        }
+
+        // blocks are 1/8 of a render unit, chunk (x, y) is drawn at (x - 8, y - 8) and faces extend toward -z from their anchor
+        glm::vec3 block_to_render_space(glm::vec3 position) {
+            return glm::vec3((position.x / 8.0f) - 8.0f, (position.y / 8.0f) - 8.0f, (position.z / 8.0f) - (1.0f / 8.0f));
+        }
+
+        glm::vec3 get_look_direction(float yaw, float pitch) {
+            return glm::vec3(cosf(glm::radians(yaw)) * cosf(glm::radians(pitch)), sinf(glm::radians(yaw)) * cosf(glm::radians(pitch)), sinf(glm::radians(pitch)));
+        }
+
+        // first person controls for one fixed tick, speeds are in blocks and degrees per second
+        void update_player(float seconds) {
+            glm::vec3 forward = glm::vec3(cosf(glm::radians(m_player_yaw)), sinf(glm::radians(m_player_yaw)), 0.0f);
+            glm::vec3 right = glm::vec3(forward.y, -forward.x, 0.0f);
+            glm::vec3 walk = glm::vec3(0.0f);
+
+            // look
+            if (m_ui.is_action_active(at::at_pitch_up)) {
+                m_player_pitch += 90.0f * seconds;
+            }
+            if (m_ui.is_action_active(at::at_pitch_down)) {
+                m_player_pitch -= 90.0f * seconds;
+            }
+            if (m_ui.is_action_active(at::at_yaw_left)) {
+                m_player_yaw += 120.0f * seconds;
+            }
+            if (m_ui.is_action_active(at::at_yaw_right)) {
+                m_player_yaw -= 120.0f * seconds;
+            }
+            m_player_pitch = glm::clamp(m_player_pitch, -89.0f, 89.0f);
+
+            // walk
+            if (m_ui.is_action_active(at::at_move_forward)) {
+                walk += forward;
+            }
+            if (m_ui.is_action_active(at::at_move_backward)) {
+                walk -= forward;
+            }
+            if (m_ui.is_action_active(at::at_move_right)) {
+                walk += right;
+            }
+            if (m_ui.is_action_active(at::at_move_left)) {
+                walk -= right;
+            }
+            if (glm::length(walk) > 0.0f) {
+                walk = glm::normalize(walk) * 4.5f;
+            }
+
+            m_player.p_velocity.x = walk.x;
+            m_player.p_velocity.y = walk.y;
+
+            // fall and jump
+            m_player.p_velocity.z -= 32.0f * seconds;
+            if (m_player.p_on_ground && m_ui.is_action_active(at::at_jump)) {
+                m_player.p_velocity.z = 9.0f;
+            }
+
+            move_body(&m_world, &m_player, seconds);
+        }
+
+        // chunks are meshed through the mesh cache when one is open, it meshes them itself otherwise
+        void remesh_chunk(long long x, long long y) {
+            if (m_mesh_cache_path != 0) {
+                m_mesh_cache.send_to_gpu(m_world.get_chunk(x, y, 0), x, y, 0, (float)x - 8.0f, (float)y - 8.0f, 0.0f);
+            } else {
+                m_world.get_chunk(x, y, 0)->send_to_gpu((float)x - 8.0f, (float)y - 8.0f, 0.0f);
+            }
+        }
+
+        // still water in every open block of the loaded chunks below height, source blocks so it never drains
+        void flood(long long height) {
+            for (long long x = m_world.get_origin_x() * 8; x < (m_world.get_origin_x() + m_world.get_width()) * 8; x++) {
+                for (long long y = m_world.get_origin_y() * 8; y < (m_world.get_origin_y() + m_world.get_length()) * 8; y++) {
+                    for (long long z = 0; z < height && z < m_world.get_height() * 8; z++) {
+                        m_fluids.set_fluid_at(x, y, z, ft::ft_water, fluid_max_level, true);
+                    }
+                }
+            }
+        }
+
+        // headless runs read the last frame back and compare it against a reference image
+        et check_headless_image() {
+            unsigned char* pixels = new unsigned char[(size_t)m_width * (size_t)m_height * 3];
+            unsigned char* reference = 0;
+            int reference_width = 0, reference_height = 0;
+            unsigned long long changed;
+            et output = et::et_no_error;
+
+            m_offscreen.read_pixels(pixels);
+
+            if (m_capture_path != 0 && !write_ppm(m_capture_path, pixels, m_width, m_height)) {
+                printf("Error: could not write %s\n", m_capture_path);
+                output = et::et_could_not_write_image;
+            }
+
+            if (m_reference_path != 0) {
+                reference = read_ppm(m_reference_path, &reference_width, &reference_height);
+
+                if (reference == 0 || reference_width != m_width || reference_height != m_height) {
+                    printf("Image: %s is missing or is not a %i by %i ppm\n", m_reference_path, m_width, m_height);
+                    output = et::et_image_mismatch;
+                } else {
+                    changed = count_changed_pixels(pixels, reference, m_width, m_height);
+                    printf("Image: %llu of %i pixels differ from %s\n", changed, m_width * m_height, m_reference_path);
+
+                    if ((double)changed > image_mismatch_limit * (double)(m_width * m_height)) {
+                        output = et::et_image_mismatch;
+                    }
+                }
+            }
+            fflush(stdout);
+
+            delete[] reference;
+            delete[] pixels;
+
+            return output;
+        }
+
+        // give back what play sets up before the world, on the way out of play however it ends
+        void release_renderer(shaders* s, shaders* translucent_shaders, texture* t) {
+            t->uninitialize();
+
+            delete t;
+            delete s;
+            delete translucent_shaders;
+
+            if (m_headless) {
+                m_offscreen.uninitialize();
+            } else {
+                SDL_GL_DeleteContext(m_context);
+                SDL_DestroyWindow(m_window);
+                SDL_Quit();
+            }
+        }
+
+        // stop every thread and give back everything play set up, the only way out of play once the worker threads have started, failures included
+        // returning without it would leave the sorter and worker threads joinable, and the game's destructor would terminate
+        void end_play(shaders* s, shaders* translucent_shaders, texture* t, ldt* chunk_lods, chunk_888** translucent_chunks, float* translucent_distances) {
+            m_translucency.uninitialize();
+            m_fluids.uninitialize();
+            m_ticks.uninitialize();
+            m_lighting.uninitialize();
+            m_world.uninitialize(&m_chunk_pool);
+            m_generator.uninitialize();
+            m_workers.uninitialize();
+            m_cold_chunks.uninitialize();
+            m_mesh_cache.uninitialize();
+            m_server.uninitialize();
+            m_camera_path.uninitialize();
+            m_recorded_path.uninitialize();
+            m_frame_timings.uninitialize();
+            m_chunk_pool.uninitialize();
+            g_memory_accounts.close_log();
+            delete[] chunk_lods;
+            delete[] translucent_chunks;
+            delete[] translucent_distances;
+
+            release_renderer(s, translucent_shaders, t);
+        }
+
     public:
+        // bind an action to a key by their names, key names are SDL's ("W", "Space", "Left Shift", ...)
+        // returns false when either name is unknown
+        bool bind_action(const char* action, const char* key) {
+            SDL_Scancode scancode = SDL_GetScancodeFromName(key);
+
+            if (scancode == SDL_SCANCODE_UNKNOWN) {
+                return false;
+            }
+
+            for (unsigned int i = 0; i < at_count; i++) {
+                if (strcmp(at_names[i], action) == 0) {
+                    m_ui.bind_action((at)i, scancode);
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // frame_cap is in frames per second and is ignored by pmt_uncapped
+        void set_frame_pacing(pmt mode, double frame_cap) {
+            m_pacing_mode = mode;
+            m_frame_cap = frame_cap;
+        }
+
+        // how much ram chunks that left the view may keep, must be set before play
+        void set_cold_cache_limit(unsigned long long bytes) {
+            m_cold_cache_bytes = bytes;
+        }
+
+        // keep built chunk meshes in a file between runs, 0 turns it off, must be set before play
+        void set_mesh_cache_path(const char* path) {
+            m_mesh_cache_path = path;
+        }
+
+        // play a world streamed from a world_server instead of generating and simulating one, must be set before play
+        void set_server(const char* address, unsigned short port) {
+            m_server_address = address;
+            m_server_port = port;
+        }
+
+        // seeds world generation and block ticks, the same seed and camera path always give the same frames
+        void set_seed(unsigned long long seed) {
+            m_seed = seed;
+        }
+
+        // a scene with water for the translucent pass, every open block below height starts as still water
+        void set_flood(long long height) {
+            m_flood_height = height;
+        }
+
+        // write the camera to path once a tick, it is saved when the game exits
+        void set_camera_recording(const char* path) {
+            m_record_path = path;
+        }
+
+        // fly the camera along a recorded path instead of taking input, every frame advances exactly one tick so each run draws the same frames
+        // the game exits when the path ends
+        void set_camera_playback(const char* path) {
+            m_play_path = path;
+        }
+
+        // write how long every frame took to a csv file when the game exits
+        void set_frame_timings_path(const char* path) {
+            m_timings_path = path;
+        }
+
+        // rpt_faces uploads one small record per face and rebuilds the vertices in the shader, the mesh cache only holds rpt_vertices meshes so it is not used
+        void set_render_path(rpt render_path) {
+            m_render_path = render_path;
+        }
+
+        // write every tag's bytes and peak to a csv file once a second of ticks
+        void set_memory_log_path(const char* path) {
+            m_memory_log_path = path;
+        }
+
+        // render frames into an offscreen framebuffer instead of a window, each frame advances the simulation by exactly one tick while the player turns on the spot
+        // the last frame is written to capture_path and compared against reference_path, either may be 0
+        void set_headless(unsigned long long frames, const char* capture_path, const char* reference_path) {
+            m_headless = true;
+            m_headless_frames = frames;
+            m_capture_path = capture_path;
+            m_reference_path = reference_path;
+        }
+
         et play() {
             // initialize error variable
             et error = et::et_no_error;
@@ -56,76 +423,253 @@ namespace abradinjapan::voxelize {
 
             // initialize variables
             shaders* s = new shaders();
+            shaders* translucent_shaders = new shaders();
             texture* t = new texture();
             glm::mat4 model = glm::mat4(1.0f);
             glm::mat4 view = glm::mat4(1.0f);
             glm::mat4 projection = glm::mat4(1.0f);
-            chunk_888** cs = new chunk_888*[64];
+            ldt* chunk_lods = 0;
+            glm::vec3 camera_position = glm::vec3(0.0f);
+            glm::vec3 previous_player_position = glm::vec3(0.0f);
+            float previous_player_yaw = 0.0f, previous_player_pitch = 0.0f;
+            float alpha = 0.0f;
+            long long chunk_x = 0, chunk_y = 0;
             //chunk_side_88** css = new chunk_side_88*[(8 * 3) + 1]; // chunk sides
-            float* vertices_buffer = new float[(3 + 2) * 6 * 6 * 512 * 3];
-            float cam_move = 0.0f, cam_pitch = 0.0f, cam_yaw = 0.0f;
+            unsigned long long frame_heap_allocations = 0;
+            double frame_start = 0.0;
+            double now = 0.0;
+            unsigned long long frame_count = 0;
+            double play_start = get_seconds();
+            double first_frame_seconds = 0.0;
+            double wait_start = 0.0;
+            double work_seconds = 0.0;
+            glm::vec3 eye_position = glm::vec3(0.0f);
+            unsigned int chunks_remeshed = 0;
+            unsigned long long playback_frames = 0;
+            bool fixed_step = m_headless || m_play_path != 0;
+            bool remote = m_server_address != 0;
+            GLint chunk_origin_location = -1;
+            chunk_888** translucent_chunks = 0;
+            float* translucent_distances = 0;
+            unsigned int translucent_count = 0;
+            chunk_888* chunk = 0;
+            float distance = 0.0f;
+            unsigned int k = 0;
             //unsigned char* chunk_buffer = new unsigned char[64];
 
             // use shaders
-            s->use_shaders((char*)"./src/shaders/v5/");
+            s->use_shaders(m_render_path == rpt::rpt_faces ? (char*)"./src/shaders/v7/" : (char*)"./src/shaders/v6/");
             if (s->p_error < 0) {
+                release_renderer(s, translucent_shaders, t);
                 return et::et_error_unknown;
             }
+            if (m_render_path == rpt::rpt_faces) {
+                m_mesh_cache_path = 0;
+                glUniform1i(glGetUniformLocation(s->p_shaders_program_ID, "u_faces"), 1);
+                chunk_origin_location = glGetUniformLocation(s->p_shaders_program_ID, "u_chunk_origin");
+            }
+
+            // fluid is drawn from vertices on either render path, blended over everything else
+            translucent_shaders->use_shaders((char*)"./src/shaders/translucent/");
+            if (translucent_shaders->p_error < 0) {
+                release_renderer(s, translucent_shaders, t);
+                return et::et_error_unknown;
+            }
+            glUseProgram(s->p_shaders_program_ID);
 
             // change opengl states
             glEnable(GL_DEPTH_TEST);
             glClearColor(0.0, 0.0, 1.0, 1.0);
-            
-            // initialize vertices
-            for (unsigned int i = 0; i < 8; i++) {
-                for (unsigned int j = 0; j < 8; j++) {
-                    cs[i + (j * 8)] = generate_chunk(0, 0, 0);
-                    cs[i + (j * 8)]->initialize();
-                    cs[i + (j * 8)]->send_to_gpu(vertices_buffer, (float)i - 8.0f, (float)j - 8.0f, 0.0f);
+
+            // camera paths and timings are held in ram for the whole run, the path is read before any thread starts so a bad one can simply return
+            if (m_play_path != 0) {
+                m_camera_path.initialize(max_camera_keyframes);
+            }
+            if (m_record_path != 0) {
+                m_recorded_path.initialize(max_camera_keyframes);
+            }
+            if (m_play_path != 0 && !m_camera_path.load(m_play_path)) {
+                printf("Error: could not read the camera path %s\n", m_play_path);
+                fflush(stdout);
+                m_camera_path.uninitialize();
+                m_recorded_path.uninitialize();
+                release_renderer(s, translucent_shaders, t);
+                return et::et_could_not_read_camera_path;
+            }
+
+            // the memory log is opened before any thread starts too, so a path that cannot be written can simply return
+            if (m_memory_log_path != 0 && !g_memory_accounts.open_log(m_memory_log_path)) {
+                printf("Error: could not write %s\n", m_memory_log_path);
+                fflush(stdout);
+                m_camera_path.uninitialize();
+                m_recorded_path.uninitialize();
+                release_renderer(s, translucent_shaders, t);
+                return et::et_could_not_write_memory_log;
+            }
+
+            // initialize world, the generator looks one column past the window and shares its pool
+            m_workers.initialize(0);
+            m_generator.initialize(&m_chunk_pool, &m_workers, 5, 1);
+            m_generator.set_seed(m_seed);
+            m_generator.set_camera(32.0f, 32.0f);
+            m_chunk_pool.initialize(64 + m_generator.get_chunk_capacity(), mtt::mtt_chunks);
+            if (!remote) {
+                m_generator.finish_view();
+            }
+            m_world.set_remote(remote);
+            if (!m_world.initialize(&m_chunk_pool, remote ? 0 : &m_generator, 8, 8, 1)) {
+                end_play(s, translucent_shaders, t, chunk_lods, translucent_chunks, translucent_distances);
+                return et::et_error_unknown;
+            }
+            chunk_lods = new ldt[m_world.get_width() * m_world.get_length()];
+            translucent_chunks = new chunk_888*[m_world.get_width() * m_world.get_length()];
+            translucent_distances = new float[m_world.get_width() * m_world.get_length()];
+            m_cold_chunks.initialize(m_cold_cache_bytes, m_cold_cache_bytes / 256);
+            if (m_mesh_cache_path != 0 && !m_mesh_cache.initialize(m_mesh_cache_path, 1 << 16)) {
+                m_mesh_cache_path = 0;
+            }
+
+            m_lighting.initialize(&m_world);
+            m_lighting.light_world();
+
+            m_ticks.initialize(&m_world, &m_lighting, &m_workers);
+            m_ticks.set_seed(m_seed);
+            m_fluids.initialize(&m_world, &m_workers);
+            if (!remote) {
+                flood(m_flood_height);
+            }
+            m_translucency.initialize(m_world.get_width() * m_world.get_length() * m_world.get_height());
+
+            // the player spawns once the server has sent the ground under it
+            if (remote) {
+                error = m_server.initialize(m_server_address, m_server_port, &m_world);
+                if (error != et::et_no_error) {
+                    end_play(s, translucent_shaders, t, chunk_lods, translucent_chunks, translucent_distances);
+                    return error;
+                }
+
+                wait_start = get_seconds();
+                while (!m_server.is_chunk_held(4, 4) && m_server.receive(&m_world, &m_lighting) && get_seconds() - wait_start < 10.0) {
+                    SDL_Delay(1);
+                }
+                if (!m_server.is_chunk_held(4, 4)) {
+                    printf("Error: the server did not send the spawn chunk!\n");
+                    fflush(stdout);
+                    end_play(s, translucent_shaders, t, chunk_lods, translucent_chunks, translucent_distances);
+                    return et::et_could_not_connect_to_server;
                 }
             }
 
+            // spawn the player standing on the middle of the world
+            m_player.p_position = glm::vec3(32.0f, 32.0f, (float)(m_world.get_surface_height(32, 32) + 1) + m_player.p_half_size.z + body_skin);
+            previous_player_position = m_player.p_position;
+
             // create texture
             t->initialize((char*)"./assets/textures/test.png", GL_TEXTURE_2D, &error);
             if (error != et::et_no_error) {
-                return error; // TODO: Exit Cleanly
+                end_play(s, translucent_shaders, t, chunk_lods, translucent_chunks, translucent_distances);
+                return error;
             }
 
             t->send_texture_to_gpu();
 
             // run game
-            while (!m_ui.quit()) {
-                // get input
-                m_ui.update();
+            m_timestep.initialize(m_tick_rate);
+            if (m_play_path != 0) {
+                playback_frames = (unsigned long long)((m_camera_path.get_duration() / m_timestep.get_tick_seconds()) + 0.5) + 1;
+            }
+            if (m_timings_path != 0) {
+                m_frame_timings.initialize(m_play_path != 0 ? playback_frames : m_headless && m_headless_frames > 0 ? m_headless_frames : max_timed_frames);
+            }
+            frame_start = get_seconds();
 
-                // display screen
-                // clear screen
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-                
-                // update camera
-                // move textured box in 3d space
-                cam_move = 0.0f;
-                
-                if (m_ui.w()) {
-                    cam_move = 0.5f;
-                    cam_pitch = 1.0f;
+            while (!m_ui.quit() && (!m_headless || m_headless_frames == 0 || frame_count < m_headless_frames) && (m_play_path == 0 || frame_count < playback_frames)) {
+                frame_heap_allocations = g_allocation_counters.p_heap_allocations;
+
+                // measure frame
+                now = get_seconds();
+                m_timestep.add_frame_time(fixed_step ? m_timestep.get_tick_seconds() : now - frame_start);
+                m_frame_statistics.record(now - frame_start);
+                frame_start = now;
+
+                // get input
+                if (!m_headless) {
+                    m_ui.update();
                 }
-                if (m_ui.s()) {
-                    cam_move = 0.5f;
-                    cam_pitch = -1.0f;
+
+                // chunks and changes from the server
+                if (remote) {
+                    m_server.receive(&m_world, &m_lighting);
                 }
-                if (m_ui.a()) {
-                    cam_move = 0.5f;
-                    cam_yaw = 1.0f;
+
+                // update simulation at a fixed rate, independent of how fast frames are drawn
+                while (m_timestep.tick()) {
+                    m_ui.begin_tick(m_timestep.get_tick_end_time(now));
+                    previous_player_position = m_player.p_position;
+                    previous_player_yaw = m_player_yaw;
+                    previous_player_pitch = m_player_pitch;
+
+                    if (m_play_path != 0) {
+                        // the path moves the eye directly, no input and no physics
+                        m_camera_path.sample((double)(m_timestep.get_tick_count() - 1) * m_timestep.get_tick_seconds(), &eye_position, &m_player_yaw, &m_player_pitch);
+                        m_player.p_position = eye_position - get_eye_offset();
+                        m_player.p_velocity = glm::vec3(0.0f);
+                    } else {
+                        if (m_headless && m_headless_frames > 0) {
+                            m_player_yaw += 360.0f / (float)m_headless_frames;
+                        }
+
+                        update_player((float)m_timestep.get_tick_seconds());
+                    }
+                    if (m_record_path != 0) {
+                        m_recorded_path.add((double)(m_timestep.get_tick_count() - 1) * m_timestep.get_tick_seconds(), m_player.p_position + get_eye_offset(), m_player_yaw, m_player_pitch);
+                    }
+
+                    // a server runs blocks and fluids itself
+                    if (!remote) {
+                        m_ticks.tick();
+                        m_fluids.tick();
+                    }
+
+                    // keep the loaded chunks centred on the player
+                    m_generator.set_camera(m_player.p_position.x, m_player.p_position.y);
+                    if (!m_world.recentre(&m_chunk_pool, &m_cold_chunks, (long long)floorf(m_player.p_position.x / 8.0f), (long long)floorf(m_player.p_position.y / 8.0f))) {
+                        end_play(s, translucent_shaders, t, chunk_lods, translucent_chunks, translucent_distances);
+                        return et::et_error_unknown;
+                    }
+
+                    if (remote) {
+                        m_server.send_position(&m_world, m_player.p_position.x, m_player.p_position.y, m_player.p_position.z);
+                    }
+
+                    // once per press
+                    if (m_ui.is_action_active(at::at_print_memory) && !m_print_memory_held) {
+                        g_memory_accounts.print();
+                    }
+                    m_print_memory_held = m_ui.is_action_active(at::at_print_memory);
+
+                    // once a second of ticks
+                    if (m_timestep.get_tick_count() % (unsigned long long)m_tick_rate == 0) {
+                        g_memory_accounts.write_log((double)m_timestep.get_tick_count() * m_timestep.get_tick_seconds());
+                    }
                 }
-                if (m_ui.d()) {
-                    cam_move = 0.5f;
-                    cam_yaw = -1.0f;
+
+                // generate ahead of the player, one batch a frame
+                if (remote) {
+                    m_server.flush();
+                } else {
+                    m_generator.update();
                 }
 
-                model = glm::rotate(model, glm::radians(cam_move), glm::vec3(cam_pitch, cam_yaw, 1.0f));
-                view = glm::lookAt(glm::vec3(8.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)); //glm::lookAt(camera_position, camera_position + camera_front, camera_up);
-                projection = glm::perspective(glm::radians(45.0f), 720.0f / 480.0f, 0.1f, 100.0f);
+                // display screen
+                // clear screen
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                // interpolate the camera between the last two ticks, eyes sit just under the top of the player
+                alpha = m_timestep.get_alpha();
+                camera_position = block_to_render_space(glm::mix(previous_player_position, m_player.p_position, alpha) + get_eye_offset());
+                view = glm::lookAt(camera_position, camera_position + get_look_direction(glm::mix(previous_player_yaw, m_player_yaw, alpha), glm::mix(previous_player_pitch, m_player_pitch, alpha)), glm::vec3(0.0f, 0.0f, 1.0f));
+                projection = glm::perspective(glm::radians(45.0f), (float)m_width / (float)m_height, 0.01f, 100.0f);
                 
                 glUniformMatrix4fv(glGetUniformLocation(s->p_shaders_program_ID, "u_model"), 1, GL_FALSE, glm::value_ptr(model));
                 glUniformMatrix4fv(glGetUniformLocation(s->p_shaders_program_ID, "u_view"), 1, GL_FALSE, glm::value_ptr(view));
@@ -136,10 +680,96 @@ namespace abradinjapan::voxelize {
                 t->bind();
                 glUniform1i(glGetUniformLocation(s->p_shaders_program_ID, "u_texture_1"), 0);
 
-                for (unsigned int i = 0; i < 64; i++) {
-                    cs[i]->bind();
-                    cs[i]->draw();
-                    cs[i]->unbind();
+                // remesh changed chunks, chunks that just came into view get their gpu objects first
+                // i and j walk the window, chunk positions are absolute
+                chunks_remeshed = 0;
+                for (long long i = 0; i < m_world.get_width(); i++) {
+                    for (long long j = 0; j < m_world.get_length(); j++) {
+                        chunk_x = m_world.get_origin_x() + i;
+                        chunk_y = m_world.get_origin_y() + j;
+
+                        if (!m_world.get_chunk(chunk_x, chunk_y, 0)->is_initialized()) {
+                            m_world.get_chunk(chunk_x, chunk_y, 0)->initialize(m_render_path);
+                        }
+                        if (m_world.get_chunk(chunk_x, chunk_y, 0)->is_dirty()) {
+                            remesh_chunk(chunk_x, chunk_y);
+                            chunks_remeshed++;
+                        }
+                    }
+                }
+
+                // pick a level of detail for each chunk
+                for (long long i = 0; i < m_world.get_width(); i++) {
+                    for (long long j = 0; j < m_world.get_length(); j++) {
+                        chunk_lods[i + (j * m_world.get_width())] = select_lod(glm::distance(camera_position, glm::vec3((float)(m_world.get_origin_x() + i) - 7.5f, (float)(m_world.get_origin_y() + j) - 7.5f, 0.375f)), m_lod_distance);
+                    }
+                }
+
+                for (long long i = 0; i < m_world.get_width(); i++) {
+                    for (long long j = 0; j < m_world.get_length(); j++) {
+                        chunk_x = m_world.get_origin_x() + i;
+                        chunk_y = m_world.get_origin_y() + j;
+
+                        // face records are the same wherever the chunk is, the shader places them
+                        if (m_render_path == rpt::rpt_faces) {
+                            glUniform3f(chunk_origin_location, (float)chunk_x - 8.0f, (float)chunk_y - 8.0f, 0.0f);
+                        }
+                        m_world.get_chunk(chunk_x, chunk_y, 0)->bind(chunk_lods[i + (j * m_world.get_width())]);
+                        m_world.get_chunk(chunk_x, chunk_y, 0)->draw(chunk_lods[i + (j * m_world.get_width())], get_seam_mask(chunk_lods, m_world.get_width(), m_world.get_length(), i, j));
+                        m_world.get_chunk(chunk_x, chunk_y, 0)->unbind(chunk_lods[i + (j * m_world.get_width())]);
+                    }
+                }
+
+                // translucent faces last, farthest chunk first, each chunk's faces are kept back to front by m_translucency
+                // runs that draw the same frames every time wait for the sort instead of picking it up a few frames late, and check its order
+                m_translucency.update(&m_world, camera_position);
+                if (fixed_step) {
+                    m_translucency.wait();
+                    m_translucency.check_order();
+                    m_translucency.update(&m_world, camera_position);
+                }
+
+                translucent_count = 0;
+                for (long long i = 0; i < m_world.get_width(); i++) {
+                    for (long long j = 0; j < m_world.get_length(); j++) {
+                        chunk = m_world.get_chunk(m_world.get_origin_x() + i, m_world.get_origin_y() + j, 0);
+                        if (chunk->get_translucent_faces() == 0) {
+                            continue;
+                        }
+
+                        // insert by distance, farthest first
+                        distance = glm::distance(camera_position, glm::vec3((float)(m_world.get_origin_x() + i) - 7.5f, (float)(m_world.get_origin_y() + j) - 7.5f, 0.375f));
+                        k = translucent_count;
+                        while (k > 0 && translucent_distances[k - 1] < distance) {
+                            translucent_chunks[k] = translucent_chunks[k - 1];
+                            translucent_distances[k] = translucent_distances[k - 1];
+                            k--;
+                        }
+                        translucent_chunks[k] = chunk;
+                        translucent_distances[k] = distance;
+                        translucent_count++;
+                    }
+                }
+
+                if (translucent_count > 0) {
+                    glUseProgram(translucent_shaders->p_shaders_program_ID);
+                    glUniformMatrix4fv(glGetUniformLocation(translucent_shaders->p_shaders_program_ID, "u_model"), 1, GL_FALSE, glm::value_ptr(model));
+                    glUniformMatrix4fv(glGetUniformLocation(translucent_shaders->p_shaders_program_ID, "u_view"), 1, GL_FALSE, glm::value_ptr(view));
+                    glUniformMatrix4fv(glGetUniformLocation(translucent_shaders->p_shaders_program_ID, "u_projection"), 1, GL_FALSE, glm::value_ptr(projection));
+                    glUniform1i(glGetUniformLocation(translucent_shaders->p_shaders_program_ID, "u_texture_1"), 0);
+
+                    // test against the opaque depth but leave it alone, so translucent faces never hide each other
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glDepthMask(GL_FALSE);
+
+                    for (unsigned int i = 0; i < translucent_count; i++) {
+                        translucent_chunks[i]->draw_translucent();
+                    }
+
+                    glDepthMask(GL_TRUE);
+                    glDisable(GL_BLEND);
+                    glUseProgram(s->p_shaders_program_ID);
                 }
 
                 /*for (unsigned int i = 0; i < 6; i++) {
@@ -150,30 +780,89 @@ namespace abradinjapan::voxelize {
 
                 t->unbind();
 
-                // update window
-                SDL_GL_SwapWindow(m_window);
+                // update window, headless frames wait for the rasterizer so their times cover the whole frame
+                if (m_headless) {
+                    glFinish();
+                } else {
+                    SDL_GL_SwapWindow(m_window);
+                }
+                if (frame_count == 0) {
+                    first_frame_seconds = get_seconds() - play_start;
+                }
+                work_seconds = get_seconds() - frame_start;
+
+                // input to present latency of the oldest input shown in this frame
+                if (m_ui.get_first_consumed_time() >= 0.0) {
+                    m_input_latency_statistics.record(get_seconds() - m_ui.get_first_consumed_time());
+                }
+                m_ui.end_frame();
+
+                m_frame_limiter.wait();
+
+                if (m_timings_path != 0) {
+                    m_frame_timings.record((double)m_timestep.get_tick_count() * m_timestep.get_tick_seconds(), get_seconds() - frame_start, work_seconds, chunks_remeshed);
+                }
+
+                // the steady state loop should never touch the general heap
+                if (g_allocation_counters.p_heap_allocations != frame_heap_allocations) {
+                    m_frames_with_heap_allocations++;
+                }
+                frame_count++;
+            }
+
+            if (m_headless) {
+                error = check_headless_image();
+            }
+            if (m_record_path != 0) {
+                if (m_recorded_path.save(m_record_path)) {
+                    printf("Camera path: %llu keyframes written to %s\n", m_recorded_path.get_count(), m_record_path);
+                } else {
+                    printf("Error: could not write %s\n", m_record_path);
+                    error = et::et_could_not_write_camera_path;
+                }
+            }
+            if (m_timings_path != 0) {
+                if (m_frame_timings.write_csv(m_timings_path)) {
+                    printf("Frame timings: %llu frames written to %s\n", m_frame_timings.get_count(), m_timings_path);
+                } else {
+                    printf("Error: could not write %s\n", m_timings_path);
+                    error = et::et_could_not_write_timings;
+                }
             }
 
+            if (m_memory_log_path != 0) {
+                g_memory_accounts.write_log((double)m_timestep.get_tick_count() * m_timestep.get_tick_seconds());
+                if (g_memory_accounts.close_log()) {
+                    printf("Memory log: written to %s\n", m_memory_log_path);
+                } else {
+                    printf("Error: could not write %s\n", m_memory_log_path);
+                    error = et::et_could_not_write_memory_log;
+                }
+            }
+
+            printf("First frame: %.3f ms after starting\n", first_frame_seconds * 1000.0);
+            m_frame_statistics.print("Frames");
+            m_input_latency_statistics.print("Input latency");
+            printf("Input transitions dropped: %llu\n", m_ui.get_transitions_dropped());
+            g_allocation_counters.print();
+            printf("\tframes with heap allocations: %llu\n", m_frames_with_heap_allocations);
+            fflush(stdout);
+            m_cold_chunks.print();
+            m_generator.print();
+            m_mesh_cache.print();
+            m_translucency.print();
+            if (remote) {
+                m_server.print();
+            }
+            g_memory_accounts.print();
+
             /*for (unsigned int i = 0; i < 6; i++) {
                 css[i]->uninitialize();
                 delete css[i];
             }*/
             
-            for (unsigned int i = 0; i < 64; i++) {
-                delete cs[i];
-            }
-            delete[] cs;
-            
-            t->uninitialize();
-
-            delete[] vertices_buffer;
             //delete css;
-            delete t;
-            delete s;
-
-            SDL_GL_DeleteContext(m_context);
-            SDL_DestroyWindow(m_window);
-            SDL_Quit();
+            end_play(s, translucent_shaders, t, chunk_lods, translucent_chunks, translucent_distances);
 
             return error;
         }
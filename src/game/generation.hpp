@@ -0,0 +1,455 @@
+#pragma once
+
+#include "terrain.hpp"
+#include "workers.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+namespace abradinjapan::voxelize {
+    // generation stage type, in the order they run
+    enum gst {
+        gst_terrain,
+        gst_carving,
+        gst_features,
+        gst_lighting,
+        gst_count
+    };
+
+    // how many columns away each stage reads, a column runs a stage once every column that close has finished the stage before it
+    // lighting is left to the light engine when the world takes the column, its radius is as far as light travels
+    const long long generation_stage_radii[gst_count] = { 0, 0, 1, 2 };
+
+    // a column of chunks on its way through the stages
+    struct generation_column {
+        long long x, y; // chunk coordinates
+        bool present;
+        unsigned int stage; // how many stages have finished
+        short surface_heights[64]; // highest solid block of each block column once carved, -1 for none
+        unsigned short surface_blocks[64];
+    };
+
+    struct generation_job {
+        long long slot;
+        float distance; // from the camera, nearest runs first
+    };
+
+    // generates columns of chunks ahead of the world, a stage at a time, so features like trees can reach across chunk borders
+    // a stage only writes its own column and only reads columns that are done with what it reads, so every job in a batch runs in parallel without locks
+    // the columns kept form a square around the camera that wraps like the world's window, a column falling out of it is dropped wherever it got to
+    class generation_pipeline {
+        slab_pool<chunk_888>* m_pool = 0;
+        worker_pool* m_workers = 0;
+        climate_map m_climates;
+        generation_column* m_columns = 0;
+        chunk_888** m_chunks = 0; // height chunks per column, 0 when not generated yet or taken by the world
+        generation_job* m_jobs = 0;
+        unsigned long long m_job_count = 0;
+        unsigned long long m_batch_size = 0;
+        long long m_size = 0; // columns along each side of the square
+        long long m_height = 0; // chunks per column
+        long long m_view_radius = 0;
+        long long m_focus_x = 0;
+        long long m_focus_y = 0;
+        float m_camera_x = 0.0f;
+        float m_camera_y = 0.0f;
+        unsigned long long m_seed = 1;
+        unsigned long long m_stages_run[gst_count];
+        unsigned long long m_columns_cancelled = 0;
+        unsigned long long m_columns_forced = 0;
+
+        // how far past the view a column has to reach a stage, so the stages after it have what they read
+        long long get_stage_reach(unsigned int stage) {
+            long long output = 0;
+
+            for (unsigned int i = stage + 1; i < gst_count; i++) {
+                output += generation_stage_radii[i];
+            }
+
+            return output;
+        }
+
+        long long get_slot(long long x, long long y) {
+            long long slot_x = x % m_size;
+            long long slot_y = y % m_size;
+
+            slot_x = slot_x < 0 ? slot_x + m_size : slot_x;
+            slot_y = slot_y < 0 ? slot_y + m_size : slot_y;
+
+            return slot_x + (slot_y * m_size);
+        }
+
+        // columns further from the focus than this are not kept
+        long long get_area_radius() {
+            return m_view_radius + get_stage_reach(gst_terrain);
+        }
+
+        long long get_focus_distance(long long x, long long y) {
+            long long distance_x = x < m_focus_x ? m_focus_x - x : x - m_focus_x;
+            long long distance_y = y < m_focus_y ? m_focus_y - y : y - m_focus_y;
+
+            return distance_x > distance_y ? distance_x : distance_y;
+        }
+
+        // whether every column within the stage's radius has finished the stage before it
+        bool can_run(generation_column* column, unsigned int stage) {
+            generation_column* neighbour;
+
+            for (long long x = column->x - generation_stage_radii[stage]; x <= column->x + generation_stage_radii[stage]; x++) {
+                for (long long y = column->y - generation_stage_radii[stage]; y <= column->y + generation_stage_radii[stage]; y++) {
+                    neighbour = get_column(x, y);
+
+                    if (neighbour == 0 || neighbour->stage < stage) {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        // chunks come out of the shared pool on the calling thread, never in a job
+        bool allocate_column(long long slot) {
+            for (long long z = 0; z < m_height; z++) {
+                if (m_chunks[(slot * m_height) + z] == 0) {
+                    m_chunks[(slot * m_height) + z] = m_pool->allocate();
+                }
+
+                if (m_chunks[(slot * m_height) + z] == 0) {
+                    release_column(slot);
+
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void release_column(long long slot) {
+            for (long long z = 0; z < m_height; z++) {
+                m_pool->deallocate(m_chunks[(slot * m_height) + z]);
+                m_chunks[(slot * m_height) + z] = 0;
+            }
+        }
+
+        static bool lookup_surface(void* context, long long x, long long y, long long* height, unsigned short* block) {
+            generation_column* column = ((generation_pipeline*)context)->get_column(x >> 3, y >> 3);
+
+            if (column == 0 || column->stage <= gst_carving) {
+                return false;
+            }
+
+            *height = column->surface_heights[(x & 7) + ((y & 7) * 8)];
+            *block = column->surface_blocks[(x & 7) + ((y & 7) * 8)];
+
+            return *height >= 0;
+        }
+
+        void run_stage(long long slot, unsigned int stage) {
+            generation_column* column = &m_columns[slot];
+            chunk_888** chunks = &m_chunks[slot * m_height];
+
+            if (stage == gst::gst_terrain) {
+                for (long long z = 0; z < m_height; z++) {
+                    generate_terrain(chunks[z], &m_climates, column->x, column->y, z);
+                }
+            } else if (stage == gst::gst_carving) {
+                for (long long z = 0; z < m_height; z++) {
+                    carve_caves(chunks[z], column->x, column->y, z);
+                }
+
+                // the surface is what features stand on, so it is taken once carving is over and never changes after
+                for (unsigned int i = 0; i < 64; i++) {
+                    column->surface_heights[i] = -1;
+                    column->surface_blocks[i] = bt::bt_air;
+
+                    for (long long z = (m_height * 8) - 1; z >= 0; z--) {
+                        if (chunks[z >> 3]->get_block_at(i & 7, i >> 3, z & 7) != bt::bt_air) {
+                            column->surface_heights[i] = (short)z;
+                            column->surface_blocks[i] = chunks[z >> 3]->get_block_at(i & 7, i >> 3, z & 7);
+
+                            break;
+                        }
+                    }
+                }
+            } else if (stage == gst::gst_features) {
+                for (long long z = 0; z < m_height; z++) {
+                    place_trees(chunks[z], column->x, column->y, z, m_seed, lookup_surface, this);
+                }
+            }
+        }
+
+        static void run_job(void* context, unsigned long long index) {
+            generation_pipeline* pipeline = (generation_pipeline*)context;
+            long long slot = pipeline->m_jobs[index].slot;
+
+            pipeline->run_stage(slot, pipeline->m_columns[slot].stage);
+        }
+
+        // bring one column through a stage right now on the calling thread, along with whatever it depends on
+        void finish_stage(long long x, long long y, unsigned int stage) {
+            generation_column* column = get_column(x, y);
+            long long slot = get_slot(x, y);
+            unsigned int next;
+
+            if (column == 0) {
+                return;
+            }
+
+            while (column->stage <= stage) {
+                next = column->stage;
+
+                for (long long i = x - generation_stage_radii[next]; i <= x + generation_stage_radii[next] && next > 0; i++) {
+                    for (long long j = y - generation_stage_radii[next]; j <= y + generation_stage_radii[next]; j++) {
+                        if (i != x || j != y) {
+                            finish_stage(i, j, next - 1);
+                        }
+                    }
+                }
+
+                if (next == gst::gst_terrain) {
+                    if (!allocate_column(slot)) {
+                        return;
+                    }
+
+                    m_climates.prepare(x * 8, y * 8);
+                }
+
+                run_stage(slot, next);
+                column->stage++;
+                m_stages_run[next]++;
+            }
+        }
+
+    public:
+        // view_radius is in columns around the camera, height is in chunks and matches the world
+        void initialize(slab_pool<chunk_888>* pool, worker_pool* workers, long long view_radius, long long height) {
+            m_pool = pool;
+            m_workers = workers;
+            m_view_radius = view_radius;
+            m_height = height;
+            m_size = (get_area_radius() * 2) + 1;
+            m_columns = new generation_column[m_size * m_size];
+            m_chunks = new chunk_888*[m_size * m_size * height];
+            m_jobs = new generation_job[m_size * m_size];
+            m_job_count = 0;
+            m_batch_size = (workers->get_thread_count() + 1) * 8;
+            m_climates.initialize(std::max(m_batch_size, (unsigned long long)(((m_size * 8) / climate_region_size) + 2) * (unsigned long long)(((m_size * 8) / climate_region_size) + 2)));
+            m_columns_cancelled = 0;
+            m_columns_forced = 0;
+
+            for (long long i = 0; i < m_size * m_size; i++) {
+                m_columns[i].present = false;
+            }
+            for (long long i = 0; i < m_size * m_size * height; i++) {
+                m_chunks[i] = 0;
+            }
+            for (unsigned int i = 0; i < gst_count; i++) {
+                m_stages_run[i] = 0;
+            }
+
+            // nothing is kept until the camera is set
+            m_focus_x = 0;
+            m_focus_y = 0;
+        }
+
+        void set_seed(unsigned long long seed) {
+            m_seed = seed;
+            m_climates.set_seed(seed);
+        }
+
+        // the most chunks the pipeline can hold at once, the shared pool needs room for these on top of the world's
+        unsigned long long get_chunk_capacity() {
+            return (unsigned long long)(m_size * m_size * m_height);
+        }
+
+        // returns 0 for columns that are not being kept
+        generation_column* get_column(long long x, long long y) {
+            generation_column* output = &m_columns[get_slot(x, y)];
+
+            if (!output->present || output->x != x || output->y != y) {
+                return 0;
+            }
+
+            return output;
+        }
+
+        // in blocks, columns that end up outside the kept square are cancelled and new ones start from nothing
+        void set_camera(float x, float y) {
+            long long focus_x = (long long)floorf(x / 8.0f);
+            long long focus_y = (long long)floorf(y / 8.0f);
+            long long slot;
+
+            m_camera_x = x;
+            m_camera_y = y;
+            m_focus_x = focus_x;
+            m_focus_y = focus_y;
+
+            // cancel
+            for (long long i = 0; i < m_size * m_size; i++) {
+                if (m_columns[i].present && get_focus_distance(m_columns[i].x, m_columns[i].y) > get_area_radius()) {
+                    if (m_columns[i].stage < gst::gst_lighting) {
+                        m_columns_cancelled++;
+                    }
+
+                    release_column(i);
+                    m_columns[i].present = false;
+                }
+            }
+
+            // start
+            for (long long x = focus_x - get_area_radius(); x <= focus_x + get_area_radius(); x++) {
+                for (long long y = focus_y - get_area_radius(); y <= focus_y + get_area_radius(); y++) {
+                    slot = get_slot(x, y);
+
+                    if (!m_columns[slot].present) {
+                        m_columns[slot].x = x;
+                        m_columns[slot].y = y;
+                        m_columns[slot].present = true;
+                        m_columns[slot].stage = gst::gst_terrain;
+                    }
+                }
+            }
+        }
+
+        // run one batch of whichever stages are ready, nearest the camera first, returns the number of jobs run
+        unsigned long long update() {
+            generation_column* column;
+            unsigned long long count;
+
+            // find the ready jobs
+            m_job_count = 0;
+            for (long long i = 0; i < m_size * m_size; i++) {
+                column = &m_columns[i];
+
+                if (!column->present || column->stage >= gst::gst_lighting) {
+                    continue;
+                }
+                if (get_focus_distance(column->x, column->y) > m_view_radius + get_stage_reach(column->stage) || !can_run(column, column->stage)) {
+                    continue;
+                }
+
+                m_jobs[m_job_count].slot = i;
+                m_jobs[m_job_count].distance = glm::length(glm::vec3((float)(column->x * 8) + 4.0f - m_camera_x, (float)(column->y * 8) + 4.0f - m_camera_y, 0.0f));
+                m_job_count++;
+            }
+
+            std::sort(m_jobs, m_jobs + m_job_count, [](const generation_job& a, const generation_job& b) { return a.distance < b.distance; });
+
+            // take the nearest, starting a column needs its chunks and its climate first
+            count = 0;
+            for (unsigned long long i = 0; i < m_job_count && count < m_batch_size; i++) {
+                if (m_columns[m_jobs[i].slot].stage == gst::gst_terrain) {
+                    if (!allocate_column(m_jobs[i].slot)) {
+                        continue;
+                    }
+
+                    m_climates.prepare(m_columns[m_jobs[i].slot].x * 8, m_columns[m_jobs[i].slot].y * 8);
+                }
+
+                m_jobs[count] = m_jobs[i];
+                count++;
+            }
+
+            m_workers->run(run_job, this, count);
+
+            for (unsigned long long i = 0; i < count; i++) {
+                m_stages_run[m_columns[m_jobs[i].slot].stage]++;
+                m_columns[m_jobs[i].slot].stage++;
+            }
+
+            return count;
+        }
+
+        // whether a column is done with every stage the pipeline runs and everything its lighting reads is done too
+        bool is_ready(long long x, long long y) {
+            generation_column* column = get_column(x, y);
+
+            return column != 0 && column->stage >= gst::gst_lighting && can_run(column, gst::gst_lighting);
+        }
+
+        // keep running batches until every column in view is ready, for loading before the first frame
+        void finish_view() {
+            bool done = false;
+
+            while (!done) {
+                done = true;
+
+                for (long long x = m_focus_x - m_view_radius; x <= m_focus_x + m_view_radius && done; x++) {
+                    for (long long y = m_focus_y - m_view_radius; y <= m_focus_y + m_view_radius && done; y++) {
+                        done = is_ready(x, y);
+                    }
+                }
+
+                if (!done && update() == 0) {
+                    return;
+                }
+            }
+        }
+
+        // hand a chunk over to the world, which lights it
+        // a column that is not far enough along is finished on the spot, returns 0 for columns that are not being kept or when the pool is full
+        chunk_888* take(long long x, long long y, long long z) {
+            generation_column* column = get_column(x, y);
+            long long slot = get_slot(x, y);
+            chunk_888* output;
+
+            if (column == 0) {
+                return 0;
+            }
+
+            // taken before and wanted again, generating is deterministic so it is simply run again
+            if (m_chunks[(slot * m_height) + z] == 0 && column->stage > gst::gst_terrain) {
+                column->stage = gst::gst_terrain;
+            }
+
+            if (column->stage < gst::gst_lighting) {
+                finish_stage(x, y, gst::gst_features);
+                m_columns_forced++;
+            }
+
+            output = m_chunks[(slot * m_height) + z];
+            m_chunks[(slot * m_height) + z] = 0;
+
+            return output;
+        }
+
+        unsigned long long get_stages_run(gst stage) {
+            return m_stages_run[stage];
+        }
+
+        unsigned long long get_columns_cancelled() {
+            return m_columns_cancelled;
+        }
+
+        unsigned long long get_columns_forced() {
+            return m_columns_forced;
+        }
+
+        void print() {
+            printf("Generation:\n");
+            printf("\tstages run: %llu terrain, %llu carving, %llu features\n", m_stages_run[gst::gst_terrain], m_stages_run[gst::gst_carving], m_stages_run[gst::gst_features]);
+            printf("\tcolumns cancelled: %llu, finished on demand: %llu\n", m_columns_cancelled, m_columns_forced);
+            fflush(stdout);
+            m_climates.print();
+        }
+
+        void uninitialize() {
+            for (long long i = 0; i < m_size * m_size; i++) {
+                release_column(i);
+            }
+
+            delete[] m_columns;
+            delete[] m_chunks;
+            delete[] m_jobs;
+            m_climates.uninitialize();
+
+            m_columns = 0;
+            m_chunks = 0;
+            m_jobs = 0;
+            m_job_count = 0;
+            m_size = 0;
+            m_height = 0;
+        }
+    };
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace abradinjapan::voxelize {
+    // channels may differ by this much before a pixel counts as changed, drivers round blending and filtering a little differently
+    const int image_channel_tolerance = 8;
+
+    // the share of changed pixels an image may have and still match its reference
+    const double image_mismatch_limit = 0.001;
+
+    // an opengl context with no window that renders into its own framebuffer
+    // surfaceless egl needs no display server, so it runs on build machines without a gpu through mesa's software rasterizer
+    class offscreen_context {
+        EGLDisplay m_display = EGL_NO_DISPLAY;
+        EGLContext m_context = EGL_NO_CONTEXT;
+        GLuint m_framebuffer = 0;
+        GLuint m_colour = 0;
+        GLuint m_depth = 0;
+        int m_width = 0;
+        int m_height = 0;
+
+    public:
+        // makes the context current and binds the framebuffer, glew still needs initializing after
+        et create_context(int width, int height) {
+            EGLint major, minor;
+            EGLConfig config;
+            EGLint config_count = 0;
+            PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            const EGLint config_attributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+            };
+            const EGLint context_attributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+                EGL_NONE
+            };
+
+            m_width = width;
+            m_height = height;
+
+            // mesa's surfaceless platform first, any other driver's default display after
+            if (get_platform_display != 0) {
+                m_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+            }
+            if (m_display == EGL_NO_DISPLAY) {
+                m_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            }
+            if (m_display == EGL_NO_DISPLAY || eglInitialize(m_display, &major, &minor) != EGL_TRUE) {
+                printf("Error: EGL display could not be initialized!\n");
+                fflush(stdout);
+                return et::et_could_not_create_offscreen_context;
+            }
+
+            if (eglChooseConfig(m_display, config_attributes, &config, 1, &config_count) != EGL_TRUE || config_count == 0 || eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
+                printf("Error: EGL has no OpenGL config!\n");
+                fflush(stdout);
+                return et::et_could_not_create_offscreen_context;
+            }
+
+            // no surface at all, everything is drawn into the framebuffer below
+            m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, context_attributes);
+            if (m_context == EGL_NO_CONTEXT || eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context) != EGL_TRUE) {
+                printf("Error: EGL OpenGL context could not be created!\n");
+                fflush(stdout);
+                return et::et_could_not_create_offscreen_context;
+            }
+
+            return et::et_no_error;
+        }
+
+        // needs glew, so it runs once glew is up
+        et create_framebuffer() {
+            glGenFramebuffers(1, &m_framebuffer);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+
+            glGenRenderbuffers(1, &m_colour);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_colour);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colour);
+
+            glGenRenderbuffers(1, &m_depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                printf("Error: offscreen framebuffer is incomplete!\n");
+                fflush(stdout);
+                return et::et_could_not_create_offscreen_context;
+            }
+
+            // a context without a surface starts with an empty viewport
+            glViewport(0, 0, m_width, m_height);
+
+            return et::et_no_error;
+        }
+
+        int get_width() {
+            return m_width;
+        }
+
+        int get_height() {
+            return m_height;
+        }
+
+        // the last frame drawn, width * height * 3 bytes of rgb with the top row first
+        void read_pixels(unsigned char* output) {
+            unsigned char swap;
+
+            glFinish();
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, output);
+
+            // opengl reads from the bottom up
+            for (int y = 0; y < m_height / 2; y++) {
+                for (int x = 0; x < m_width * 3; x++) {
+                    swap = output[(y * m_width * 3) + x];
+                    output[(y * m_width * 3) + x] = output[((m_height - 1 - y) * m_width * 3) + x];
+                    output[((m_height - 1 - y) * m_width * 3) + x] = swap;
+                }
+            }
+        }
+
+        void uninitialize() {
+            if (m_framebuffer != 0) {
+                glDeleteFramebuffers(1, &m_framebuffer);
+                glDeleteRenderbuffers(1, &m_colour);
+                glDeleteRenderbuffers(1, &m_depth);
+            }
+
+            if (m_display != EGL_NO_DISPLAY) {
+                eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                if (m_context != EGL_NO_CONTEXT) {
+                    eglDestroyContext(m_display, m_context);
+                }
+                eglTerminate(m_display);
+            }
+
+            m_display = EGL_NO_DISPLAY;
+            m_context = EGL_NO_CONTEXT;
+            m_framebuffer = 0;
+            m_colour = 0;
+            m_depth = 0;
+        }
+    };
+
+    // binary ppm, rgb with the top row first
+    bool write_ppm(const char* path, unsigned char* pixels, int width, int height) {
+        FILE* f = fopen(path, "wb");
+        bool output;
+
+        if (f == 0) {
+            return false;
+        }
+
+        fprintf(f, "P6\n%i %i\n255\n", width, height);
+        output = fwrite(pixels, 1, (size_t)width * (size_t)height * 3, f) == (size_t)width * (size_t)height * 3;
+        fclose(f);
+
+        return output;
+    }
+
+    // returns 0 when the file is missing or not a binary ppm, otherwise the caller deletes the pixels
+    unsigned char* read_ppm(const char* path, int* width, int* height) {
+        FILE* f = fopen(path, "rb");
+        unsigned char* output;
+        int max_value;
+
+        if (f == 0) {
+            return 0;
+        }
+
+        if (fscanf(f, "P6 %i %i %i", width, height, &max_value) != 3 || max_value != 255 || *width <= 0 || *height <= 0 || fgetc(f) == EOF) {
+            fclose(f);
+
+            return 0;
+        }
+
+        output = new unsigned char[(size_t)*width * (size_t)*height * 3];
+        if (fread(output, 1, (size_t)*width * (size_t)*height * 3, f) != (size_t)*width * (size_t)*height * 3) {
+            delete[] output;
+            output = 0;
+        }
+        fclose(f);
+
+        return output;
+    }
+
+    // how many pixels differ by more than the tolerance in any channel
+    unsigned long long count_changed_pixels(unsigned char* a, unsigned char* b, int width, int height) {
+        unsigned long long output = 0;
+        int difference;
+        bool changed;
+
+        for (long long i = 0; i < (long long)width * (long long)height; i++) {
+            changed = false;
+
+            for (long long channel = 0; channel < 3; channel++) {
+                difference = (int)a[(i * 3) + channel] - (int)b[(i * 3) + channel];
+                changed |= difference > image_channel_tolerance || difference < -image_channel_tolerance;
+            }
+
+            output += changed ? 1 : 0;
+        }
+
+        return output;
+    }
+}
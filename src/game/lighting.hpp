@@ -0,0 +1,391 @@
+#pragma once
+
+#include "world.hpp"
+
+namespace abradinjapan::voxelize {
+    // light channel type
+    enum lct {
+        lct_sun,
+        lct_block
+    };
+
+    // one queued light update in world block coordinates
+    struct light_node {
+        int x, y, z;
+        unsigned char level;
+    };
+
+    // ring buffer of light nodes, grows when full so a large flood never drops light
+    class light_queue {
+        light_node* m_nodes = 0;
+        unsigned long long m_capacity = 0;
+        unsigned long long m_head = 0;
+        unsigned long long m_count = 0;
+
+        void grow() {
+            light_node* nodes = new light_node[m_capacity * 2];
+
+            for (unsigned long long i = 0; i < m_count; i++) {
+                nodes[i] = m_nodes[(m_head + i) % m_capacity];
+            }
+
+            delete[] m_nodes;
+
+            m_nodes = nodes;
+            m_capacity *= 2;
+            m_head = 0;
+        }
+
+    public:
+        void initialize(unsigned long long capacity) {
+            m_nodes = new light_node[capacity];
+            m_capacity = capacity;
+            m_head = 0;
+            m_count = 0;
+        }
+
+        void push(long long x, long long y, long long z, unsigned char level) {
+            if (m_count == m_capacity) {
+                grow();
+            }
+
+            light_node* node = &m_nodes[(m_head + m_count) % m_capacity];
+            node->x = (int)x;
+            node->y = (int)y;
+            node->z = (int)z;
+            node->level = level;
+            m_count++;
+        }
+
+        light_node pop() {
+            light_node output = m_nodes[m_head];
+
+            m_head = (m_head + 1) % m_capacity;
+            m_count--;
+
+            return output;
+        }
+
+        bool is_empty() {
+            return m_count == 0;
+        }
+
+        void uninitialize() {
+            delete[] m_nodes;
+
+            m_nodes = 0;
+            m_capacity = 0;
+            m_head = 0;
+            m_count = 0;
+        }
+    };
+
+    // breadth first flood fill of sunlight and block light over a world
+    // terrain columns grow along z (see generate_chunk), so sunlight enters at the top of the world and falls toward -z without losing strength
+    class light_engine {
+        world* m_world = 0;
+        light_queue m_propagate_queues[2];
+        light_queue m_remove_queues[2];
+
+        unsigned char get_level(long long x, long long y, long long z, lct channel) {
+            unsigned char light = m_world->get_light_at(x, y, z);
+
+            if (channel == lct::lct_sun) {
+                return get_sunlight(light);
+            }
+
+            return get_block_light(light);
+        }
+
+        void set_level(long long x, long long y, long long z, lct channel, unsigned char level) {
+            unsigned char light = m_world->get_light_at(x, y, z);
+
+            if (channel == lct::lct_sun) {
+                m_world->set_light_at(x, y, z, pack_light(level, get_block_light(light)));
+            } else {
+                m_world->set_light_at(x, y, z, pack_light(get_sunlight(light), level));
+            }
+        }
+
+        // full strength sunlight keeps its strength going straight down
+        bool is_sunbeam(lct channel, unsigned int direction, unsigned char level) {
+            return channel == lct::lct_sun && direction == st2::st2_back && level == 15;
+        }
+
+        void propagate(lct channel) {
+            light_queue* queue = &m_propagate_queues[channel];
+            light_node node;
+            unsigned char level;
+            unsigned char next_level;
+            long long x, y, z;
+
+            while (!queue->is_empty()) {
+                node = queue->pop();
+                level = get_level(node.x, node.y, node.z, channel);
+
+                for (unsigned int i = 0; i < 6; i++) {
+                    x = node.x + st2_offsets[i][0];
+                    y = node.y + st2_offsets[i][1];
+                    z = node.z + st2_offsets[i][2];
+
+                    // light only travels through air
+                    if (!m_world->contains_block(x, y, z) || m_world->get_block_at(x, y, z) != bt::bt_air) {
+                        continue;
+                    }
+
+                    if (is_sunbeam(channel, i, level)) {
+                        next_level = 15;
+                    } else if (level > 1) {
+                        next_level = level - 1;
+                    } else {
+                        continue;
+                    }
+
+                    if (get_level(x, y, z, channel) < next_level) {
+                        set_level(x, y, z, channel, next_level);
+                        queue->push(x, y, z, next_level);
+                    }
+                }
+            }
+        }
+
+        // darken everything that was lit by the removed nodes, and queue the brighter edges to fill the hole back in
+        void remove(lct channel) {
+            light_queue* queue = &m_remove_queues[channel];
+            light_node node;
+            unsigned char neighbour_level;
+            long long x, y, z;
+
+            while (!queue->is_empty()) {
+                node = queue->pop();
+
+                for (unsigned int i = 0; i < 6; i++) {
+                    x = node.x + st2_offsets[i][0];
+                    y = node.y + st2_offsets[i][1];
+                    z = node.z + st2_offsets[i][2];
+
+                    if (!m_world->contains_block(x, y, z)) {
+                        continue;
+                    }
+
+                    neighbour_level = get_level(x, y, z, channel);
+                    if (neighbour_level == 0) {
+                        continue;
+                    }
+
+                    if (neighbour_level < node.level || is_sunbeam(channel, i, node.level)) {
+                        // emitters are the only solid blocks holding light, they relight themselves
+                        if (m_world->get_block_at(x, y, z) != bt::bt_air) {
+                            m_propagate_queues[channel].push(x, y, z, neighbour_level);
+
+                            continue;
+                        }
+
+                        set_level(x, y, z, channel, 0);
+                        queue->push(x, y, z, neighbour_level);
+                    } else {
+                        m_propagate_queues[channel].push(x, y, z, neighbour_level);
+                    }
+                }
+            }
+        }
+
+        // full sunlight from the top of the world down to the opaque height of every column in the inclusive box, nothing under it is read
+        // a sky block only needs queueing if a column beside it reaches up to it, everywhere else its neighbours are sky already
+        void seed_sky(long long x1, long long y1, long long x2, long long y2) {
+            long long height = m_world->get_height() * 8;
+            long long reach;
+
+            for (long long x = x1; x <= x2; x++) {
+                for (long long y = y1; y <= y2; y++) {
+                    reach = -1;
+                    for (unsigned int i = 0; i < 6; i++) {
+                        if (st2_offsets[i][2] == 0 && m_world->contains_block(x + st2_offsets[i][0], y + st2_offsets[i][1], 0)) {
+                            reach = std::max(reach, m_world->get_opaque_height(x + st2_offsets[i][0], y + st2_offsets[i][1]));
+                        }
+                    }
+
+                    for (long long z = height - 1; z > m_world->get_opaque_height(x, y); z--) {
+                        set_level(x, y, z, lct::lct_sun, 15);
+                        if (z <= reach) {
+                            m_propagate_queues[lct::lct_sun].push(x, y, z, 15);
+                        }
+                    }
+                }
+            }
+        }
+
+        static void on_region_changed(void* context, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            ((light_engine*)context)->relight_box(x1, y1, z1, x2, y2, z2);
+        }
+
+    public:
+        // bulk edits on the world are relit automatically, single edits go through set_block_at
+        void initialize(world* w) {
+            m_world = w;
+
+            for (unsigned int i = 0; i < 2; i++) {
+                m_propagate_queues[i].initialize(4096);
+                m_remove_queues[i].initialize(4096);
+            }
+
+            w->add_region_listener(on_region_changed, this);
+        }
+
+        // light the whole world from scratch
+        void light_world() {
+            long long low_x = m_world->get_origin_x() * 8;
+            long long low_y = m_world->get_origin_y() * 8;
+            long long high_x = low_x + (m_world->get_width() * 8);
+            long long high_y = low_y + (m_world->get_length() * 8);
+            long long height = m_world->get_height() * 8;
+            unsigned short block;
+
+            for (long long x = low_x; x < high_x; x++) {
+                for (long long y = low_y; y < high_y; y++) {
+                    for (long long z = 0; z < height; z++) {
+                        block = m_world->get_block_at(x, y, z);
+
+                        m_world->set_light_at(x, y, z, pack_light(0, get_block_emission(block)));
+
+                        if (get_block_emission(block) > 0) {
+                            m_propagate_queues[lct::lct_block].push(x, y, z, get_block_emission(block));
+                        }
+                    }
+                }
+            }
+
+            seed_sky(low_x, low_y, high_x - 1, high_y - 1);
+
+            propagate(lct::lct_sun);
+            propagate(lct::lct_block);
+        }
+
+        // relight everything a change inside the box can reach, cheaper than removing light one block at a time for big edits
+        // light spreads at most 15 blocks sideways but sunlight falls any distance, so a margin around the box is redone over the whole height of the world
+        void relight_box(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            long long low_x = m_world->get_origin_x() * 8;
+            long long low_y = m_world->get_origin_y() * 8;
+            long long high_x = low_x + (m_world->get_width() * 8);
+            long long high_y = low_y + (m_world->get_length() * 8);
+            long long height = m_world->get_height() * 8;
+            unsigned short block;
+            unsigned char light;
+
+            x1 = x1 - 15 < low_x ? low_x : x1 - 15;
+            y1 = y1 - 15 < low_y ? low_y : y1 - 15;
+            x2 = x2 + 15 >= high_x ? high_x - 1 : x2 + 15;
+            y2 = y2 + 15 >= high_y ? high_y - 1 : y2 + 15;
+            z1 = 0;
+            z2 = height - 1;
+
+            // clear the box down to its own emitters
+            for (long long x = x1; x <= x2; x++) {
+                for (long long y = y1; y <= y2; y++) {
+                    for (long long z = z1; z <= z2; z++) {
+                        block = m_world->get_block_at(x, y, z);
+
+                        m_world->set_light_at(x, y, z, pack_light(0, get_block_emission(block)));
+
+                        if (get_block_emission(block) > 0) {
+                            m_propagate_queues[lct::lct_block].push(x, y, z, get_block_emission(block));
+                        }
+                    }
+                }
+            }
+
+            seed_sky(x1, y1, x2, y2);
+
+            // light flowing back in from the ring of blocks around the box
+            for (long long x = x1 - 1; x <= x2 + 1; x++) {
+                for (long long y = y1 - 1; y <= y2 + 1; y++) {
+                    if (x >= x1 && x <= x2 && y >= y1 && y <= y2) {
+                        continue;
+                    }
+                    if (x < low_x || y < low_y || x >= high_x || y >= high_y) {
+                        continue;
+                    }
+
+                    for (long long z = 0; z < height; z++) {
+                        light = m_world->get_light_at(x, y, z);
+
+                        if (get_sunlight(light) > 0) {
+                            m_propagate_queues[lct::lct_sun].push(x, y, z, get_sunlight(light));
+                        }
+                        if (get_block_light(light) > 0) {
+                            m_propagate_queues[lct::lct_block].push(x, y, z, get_block_light(light));
+                        }
+                    }
+                }
+            }
+
+            propagate(lct::lct_sun);
+            propagate(lct::lct_block);
+        }
+
+        // change one block and relight only what the change can reach
+        void set_block_at(long long x, long long y, long long z, unsigned short value) {
+            unsigned char level;
+
+            if (!m_world->contains_block(x, y, z) || m_world->get_block_at(x, y, z) == value) {
+                return;
+            }
+
+            m_world->set_block_at(x, y, z, value);
+
+            // take out the light that was here
+            for (unsigned int i = 0; i < 2; i++) {
+                level = get_level(x, y, z, (lct)i);
+
+                if (level > 0) {
+                    set_level(x, y, z, (lct)i, 0);
+                    m_remove_queues[i].push(x, y, z, level);
+                    remove((lct)i);
+                }
+            }
+
+            // let the surroundings flow into a new gap
+            if (value == bt::bt_air) {
+                for (unsigned int i = 0; i < 6; i++) {
+                    if (m_world->contains_block(x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2])) {
+                        for (unsigned int j = 0; j < 2; j++) {
+                            level = get_level(x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2], (lct)j);
+
+                            if (level > 0) {
+                                m_propagate_queues[j].push(x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2], level);
+                            }
+                        }
+                    }
+                }
+
+                // open to the sky
+                if (z == (m_world->get_height() * 8) - 1) {
+                    set_level(x, y, z, lct::lct_sun, 15);
+                    m_propagate_queues[lct::lct_sun].push(x, y, z, 15);
+                }
+            }
+
+            // new light source
+            if (get_block_emission(value) > 0) {
+                set_level(x, y, z, lct::lct_block, get_block_emission(value));
+                m_propagate_queues[lct::lct_block].push(x, y, z, get_block_emission(value));
+            }
+
+            propagate(lct::lct_sun);
+            propagate(lct::lct_block);
+        }
+
+        void uninitialize() {
+            if (m_world != 0) {
+                m_world->remove_region_listener(on_region_changed, this);
+            }
+
+            for (unsigned int i = 0; i < 2; i++) {
+                m_propagate_queues[i].uninitialize();
+                m_remove_queues[i].uninitialize();
+            }
+
+            m_world = 0;
+        }
+    };
+}
@@ -0,0 +1,545 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace abradinjapan::voxelize {
+    // allocation counters
+    // heap counts every global operator new / delete, the rest count the pools that are meant to replace them
+    class allocation_counters {
+    public:
+        std::atomic<unsigned long long> p_heap_allocations{0};
+        std::atomic<unsigned long long> p_heap_frees{0};
+        std::atomic<unsigned long long> p_pool_allocations{0};
+        std::atomic<unsigned long long> p_pool_frees{0};
+        std::atomic<unsigned long long> p_pool_exhaustions{0};
+        std::atomic<unsigned long long> p_arena_allocations{0};
+        std::atomic<unsigned long long> p_arena_resets{0};
+        std::atomic<unsigned long long> p_arena_exhaustions{0};
+
+        void print() {
+            printf("Allocations:\n");
+            printf("\theap: %llu allocations, %llu frees\n", p_heap_allocations.load(), p_heap_frees.load());
+            printf("\tpools: %llu allocations, %llu frees, %llu exhaustions\n", p_pool_allocations.load(), p_pool_frees.load(), p_pool_exhaustions.load());
+            printf("\tarenas: %llu allocations, %llu resets, %llu exhaustions\n", p_arena_allocations.load(), p_arena_resets.load(), p_arena_exhaustions.load());
+            fflush(stdout);
+        }
+    };
+
+    inline allocation_counters g_allocation_counters;
+
+    // memory tag type, what a tracked byte is being used for
+    enum mtt {
+        mtt_chunks, // chunks handed out by the chunk pools
+        mtt_cold_chunks, // compressed chunks held by the cold cache
+        mtt_mesh_scratch, // mesh arenas in use
+        mtt_textures, // image pixels waiting to be uploaded
+        mtt_translucency, // face centres and orders kept for sorting translucent faces
+        mtt_navigation, // walkable cells, the portal graph, path requests and search scratch
+        mtt_gpu_vertices, // vertex buffers
+        mtt_gpu_indices, // index buffers
+        mtt_gpu_textures, // textures with their mipmaps
+        mtt_count
+    };
+
+    const char* const mtt_names[mtt_count] = {
+        "chunks",
+        "cold_chunks",
+        "mesh_scratch",
+        "textures",
+        "translucency",
+        "navigation",
+        "gpu_vertices",
+        "gpu_indices",
+        "gpu_textures"
+    };
+
+    // bytes held per tag and the most each has ever held at once
+    // the owners of the memory report it, gpu bytes are what was asked of the driver rather than what it really keeps
+    class memory_accounts {
+        std::atomic<long long> m_bytes[mtt_count] = {};
+        std::atomic<long long> m_peaks[mtt_count] = {};
+        FILE* m_log = 0;
+
+    public:
+        void add(mtt tag, long long bytes) {
+            long long now = m_bytes[tag].fetch_add(bytes) + bytes;
+            long long peak = m_peaks[tag].load();
+
+            while (now > peak && !m_peaks[tag].compare_exchange_weak(peak, now)) {}
+        }
+
+        void remove(mtt tag, long long bytes) {
+            m_bytes[tag].fetch_sub(bytes);
+        }
+
+        long long get_bytes(mtt tag) {
+            return m_bytes[tag].load();
+        }
+
+        long long get_peak(mtt tag) {
+            return m_peaks[tag].load();
+        }
+
+        void print() {
+            long long cpu = 0;
+            long long gpu = 0;
+
+            printf("Memory:\n");
+            for (unsigned int i = 0; i < mtt_count; i++) {
+                printf("\t%s: %.1f KiB, peak %.1f KiB\n", mtt_names[i], (double)get_bytes((mtt)i) / 1024.0, (double)get_peak((mtt)i) / 1024.0);
+                if (i < mtt_gpu_vertices) {
+                    cpu += get_bytes((mtt)i);
+                } else {
+                    gpu += get_bytes((mtt)i);
+                }
+            }
+            printf("\ttotal: %.1f KiB cpu, %.1f KiB gpu\n", (double)cpu / 1024.0, (double)gpu / 1024.0);
+            fflush(stdout);
+        }
+
+        // a csv with one row per write_log, every tag's bytes followed by its peak
+        bool open_log(const char* path) {
+            m_log = fopen(path, "w");
+            if (m_log == 0) {
+                return false;
+            }
+
+            fprintf(m_log, "time");
+            for (unsigned int i = 0; i < mtt_count; i++) {
+                fprintf(m_log, ",%s,%s_peak", mtt_names[i], mtt_names[i]);
+            }
+            fprintf(m_log, "\n");
+
+            return true;
+        }
+
+        // does nothing without an open log, stdio buffers the rows so this never touches the heap
+        void write_log(double time) {
+            if (m_log == 0) {
+                return;
+            }
+
+            fprintf(m_log, "%.3f", time);
+            for (unsigned int i = 0; i < mtt_count; i++) {
+                fprintf(m_log, ",%lld,%lld", get_bytes((mtt)i), get_peak((mtt)i));
+            }
+            fprintf(m_log, "\n");
+        }
+
+        bool close_log() {
+            bool output = true;
+
+            if (m_log != 0) {
+                output = fclose(m_log) == 0;
+                m_log = 0;
+            }
+
+            return output;
+        }
+    };
+
+    inline memory_accounts g_memory_accounts;
+
+    // fixed size pool of objects, carved out of one allocation made up front
+    template <typename T>
+    class slab_pool {
+        unsigned char* m_storage = 0;
+        unsigned long long* m_free_list = 0;
+        unsigned long long m_free_count = 0;
+        unsigned long long m_capacity = 0;
+        mtt m_tag = mtt_chunks;
+
+    public:
+        void initialize(unsigned long long capacity, mtt tag) {
+            m_capacity = capacity;
+            m_tag = tag;
+            m_storage = (unsigned char*)::operator new(sizeof(T) * capacity, std::align_val_t(alignof(T)));
+            m_free_list = new unsigned long long[capacity];
+
+            // hand out low slots first
+            for (unsigned long long i = 0; i < capacity; i++) {
+                m_free_list[i] = capacity - 1 - i;
+            }
+            m_free_count = capacity;
+        }
+
+        // returns 0 when the pool is full
+        T* allocate() {
+            if (m_free_count == 0) {
+                g_allocation_counters.p_pool_exhaustions++;
+
+                return 0;
+            }
+
+            m_free_count--;
+            g_allocation_counters.p_pool_allocations++;
+            g_memory_accounts.add(m_tag, sizeof(T));
+
+            return new (m_storage + (m_free_list[m_free_count] * sizeof(T))) T();
+        }
+
+        void deallocate(T* object) {
+            if (object == 0) {
+                return;
+            }
+
+            object->~T();
+
+            m_free_list[m_free_count] = (unsigned long long)((unsigned char*)object - m_storage) / sizeof(T);
+            m_free_count++;
+            g_allocation_counters.p_pool_frees++;
+            g_memory_accounts.remove(m_tag, sizeof(T));
+        }
+
+        unsigned long long used() {
+            return m_capacity - m_free_count;
+        }
+
+        unsigned long long capacity() {
+            return m_capacity;
+        }
+
+        void uninitialize() {
+            // anything still handed out goes with the storage
+            g_memory_accounts.remove(m_tag, (long long)(used() * sizeof(T)));
+            ::operator delete(m_storage, std::align_val_t(alignof(T)));
+            delete[] m_free_list;
+
+            m_storage = 0;
+            m_free_list = 0;
+            m_free_count = 0;
+            m_capacity = 0;
+        }
+    };
+
+    // bump allocator for short lived scratch memory, everything is released at once with reset()
+    // allocations that do not fit come from the heap instead, they are counted as exhaustions and freed on the next reset()
+    class arena {
+        unsigned char* m_memory = 0;
+        unsigned long long m_capacity = 0;
+        unsigned long long m_used = 0;
+        unsigned char* m_overflow = 0; // heap blocks past the capacity, each starts with a link to the one before it
+        unsigned long long m_overflow_used = 0;
+        mtt m_tag = mtt_mesh_scratch;
+
+        // the link is padded out so what follows it is aligned for any type
+        void* allocate_overflow(unsigned long long size) {
+            unsigned char* block = (unsigned char*)::operator new(size + alignof(std::max_align_t));
+
+            *(unsigned char**)block = m_overflow;
+            m_overflow = block;
+            m_overflow_used += size;
+            g_memory_accounts.add(m_tag, (long long)size);
+
+            return block + alignof(std::max_align_t);
+        }
+
+        void release_overflow() {
+            unsigned char* next;
+
+            while (m_overflow != 0) {
+                next = *(unsigned char**)m_overflow;
+                ::operator delete(m_overflow);
+                m_overflow = next;
+            }
+
+            g_memory_accounts.remove(m_tag, (long long)m_overflow_used);
+            m_overflow_used = 0;
+        }
+
+    public:
+        void initialize(unsigned long long capacity, mtt tag) {
+            m_memory = new unsigned char[capacity];
+            m_capacity = capacity;
+            m_used = 0;
+            m_overflow = 0;
+            m_overflow_used = 0;
+            m_tag = tag;
+        }
+
+        bool is_initialized() {
+            return m_memory != 0;
+        }
+
+        // never returns 0, a full arena falls back to the heap until the next reset
+        template <typename T>
+        T* allocate(unsigned long long count) {
+            unsigned long long start = (m_used + alignof(T) - 1) & ~(unsigned long long)(alignof(T) - 1);
+
+            if (start + (count * sizeof(T)) > m_capacity) {
+                g_allocation_counters.p_arena_exhaustions++;
+
+                return (T*)allocate_overflow(count * sizeof(T));
+            }
+
+            g_memory_accounts.add(m_tag, (long long)(start + (count * sizeof(T)) - m_used));
+            m_used = start + (count * sizeof(T));
+            g_allocation_counters.p_arena_allocations++;
+
+            return (T*)(m_memory + start);
+        }
+
+        void reset() {
+            g_memory_accounts.remove(m_tag, (long long)m_used);
+            m_used = 0;
+            release_overflow();
+            g_allocation_counters.p_arena_resets++;
+        }
+
+        unsigned long long used() {
+            return m_used;
+        }
+
+        void uninitialize() {
+            g_memory_accounts.remove(m_tag, (long long)m_used);
+            release_overflow();
+            delete[] m_memory;
+
+            m_memory = 0;
+            m_capacity = 0;
+            m_used = 0;
+        }
+    };
+
+    // open addressing from chunk or region coordinates to an index into an array its owner keeps, carved out up front
+    // kept at most half full, removing shifts the rest of a probe run back so no tombstones pile up
+    class keyed_table {
+        struct slot {
+            long long x, y, z;
+            long long index; // -1 is empty
+        };
+
+        slot* m_slots = 0;
+        unsigned long long m_size = 0; // a power of two
+
+        unsigned long long get_home(long long x, long long y, long long z) {
+            unsigned long long hash = ((unsigned long long)x * 0x9E3779B97F4A7C15ull) ^ ((unsigned long long)y * 0xC2B2AE3D27D4EB4Full) ^ ((unsigned long long)z * 0x165667B19E3779F9ull);
+
+            return (hash ^ (hash >> 29)) & (m_size - 1);
+        }
+
+        // the slot holding the key, or the empty slot ending its probe run
+        unsigned long long probe(long long x, long long y, long long z) {
+            unsigned long long position = get_home(x, y, z);
+
+            while (m_slots[position].index != -1 && (m_slots[position].x != x || m_slots[position].y != y || m_slots[position].z != z)) {
+                position = (position + 1) & (m_size - 1);
+            }
+
+            return position;
+        }
+
+    public:
+        void initialize(unsigned long long max_entries) {
+            m_size = 1;
+            while (m_size < max_entries * 2) {
+                m_size *= 2;
+            }
+            m_slots = new slot[m_size];
+
+            clear();
+        }
+
+        void clear() {
+            for (unsigned long long i = 0; i < m_size; i++) {
+                m_slots[i].index = -1;
+            }
+        }
+
+        // -1 when the key is not in the table
+        long long find(long long x, long long y, long long z) {
+            if (m_size == 0) {
+                return -1;
+            }
+
+            return m_slots[probe(x, y, z)].index;
+        }
+
+        // the owner never holds more than max_entries, so there is always an empty slot
+        void insert(long long x, long long y, long long z, long long index) {
+            unsigned long long position = probe(x, y, z);
+
+            m_slots[position].x = x;
+            m_slots[position].y = y;
+            m_slots[position].z = z;
+            m_slots[position].index = index;
+        }
+
+        void remove(long long x, long long y, long long z) {
+            unsigned long long position = probe(x, y, z);
+            unsigned long long next = (position + 1) & (m_size - 1);
+            unsigned long long home;
+
+            if (m_slots[position].index == -1) {
+                return;
+            }
+            m_slots[position].index = -1;
+
+            while (m_slots[next].index != -1) {
+                home = get_home(m_slots[next].x, m_slots[next].y, m_slots[next].z);
+
+                // move it back unless its home lies cyclically between the gap and where it sits
+                if (((next - home) & (m_size - 1)) >= ((next - position) & (m_size - 1))) {
+                    m_slots[position] = m_slots[next];
+                    m_slots[next].index = -1;
+                    position = next;
+                }
+
+                next = (next + 1) & (m_size - 1);
+            }
+        }
+
+        void uninitialize() {
+            delete[] m_slots;
+
+            m_slots = 0;
+            m_size = 0;
+        }
+    };
+
+    // big enough for the worst case chunk mesh (every face of every block plus all seams)
+    const unsigned long long mesh_arena_size = 2 * 1024 * 1024;
+
+    // one mesh scratch arena per thread, created on first use
+    inline arena* get_mesh_arena() {
+        thread_local arena mesh_arena;
+
+        if (!mesh_arena.is_initialized()) {
+            mesh_arena.initialize(mesh_arena_size, mtt::mtt_mesh_scratch);
+        }
+
+        return &mesh_arena;
+    }
+}
+
+// count every general heap allocation so the pools can be proven to replace them
+// the game is built as a single translation unit, so these replacements live here
+// every form is replaced, libraries loaded at run time allocate through the nothrow and aligned ones and free through the plain delete
+namespace abradinjapan::voxelize {
+    // 0 when the heap is out of memory, everything it returns goes back through free_heap
+    inline void* allocate_heap(size_t size, size_t alignment) {
+        void* output = 0;
+
+        if (size == 0) {
+            size = 1;
+        }
+
+        if (alignment <= alignof(std::max_align_t)) {
+            output = malloc(size);
+        } else if (posix_memalign(&output, alignment, size) != 0) {
+            output = 0;
+        }
+
+        if (output != 0) {
+            g_allocation_counters.p_heap_allocations++;
+        }
+
+        return output;
+    }
+
+    inline void free_heap(void* pointer) {
+        if (pointer != 0) {
+            g_allocation_counters.p_heap_frees++;
+        }
+
+        free(pointer);
+    }
+}
+
+void* operator new(size_t size) {
+    void* output = abradinjapan::voxelize::allocate_heap(size, alignof(std::max_align_t));
+
+    if (output == 0) {
+        throw std::bad_alloc();
+    }
+
+    return output;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* output = abradinjapan::voxelize::allocate_heap(size, (size_t)alignment);
+
+    if (output == 0) {
+        throw std::bad_alloc();
+    }
+
+    return output;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return abradinjapan::voxelize::allocate_heap(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return abradinjapan::voxelize::allocate_heap(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return abradinjapan::voxelize::allocate_heap(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return abradinjapan::voxelize::allocate_heap(size, (size_t)alignment);
+}
+
+// kept out of line so the compiler never sees free() matched against operator new at a call site
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    abradinjapan::voxelize::free_heap(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    operator delete(pointer);
+}
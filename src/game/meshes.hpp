@@ -0,0 +1,396 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace abradinjapan::voxelize {
+    const unsigned int mesh_file_magic = 0x4D4C5856; // "VXLM"
+    const unsigned int mesh_file_format = 2;
+    const unsigned long long mesh_record_magic = 0x4452434D4C58564Eull;
+
+    struct mesh_file_header {
+        unsigned int magic;
+        unsigned int format;
+        unsigned int mesher_version; // a different mesher throws the whole file away
+        unsigned int vertex_length;
+    };
+
+    // one chunk's meshes, the vertices of every level follow it in ldt order, padded out to 8 bytes
+    struct mesh_record {
+        unsigned long long magic; // written last, a record cut short by a crash has none
+        long long x, y, z; // chunk coordinates
+        unsigned long long hash; // see chunk_888::get_mesh_hash
+        unsigned long long vertex_counts[ldt_count];
+        unsigned long long body_lengths[ldt_count];
+        unsigned long long seam_lengths[ldt_count][6];
+    };
+
+    // where the newest record of a chunk sits in the file
+    struct mesh_entry {
+        long long x, y, z;
+        unsigned long long hash;
+        unsigned long long offset;
+        unsigned long long size;
+        bool present;
+    };
+
+    // built chunk meshes kept on disk between runs, so chunks whose blocks have not changed since are uploaded straight from the file instead of being meshed
+    // records are only ever appended, a chunk that is meshed again gets a new record and the old one is left as garbage until the file is compacted on the next start
+    // the file is memory mapped, uploads copy from the mapping into the gpu buffers
+    class mesh_cache {
+        int m_file = -1;
+        unsigned char* m_map = 0;
+        unsigned long long m_map_length = 0;
+        unsigned long long m_file_length = 0;
+        unsigned long long m_live_bytes = 0; // in records that are still the newest for their chunk
+        mesh_entry* m_entries = 0; // the first m_count are in use, entries are never removed
+        keyed_table m_table; // chunk coordinates to entry indices
+        unsigned long long m_max_entries = 0;
+        unsigned long long m_count = 0;
+        unsigned long long m_hits = 0;
+        unsigned long long m_misses = 0;
+        unsigned long long m_stores = 0;
+
+        // the entry for a chunk, or the empty one it would go in, 0 when the table is full
+        mesh_entry* find(long long x, long long y, long long z) {
+            long long index = m_table.find(x, y, z);
+
+            if (index != -1) {
+                return &m_entries[index];
+            }
+            if (m_count == m_max_entries) {
+                return 0;
+            }
+
+            m_entries[m_count].present = false;
+
+            return &m_entries[m_count];
+        }
+
+        unsigned long long get_record_size(mesh_record* record) {
+            unsigned long long output = sizeof(mesh_record);
+
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                output += record->vertex_counts[i] * chunk_vertex_length * sizeof(float);
+            }
+
+            return (output + 7) & ~7ull;
+        }
+
+        // make a record the newest for its chunk
+        void add_entry(mesh_record* record, unsigned long long offset, unsigned long long size) {
+            mesh_entry* entry = find(record->x, record->y, record->z);
+
+            if (entry == 0) {
+                return;
+            }
+
+            if (entry->present) {
+                m_live_bytes -= entry->size;
+            } else {
+                m_table.insert(record->x, record->y, record->z, (long long)m_count);
+                m_count++;
+            }
+
+            entry->x = record->x;
+            entry->y = record->y;
+            entry->z = record->z;
+            entry->hash = record->hash;
+            entry->offset = offset;
+            entry->size = size;
+            entry->present = true;
+            m_live_bytes += size;
+        }
+
+        // map the whole file, again whenever records were written past the end of the last mapping
+        bool map_file() {
+            if (m_map != 0) {
+                munmap(m_map, m_map_length);
+                m_map = 0;
+                m_map_length = 0;
+            }
+
+            m_map = (unsigned char*)mmap(0, m_file_length, PROT_READ, MAP_SHARED, m_file, 0);
+            if (m_map == MAP_FAILED) {
+                m_map = 0;
+
+                return false;
+            }
+            m_map_length = m_file_length;
+
+            return true;
+        }
+
+        // read every record into the table, a file from another mesher is emptied and a torn record at the end is cut off
+        bool index_file() {
+            mesh_file_header header = { mesh_file_magic, mesh_file_format, mesher_version, chunk_vertex_length };
+            mesh_file_header* found;
+            mesh_record* record;
+            unsigned long long offset = sizeof(mesh_file_header);
+            unsigned long long size;
+            struct stat status;
+
+            if (fstat(m_file, &status) != 0) {
+                return false;
+            }
+            m_file_length = (unsigned long long)status.st_size;
+
+            if (m_file_length >= sizeof(mesh_file_header) && map_file()) {
+                found = (mesh_file_header*)m_map;
+
+                if (found->magic == header.magic && found->format == header.format && found->mesher_version == header.mesher_version && found->vertex_length == header.vertex_length) {
+                    while (offset + sizeof(mesh_record) <= m_file_length) {
+                        record = (mesh_record*)(m_map + offset);
+                        if (record->magic != mesh_record_magic) {
+                            break;
+                        }
+
+                        size = get_record_size(record);
+                        if (offset + size > m_file_length) {
+                            break;
+                        }
+
+                        add_entry(record, offset, size);
+                        offset += size;
+                    }
+
+                    if (offset < m_file_length && ftruncate(m_file, offset) != 0) {
+                        return false;
+                    }
+                    m_file_length = offset;
+
+                    return map_file();
+                }
+            }
+
+            // new, or meshed by something else
+            m_table.clear();
+            m_count = 0;
+            m_live_bytes = 0;
+
+            if (ftruncate(m_file, 0) != 0 || pwrite(m_file, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+                return false;
+            }
+            m_file_length = sizeof(header);
+
+            return map_file();
+        }
+
+        // write only the newest record of each chunk to a new file and swap it in
+        bool compact(const char* path) {
+            char temporary_path[4096];
+            unsigned long long offset = sizeof(mesh_file_header);
+            int file;
+            bool output = true;
+
+            snprintf(temporary_path, sizeof(temporary_path), "%s.compacting", path);
+            file = open(temporary_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (file < 0) {
+                return false;
+            }
+
+            output = pwrite(file, m_map, sizeof(mesh_file_header), 0) == (ssize_t)sizeof(mesh_file_header);
+            for (unsigned long long i = 0; i < m_count && output; i++) {
+                output = pwrite(file, m_map + m_entries[i].offset, m_entries[i].size, offset) == (ssize_t)m_entries[i].size;
+                m_entries[i].offset = offset;
+                offset += m_entries[i].size;
+            }
+
+            if (!output || rename(temporary_path, path) != 0) {
+                close(file);
+                unlink(temporary_path);
+
+                return false;
+            }
+
+            close(m_file);
+            m_file = file;
+            m_file_length = offset;
+
+            return map_file();
+        }
+
+        // mesh every level, optionally upload it, and append it as a new record
+        void mesh_and_store(chunk_888* chunk, long long x, long long y, long long z, float render_x, float render_y, float render_z, unsigned long long hash, bool upload) {
+            mesh_record record;
+            unsigned long long offset = m_file_length + sizeof(mesh_record);
+            unsigned long long size;
+            float* vertices;
+            bool written;
+
+            // a full table has nowhere to index the record, so it is not written at all
+            written = m_file >= 0 && find(x, y, z) != 0;
+
+            record.x = x;
+            record.y = y;
+            record.z = z;
+            record.hash = hash;
+
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                record.vertex_counts[i] = chunk->mesh_to_memory((ldt)i, render_x, render_y, render_z, &vertices, &record.body_lengths[i], record.seam_lengths[i]);
+                size = record.vertex_counts[i] * chunk_vertex_length * sizeof(float);
+
+                if (written && size > 0) {
+                    written = pwrite(m_file, vertices, size, offset) == (ssize_t)size;
+                }
+                offset += size;
+
+                if (upload) {
+                    chunk->upload_mesh((ldt)i, vertices, record.vertex_counts[i], record.body_lengths[i], record.seam_lengths[i]);
+                }
+                get_mesh_arena()->reset();
+            }
+            if (upload) {
+                chunk->send_translucent_to_gpu(render_x, render_y, render_z);
+            }
+
+            // the header and its magic go in after the vertices, a record cut off by the end of the file is dropped when indexing
+            // nothing is synced, so a crash can still leave a record whose magic landed before its vertices did
+            record.magic = mesh_record_magic;
+            size = get_record_size(&record);
+            if (written && pwrite(m_file, &record, sizeof(mesh_record), m_file_length) == (ssize_t)sizeof(mesh_record) && ftruncate(m_file, m_file_length + size) == 0) {
+                add_entry(&record, m_file_length, size);
+                m_file_length += size;
+                m_stores++;
+            }
+        }
+
+    public:
+        // opens or creates the file, compacting it when most of it is garbage
+        // returns false when the file cannot be used, every call then simply meshes
+        bool initialize(const char* path, unsigned long long max_entries) {
+            m_max_entries = max_entries;
+            m_entries = new mesh_entry[max_entries];
+            m_table.initialize(max_entries);
+            m_count = 0;
+            m_live_bytes = 0;
+
+            m_file = open(path, O_RDWR | O_CREAT, 0644);
+            if (m_file < 0 || !index_file()) {
+                printf("Error: mesh cache %s could not be opened, chunks will be meshed every time\n", path);
+                fflush(stdout);
+                uninitialize();
+
+                return false;
+            }
+
+            // keeping the garbage would cost more than rewriting what is left
+            if (m_file_length - sizeof(mesh_file_header) > m_live_bytes * 2 && !compact(path)) {
+                printf("Error: mesh cache %s could not be compacted\n", path);
+                fflush(stdout);
+            }
+
+            return true;
+        }
+
+        // the stored record for a chunk, 0 when there is none or its blocks, neighbours or position have changed since
+        // the vertices of every level follow the record
+        mesh_record* find_mesh(long long x, long long y, long long z, unsigned long long hash) {
+            mesh_entry* entry;
+
+            if (m_file < 0) {
+                return 0;
+            }
+
+            entry = find(x, y, z);
+            if (entry == 0 || !entry->present || entry->hash != hash) {
+                return 0;
+            }
+
+            if (entry->offset + entry->size > m_map_length && !map_file()) {
+                return 0;
+            }
+
+            return (mesh_record*)(m_map + entry->offset);
+        }
+
+        // mesh a chunk and add it to the file without uploading anything, for filling the cache ahead of time
+        void store(chunk_888* chunk, long long x, long long y, long long z, float render_x, float render_y, float render_z) {
+            mesh_and_store(chunk, x, y, z, render_x, render_y, render_z, chunk->get_mesh_hash(render_x, render_y, render_z), false);
+        }
+
+        // stands in for chunk_888::send_to_gpu, uploading from the file when the chunk has not changed since its meshes were stored
+        void send_to_gpu(chunk_888* chunk, long long x, long long y, long long z, float render_x, float render_y, float render_z) {
+            unsigned long long hash;
+            mesh_record* record;
+            float* vertices;
+
+            if (m_file < 0) {
+                chunk->send_to_gpu(render_x, render_y, render_z);
+
+                return;
+            }
+
+            chunk->mark_clean();
+            hash = chunk->get_mesh_hash(render_x, render_y, render_z);
+            record = find_mesh(x, y, z, hash);
+
+            if (record == 0) {
+                m_misses++;
+                mesh_and_store(chunk, x, y, z, render_x, render_y, render_z, hash, true);
+
+                return;
+            }
+
+            vertices = (float*)(record + 1);
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                chunk->upload_mesh((ldt)i, vertices, record->vertex_counts[i], record->body_lengths[i], record->seam_lengths[i]);
+                vertices += record->vertex_counts[i] * chunk_vertex_length;
+            }
+            // fluid is not kept in the file, it is cheap to mesh
+            chunk->send_translucent_to_gpu(render_x, render_y, render_z);
+            m_hits++;
+        }
+
+        unsigned long long get_hits() {
+            return m_hits;
+        }
+
+        unsigned long long get_misses() {
+            return m_misses;
+        }
+
+        unsigned long long get_count() {
+            return m_count;
+        }
+
+        unsigned long long get_file_length() {
+            return m_file_length;
+        }
+
+        void print() {
+            if (m_file < 0) {
+                return;
+            }
+
+            printf("Mesh cache:\n");
+            printf("\tchunks: %llu of %llu, %llu bytes on disk, %llu of them current\n", m_count, m_max_entries, m_file_length, m_live_bytes);
+            printf("\thits: %llu, misses: %llu, stores: %llu\n", m_hits, m_misses, m_stores);
+            fflush(stdout);
+        }
+
+        void uninitialize() {
+            if (m_map != 0) {
+                munmap(m_map, m_map_length);
+            }
+            if (m_file >= 0) {
+                close(m_file);
+            }
+            delete[] m_entries;
+            m_table.uninitialize();
+
+            m_file = -1;
+            m_map = 0;
+            m_map_length = 0;
+            m_file_length = 0;
+            m_live_bytes = 0;
+            m_entries = 0;
+            m_max_entries = 0;
+            m_count = 0;
+        }
+    };
+}
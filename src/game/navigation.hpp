@@ -0,0 +1,1034 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace abradinjapan::voxelize {
+    // agents are one block wide and two tall, they stand in a cell with a solid block under it and two blocks of air
+    // a step goes to one of the four cells beside it, at most a block up or down, and the lower of the two cells needs a third block of air for the head on the way
+
+    // the most portals one chunk column keeps, crossings past this are dropped
+    const unsigned int max_column_portals = 64;
+
+    // steps between two cells of a column that cannot reach each other inside it
+    const unsigned short navigation_unreachable = 0xFFFF;
+
+    // where a node that has left the open heap sits
+    const unsigned int navigation_closed = 0xFFFFFFFF;
+
+    // path requests that can be out at once
+    const unsigned int max_path_requests = 128;
+
+    // cells in the longest path a request can return, longer paths fail
+    const unsigned int max_path_length = 1024;
+
+    // the four sides of a column that portals sit on
+    const st2 navigation_sides[4] = {
+        st2::st2_left,
+        st2::st2_right,
+        st2::st2_bottom,
+        st2::st2_top
+    };
+
+    // path status type
+    enum pst {
+        pst_free,
+        pst_waiting,
+        pst_found,
+        pst_failed
+    };
+
+    // where agents can stand in one chunk, a mask per z layer laid out like the solid masks
+    struct navigation_chunk {
+        unsigned long long walkable[8];
+        unsigned long long tall[8]; // walkable with a third block of air, room to step up from or down onto
+    };
+
+    // the middle of one run of crossings along a border, the graph links it to the same run seen from the column across
+    struct navigation_portal {
+        unsigned char x, y; // within the column
+        short z;
+        short across_z; // where the step over the border lands
+        unsigned char side; // st2
+    };
+
+    // the portals of one chunk column and the steps between each pair of them inside it
+    struct navigation_column {
+        long long x, y; // the chunk column it was built for
+        unsigned int portal_count;
+        navigation_portal portals[max_column_portals];
+        unsigned short costs[max_column_portals * max_column_portals];
+    };
+
+    // hierarchical pathfinding over the world's window
+    // every chunk keeps its walkable cells as masks, every chunk column keeps portals where agents can cross into the columns beside it, and paths are found over the portals first then filled in a column at a time
+    // block and region listeners only mark chunks and columns dirty, they are rebuilt in update() while the search thread is idle
+    // requests are answered on a thread of their own, update() never waits, it hands over waiting requests and picks up answers from the last batch
+    class navigator {
+        world* m_world = 0;
+        long long m_width = 0; // in chunks, like the world
+        long long m_length = 0;
+        long long m_height = 0;
+        long long m_origin_x = 0; // the window the graph was last built for
+        long long m_origin_y = 0;
+        unsigned int m_column_cells = 0;
+        navigation_chunk* m_chunks = 0; // by world chunk slot
+        navigation_column* m_columns = 0; // by world chunk slot at z 0
+        bool* m_dirty_chunks = 0;
+        bool* m_dirty_columns = 0;
+        bool m_dirty = false;
+        unsigned long long m_bytes = 0;
+
+        // requests, the search thread owns the ones in flight
+        pst* m_statuses = 0;
+        pst* m_results = 0;
+        long long* m_ends = 0; // start and goal, six a request
+        int* m_cells = 0; // three a cell, max_path_length a request
+        unsigned int* m_lengths = 0;
+        bool* m_in_flight = 0;
+        bool* m_released = 0; // let go of while in flight, freed when the batch comes back
+        unsigned int* m_batch = 0;
+        unsigned int m_batch_count = 0;
+        unsigned int m_next_request = 0;
+
+        // search scratch, only ever used by whoever owns the graph at the time
+        unsigned short* m_distances = 0; // a column's cells
+        unsigned int* m_parents = 0;
+        unsigned int* m_queue = 0;
+        unsigned int* m_steps = 0;
+        unsigned short m_start_costs[max_column_portals];
+        unsigned short m_goal_costs[max_column_portals];
+        unsigned int* m_g = 0; // every portal of every column, then the start and the goal
+        unsigned int* m_f = 0;
+        unsigned int* m_came_from = 0;
+        unsigned int* m_stamps = 0; // which search each node was last seen by
+        unsigned int* m_heap = 0;
+        unsigned int* m_heap_positions = 0;
+        unsigned int* m_route = 0;
+        unsigned int m_heap_count = 0;
+        unsigned int m_search = 0;
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_start_signal;
+        std::condition_variable m_done_signal;
+        bool m_start = false;
+        bool m_quit = false;
+        std::atomic<bool> m_busy{false};
+
+        // statistics
+        unsigned long long m_portal_count = 0;
+        unsigned long long m_portals_dropped = 0;
+        unsigned long long m_chunks_rebuilt = 0;
+        unsigned long long m_columns_rebuilt = 0;
+        unsigned long long m_paths_found = 0;
+        unsigned long long m_paths_failed = 0;
+
+        // same layout as world::get_chunk_slot at z 0
+        long long get_column_slot(long long x, long long y) {
+            long long slot_x = x % m_width;
+            long long slot_y = y % m_length;
+
+            slot_x = slot_x < 0 ? slot_x + m_width : slot_x;
+            slot_y = slot_y < 0 ? slot_y + m_length : slot_y;
+
+            return slot_x + (slot_y * m_width);
+        }
+
+        bool has_column(long long x, long long y) {
+            return x >= m_origin_x && y >= m_origin_y && x < m_origin_x + m_width && y < m_origin_y + m_length;
+        }
+
+        unsigned int get_node_count() {
+            return (unsigned int)(m_width * m_length * max_column_portals);
+        }
+
+        bool is_walkable(long long column, int x, int y, long long z) {
+            if (z < 0 || z >= m_height * 8) {
+                return false;
+            }
+
+            return (m_chunks[column + ((z >> 3) * m_width * m_length)].walkable[z & 7] >> (x + (y * 8))) & 1;
+        }
+
+        bool is_tall(long long column, int x, int y, long long z) {
+            if (z < 0 || z >= m_height * 8) {
+                return false;
+            }
+
+            return (m_chunks[column + ((z >> 3) * m_width * m_length)].tall[z & 7] >> (x + (y * 8))) & 1;
+        }
+
+        // the cells may be in different columns, they are expected to be beside each other
+        bool can_step(long long column_a, int ax, int ay, long long az, long long column_b, int bx, int by, long long bz) {
+            if (!is_walkable(column_a, ax, ay, az) || !is_walkable(column_b, bx, by, bz)) {
+                return false;
+            }
+
+            if (bz == az) {
+                return true;
+            }
+            if (bz == az + 1) {
+                return is_tall(column_a, ax, ay, az);
+            }
+            if (bz == az - 1) {
+                return is_tall(column_b, bx, by, bz);
+            }
+
+            return false;
+        }
+
+        // outside the world counts as solid below it and as air above it
+        unsigned long long get_solid_layer(long long x, long long y, long long z) {
+            if (z < 0) {
+                return ~0ull;
+            }
+            if (z >= m_height * 8) {
+                return 0;
+            }
+
+            return m_world->get_chunk(x, y, z >> 3)->get_solid_mask(z & 7);
+        }
+
+        void build_chunk(long long slot) {
+            navigation_chunk* chunk = &m_chunks[slot];
+            long long x, y, z;
+            long long block_z;
+
+            m_world->get_slot_chunk(slot, &x, &y, &z);
+
+            for (unsigned int i = 0; i < 8; i++) {
+                block_z = (z * 8) + i;
+                chunk->walkable[i] = get_solid_layer(x, y, block_z - 1) & ~get_solid_layer(x, y, block_z) & ~get_solid_layer(x, y, block_z + 1);
+                chunk->tall[i] = chunk->walkable[i] & ~get_solid_layer(x, y, block_z + 2);
+            }
+
+            m_chunks_rebuilt++;
+        }
+
+        // steps from one cell to every cell of its column without leaving it, stops early once the cell to is reached, -1 for none
+        // distances are left in m_distances and the way back in m_parents
+        void search_column(long long column, unsigned int from, long long to) {
+            unsigned int head = 0;
+            unsigned int tail = 0;
+            unsigned int cell, next;
+            int x, y, next_x, next_y;
+            long long z, next_z;
+
+            for (unsigned int i = 0; i < m_column_cells; i++) {
+                m_distances[i] = navigation_unreachable;
+            }
+
+            m_distances[from] = 0;
+            m_queue[tail] = from;
+            tail++;
+
+            while (head < tail) {
+                cell = m_queue[head];
+                head++;
+                if ((long long)cell == to) {
+                    return;
+                }
+
+                x = cell & 7;
+                y = (cell >> 3) & 7;
+                z = cell >> 6;
+
+                for (unsigned int i = 0; i < 4; i++) {
+                    next_x = x + st2_offsets[navigation_sides[i]][0];
+                    next_y = y + st2_offsets[navigation_sides[i]][1];
+                    if (next_x < 0 || next_y < 0 || next_x > 7 || next_y > 7) {
+                        continue;
+                    }
+
+                    for (next_z = z - 1; next_z <= z + 1; next_z++) {
+                        if (next_z < 0 || next_z >= m_height * 8) {
+                            continue;
+                        }
+
+                        next = next_x + (next_y * 8) + ((unsigned int)next_z * 64);
+                        if (m_distances[next] != navigation_unreachable || !can_step(column, x, y, z, column, next_x, next_y, next_z)) {
+                            continue;
+                        }
+
+                        m_distances[next] = m_distances[cell] + 1;
+                        m_parents[next] = cell;
+                        m_queue[tail] = next;
+                        tail++;
+                    }
+                }
+            }
+        }
+
+        // the cell on a border i blocks along it, and the cell across the border from it
+        void get_border_cell(st2 side, int i, int* x, int* y, int* across_x, int* across_y) {
+            *x = st2_offsets[side][0] < 0 ? 0 : (st2_offsets[side][0] > 0 ? 7 : i);
+            *y = st2_offsets[side][1] < 0 ? 0 : (st2_offsets[side][1] > 0 ? 7 : i);
+            *across_x = (*x + st2_offsets[side][0]) & 7;
+            *across_y = (*y + st2_offsets[side][1]) & 7;
+        }
+
+        // how far up or down the step over a border from a cell goes, 2 when there is none
+        // a cell has at most one, the cells above and below one that can be stood in never can
+        int find_crossing(long long column, long long across, st2 side, int i, long long z) {
+            int x, y, across_x, across_y;
+
+            get_border_cell(side, i, &x, &y, &across_x, &across_y);
+            if (!is_walkable(column, x, y, z)) {
+                return 2;
+            }
+
+            for (int dz = -1; dz <= 1; dz++) {
+                if (can_step(column, x, y, z, across, across_x, across_y, z + dz)) {
+                    return dz;
+                }
+            }
+
+            return 2;
+        }
+
+        void add_portal(navigation_column* column, st2 side, int i, long long z, int dz) {
+            navigation_portal* portal;
+            int x, y, across_x, across_y;
+
+            if (column->portal_count == max_column_portals) {
+                m_portals_dropped++;
+
+                return;
+            }
+
+            portal = &column->portals[column->portal_count];
+            column->portal_count++;
+            get_border_cell(side, i, &x, &y, &across_x, &across_y);
+
+            portal->x = (unsigned char)x;
+            portal->y = (unsigned char)y;
+            portal->z = (short)z;
+            portal->across_z = (short)(z + dz);
+            portal->side = (unsigned char)side;
+        }
+
+        // runs of crossings are found the same way from either side of a border, so both columns put a portal at the same place
+        void build_column(long long slot) {
+            navigation_column* column = &m_columns[slot];
+            long long x, y, z;
+            long long across;
+            st2 side;
+            int first, run_dz, dz;
+
+            m_world->get_slot_chunk(slot, &x, &y, &z);
+            m_portal_count -= column->portal_count;
+            column->x = x;
+            column->y = y;
+            column->portal_count = 0;
+
+            for (unsigned int i = 0; i < 4; i++) {
+                side = navigation_sides[i];
+                if (!has_column(x + st2_offsets[side][0], y + st2_offsets[side][1])) {
+                    continue;
+                }
+
+                across = get_column_slot(x + st2_offsets[side][0], y + st2_offsets[side][1]);
+                for (long long block_z = 0; block_z < m_height * 8; block_z++) {
+                    first = -1;
+                    run_dz = 2;
+
+                    for (int j = 0; j <= 8; j++) {
+                        dz = j < 8 ? find_crossing(slot, across, side, j, block_z) : 2;
+
+                        if (first >= 0 && dz != run_dz) {
+                            add_portal(column, side, (first + j - 1) / 2, block_z, run_dz);
+                            first = -1;
+                        }
+                        if (first < 0 && dz != 2) {
+                            first = j;
+                            run_dz = dz;
+                        }
+                    }
+                }
+            }
+
+            // steps between every pair of portals
+            for (unsigned int i = 0; i < column->portal_count; i++) {
+                search_column(slot, get_portal_cell(&column->portals[i]), -1);
+
+                for (unsigned int j = 0; j < column->portal_count; j++) {
+                    column->costs[(i * max_column_portals) + j] = m_distances[get_portal_cell(&column->portals[j])];
+                }
+            }
+
+            m_portal_count += column->portal_count;
+            m_columns_rebuilt++;
+        }
+
+        unsigned int get_portal_cell(navigation_portal* portal) {
+            return portal->x + (portal->y * 8) + ((unsigned int)portal->z * 64);
+        }
+
+        // bring every dirty chunk and column up to date with the world, only while the search thread is idle
+        void rebuild() {
+            if (!m_dirty && m_origin_x == m_world->get_origin_x() && m_origin_y == m_world->get_origin_y()) {
+                return;
+            }
+
+            m_origin_x = m_world->get_origin_x();
+            m_origin_y = m_world->get_origin_y();
+
+            for (long long i = 0; i < m_width * m_length * m_height; i++) {
+                if (m_dirty_chunks[i]) {
+                    build_chunk(i);
+                    m_dirty_chunks[i] = false;
+                }
+            }
+            for (long long i = 0; i < m_width * m_length; i++) {
+                if (m_dirty_columns[i]) {
+                    build_column(i);
+                    m_dirty_columns[i] = false;
+                }
+            }
+
+            m_dirty = false;
+        }
+
+        void mark_column(long long x, long long y) {
+            if (m_world->get_chunk(x, y, 0) != 0) {
+                m_dirty_columns[get_column_slot(x, y)] = true;
+                m_dirty = true;
+            }
+        }
+
+        // the chunks whose cells can see a block change in an inclusive box, and every column with a border on it
+        void mark_box(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            z1 = z1 - 2 < 0 ? 0 : z1 - 2;
+            z2 = z2 + 1 >= m_height * 8 ? (m_height * 8) - 1 : z2 + 1;
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        if (m_world->get_chunk(cx, cy, cz) != 0) {
+                            m_dirty_chunks[m_world->get_chunk_slot(cx, cy, cz)] = true;
+                        }
+                    }
+                }
+            }
+
+            for (long long cx = (x1 - 1) >> 3; cx <= (x2 + 1) >> 3; cx++) {
+                for (long long cy = (y1 - 1) >> 3; cy <= (y2 + 1) >> 3; cy++) {
+                    mark_column(cx, cy);
+                }
+            }
+        }
+
+        static void on_block_changed(void* context, long long x, long long y, long long z, unsigned short old_value, unsigned short new_value) {
+            if ((old_value != 0) != (new_value != 0)) {
+                ((navigator*)context)->mark_box(x, y, z, x, y, z);
+            }
+        }
+
+        static void on_region_changed(void* context, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            ((navigator*)context)->mark_box(x1, y1, z1, x2, y2, z2);
+        }
+
+        // nodes are every portal slot of every column, then the start and the goal of the search
+        void get_node_cell(unsigned int node, unsigned int request, long long* x, long long* y, long long* z) {
+            navigation_column* column;
+            navigation_portal* portal;
+
+            if (node >= get_node_count()) {
+                *x = m_ends[(request * 6) + ((node - get_node_count()) * 3)];
+                *y = m_ends[(request * 6) + ((node - get_node_count()) * 3) + 1];
+                *z = m_ends[(request * 6) + ((node - get_node_count()) * 3) + 2];
+
+                return;
+            }
+
+            column = &m_columns[node / max_column_portals];
+            portal = &column->portals[node % max_column_portals];
+            *x = (column->x * 8) + portal->x;
+            *y = (column->y * 8) + portal->y;
+            *z = portal->z;
+        }
+
+        // the portal on the other side of a border, -1 when the column across dropped it
+        long long find_partner(unsigned int node) {
+            navigation_column* column = &m_columns[node / max_column_portals];
+            navigation_portal* portal = &column->portals[node % max_column_portals];
+            long long x = column->x + st2_offsets[portal->side][0];
+            long long y = column->y + st2_offsets[portal->side][1];
+            navigation_column* across;
+            navigation_portal* candidate;
+            unsigned int across_x = (portal->x + st2_offsets[portal->side][0]) & 7;
+            unsigned int across_y = (portal->y + st2_offsets[portal->side][1]) & 7;
+            unsigned int opposite = (portal->side + 3) % 6;
+
+            if (!has_column(x, y)) {
+                return -1;
+            }
+
+            across = &m_columns[get_column_slot(x, y)];
+            for (unsigned int i = 0; i < across->portal_count; i++) {
+                candidate = &across->portals[i];
+                if (candidate->side == opposite && candidate->x == across_x && candidate->y == across_y && candidate->z == portal->across_z) {
+                    return (get_column_slot(x, y) * max_column_portals) + i;
+                }
+            }
+
+            return -1;
+        }
+
+        // indexed binary heap on m_f
+        void heap_up(unsigned int position) {
+            unsigned int node = m_heap[position];
+            unsigned int parent;
+
+            while (position > 0) {
+                parent = (position - 1) / 2;
+                if (m_f[m_heap[parent]] <= m_f[node]) {
+                    break;
+                }
+
+                m_heap[position] = m_heap[parent];
+                m_heap_positions[m_heap[position]] = position;
+                position = parent;
+            }
+
+            m_heap[position] = node;
+            m_heap_positions[node] = position;
+        }
+
+        unsigned int heap_pop() {
+            unsigned int output = m_heap[0];
+            unsigned int node, position, child;
+
+            m_heap_count--;
+            m_heap_positions[output] = navigation_closed;
+            if (m_heap_count == 0) {
+                return output;
+            }
+
+            node = m_heap[m_heap_count];
+            position = 0;
+            while ((child = (position * 2) + 1) < m_heap_count) {
+                if (child + 1 < m_heap_count && m_f[m_heap[child + 1]] < m_f[m_heap[child]]) {
+                    child++;
+                }
+                if (m_f[node] <= m_f[m_heap[child]]) {
+                    break;
+                }
+
+                m_heap[position] = m_heap[child];
+                m_heap_positions[m_heap[position]] = position;
+                position = child;
+            }
+
+            m_heap[position] = node;
+            m_heap_positions[node] = position;
+
+            return output;
+        }
+
+        // reach a node from another for cost more steps, the heuristic is the distance across x and y, never more than the steps left
+        void relax(unsigned int request, unsigned int from, unsigned int node, unsigned int cost) {
+            unsigned int g = m_g[from] + cost;
+            long long x, y, z, goal_x, goal_y, goal_z;
+
+            if (m_stamps[node] == m_search && (m_heap_positions[node] == navigation_closed || g >= m_g[node])) {
+                return;
+            }
+
+            get_node_cell(node, request, &x, &y, &z);
+            get_node_cell(get_node_count() + 1, request, &goal_x, &goal_y, &goal_z);
+
+            m_g[node] = g;
+            m_f[node] = g + (unsigned int)((x < goal_x ? goal_x - x : x - goal_x) + (y < goal_y ? goal_y - y : y - goal_y));
+            m_came_from[node] = from;
+            if (m_stamps[node] != m_search) {
+                m_stamps[node] = m_search;
+                m_heap[m_heap_count] = node;
+                m_heap_count++;
+                heap_up(m_heap_count - 1);
+            } else {
+                heap_up(m_heap_positions[node]);
+            }
+        }
+
+        bool append_cell(unsigned int request, long long x, long long y, long long z) {
+            int* cell = &m_cells[(((unsigned long long)request * max_path_length) + m_lengths[request]) * 3];
+
+            if (m_lengths[request] == max_path_length) {
+                return false;
+            }
+
+            cell[0] = (int)x;
+            cell[1] = (int)y;
+            cell[2] = (int)z;
+            m_lengths[request]++;
+
+            return true;
+        }
+
+        // fill in the cells between two nodes of the same column
+        bool append_column_path(unsigned int request, long long slot, long long from_x, long long from_y, long long from_z, long long to_x, long long to_y, long long to_z) {
+            unsigned int from = (from_x & 7) + ((from_y & 7) * 8) + ((unsigned int)from_z * 64);
+            unsigned int to = (to_x & 7) + ((to_y & 7) * 8) + ((unsigned int)to_z * 64);
+            unsigned int count = 0;
+            unsigned int cell;
+
+            search_column(slot, from, to);
+            if (m_distances[to] == navigation_unreachable) {
+                return false;
+            }
+
+            for (cell = to; cell != from; cell = m_parents[cell]) {
+                m_steps[count] = cell;
+                count++;
+            }
+
+            while (count > 0) {
+                count--;
+                cell = m_steps[count];
+                if (!append_cell(request, (m_columns[slot].x * 8) + (cell & 7), (m_columns[slot].y * 8) + ((cell >> 3) & 7), cell >> 6)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // hierarchical a* from the request's start to its goal, false when there is no way or the path is too long
+        bool find_path(unsigned int request) {
+            long long* ends = &m_ends[request * 6];
+            unsigned int start = get_node_count();
+            unsigned int goal = get_node_count() + 1;
+            long long start_slot, goal_slot;
+            unsigned int start_cell, goal_cell;
+            unsigned short direct = navigation_unreachable;
+            navigation_column* column;
+            unsigned int node, slot, route_count;
+            long long partner;
+            long long x, y, z, next_x, next_y, next_z;
+
+            m_lengths[request] = 0;
+            if (!has_column(ends[0] >> 3, ends[1] >> 3) || !has_column(ends[3] >> 3, ends[4] >> 3)) {
+                return false;
+            }
+
+            start_slot = get_column_slot(ends[0] >> 3, ends[1] >> 3);
+            goal_slot = get_column_slot(ends[3] >> 3, ends[4] >> 3);
+            if (!is_walkable(start_slot, ends[0] & 7, ends[1] & 7, ends[2]) || !is_walkable(goal_slot, ends[3] & 7, ends[4] & 7, ends[5])) {
+                return false;
+            }
+            start_cell = (ends[0] & 7) + ((ends[1] & 7) * 8) + ((unsigned int)ends[2] * 64);
+            goal_cell = (ends[3] & 7) + ((ends[4] & 7) * 8) + ((unsigned int)ends[5] * 64);
+
+            // the start and the goal join the graph through the portals of their own columns
+            search_column(start_slot, start_cell, -1);
+            for (unsigned int i = 0; i < m_columns[start_slot].portal_count; i++) {
+                m_start_costs[i] = m_distances[get_portal_cell(&m_columns[start_slot].portals[i])];
+            }
+            if (start_slot == goal_slot) {
+                direct = m_distances[goal_cell];
+            }
+            search_column(goal_slot, goal_cell, -1);
+            for (unsigned int i = 0; i < m_columns[goal_slot].portal_count; i++) {
+                m_goal_costs[i] = m_distances[get_portal_cell(&m_columns[goal_slot].portals[i])];
+            }
+
+            // search the graph
+            m_search++;
+            m_heap_count = 0;
+            m_stamps[start] = m_search;
+            m_g[start] = 0;
+            m_f[start] = 0;
+            m_heap[0] = start;
+            m_heap_positions[start] = 0;
+            m_heap_count = 1;
+
+            while (m_heap_count > 0) {
+                node = heap_pop();
+                if (node == goal) {
+                    break;
+                }
+
+                if (node == start) {
+                    column = &m_columns[start_slot];
+                    for (unsigned int i = 0; i < column->portal_count; i++) {
+                        if (m_start_costs[i] != navigation_unreachable) {
+                            relax(request, node, ((unsigned int)start_slot * max_column_portals) + i, m_start_costs[i]);
+                        }
+                    }
+                    if (direct != navigation_unreachable) {
+                        relax(request, node, goal, direct);
+                    }
+
+                    continue;
+                }
+
+                slot = node / max_column_portals;
+                column = &m_columns[slot];
+                partner = find_partner(node);
+                if (partner >= 0) {
+                    relax(request, node, (unsigned int)partner, 1);
+                }
+                for (unsigned int i = 0; i < column->portal_count; i++) {
+                    if (i != node % max_column_portals && column->costs[((node % max_column_portals) * max_column_portals) + i] != navigation_unreachable) {
+                        relax(request, node, (slot * max_column_portals) + i, column->costs[((node % max_column_portals) * max_column_portals) + i]);
+                    }
+                }
+                if ((long long)slot == goal_slot && m_goal_costs[node % max_column_portals] != navigation_unreachable) {
+                    relax(request, node, goal, m_goal_costs[node % max_column_portals]);
+                }
+            }
+
+            if (m_stamps[goal] != m_search || m_heap_positions[goal] != navigation_closed) {
+                return false;
+            }
+
+            // walk back to the start, then fill in every leg
+            route_count = 0;
+            for (node = goal; node != start; node = m_came_from[node]) {
+                m_route[route_count] = node;
+                route_count++;
+            }
+            m_route[route_count] = start;
+
+            append_cell(request, ends[0], ends[1], ends[2]);
+            for (unsigned int i = route_count; i > 0; i--) {
+                get_node_cell(m_route[i], request, &x, &y, &z);
+                get_node_cell(m_route[i - 1], request, &next_x, &next_y, &next_z);
+
+                // a step over a border
+                if ((x >> 3) != (next_x >> 3) || (y >> 3) != (next_y >> 3)) {
+                    if (!append_cell(request, next_x, next_y, next_z)) {
+                        return false;
+                    }
+
+                    continue;
+                }
+
+                if ((x != next_x || y != next_y || z != next_z) && !append_column_path(request, get_column_slot(x >> 3, y >> 3), x, y, z, next_x, next_y, next_z)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void work() {
+            unsigned int request;
+
+            while (true) {
+                // wait for a batch
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+
+                    m_start_signal.wait(lock, [&] { return m_quit || m_start; });
+                    if (m_quit) {
+                        return;
+                    }
+
+                    m_start = false;
+                }
+
+                for (unsigned int i = 0; i < m_batch_count; i++) {
+                    request = m_batch[i];
+                    m_results[request] = find_path(request) ? pst::pst_found : pst::pst_failed;
+                }
+
+                // hand everything back
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    m_busy.store(false, std::memory_order_release);
+                    m_done_signal.notify_all();
+                }
+            }
+        }
+
+    public:
+        // the world must already be generated, the graph follows its block changes until uninitialized
+        void initialize(world* w) {
+            unsigned long long chunk_count;
+            unsigned long long column_count;
+
+            m_world = w;
+            m_width = w->get_width();
+            m_length = w->get_length();
+            m_height = w->get_height();
+            m_origin_x = w->get_origin_x();
+            m_origin_y = w->get_origin_y();
+            m_column_cells = (unsigned int)(64 * m_height * 8);
+            chunk_count = (unsigned long long)(m_width * m_length * m_height);
+            column_count = (unsigned long long)(m_width * m_length);
+
+            m_chunks = new navigation_chunk[chunk_count];
+            m_columns = new navigation_column[column_count];
+            m_dirty_chunks = new bool[chunk_count];
+            m_dirty_columns = new bool[column_count];
+            m_statuses = new pst[max_path_requests];
+            m_results = new pst[max_path_requests];
+            m_ends = new long long[max_path_requests * 6];
+            m_cells = new int[(unsigned long long)max_path_requests * max_path_length * 3];
+            m_lengths = new unsigned int[max_path_requests];
+            m_in_flight = new bool[max_path_requests];
+            m_released = new bool[max_path_requests];
+            m_batch = new unsigned int[max_path_requests];
+            m_distances = new unsigned short[m_column_cells];
+            m_parents = new unsigned int[m_column_cells];
+            m_queue = new unsigned int[m_column_cells];
+            m_steps = new unsigned int[m_column_cells];
+            m_g = new unsigned int[get_node_count() + 2];
+            m_f = new unsigned int[get_node_count() + 2];
+            m_came_from = new unsigned int[get_node_count() + 2];
+            m_stamps = new unsigned int[get_node_count() + 2];
+            m_heap = new unsigned int[get_node_count() + 2];
+            m_heap_positions = new unsigned int[get_node_count() + 2];
+            m_route = new unsigned int[get_node_count() + 2];
+
+            m_bytes = (chunk_count * (sizeof(navigation_chunk) + sizeof(bool))) + (column_count * (sizeof(navigation_column) + sizeof(bool)));
+            m_bytes += max_path_requests * ((2 * sizeof(pst)) + (6 * sizeof(long long)) + sizeof(unsigned int) + (2 * sizeof(bool)) + sizeof(unsigned int));
+            m_bytes += (unsigned long long)max_path_requests * max_path_length * 3 * sizeof(int);
+            m_bytes += m_column_cells * (sizeof(unsigned short) + (3 * sizeof(unsigned int)));
+            m_bytes += (get_node_count() + 2) * 7 * sizeof(unsigned int);
+            g_memory_accounts.add(mtt::mtt_navigation, (long long)m_bytes);
+
+            for (unsigned long long i = 0; i < chunk_count; i++) {
+                m_dirty_chunks[i] = true;
+            }
+            for (unsigned long long i = 0; i < column_count; i++) {
+                m_columns[i].portal_count = 0;
+                m_dirty_columns[i] = true;
+            }
+            for (unsigned int i = 0; i < get_node_count() + 2; i++) {
+                m_stamps[i] = 0;
+            }
+            for (unsigned int i = 0; i < max_path_requests; i++) {
+                m_statuses[i] = pst::pst_free;
+                m_lengths[i] = 0;
+                m_in_flight[i] = false;
+                m_released[i] = false;
+            }
+            m_batch_count = 0;
+            m_next_request = 0;
+            m_search = 0;
+            m_portal_count = 0;
+            m_portals_dropped = 0;
+            m_chunks_rebuilt = 0;
+            m_columns_rebuilt = 0;
+            m_paths_found = 0;
+            m_paths_failed = 0;
+            m_dirty = true;
+            rebuild();
+
+            w->add_block_listener(on_block_changed, this);
+            w->add_region_listener(on_region_changed, this);
+
+            m_quit = false;
+            m_start = false;
+            m_busy = false;
+            m_thread = std::thread(&navigator::work, this);
+        }
+
+        // ask for a path between two cells agents can stand in, in block coordinates
+        // returns the request to check on, or -1 when every request is taken
+        long long request_path(long long start_x, long long start_y, long long start_z, long long goal_x, long long goal_y, long long goal_z) {
+            unsigned int request;
+
+            for (unsigned int i = 0; i < max_path_requests; i++) {
+                request = (m_next_request + i) % max_path_requests;
+                if (m_statuses[request] != pst::pst_free || m_in_flight[request]) {
+                    continue;
+                }
+
+                m_ends[(request * 6) + 0] = start_x;
+                m_ends[(request * 6) + 1] = start_y;
+                m_ends[(request * 6) + 2] = start_z;
+                m_ends[(request * 6) + 3] = goal_x;
+                m_ends[(request * 6) + 4] = goal_y;
+                m_ends[(request * 6) + 5] = goal_z;
+                m_lengths[request] = 0;
+                m_statuses[request] = pst::pst_waiting;
+                m_next_request = (request + 1) % max_path_requests;
+
+                return request;
+            }
+
+            return -1;
+        }
+
+        // pst_waiting until an update() after the search thread got to it
+        pst get_path_status(long long request) {
+            return m_statuses[request];
+        }
+
+        // cells from the start to the goal, both included
+        unsigned int get_path_length(long long request) {
+            return m_statuses[request] == pst::pst_found ? m_lengths[request] : 0;
+        }
+
+        void get_path_cell(long long request, unsigned int index, long long* x, long long* y, long long* z) {
+            int* cell = &m_cells[(((unsigned long long)request * max_path_length) + index) * 3];
+
+            *x = cell[0];
+            *y = cell[1];
+            *z = cell[2];
+        }
+
+        // done with a request, a path still being searched for is dropped when it comes back
+        void release_path(long long request) {
+            if (m_in_flight[request]) {
+                m_released[request] = true;
+            }
+
+            m_statuses[request] = pst::pst_free;
+        }
+
+        // call once a tick, never waits
+        // picks up the last batch of answers, rebuilds whatever the world changed since, then hands every waiting request to the search thread
+        void update() {
+            unsigned int request;
+
+            if (m_busy.load(std::memory_order_acquire)) {
+                return;
+            }
+
+            for (unsigned int i = 0; i < m_batch_count; i++) {
+                request = m_batch[i];
+                m_in_flight[request] = false;
+
+                if (m_released[request]) {
+                    m_released[request] = false;
+
+                    continue;
+                }
+
+                m_statuses[request] = m_results[request];
+                if (m_results[request] == pst::pst_found) {
+                    m_paths_found++;
+                } else {
+                    m_paths_failed++;
+                }
+            }
+            m_batch_count = 0;
+
+            rebuild();
+
+            for (unsigned int i = 0; i < max_path_requests; i++) {
+                if (m_statuses[i] == pst::pst_waiting && !m_in_flight[i]) {
+                    m_in_flight[i] = true;
+                    m_batch[m_batch_count] = i;
+                    m_batch_count++;
+                }
+            }
+            if (m_batch_count == 0) {
+                return;
+            }
+
+            // start searching
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_busy.store(true, std::memory_order_relaxed);
+                m_start = true;
+            }
+            m_start_signal.notify_one();
+        }
+
+        // blocks until a running batch has finished, its answers still come in on the next update()
+        void wait() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_done_signal.wait(lock, [&] { return !m_busy.load(std::memory_order_acquire); });
+        }
+
+        unsigned long long get_portal_count() {
+            return m_portal_count;
+        }
+
+        unsigned long long get_columns_rebuilt() {
+            return m_columns_rebuilt;
+        }
+
+        unsigned long long get_chunks_rebuilt() {
+            return m_chunks_rebuilt;
+        }
+
+        void print() {
+            printf("Navigation:\n");
+            printf("\tportals: %llu in %lld columns, %llu dropped\n", m_portal_count, m_width * m_length, m_portals_dropped);
+            printf("\trebuilt: %llu chunks, %llu columns\n", m_chunks_rebuilt, m_columns_rebuilt);
+            printf("\tpaths: %llu found, %llu failed\n", m_paths_found, m_paths_failed);
+            fflush(stdout);
+        }
+
+        void uninitialize() {
+            if (m_thread.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    m_quit = true;
+                }
+                m_start_signal.notify_one();
+                m_thread.join();
+            }
+
+            m_world->remove_block_listener(on_block_changed, this);
+            m_world->remove_region_listener(on_region_changed, this);
+            g_memory_accounts.remove(mtt::mtt_navigation, (long long)m_bytes);
+
+            delete[] m_chunks;
+            delete[] m_columns;
+            delete[] m_dirty_chunks;
+            delete[] m_dirty_columns;
+            delete[] m_statuses;
+            delete[] m_results;
+            delete[] m_ends;
+            delete[] m_cells;
+            delete[] m_lengths;
+            delete[] m_in_flight;
+            delete[] m_released;
+            delete[] m_batch;
+            delete[] m_distances;
+            delete[] m_parents;
+            delete[] m_queue;
+            delete[] m_steps;
+            delete[] m_g;
+            delete[] m_f;
+            delete[] m_came_from;
+            delete[] m_stamps;
+            delete[] m_heap;
+            delete[] m_heap_positions;
+            delete[] m_route;
+
+            m_chunks = 0;
+            m_columns = 0;
+            m_dirty_chunks = 0;
+            m_dirty_columns = 0;
+            m_statuses = 0;
+            m_results = 0;
+            m_ends = 0;
+            m_cells = 0;
+            m_lengths = 0;
+            m_in_flight = 0;
+            m_released = 0;
+            m_batch = 0;
+            m_distances = 0;
+            m_parents = 0;
+            m_queue = 0;
+            m_steps = 0;
+            m_g = 0;
+            m_f = 0;
+            m_came_from = 0;
+            m_stamps = 0;
+            m_heap = 0;
+            m_heap_positions = 0;
+            m_route = 0;
+            m_bytes = 0;
+            m_world = 0;
+        }
+    };
+}
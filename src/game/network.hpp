@@ -0,0 +1,577 @@
+#pragma once
+
+#include "types.hpp"
+#include "cache.hpp"
+#include "lighting.hpp"
+#include "timing.hpp"
+#include "world.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace abradinjapan::voxelize {
+    // bumped whenever a message changes layout, both ends must match
+    const unsigned int network_protocol_version = 1;
+
+    // every message starts with the length of its body then its type
+    const unsigned long long message_header_size = 5;
+
+    // room for a few hundred chunks either way, a connection that falls this far behind is dropped
+    const unsigned long long connection_buffer_size = 256 * 1024;
+
+    // the most chunks a client's window may hold, 16 by 16 by 1
+    const long long max_client_view_chunks = 256;
+
+    // network message type
+    // numbers are written in host byte order, both ends run on the same machine
+    enum nmt {
+        nmt_hello, // client to server: protocol version, window width and length in chunks
+        nmt_position, // client to server: player position in blocks, the chunk the window is centred on
+        nmt_ping, // server to client: server time
+        nmt_pong, // client to server: the server time of the ping it answers
+        nmt_chunk, // server to client: chunk position, then the chunk packed by compress_chunk
+        nmt_deltas // server to client: groups of changed blocks, each a chunk position, a count, then index, block and fluid per change
+    };
+
+    // bytes in one change inside an nmt_deltas group
+    const unsigned long long delta_change_size = 5;
+
+    // bytes in the chunk position and count heading an nmt_deltas group
+    const unsigned long long delta_group_size = 14;
+
+    void write_bytes(unsigned char** output, const void* value, unsigned long long length) {
+        memcpy(*output, value, length);
+        *output += length;
+    }
+
+    void read_bytes(unsigned char** input, void* value, unsigned long long length) {
+        memcpy(value, *input, length);
+        *input += length;
+    }
+
+    // a non blocking tcp socket with a buffer each way, messages are written into the send buffer and read out of the receive buffer whole
+    class connection {
+        int m_socket = -1;
+        unsigned char* m_send_buffer = 0;
+        unsigned long long m_send_length = 0;
+        unsigned char* m_receive_buffer = 0;
+        unsigned long long m_receive_start = 0; // the next unread message
+        unsigned long long m_receive_length = 0;
+        unsigned char* m_message = 0; // the message begin_message handed out
+        unsigned long long m_bytes_sent = 0;
+        unsigned long long m_bytes_received = 0;
+
+    public:
+        // takes ownership of a connected socket
+        void initialize(int socket) {
+            int enable = 1;
+
+            m_socket = socket;
+            fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL, 0) | O_NONBLOCK);
+
+            // messages are batched per tick already, waiting for more only adds latency
+            setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+            if (m_send_buffer == 0) {
+                m_send_buffer = new unsigned char[connection_buffer_size];
+                m_receive_buffer = new unsigned char[connection_buffer_size];
+            }
+            m_send_length = 0;
+            m_receive_start = 0;
+            m_receive_length = 0;
+            m_bytes_sent = 0;
+            m_bytes_received = 0;
+        }
+
+        bool is_open() {
+            return m_socket != -1;
+        }
+
+        // room for a message body of up to capacity bytes, 0 when the send buffer is too full
+        // the body is written through the pointer and committed with end_message
+        unsigned char* begin_message(nmt type, unsigned long long capacity) {
+            if (m_send_length + message_header_size + capacity > connection_buffer_size) {
+                return 0;
+            }
+
+            m_message = &m_send_buffer[m_send_length];
+            m_message[4] = (unsigned char)type;
+
+            return m_message + message_header_size;
+        }
+
+        // length is how much of the body was written
+        void end_message(unsigned long long length) {
+            unsigned int body_length = (unsigned int)length;
+
+            memcpy(m_message, &body_length, sizeof(body_length));
+            m_send_length += message_header_size + length;
+            m_message = 0;
+        }
+
+        // bytes written but not yet taken by the socket
+        unsigned long long get_pending() {
+            return m_send_length;
+        }
+
+        // hand the socket as much as it takes, returns false once the connection is gone
+        bool flush() {
+            ssize_t sent;
+
+            while (m_socket != -1 && m_send_length > 0) {
+                sent = send(m_socket, m_send_buffer, m_send_length, MSG_NOSIGNAL);
+
+                if (sent < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    if (errno == EINTR) {
+                        continue;
+                    }
+
+                    close_socket();
+
+                    return false;
+                }
+
+                memmove(m_send_buffer, m_send_buffer + sent, m_send_length - sent);
+                m_send_length -= sent;
+                m_bytes_sent += sent;
+            }
+
+            return m_socket != -1;
+        }
+
+        // read whatever has arrived, returns false once the connection is gone
+        bool fill() {
+            ssize_t received;
+
+            // move the unread messages to the front to make room
+            if (m_receive_start > 0) {
+                memmove(m_receive_buffer, m_receive_buffer + m_receive_start, m_receive_length - m_receive_start);
+                m_receive_length -= m_receive_start;
+                m_receive_start = 0;
+            }
+
+            while (m_socket != -1 && m_receive_length < connection_buffer_size) {
+                received = recv(m_socket, m_receive_buffer + m_receive_length, connection_buffer_size - m_receive_length, 0);
+
+                if (received < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                }
+                if (received <= 0) {
+                    close_socket();
+
+                    return false;
+                }
+
+                m_receive_length += received;
+                m_bytes_received += received;
+            }
+
+            return m_socket != -1;
+        }
+
+        // the next whole message, 0 until one has arrived, the body stays valid until the next fill
+        unsigned char* next_message(nmt* type, unsigned long long* length) {
+            unsigned int body_length;
+            unsigned char* output;
+
+            if (m_receive_length - m_receive_start < message_header_size) {
+                return 0;
+            }
+
+            memcpy(&body_length, &m_receive_buffer[m_receive_start], sizeof(body_length));
+
+            // a message that could never fit means the stream is corrupt
+            if (message_header_size + body_length > connection_buffer_size) {
+                close_socket();
+
+                return 0;
+            }
+            if (m_receive_length - m_receive_start < message_header_size + body_length) {
+                return 0;
+            }
+
+            *type = (nmt)m_receive_buffer[m_receive_start + 4];
+            *length = body_length;
+            output = &m_receive_buffer[m_receive_start + message_header_size];
+            m_receive_start += message_header_size + body_length;
+
+            return output;
+        }
+
+        unsigned long long get_bytes_sent() {
+            return m_bytes_sent;
+        }
+
+        unsigned long long get_bytes_received() {
+            return m_bytes_received;
+        }
+
+        void close_socket() {
+            if (m_socket != -1) {
+                close(m_socket);
+            }
+
+            m_socket = -1;
+        }
+
+        void uninitialize() {
+            close_socket();
+
+            delete[] m_send_buffer;
+            delete[] m_receive_buffer;
+
+            m_send_buffer = 0;
+            m_receive_buffer = 0;
+            m_send_length = 0;
+            m_receive_start = 0;
+            m_receive_length = 0;
+        }
+    };
+
+    // which chunk each slot of a client's window holds, laid out like world::get_chunk_slot
+    // the server and the client keep one each, so the server knows what to send and what deltas the client can use
+    class held_chunks {
+        long long m_x[max_client_view_chunks];
+        long long m_y[max_client_view_chunks];
+        bool m_held[max_client_view_chunks];
+        long long m_width = 0;
+        long long m_length = 0;
+        long long m_origin_x = 0;
+        long long m_origin_y = 0;
+
+        long long get_slot(long long x, long long y) {
+            long long slot_x = x % m_width;
+            long long slot_y = y % m_length;
+
+            slot_x = slot_x < 0 ? slot_x + m_width : slot_x;
+            slot_y = slot_y < 0 ? slot_y + m_length : slot_y;
+
+            return slot_x + (slot_y * m_width);
+        }
+
+    public:
+        void initialize(long long width, long long length) {
+            m_width = width;
+            m_length = length;
+            m_origin_x = 0;
+            m_origin_y = 0;
+
+            for (long long i = 0; i < max_client_view_chunks; i++) {
+                m_held[i] = false;
+            }
+        }
+
+        long long get_width() {
+            return m_width;
+        }
+
+        long long get_length() {
+            return m_length;
+        }
+
+        long long get_origin_x() {
+            return m_origin_x;
+        }
+
+        long long get_origin_y() {
+            return m_origin_y;
+        }
+
+        // the window follows the chunk the player stands in the same way world::recentre does, chunks left outside are forgotten
+        void recentre(long long centre_x, long long centre_y) {
+            m_origin_x = centre_x - (m_width / 2);
+            m_origin_y = centre_y - (m_length / 2);
+
+            for (long long i = 0; i < m_width * m_length; i++) {
+                if (m_held[i] && !contains(m_x[i], m_y[i])) {
+                    m_held[i] = false;
+                }
+            }
+        }
+
+        bool contains(long long x, long long y) {
+            return x >= m_origin_x && y >= m_origin_y && x < m_origin_x + m_width && y < m_origin_y + m_length;
+        }
+
+        bool is_held(long long x, long long y) {
+            long long slot = get_slot(x, y);
+
+            return contains(x, y) && m_held[slot] && m_x[slot] == x && m_y[slot] == y;
+        }
+
+        void hold(long long x, long long y) {
+            long long slot = get_slot(x, y);
+
+            m_x[slot] = x;
+            m_y[slot] = y;
+            m_held[slot] = true;
+        }
+
+        // the chunk must be sent again in full
+        void forget(long long x, long long y) {
+            if (is_held(x, y)) {
+                m_held[get_slot(x, y)] = false;
+            }
+        }
+
+        long long get_count() {
+            long long output = 0;
+
+            for (long long i = 0; i < m_width * m_length; i++) {
+                output += m_held[i] ? 1 : 0;
+            }
+
+            return output;
+        }
+    };
+
+    // the client's end of a connection to a world_server, it fills a remote world with what the server sends
+    // the player moves locally, the server owns every block and fluid
+    class server_connection {
+        connection m_connection;
+        held_chunks m_held;
+        float m_sent_position[3];
+        long long m_sent_centre_x = 0;
+        long long m_sent_centre_y = 0;
+        unsigned long long m_chunks_received = 0;
+        unsigned long long m_changes_received = 0;
+        unsigned long long m_pings_answered = 0;
+        double m_connected_at = 0.0;
+
+        // returns false when the changes are malformed, a group running past the end, an index outside a chunk or a chunk outside the world's height
+        bool apply_deltas(world* w, light_engine* lighting, unsigned char* input, unsigned long long length) {
+            unsigned char* end = input + length;
+            int chunk[3];
+            unsigned short count, index, block;
+            unsigned char fluid;
+            long long x, y, z;
+
+            while (input + delta_group_size <= end) {
+                read_bytes(&input, chunk, sizeof(chunk));
+                read_bytes(&input, &count, sizeof(count));
+
+                if (chunk[2] < 0 || chunk[2] >= w->get_height() || (unsigned long long)(end - input) < (unsigned long long)count * delta_change_size) {
+                    return false;
+                }
+
+                for (unsigned short i = 0; i < count; i++) {
+                    read_bytes(&input, &index, sizeof(index));
+                    read_bytes(&input, &block, sizeof(block));
+                    read_bytes(&input, &fluid, sizeof(fluid));
+
+                    if (index >= 512) {
+                        return false;
+                    }
+
+                    // a chunk that left the window since will be sent again in full when it comes back
+                    if (!m_held.is_held(chunk[0], chunk[1]) || w->get_chunk(chunk[0], chunk[1], chunk[2]) == 0) {
+                        continue;
+                    }
+
+                    x = ((long long)chunk[0] * 8) + (index & 7);
+                    y = ((long long)chunk[1] * 8) + ((index >> 3) & 7);
+                    z = ((long long)chunk[2] * 8) + (index >> 6);
+
+                    if (w->get_block_at(x, y, z) != block) {
+                        lighting->set_block_at(x, y, z, block);
+                    }
+                    if (w->get_fluid_at(x, y, z) != fluid) {
+                        w->set_fluid_at(x, y, z, fluid);
+                    }
+                    m_changes_received++;
+                }
+            }
+
+            return input == end;
+        }
+
+    public:
+        // blocks until connected, the window is the size of the remote world
+        et initialize(const char* address, unsigned short port, world* w) {
+            sockaddr_in server_address;
+            unsigned char* body;
+            unsigned int hello[3] = { network_protocol_version, (unsigned int)w->get_width(), (unsigned int)w->get_length() };
+            int socket_handle = socket(AF_INET, SOCK_STREAM, 0);
+
+            memset(&server_address, 0, sizeof(server_address));
+            server_address.sin_family = AF_INET;
+            server_address.sin_port = htons(port);
+
+            if (socket_handle < 0 || inet_pton(AF_INET, address, &server_address.sin_addr) != 1 || connect(socket_handle, (sockaddr*)&server_address, sizeof(server_address)) != 0) {
+                printf("Error: could not connect to a server at %s:%u\n", address, port);
+                fflush(stdout);
+
+                if (socket_handle >= 0) {
+                    close(socket_handle);
+                }
+
+                return et::et_could_not_connect_to_server;
+            }
+
+            m_connection.initialize(socket_handle);
+            m_held.initialize(w->get_width(), w->get_length());
+            m_sent_position[0] = m_sent_position[1] = m_sent_position[2] = -1.0f;
+            m_sent_centre_x = w->get_origin_x() + (w->get_width() / 2);
+            m_sent_centre_y = w->get_origin_y() + (w->get_length() / 2);
+            m_held.recentre(m_sent_centre_x, m_sent_centre_y);
+            m_chunks_received = 0;
+            m_changes_received = 0;
+            m_pings_answered = 0;
+            m_connected_at = get_seconds();
+
+            body = m_connection.begin_message(nmt::nmt_hello, sizeof(hello));
+            memcpy(body, hello, sizeof(hello));
+            m_connection.end_message(sizeof(hello));
+
+            // until the player spawns the server streams around the middle of the window
+            send_position(w, (float)(m_sent_centre_x * 8), (float)(m_sent_centre_y * 8), 0.0f);
+            m_connection.flush();
+
+            return et::et_no_error;
+        }
+
+        bool is_connected() {
+            return m_connection.is_open();
+        }
+
+        // tell the server where the player is, only sent when it moved, call after the world recentres so the server never sends into a window the client already left
+        void send_position(world* w, float x, float y, float z) {
+            long long centre_x = w->get_origin_x() + (w->get_width() / 2);
+            long long centre_y = w->get_origin_y() + (w->get_length() / 2);
+            unsigned char* body;
+            unsigned char* output;
+
+            if (x == m_sent_position[0] && y == m_sent_position[1] && z == m_sent_position[2] && centre_x == m_sent_centre_x && centre_y == m_sent_centre_y) {
+                return;
+            }
+
+            body = m_connection.begin_message(nmt::nmt_position, (sizeof(float) * 3) + (sizeof(long long) * 2));
+            if (body == 0) {
+                return;
+            }
+
+            output = body;
+            write_bytes(&output, &x, sizeof(x));
+            write_bytes(&output, &y, sizeof(y));
+            write_bytes(&output, &z, sizeof(z));
+            write_bytes(&output, &centre_x, sizeof(centre_x));
+            write_bytes(&output, &centre_y, sizeof(centre_y));
+            m_connection.end_message(output - body);
+
+            m_sent_position[0] = x;
+            m_sent_position[1] = y;
+            m_sent_position[2] = z;
+            m_sent_centre_x = centre_x;
+            m_sent_centre_y = centre_y;
+            m_held.recentre(centre_x, centre_y);
+        }
+
+        // apply everything that has arrived, returns false once the server is gone
+        // a malformed chunk or set of changes closes the connection, the stream can no longer be trusted
+        bool receive(world* w, light_engine* lighting) {
+            unsigned char* body;
+            unsigned char* input;
+            unsigned char* output;
+            unsigned long long length;
+            int chunk[3];
+            double ping_time;
+            nmt type;
+
+            if (!m_connection.is_open()) {
+                return false;
+            }
+
+            m_connection.fill();
+
+            while ((body = m_connection.next_message(&type, &length)) != 0) {
+                input = body;
+
+                if (type == nmt::nmt_chunk) {
+                    if (length <= sizeof(chunk)) {
+                        m_connection.close_socket();
+
+                        return false;
+                    }
+
+                    read_bytes(&input, chunk, sizeof(chunk));
+
+                    // outside the window it is dropped unread, inside it has to decode
+                    if (m_held.contains(chunk[0], chunk[1]) && w->get_chunk(chunk[0], chunk[1], chunk[2]) != 0) {
+                        if (!w->load_compressed_chunk(chunk[0], chunk[1], chunk[2], input, length - sizeof(chunk))) {
+                            m_connection.close_socket();
+
+                            return false;
+                        }
+
+                        m_held.hold(chunk[0], chunk[1]);
+                        m_chunks_received++;
+                    }
+                } else if (type == nmt::nmt_deltas) {
+                    if (!apply_deltas(w, lighting, body, length)) {
+                        m_connection.close_socket();
+
+                        return false;
+                    }
+                } else if (type == nmt::nmt_ping && length == sizeof(ping_time)) {
+                    read_bytes(&input, &ping_time, sizeof(ping_time));
+
+                    output = m_connection.begin_message(nmt::nmt_pong, sizeof(ping_time));
+                    if (output != 0) {
+                        memcpy(output, &ping_time, sizeof(ping_time));
+                        m_connection.end_message(sizeof(ping_time));
+                        m_pings_answered++;
+                    }
+                }
+            }
+
+            return m_connection.flush();
+        }
+
+        // send what send_position and receive queued
+        bool flush() {
+            return m_connection.flush();
+        }
+
+        bool is_chunk_held(long long x, long long y) {
+            return m_held.is_held(x, y);
+        }
+
+        long long get_held_count() {
+            return m_held.get_count();
+        }
+
+        unsigned long long get_chunks_received() {
+            return m_chunks_received;
+        }
+
+        unsigned long long get_changes_received() {
+            return m_changes_received;
+        }
+
+        void print() {
+            double seconds = get_seconds() - m_connected_at;
+
+            printf("Server connection:\n");
+            printf("\t%s, chunks received: %llu, changes received: %llu, pings answered: %llu\n", m_connection.is_open() ? "connected" : "disconnected", m_chunks_received, m_changes_received, m_pings_answered);
+            printf("\treceived %llu bytes (%.1f KiB/s), sent %llu bytes\n", m_connection.get_bytes_received(), seconds > 0.0 ? ((double)m_connection.get_bytes_received() / 1024.0) / seconds : 0.0, m_connection.get_bytes_sent());
+            fflush(stdout);
+        }
+
+        void uninitialize() {
+            m_connection.uninitialize();
+        }
+    };
+}
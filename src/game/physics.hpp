@@ -0,0 +1,109 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <math.h>
+
+namespace abradinjapan::voxelize {
+    // an axis aligned box that moves through the world, measured in blocks
+    class body {
+    public:
+        glm::vec3 p_position = glm::vec3(0.0f); // centre of the box
+        glm::vec3 p_velocity = glm::vec3(0.0f);
+        glm::vec3 p_half_size = glm::vec3(0.3f, 0.3f, 0.9f);
+        bool p_on_ground = false;
+    };
+
+    // gap kept between a body and the blocks it rests against, so touching faces never count as overlapping
+    const float body_skin = 0.001f;
+
+    // true when any block in one layer of a swept box is solid
+    bool is_layer_solid(world* w, int axis, long long layer, long long* range_1, long long* range_2) {
+        long long low[3];
+        long long high[3];
+
+        low[axis] = layer;
+        high[axis] = layer;
+        low[(axis + 1) % 3] = range_1[0];
+        high[(axis + 1) % 3] = range_1[1];
+        low[(axis + 2) % 3] = range_2[0];
+        high[(axis + 2) % 3] = range_2[1];
+
+        return w->is_box_solid(low[0], low[1], low[2], high[0], high[1], high[2]);
+    }
+
+    // move a body along one axis, stopping at the first solid layer of blocks in the way
+    // every layer between the start and the end is tested, so no speed can tunnel through a wall
+    float sweep_body_axis(world* w, body* b, int axis, float distance) {
+        int other_1 = (axis + 1) % 3;
+        int other_2 = (axis + 2) % 3;
+        long long range_1[2];
+        long long range_2[2];
+        float low = b->p_position[axis] - b->p_half_size[axis];
+        float high = b->p_position[axis] + b->p_half_size[axis];
+        long long first, last;
+
+        if (distance == 0.0f) {
+            return 0.0f;
+        }
+
+        // blocks overlapped across the other two axes
+        range_1[0] = (long long)floorf(b->p_position[other_1] - b->p_half_size[other_1]);
+        range_1[1] = (long long)ceilf(b->p_position[other_1] + b->p_half_size[other_1]) - 1;
+        range_2[0] = (long long)floorf(b->p_position[other_2] - b->p_half_size[other_2]);
+        range_2[1] = (long long)ceilf(b->p_position[other_2] + b->p_half_size[other_2]) - 1;
+
+        if (distance > 0.0f) {
+            first = (long long)ceilf(high);
+            last = (long long)ceilf(high + distance) - 1;
+
+            for (long long layer = first; layer <= last; layer++) {
+                if (is_layer_solid(w, axis, layer, range_1, range_2)) {
+                    distance = ((float)layer - body_skin) - high;
+                    if (distance < 0.0f) {
+                        distance = 0.0f;
+                    }
+
+                    b->p_position[axis] += distance;
+                    b->p_velocity[axis] = 0.0f;
+
+                    return distance;
+                }
+            }
+        } else {
+            first = (long long)floorf(low) - 1;
+            last = (long long)floorf(low + distance);
+
+            for (long long layer = first; layer >= last; layer--) {
+                if (is_layer_solid(w, axis, layer, range_1, range_2)) {
+                    distance = ((float)(layer + 1) + body_skin) - low;
+                    if (distance > 0.0f) {
+                        distance = 0.0f;
+                    }
+
+                    b->p_position[axis] += distance;
+                    b->p_velocity[axis] = 0.0f;
+
+                    return distance;
+                }
+            }
+        }
+
+        b->p_position[axis] += distance;
+
+        return distance;
+    }
+
+    // integrate a body for one tick, resolving collisions one axis at a time with z (up) first
+    void move_body(world* w, body* b, float seconds) {
+        float fall = b->p_velocity.z * seconds;
+
+        b->p_on_ground = false;
+
+        if (sweep_body_axis(w, b, 2, fall) != fall && fall < 0.0f) {
+            b->p_on_ground = true;
+        }
+        sweep_body_axis(w, b, 0, b->p_velocity.x * seconds);
+        sweep_body_axis(w, b, 1, b->p_velocity.y * seconds);
+    }
+}
@@ -0,0 +1,643 @@
+#pragma once
+
+#include "types.hpp"
+#include "fluids.hpp"
+#include "lighting.hpp"
+#include "network.hpp"
+#include "ticks.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
+#include <signal.h>
+
+namespace abradinjapan::voxelize {
+    // how many clients a server takes at once
+    const unsigned int max_server_clients = 8;
+
+    // chunks along x and y of the server's own window, wide enough for the largest client window
+    const long long server_view_size = 16;
+
+    // changes kept per tick, past this the chunks they fall in are sent again in full instead
+    const unsigned long long server_change_capacity = 16384;
+
+    // the largest nmt_deltas message, bigger batches are split
+    const unsigned long long max_delta_message_size = 16 * 1024;
+
+    // chunks stop streaming to a client while this much is still waiting on its socket, deltas and pings still go out
+    const unsigned long long max_pending_stream_bytes = 64 * 1024;
+
+    const unsigned int ping_interval_ticks = 30;
+
+    // set from a signal handler to stop world_server::run
+    inline volatile sig_atomic_t g_server_stop = 0;
+
+    // one block or fluid changed during a tick, what it changed to is read when it is sent
+    struct server_change {
+        long long x, y, z; // chunk coordinates
+        unsigned short index; // x + (y * 8) + (z * 64) inside the chunk
+    };
+
+    bool operator<(const server_change& a, const server_change& b) {
+        if (a.x != b.x) {
+            return a.x < b.x;
+        }
+        if (a.y != b.y) {
+            return a.y < b.y;
+        }
+        if (a.z != b.z) {
+            return a.z < b.z;
+        }
+
+        return a.index < b.index;
+    }
+
+    // a chunk column waiting to be streamed to a client
+    struct stream_candidate {
+        float distance; // squared, in blocks, from the player to the middle of the column
+        long long x, y;
+    };
+
+    bool operator<(const stream_candidate& a, const stream_candidate& b) {
+        return a.distance < b.distance;
+    }
+
+    struct server_client {
+        connection p_connection;
+        held_chunks p_held;
+        bool p_greeted = false; // sent a valid hello
+        unsigned long long p_id = 0;
+        float p_position[3] = { 0.0f, 0.0f, 0.0f };
+        double p_budget = 0.0; // bytes this client may still be sent, refilled every tick
+        double p_ping_sent_at = -1.0; // -1 while no ping is out
+        double p_connected_at = 0.0;
+        unsigned long long p_chunks_sent = 0;
+        unsigned long long p_chunk_bytes = 0;
+        unsigned long long p_changes_sent = 0;
+        unsigned long long p_delta_bytes = 0;
+        frame_statistics p_round_trips = frame_statistics();
+    };
+
+    // the authoritative simulation, run in its own process with --server and streamed to clients over tcp
+    // chunks are sent whole the first time a client sees them, nearest first and within a per client byte budget, after that only the blocks that change are sent, batched once per tick
+    // the server keeps a single window of chunks, it follows the first client and clients further away than it reaches only get what it holds
+    class world_server {
+        int m_listener = -1;
+        unsigned short m_port = 0;
+        server_client m_clients[max_server_clients];
+        bool m_client_slots[max_server_clients];
+        unsigned long long m_next_client_id = 0;
+        double m_bytes_per_second = 1024.0 * 1024.0;
+        double m_tick_rate = 60.0;
+        unsigned long long m_tick_count = 0;
+        slab_pool<chunk_888> m_chunk_pool = slab_pool<chunk_888>();
+        world m_world = world();
+        chunk_cache m_cold_chunks = chunk_cache();
+        light_engine m_lighting = light_engine();
+        worker_pool m_workers;
+        generation_pipeline m_generator = generation_pipeline();
+        tick_scheduler m_ticks = tick_scheduler();
+        fluid_solver m_fluids = fluid_solver();
+        server_change* m_changes = 0;
+        unsigned long long m_change_count = 0;
+        server_change* m_stale = 0; // chunks every client must be sent again, only x, y and z are used
+        unsigned long long m_stale_count = 0;
+        bool m_all_stale = false;
+        bool m_recentring = false;
+        stream_candidate m_candidates[max_client_view_chunks];
+
+        void mark_stale(long long x, long long y, long long z) {
+            if (m_stale_count == server_change_capacity) {
+                m_all_stale = true;
+
+                return;
+            }
+
+            m_stale[m_stale_count].x = x;
+            m_stale[m_stale_count].y = y;
+            m_stale[m_stale_count].z = z;
+            m_stale_count++;
+        }
+
+        void record_change(long long x, long long y, long long z) {
+            if (m_change_count == server_change_capacity) {
+                mark_stale(x >> 3, y >> 3, z >> 3);
+
+                return;
+            }
+
+            m_changes[m_change_count].x = x >> 3;
+            m_changes[m_change_count].y = y >> 3;
+            m_changes[m_change_count].z = z >> 3;
+            m_changes[m_change_count].index = (unsigned short)((x & 7) + ((y & 7) * 8) + ((z & 7) * 64));
+            m_change_count++;
+        }
+
+        static void on_block_changed(void* context, long long x, long long y, long long z, unsigned short old_value, unsigned short new_value) {
+            if (old_value != new_value) {
+                ((world_server*)context)->record_change(x, y, z);
+            }
+        }
+
+        static void on_fluid_changed(void* context, long long x, long long y, long long z, unsigned char old_value, unsigned char new_value) {
+            if (old_value != new_value) {
+                ((world_server*)context)->record_change(x, y, z);
+            }
+        }
+
+        // bulk edits touch too many blocks to send one by one, the chunks are sent again whole
+        // chunks entering the window as it moves are not edits, nobody holds them yet
+        static void on_region_changed(void* context, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            world_server* server = (world_server*)context;
+
+            if (server->m_recentring) {
+                return;
+            }
+
+            for (long long x = x1 >> 3; x <= x2 >> 3; x++) {
+                for (long long y = y1 >> 3; y <= y2 >> 3; y++) {
+                    for (long long z = z1 >> 3; z <= z2 >> 3; z++) {
+                        server->mark_stale(x, y, z);
+                    }
+                }
+            }
+        }
+
+        void accept_clients() {
+            int socket_handle;
+
+            while ((socket_handle = accept(m_listener, 0, 0)) >= 0) {
+                for (unsigned int i = 0; i < max_server_clients; i++) {
+                    if (!m_client_slots[i]) {
+                        m_client_slots[i] = true;
+                        m_clients[i].p_connection.initialize(socket_handle);
+                        m_clients[i].p_greeted = false;
+                        m_clients[i].p_id = m_next_client_id++;
+                        m_clients[i].p_budget = 0.0;
+                        m_clients[i].p_ping_sent_at = -1.0;
+                        m_clients[i].p_connected_at = get_seconds();
+                        m_clients[i].p_chunks_sent = 0;
+                        m_clients[i].p_chunk_bytes = 0;
+                        m_clients[i].p_changes_sent = 0;
+                        m_clients[i].p_delta_bytes = 0;
+                        m_clients[i].p_round_trips = frame_statistics();
+                        socket_handle = -1;
+
+                        printf("Server: client %llu connected\n", m_clients[i].p_id);
+                        fflush(stdout);
+
+                        break;
+                    }
+                }
+
+                // full
+                if (socket_handle != -1) {
+                    close(socket_handle);
+                }
+            }
+        }
+
+        void print_client(server_client* client) {
+            double seconds = get_seconds() - client->p_connected_at;
+
+            printf("\tclient %llu: %llu chunks in %llu bytes (%.0f each), %llu changes in %llu bytes\n", client->p_id, client->p_chunks_sent, client->p_chunk_bytes, client->p_chunks_sent > 0 ? (double)client->p_chunk_bytes / (double)client->p_chunks_sent : 0.0, client->p_changes_sent, client->p_delta_bytes);
+            printf("\tclient %llu: sent %.1f KiB/s, received %.1f KiB/s over %.1f seconds\n", client->p_id, seconds > 0.0 ? ((double)client->p_connection.get_bytes_sent() / 1024.0) / seconds : 0.0, seconds > 0.0 ? ((double)client->p_connection.get_bytes_received() / 1024.0) / seconds : 0.0, seconds);
+            client->p_round_trips.print("\tround trip");
+            fflush(stdout);
+        }
+
+        void disconnect(unsigned int slot) {
+            printf("Server: client %llu disconnected\n", m_clients[slot].p_id);
+            print_client(&m_clients[slot]);
+
+            m_clients[slot].p_connection.close_socket();
+            m_client_slots[slot] = false;
+        }
+
+        // returns false when the client broke the protocol
+        bool receive(server_client* client) {
+            unsigned char* body;
+            unsigned char* input;
+            unsigned long long length;
+            unsigned int hello[3];
+            long long centre[2];
+            double ping_time;
+            nmt type;
+
+            client->p_connection.fill();
+
+            while ((body = client->p_connection.next_message(&type, &length)) != 0) {
+                input = body;
+
+                if (type == nmt::nmt_hello && length == sizeof(hello)) {
+                    read_bytes(&input, hello, sizeof(hello));
+
+                    if (hello[0] != network_protocol_version || hello[1] == 0 || hello[2] == 0 || (long long)(hello[1] * hello[2]) > max_client_view_chunks) {
+                        printf("Server: client %llu sent an unusable hello, protocol %u with a %u by %u window\n", client->p_id, hello[0], hello[1], hello[2]);
+                        fflush(stdout);
+
+                        return false;
+                    }
+
+                    client->p_held.initialize(hello[1], hello[2]);
+                    client->p_greeted = true;
+                } else if (type == nmt::nmt_position && length == (sizeof(float) * 3) + sizeof(centre) && client->p_greeted) {
+                    read_bytes(&input, client->p_position, sizeof(float) * 3);
+                    read_bytes(&input, centre, sizeof(centre));
+                    client->p_held.recentre(centre[0], centre[1]);
+                } else if (type == nmt::nmt_pong && length == sizeof(ping_time)) {
+                    read_bytes(&input, &ping_time, sizeof(ping_time));
+
+                    if (ping_time == client->p_ping_sent_at) {
+                        client->p_round_trips.record(get_seconds() - ping_time);
+                        client->p_ping_sent_at = -1.0;
+                    }
+                }
+            }
+
+            return client->p_connection.is_open();
+        }
+
+        // one message per batch of up to max_delta_message_size, only changes in chunks the client holds are sent
+        void send_deltas(server_client* client) {
+            unsigned char* body = 0;
+            unsigned char* output = 0;
+            unsigned char* count_position = 0;
+            unsigned short count = 0;
+            int chunk[3];
+            unsigned short block;
+            unsigned char fluid;
+            server_change* change;
+            server_change* group = 0;
+
+            for (unsigned long long i = 0; i < m_change_count; i++) {
+                change = &m_changes[i];
+
+                if (!client->p_held.is_held(change->x, change->y) || m_world.get_chunk(change->x, change->y, change->z) == 0) {
+                    continue;
+                }
+
+                // a new message once this one is full
+                if (body != 0 && (unsigned long long)(output - body) + delta_group_size + delta_change_size > max_delta_message_size) {
+                    memcpy(count_position, &count, sizeof(count));
+                    client->p_connection.end_message(output - body);
+                    client->p_delta_bytes += (output - body) + message_header_size;
+                    client->p_budget -= (double)((output - body) + message_header_size);
+                    body = 0;
+                }
+                if (body == 0) {
+                    body = client->p_connection.begin_message(nmt::nmt_deltas, max_delta_message_size);
+
+                    // the client is too far behind for deltas, it gets the chunk again once it catches up
+                    if (body == 0) {
+                        client->p_held.forget(change->x, change->y);
+                        continue;
+                    }
+
+                    output = body;
+                    group = 0;
+                }
+
+                // a new group for each chunk, changes are sorted so a chunk's changes sit together
+                if (group == 0 || group->x != change->x || group->y != change->y || group->z != change->z) {
+                    if (group != 0) {
+                        memcpy(count_position, &count, sizeof(count));
+                    }
+
+                    chunk[0] = (int)change->x;
+                    chunk[1] = (int)change->y;
+                    chunk[2] = (int)change->z;
+                    count = 0;
+                    group = change;
+                    write_bytes(&output, chunk, sizeof(chunk));
+                    count_position = output;
+                    write_bytes(&output, &count, sizeof(count));
+                }
+
+                block = m_world.get_block_at((change->x * 8) + (change->index & 7), (change->y * 8) + ((change->index >> 3) & 7), (change->z * 8) + (change->index >> 6));
+                fluid = m_world.get_fluid_at((change->x * 8) + (change->index & 7), (change->y * 8) + ((change->index >> 3) & 7), (change->z * 8) + (change->index >> 6));
+                write_bytes(&output, &change->index, sizeof(change->index));
+                write_bytes(&output, &block, sizeof(block));
+                write_bytes(&output, &fluid, sizeof(fluid));
+                count++;
+                client->p_changes_sent++;
+            }
+
+            if (body != 0) {
+                memcpy(count_position, &count, sizeof(count));
+                client->p_connection.end_message(output - body);
+                client->p_delta_bytes += (output - body) + message_header_size;
+                client->p_budget -= (double)((output - body) + message_header_size);
+            }
+        }
+
+        // whole chunks the client does not hold yet, nearest first, until the budget runs out or its socket backs up
+        void stream_chunks(server_client* client) {
+            unsigned long long candidate_count = 0;
+            unsigned long long length;
+            unsigned char* body;
+            unsigned char* output;
+            int chunk[3];
+            long long x, y;
+            float dx, dy;
+            bool sent;
+
+            for (long long i = 0; i < client->p_held.get_width(); i++) {
+                for (long long j = 0; j < client->p_held.get_length(); j++) {
+                    x = client->p_held.get_origin_x() + i;
+                    y = client->p_held.get_origin_y() + j;
+
+                    if (client->p_held.is_held(x, y) || m_world.get_chunk(x, y, 0) == 0) {
+                        continue;
+                    }
+
+                    dx = ((float)x * 8.0f) + 4.0f - client->p_position[0];
+                    dy = ((float)y * 8.0f) + 4.0f - client->p_position[1];
+                    m_candidates[candidate_count].distance = (dx * dx) + (dy * dy);
+                    m_candidates[candidate_count].x = x;
+                    m_candidates[candidate_count].y = y;
+                    candidate_count++;
+                }
+            }
+
+            std::sort(m_candidates, m_candidates + candidate_count);
+
+            for (unsigned long long i = 0; i < candidate_count && client->p_budget > 0.0 && client->p_connection.get_pending() < max_pending_stream_bytes; i++) {
+                sent = true;
+
+                for (long long z = 0; z < m_world.get_height() && sent; z++) {
+                    body = client->p_connection.begin_message(nmt::nmt_chunk, sizeof(chunk) + compressed_chunk_capacity);
+                    if (body == 0) {
+                        sent = false;
+                        break;
+                    }
+
+                    chunk[0] = (int)m_candidates[i].x;
+                    chunk[1] = (int)m_candidates[i].y;
+                    chunk[2] = (int)z;
+                    output = body;
+                    write_bytes(&output, chunk, sizeof(chunk));
+                    length = sizeof(chunk) + compress_chunk(m_world.get_chunk(chunk[0], chunk[1], chunk[2]), output);
+                    client->p_connection.end_message(length);
+
+                    client->p_chunk_bytes += length + message_header_size;
+                    client->p_budget -= (double)(length + message_header_size);
+                }
+
+                if (sent) {
+                    client->p_held.hold(m_candidates[i].x, m_candidates[i].y);
+                    client->p_chunks_sent++;
+                }
+            }
+        }
+
+        void ping(server_client* client) {
+            unsigned char* body;
+            double now;
+
+            if (client->p_ping_sent_at >= 0.0 || m_tick_count % ping_interval_ticks != 0) {
+                return;
+            }
+
+            body = client->p_connection.begin_message(nmt::nmt_ping, sizeof(now));
+            if (body != 0) {
+                now = get_seconds();
+                memcpy(body, &now, sizeof(now));
+                client->p_connection.end_message(sizeof(now));
+                client->p_ping_sent_at = now;
+            }
+        }
+
+        void replicate() {
+            server_client* client;
+            unsigned long long unique = 0;
+
+            // duplicates of a block are dropped, what is sent is read from the world anyway
+            std::sort(m_changes, m_changes + m_change_count);
+            for (unsigned long long i = 0; i < m_change_count; i++) {
+                if (unique == 0 || m_changes[unique - 1] < m_changes[i]) {
+                    m_changes[unique] = m_changes[i];
+                    unique++;
+                }
+            }
+            m_change_count = unique;
+
+            for (unsigned int i = 0; i < max_server_clients; i++) {
+                if (!m_client_slots[i] || !m_clients[i].p_greeted) {
+                    continue;
+                }
+                client = &m_clients[i];
+
+                // the budget may only bank a second's worth
+                client->p_budget += m_bytes_per_second / m_tick_rate;
+                if (client->p_budget > m_bytes_per_second) {
+                    client->p_budget = m_bytes_per_second;
+                }
+
+                if (m_all_stale) {
+                    client->p_held.initialize(client->p_held.get_width(), client->p_held.get_length());
+                }
+                for (unsigned long long j = 0; j < m_stale_count; j++) {
+                    client->p_held.forget(m_stale[j].x, m_stale[j].y);
+                }
+
+                send_deltas(client);
+                stream_chunks(client);
+                ping(client);
+
+                if (!client->p_connection.flush()) {
+                    disconnect(i);
+                }
+            }
+
+            m_change_count = 0;
+            m_stale_count = 0;
+            m_all_stale = false;
+        }
+
+        // the server window follows the first client that said hello
+        bool follow_clients() {
+            bool output = true;
+
+            for (unsigned int i = 0; i < max_server_clients; i++) {
+                if (m_client_slots[i] && m_clients[i].p_greeted) {
+                    m_generator.set_camera(m_clients[i].p_position[0], m_clients[i].p_position[1]);
+
+                    m_recentring = true;
+                    output = m_world.recentre(&m_chunk_pool, &m_cold_chunks, (long long)floorf(m_clients[i].p_position[0] / 8.0f), (long long)floorf(m_clients[i].p_position[1] / 8.0f));
+                    m_recentring = false;
+
+                    break;
+                }
+            }
+
+            return output;
+        }
+
+    public:
+        // listens on loopback only, port 0 picks a free port
+        et initialize(unsigned short port) {
+            sockaddr_in address;
+            socklen_t address_length = sizeof(address);
+            int enable = 1;
+
+            m_tick_count = 0;
+            m_change_count = 0;
+            m_stale_count = 0;
+            m_all_stale = false;
+            m_recentring = false;
+            for (unsigned int i = 0; i < max_server_clients; i++) {
+                m_client_slots[i] = false;
+            }
+
+            // the same world the game starts with, around the same spawn
+            m_workers.initialize(0);
+            m_generator.initialize(&m_chunk_pool, &m_workers, (server_view_size / 2) + 1, 1);
+            m_generator.set_camera(32.0f, 32.0f);
+            m_chunk_pool.initialize((server_view_size * server_view_size) + m_generator.get_chunk_capacity(), mtt::mtt_chunks);
+            m_generator.finish_view();
+            if (!m_world.initialize(&m_chunk_pool, &m_generator, server_view_size, server_view_size, 1)) {
+                return et::et_error_unknown;
+            }
+            m_cold_chunks.initialize(16 * 1024 * 1024, (16 * 1024 * 1024) / 256);
+            m_lighting.initialize(&m_world);
+            m_lighting.light_world();
+            m_ticks.initialize(&m_world, &m_lighting, &m_workers);
+            m_fluids.initialize(&m_world, &m_workers);
+
+            m_changes = new server_change[server_change_capacity];
+            m_stale = new server_change[server_change_capacity];
+            m_world.add_block_listener(on_block_changed, this);
+            m_world.add_fluid_listener(on_fluid_changed, this);
+            m_world.add_region_listener(on_region_changed, this);
+
+            memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            m_listener = socket(AF_INET, SOCK_STREAM, 0);
+            if (m_listener < 0) {
+                printf("Error: could not create the server socket!\n");
+                fflush(stdout);
+                return et::et_could_not_start_server;
+            }
+            setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            if (bind(m_listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(m_listener, max_server_clients) != 0 || getsockname(m_listener, (sockaddr*)&address, &address_length) != 0) {
+                printf("Error: could not listen on port %u!\n", port);
+                fflush(stdout);
+                return et::et_could_not_start_server;
+            }
+            fcntl(m_listener, F_SETFL, fcntl(m_listener, F_GETFL, 0) | O_NONBLOCK);
+            m_port = ntohs(address.sin_port);
+
+            return et::et_no_error;
+        }
+
+        // bytes per second each client may be sent, chunks wait when it is used up
+        void set_bandwidth(double bytes_per_second) {
+            m_bytes_per_second = bytes_per_second;
+        }
+
+        unsigned short get_port() {
+            return m_port;
+        }
+
+        // the server's own edits, replicated to every client like the ones ticks make
+        void set_block_at(long long x, long long y, long long z, unsigned short value) {
+            if (m_world.contains_block(x, y, z)) {
+                m_lighting.set_block_at(x, y, z, value);
+            }
+        }
+
+        world* get_world() {
+            return &m_world;
+        }
+
+        // one simulation tick: take in clients and their messages, simulate, then send every client what changed and what it is missing
+        et tick() {
+            accept_clients();
+
+            for (unsigned int i = 0; i < max_server_clients; i++) {
+                if (m_client_slots[i] && !receive(&m_clients[i])) {
+                    disconnect(i);
+                }
+            }
+
+            if (!follow_clients()) {
+                return et::et_error_unknown;
+            }
+            m_generator.update();
+
+            m_ticks.tick();
+            m_fluids.tick();
+
+            replicate();
+            m_tick_count++;
+
+            return et::et_no_error;
+        }
+
+        // tick at the game's rate until ticks have run or the process is interrupted, 0 runs until interrupted
+        et run(unsigned long long ticks) {
+            frame_limiter limiter = frame_limiter();
+            et error = et::et_no_error;
+
+            signal(SIGINT, [](int) { g_server_stop = 1; });
+            signal(SIGTERM, [](int) { g_server_stop = 1; });
+
+            printf("Server: listening on 127.0.0.1:%u\n", m_port);
+            fflush(stdout);
+
+            limiter.initialize(m_tick_rate);
+            while (!g_server_stop && (ticks == 0 || m_tick_count < ticks) && error == et::et_no_error) {
+                error = tick();
+                limiter.wait();
+            }
+
+            return error;
+        }
+
+        unsigned long long get_tick_count() {
+            return m_tick_count;
+        }
+
+        void print() {
+            printf("Server: %llu ticks\n", m_tick_count);
+            for (unsigned int i = 0; i < max_server_clients; i++) {
+                if (m_client_slots[i]) {
+                    print_client(&m_clients[i]);
+                }
+            }
+            fflush(stdout);
+            m_generator.print();
+        }
+
+        void uninitialize() {
+            for (unsigned int i = 0; i < max_server_clients; i++) {
+                m_clients[i].p_connection.uninitialize();
+                m_client_slots[i] = false;
+            }
+            if (m_listener != -1) {
+                close(m_listener);
+            }
+            m_listener = -1;
+
+            m_world.remove_block_listener(on_block_changed, this);
+            m_world.remove_fluid_listener(on_fluid_changed, this);
+            m_world.remove_region_listener(on_region_changed, this);
+            delete[] m_changes;
+            delete[] m_stale;
+            m_changes = 0;
+            m_stale = 0;
+
+            m_fluids.uninitialize();
+            m_ticks.uninitialize();
+            m_lighting.uninitialize();
+            m_world.uninitialize(&m_chunk_pool);
+            m_generator.uninitialize();
+            m_workers.uninitialize();
+            m_cold_chunks.uninitialize();
+            m_chunk_pool.uninitialize();
+        }
+    };
+}
@@ -1,31 +1,206 @@
 #pragma once
 
-#include "types.hpp"
+#include "biomes.hpp"
 
 namespace abradinjapan::voxelize {
-    chunk_888* generate_chunk(long long x, long long y, long long z) {
-        chunk_888* output = new chunk_888();
-        unsigned short height;
-        float value_1, value_2;
+    // one column in this many grows a tree
+    const unsigned long long tree_chance = 48;
+
+    // how far a tree's leaves reach from its trunk
+    const long long tree_reach = 2;
+
+    // the same column and seed always give the same number
+    unsigned long long get_column_hash(long long x, long long y, unsigned long long seed) {
+        unsigned long long output = seed ^ ((unsigned long long)x * 0x9E3779B97F4A7C15ull) ^ ((unsigned long long)y * 0xC2B2AE3D27D4EB4Full);
+
+        output = (output ^ (output >> 30)) * 0xBF58476D1CE4E5B9ull;
+        output = (output ^ (output >> 27)) * 0x94D049BB133111EBull;
+
+        return output ^ (output >> 31);
+    }
+
+    // the rolling shape every biome shares, scaled by each biome's height range, from -1 to 1
+    float get_terrain_detail(long long x, long long) {
+        return (float)sin(2 * 3.14159 + (x & 7));
+    }
+
+    // the surface biome of a column, the weights give the odds so biomes fade into each other instead of meeting at a line
+    unsigned int pick_biome(float* weights, long long x, long long y, unsigned long long seed) {
+        float roll = (float)(get_column_hash(x, y, seed ^ 0x5BD1E995ull) & 0xFFFF) / 65536.0f;
+
+        for (unsigned int i = 0; i + 1 < bmt_count; i++) {
+            if (roll < weights[i]) {
+                return i;
+            }
+
+            roll -= weights[i];
+        }
+
+        return bmt_count - 1;
+    }
+
+    // one block column, the biome's surface on top of a few layers of its filler, stone underneath
+    // height is the first air block above the ground
+    void fill_terrain_column(chunk_888* output, unsigned int i, unsigned int j, long long z, long long height, unsigned int column_biome) {
+        long long block_z;
+        unsigned short block;
+
+        for (unsigned int k = 0; k < 8; k++) {
+            block_z = (z * 8) + k;
+
+            // picked without branching, heights change from column to column near borders
+            block = block_z + 3 >= height ? biomes[column_biome].filler_block : (unsigned short)bt::bt_stone;
+            block = block_z + 1 == height ? biomes[column_biome].surface_block : block;
+            block = block_z >= height ? (unsigned short)bt::bt_air : block;
+
+            output->set_block_at(i, j, k, block);
+        }
+    }
+
+    // there is always some ground
+    long long get_blended_height(biome_blend* blend, long long x, long long y) {
+        long long output = (long long)(blend->base_height + (blend->height_range * get_terrain_detail(x, y)));
+
+        return output < 1 ? 1 : output;
+    }
+
+    // biomes are weighed at the climate samples only, each block column interpolates the weights and the blended height between them
+    void generate_terrain(chunk_888* output, climate_map* climates, long long x, long long y, long long z) {
+        biome_blend blends[9];
+        biome_blend line[3];
+        biome_blend column;
+        unsigned int column_biome;
+        bool single = true;
+
+        climates->get_chunk_blends(x, y, blends);
+
+        // away from borders every sample is wholly one biome, then there is nothing to interpolate or pick
+        column_biome = pick_biome(blends[0].weights, x * 8, y * 8, climates->get_seed());
+        for (unsigned int i = 0; i < 9 && single; i++) {
+            single = blends[i].weights[column_biome] == 1.0f;
+        }
+
+        if (single) {
+            for (unsigned int i = 0; i < 8; i++) {
+                for (unsigned int j = 0; j < 8; j++) {
+                    fill_terrain_column(output, i, j, z, get_blended_height(&blends[0], (x * 8) + i, (y * 8) + j), column_biome);
+                }
+            }
+
+            return;
+        }
 
         for (unsigned int i = 0; i < 8; i++) {
+            // bilinear in two steps, along x once for the whole line of columns then along y for each
+            for (unsigned int row = 0; row < 3; row++) {
+                mix_biome_blends(&blends[(i / climate_spacing) + (row * 3)], &blends[(i / climate_spacing) + 1 + (row * 3)], (float)(i % climate_spacing) / (float)climate_spacing, &line[row]);
+            }
+
             for (unsigned int j = 0; j < 8; j++) {
-                value_1 = (4.0f * sin(2 * 3.14159 + i) + 4.0f);
+                mix_biome_blends(&line[j / climate_spacing], &line[(j / climate_spacing) + 1], (float)(j % climate_spacing) / (float)climate_spacing, &column);
+                column_biome = pick_biome(column.weights, (x * 8) + i, (y * 8) + j, climates->get_seed());
 
-                //printf("%f / %f\n", value_1, value_2);
+                fill_terrain_column(output, i, j, z, get_blended_height(&column, (x * 8) + i, (y * 8) + j), column_biome);
+            }
+        }
+    }
 
-                height = (unsigned short)value_1;
+    // terrain alone in one pass, see generation_pipeline for the rest of the stages
+    // nothing is cached between calls so every climate sample is taken directly, with the default seed
+    // returns 0 when the chunk pool is full
+    chunk_888* generate_chunk(slab_pool<chunk_888>* pool, long long x, long long y, long long z) {
+        chunk_888* output = pool->allocate();
+        climate_map climates = climate_map();
 
-                for (unsigned short k = 0; k < height; k++) {
-                    output->set_block_at(i, j, k, 1);
-                }
+        if (output == 0) {
+            return 0;
+        }
+
+        generate_terrain(output, &climates, x, y, z);
+
+        return output;
+    }
 
-                for (unsigned short k = height; k < 8; k++) {
-                    output->set_block_at(i, j, k, 0);
+    // caves wherever 3d noise runs high, the noise is continuous so caves carry on across chunk borders by themselves
+    // the bottom layer of the world is never carved so nothing can fall out of it
+    void carve_caves(chunk_888* output, long long x, long long y, long long z) {
+        for (unsigned int i = 0; i < 8; i++) {
+            for (unsigned int j = 0; j < 8; j++) {
+                for (unsigned int k = 0; k < 8; k++) {
+                    if ((z * 8) + k == 0 || output->get_block_at(i, j, k) == bt::bt_air) {
+                        continue;
+                    }
+
+                    if (glm::simplex(glm::vec3((float)((x * 8) + i), (float)((y * 8) + j), (float)((z * 8) + k)) * 0.09f) > 0.45f) {
+                        output->set_block_at(i, j, k, bt::bt_air);
+                    }
                 }
             }
         }
+    }
+
+    // what a tree puts at an offset from the block just above its root, air for nothing
+    unsigned short get_tree_block(long long dx, long long dy, long long dz) {
+        long long distance_x = dx < 0 ? -dx : dx;
+        long long distance_y = dy < 0 ? -dy : dy;
+
+        // trunk
+        if (distance_x == 0 && distance_y == 0 && dz < 4) {
+            return bt::bt_log;
+        }
 
-        return output;
+        // two wide layers of leaves without their corners, then a small cap
+        if (dz == 2 || dz == 3) {
+            return (distance_x == tree_reach && distance_y == tree_reach) ? bt::bt_air : bt::bt_leaves;
+        }
+        if (dz == 4) {
+            return distance_x + distance_y <= 1 ? bt::bt_leaves : bt::bt_air;
+        }
+
+        return bt::bt_air;
+    }
+
+    // answers for a block column near the chunk being decorated, false when it is not known
+    typedef bool (*surface_lookup)(void* context, long long x, long long y, long long* height, unsigned short* block);
+
+    // place the parts of every tree close enough to reach into the chunk, including trees rooted in the chunks around it
+    // trees only ever fill air, and are placed in a fixed order, so the result does not depend on which chunk got here first
+    void place_trees(chunk_888* output, long long x, long long y, long long z, unsigned long long seed, surface_lookup lookup, void* context) {
+        long long height, block_x, block_y, block_z;
+        unsigned short block;
+
+        for (long long tree_x = (x * 8) - tree_reach; tree_x < (x * 8) + 8 + tree_reach; tree_x++) {
+            for (long long tree_y = (y * 8) - tree_reach; tree_y < (y * 8) + 8 + tree_reach; tree_y++) {
+                if (get_column_hash(tree_x, tree_y, seed) % tree_chance != 0) {
+                    continue;
+                }
+                if (!lookup(context, tree_x, tree_y, &height, &block) || block != bt::bt_grass) {
+                    continue;
+                }
+
+                for (long long dz = 0; dz <= 4; dz++) {
+                    block_z = height + 1 + dz;
+                    if (block_z < z * 8 || block_z >= (z * 8) + 8) {
+                        continue;
+                    }
+
+                    for (long long dx = -tree_reach; dx <= tree_reach; dx++) {
+                        for (long long dy = -tree_reach; dy <= tree_reach; dy++) {
+                            block_x = tree_x + dx;
+                            block_y = tree_y + dy;
+                            block = get_tree_block(dx, dy, dz);
+
+                            if (block == bt::bt_air || block_x < x * 8 || block_y < y * 8 || block_x >= (x * 8) + 8 || block_y >= (y * 8) + 8) {
+                                continue;
+                            }
+
+                            if (output->get_block_at(block_x & 7, block_y & 7, block_z & 7) == bt::bt_air) {
+                                output->set_block_at(block_x & 7, block_y & 7, block_z & 7, block);
+                            }
+                        }
+                    }
+                }
+            }
+        }
     }
-}
\ No newline at end of file
+}
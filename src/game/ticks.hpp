@@ -0,0 +1,571 @@
+#pragma once
+
+#include "lighting.hpp"
+#include "workers.hpp"
+
+namespace abradinjapan::voxelize {
+    // ticks between a block losing its support and a sand block above it falling
+    const unsigned int sand_fall_delay = 2;
+
+    // slots on the timing wheel, delays longer than this wait out whole turns of the wheel
+    const unsigned int timing_wheel_length = 256;
+
+    // splitmix64, cheap enough to seed fresh for every chunk on every tick
+    unsigned long long next_random(unsigned long long* state) {
+        unsigned long long output = (*state += 0x9E3779B97F4A7C15ull);
+
+        output = (output ^ (output >> 30)) * 0xBF58476D1CE4E5B9ull;
+        output = (output ^ (output >> 27)) * 0x94D049BB133111EBull;
+
+        return output ^ (output >> 31);
+    }
+
+    // one block change asked for by a tick, only applied if the block still holds the expected value
+    struct block_edit {
+        int x, y, z;
+        unsigned short expected;
+        unsigned short value;
+    };
+
+    // growable list of block edits
+    class block_edit_queue {
+        block_edit* m_edits = 0;
+        unsigned long long m_capacity = 0;
+        unsigned long long m_count = 0;
+
+    public:
+        void initialize(unsigned long long capacity) {
+            m_edits = new block_edit[capacity];
+            m_capacity = capacity;
+            m_count = 0;
+        }
+
+        void push(long long x, long long y, long long z, unsigned short expected, unsigned short value) {
+            block_edit* edits;
+
+            if (m_count == m_capacity) {
+                edits = new block_edit[m_capacity * 2];
+
+                for (unsigned long long i = 0; i < m_count; i++) {
+                    edits[i] = m_edits[i];
+                }
+
+                delete[] m_edits;
+
+                m_edits = edits;
+                m_capacity *= 2;
+            }
+
+            m_edits[m_count] = { (int)x, (int)y, (int)z, expected, value };
+            m_count++;
+        }
+
+        block_edit* get(unsigned long long index) {
+            return &m_edits[index];
+        }
+
+        unsigned long long get_count() {
+            return m_count;
+        }
+
+        void clear() {
+            m_count = 0;
+        }
+
+        void uninitialize() {
+            delete[] m_edits;
+
+            m_edits = 0;
+            m_capacity = 0;
+            m_count = 0;
+        }
+    };
+
+    // the randomly ticking blocks of one chunk
+    // the local indices and block types sit in separate arrays so sampling never touches the chunk itself
+    class active_block_list {
+        unsigned short m_indices[512];
+        unsigned short m_types[512];
+        short m_slots[512]; // where each local index sits in the lists, -1 when it is not active
+        unsigned short m_count = 0;
+
+    public:
+        void initialize() {
+            m_count = 0;
+
+            for (unsigned int i = 0; i < 512; i++) {
+                m_slots[i] = -1;
+            }
+        }
+
+        // add, retype or remove a block depending on whether its new type ticks
+        void set(unsigned short index, unsigned short type) {
+            short slot = m_slots[index];
+
+            if (is_random_ticking(type)) {
+                if (slot == -1) {
+                    m_slots[index] = (short)m_count;
+                    m_indices[m_count] = index;
+                    m_types[m_count] = type;
+                    m_count++;
+                } else {
+                    m_types[slot] = type;
+                }
+            } else if (slot != -1) {
+                // swap the last entry into the hole
+                m_count--;
+                m_indices[slot] = m_indices[m_count];
+                m_types[slot] = m_types[m_count];
+                m_slots[m_indices[slot]] = slot;
+                m_slots[index] = -1;
+            }
+        }
+
+        unsigned short get_index(unsigned short slot) {
+            return m_indices[slot];
+        }
+
+        unsigned short get_type(unsigned short slot) {
+            return m_types[slot];
+        }
+
+        unsigned short get_count() {
+            return m_count;
+        }
+    };
+
+    // one delayed tick waiting on the timing wheel
+    struct scheduled_tick {
+        int x, y, z;
+        unsigned int rounds; // full turns of the wheel left before it fires
+        long long next; // next entry in the same slot or the free list, -1 ends the list
+    };
+
+    // delayed ticks bucketed by the tick they fire on, scheduling and firing are both constant time
+    class timing_wheel {
+        scheduled_tick* m_entries = 0;
+        unsigned long long m_capacity = 0;
+        long long m_free = -1;
+        long long m_slots[timing_wheel_length];
+        unsigned int m_current = 0;
+        unsigned long long m_count = 0;
+
+        void grow(unsigned long long capacity) {
+            scheduled_tick* entries = new scheduled_tick[capacity];
+
+            for (unsigned long long i = 0; i < m_capacity; i++) {
+                entries[i] = m_entries[i];
+            }
+
+            // new entries go onto the free list
+            for (unsigned long long i = m_capacity; i < capacity; i++) {
+                entries[i].next = (i + 1 < capacity) ? (long long)(i + 1) : m_free;
+            }
+            m_free = (long long)m_capacity;
+
+            delete[] m_entries;
+
+            m_entries = entries;
+            m_capacity = capacity;
+        }
+
+    public:
+        void initialize(unsigned long long capacity) {
+            m_capacity = 0;
+            m_free = -1;
+            m_current = 0;
+            m_count = 0;
+
+            for (unsigned int i = 0; i < timing_wheel_length; i++) {
+                m_slots[i] = -1;
+            }
+
+            grow(capacity);
+        }
+
+        // a delay of 0 still waits for the next tick
+        void schedule(long long x, long long y, long long z, unsigned int delay) {
+            long long entry;
+            unsigned int slot;
+
+            if (delay == 0) {
+                delay = 1;
+            }
+
+            if (m_free == -1) {
+                grow(m_capacity * 2);
+            }
+
+            entry = m_free;
+            m_free = m_entries[entry].next;
+
+            slot = (m_current + delay) % timing_wheel_length;
+            m_entries[entry].x = (int)x;
+            m_entries[entry].y = (int)y;
+            m_entries[entry].z = (int)z;
+            m_entries[entry].rounds = (delay - 1) / timing_wheel_length;
+            m_entries[entry].next = m_slots[slot];
+            m_slots[slot] = entry;
+            m_count++;
+        }
+
+        // step one tick forward and hand every tick that is due to the output queue
+        void advance(block_edit_queue* due) {
+            long long entry;
+            long long next;
+            long long* link;
+
+            m_current = (m_current + 1) % timing_wheel_length;
+            link = &m_slots[m_current];
+            entry = *link;
+
+            while (entry != -1) {
+                next = m_entries[entry].next;
+
+                if (m_entries[entry].rounds > 0) {
+                    // not this turn
+                    m_entries[entry].rounds--;
+                    link = &m_entries[entry].next;
+                } else {
+                    due->push(m_entries[entry].x, m_entries[entry].y, m_entries[entry].z, 0, 0);
+
+                    *link = next;
+                    m_entries[entry].next = m_free;
+                    m_free = entry;
+                    m_count--;
+                }
+
+                entry = next;
+            }
+        }
+
+        unsigned long long get_count() {
+            return m_count;
+        }
+
+        void uninitialize() {
+            delete[] m_entries;
+
+            m_entries = 0;
+            m_capacity = 0;
+            m_free = -1;
+            m_count = 0;
+        }
+    };
+
+    // what a randomly picked block does, it may only read the world and queue edits
+    void random_tick_block(world* w, block_edit_queue* edits, long long x, long long y, long long z, unsigned short type, unsigned long long* random) {
+        long long target_x, target_y, target_z;
+        unsigned long long pick;
+
+        if (type == bt::bt_grass) {
+            // smothered grass dies back to dirt
+            if (w->contains_block(x, y, z + 1) && w->get_block_at(x, y, z + 1) != bt::bt_air) {
+                edits->push(x, y, z, bt::bt_grass, bt::bt_dirt);
+
+                return;
+            }
+
+            // spread to one nearby uncovered dirt block
+            pick = next_random(random) % 27;
+            target_x = x + (long long)(pick % 3) - 1;
+            target_y = y + (long long)((pick / 3) % 3) - 1;
+            target_z = z + (long long)(pick / 9) - 1;
+
+            if (w->contains_block(target_x, target_y, target_z) && w->get_block_at(target_x, target_y, target_z) == bt::bt_dirt && (!w->contains_block(target_x, target_y, target_z + 1) || w->get_block_at(target_x, target_y, target_z + 1) == bt::bt_air)) {
+                edits->push(target_x, target_y, target_z, bt::bt_dirt, bt::bt_grass);
+            }
+        }
+    }
+
+    // what a block does when its delayed tick comes up, same rules as random_tick_block
+    void scheduled_tick_block(world* w, block_edit_queue* edits, long long x, long long y, long long z) {
+        if (!w->contains_block(x, y, z)) {
+            return;
+        }
+
+        // unsupported sand falls one block, landing schedules the next fall
+        if (w->get_block_at(x, y, z) == bt::bt_sand && z > 0 && w->get_block_at(x, y, z - 1) == bt::bt_air) {
+            edits->push(x, y, z - 1, bt::bt_air, bt::bt_sand);
+            edits->push(x, y, z, bt::bt_sand, bt::bt_air);
+        }
+    }
+
+    // runs block updates once per game tick
+    // random ticks only ever sample the active blocks of chunks that have some, and delayed ticks sit on a timing wheel, so the cost follows what is changing rather than how much is loaded
+    // chunks tick in parallel against a world that nobody writes to, each worker queues its edits and the queues are applied in chunk order afterwards
+    // an edit whose block changed since it was queued is dropped, so two chunks reaching across their shared border can never clobber each other
+    class tick_scheduler {
+        world* m_world = 0;
+        light_engine* m_lighting = 0;
+        worker_pool* m_workers = 0;
+        active_block_list* m_lists = 0; // one per world chunk slot
+        long long* m_active_chunks = 0; // chunks with at least one active block
+        long long* m_active_chunk_slots = 0; // where each chunk sits in m_active_chunks, -1 when absent
+        long long m_active_chunk_count = 0;
+        unsigned long long m_active_block_count = 0;
+        block_edit_queue* m_edit_queues = 0; // one per partition
+        unsigned int m_partition_count = 0;
+        block_edit_queue m_due_ticks;
+        timing_wheel m_wheel;
+        unsigned long long m_seed = 1;
+        unsigned long long m_tick_count = 0;
+        float m_random_tick_chance = 3.0f / 512.0f;
+        unsigned long long m_edits_applied = 0;
+
+        // keep the active lists and the wheel in step with every block change, whoever made it
+        static void on_block_changed(void* context, long long x, long long y, long long z, unsigned short old_value, unsigned short new_value) {
+            tick_scheduler* ticks = (tick_scheduler*)context;
+            world* w = ticks->m_world;
+
+            ticks->track_block(x, y, z, new_value);
+
+            // sand reacts to being placed and to losing what held it up
+            if (new_value == bt::bt_sand) {
+                ticks->m_wheel.schedule(x, y, z, sand_fall_delay);
+            }
+            if (new_value == bt::bt_air && old_value != bt::bt_air && w->contains_block(x, y, z + 1) && w->get_block_at(x, y, z + 1) == bt::bt_sand) {
+                ticks->m_wheel.schedule(x, y, z + 1, sand_fall_delay);
+            }
+        }
+
+        // bulk edits do not say what changed, so the whole box is looked at again
+        static void on_region_changed(void* context, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            tick_scheduler* ticks = (tick_scheduler*)context;
+            world* w = ticks->m_world;
+            unsigned short block;
+
+            for (long long x = x1; x <= x2; x++) {
+                for (long long y = y1; y <= y2; y++) {
+                    for (long long z = z1; z <= z2 + 1 && z < w->get_height() * 8; z++) {
+                        block = w->get_block_at(x, y, z);
+
+                        if (z <= z2) {
+                            ticks->track_block(x, y, z, block);
+                        }
+
+                        // any sand in or just above the box may have lost its support
+                        if (block == bt::bt_sand) {
+                            ticks->m_wheel.schedule(x, y, z, sand_fall_delay);
+                        }
+                    }
+                }
+            }
+        }
+
+        void track_block(long long x, long long y, long long z, unsigned short value) {
+            long long chunk = m_world->get_chunk_slot(x >> 3, y >> 3, z >> 3);
+            active_block_list* list = &m_lists[chunk];
+            unsigned short count = list->get_count();
+
+            list->set((unsigned short)((x & 7) + ((y & 7) * 8) + ((z & 7) * 64)), value);
+            m_active_block_count += list->get_count();
+            m_active_block_count -= count;
+
+            // chunk gained or lost its last active block
+            if (count == 0 && list->get_count() > 0) {
+                add_active_chunk(chunk);
+            } else if (count > 0 && list->get_count() == 0) {
+                remove_active_chunk(chunk);
+            }
+        }
+
+        static void tick_partition_job(void* context, unsigned long long index) {
+            ((tick_scheduler*)context)->tick_partition((unsigned int)index);
+        }
+
+        void add_active_chunk(long long chunk) {
+            m_active_chunk_slots[chunk] = m_active_chunk_count;
+            m_active_chunks[m_active_chunk_count] = chunk;
+            m_active_chunk_count++;
+        }
+
+        void remove_active_chunk(long long chunk) {
+            long long slot = m_active_chunk_slots[chunk];
+
+            m_active_chunk_count--;
+            m_active_chunks[slot] = m_active_chunks[m_active_chunk_count];
+            m_active_chunk_slots[m_active_chunks[slot]] = slot;
+            m_active_chunk_slots[chunk] = -1;
+        }
+
+        // sample random ticks for one contiguous share of the active chunks
+        void tick_partition(unsigned int partition) {
+            block_edit_queue* edits = &m_edit_queues[partition];
+            long long first = (m_active_chunk_count * partition) / m_partition_count;
+            long long last = (m_active_chunk_count * (partition + 1)) / m_partition_count;
+            active_block_list* list;
+            unsigned long long random;
+            unsigned long long samples;
+            float expected;
+            long long chunk, chunk_x, chunk_y, chunk_z;
+            unsigned short slot;
+            unsigned short index;
+
+            edits->clear();
+
+            for (long long i = first; i < last; i++) {
+                chunk = m_active_chunks[i];
+                list = &m_lists[chunk];
+                m_world->get_slot_chunk(chunk, &chunk_x, &chunk_y, &chunk_z);
+
+                // seeded by chunk and tick, so results do not depend on how many threads ran
+                random = m_seed ^ ((unsigned long long)chunk * 0xD1B54A32D192ED03ull) ^ (m_tick_count * 0x9E3779B97F4A7C15ull);
+
+                // each active block has the same chance every tick, the fraction is rounded up at random
+                expected = (float)list->get_count() * m_random_tick_chance;
+                samples = (unsigned long long)expected;
+                if ((float)(next_random(&random) & 0xFFFF) / 65536.0f < expected - (float)samples) {
+                    samples++;
+                }
+
+                for (unsigned long long j = 0; j < samples; j++) {
+                    slot = (unsigned short)(next_random(&random) % list->get_count());
+                    index = list->get_index(slot);
+
+                    random_tick_block(m_world, edits, (chunk_x * 8) + (index & 7), (chunk_y * 8) + ((index >> 3) & 7), (chunk_z * 8) + (index >> 6), list->get_type(slot), &random);
+                }
+            }
+        }
+
+        void apply_edits(block_edit_queue* edits) {
+            block_edit* edit;
+
+            for (unsigned long long i = 0; i < edits->get_count(); i++) {
+                edit = edits->get(i);
+
+                if (m_world->get_block_at(edit->x, edit->y, edit->z) == edit->expected) {
+                    m_lighting->set_block_at(edit->x, edit->y, edit->z, edit->value);
+                    m_edits_applied++;
+                }
+            }
+
+            edits->clear();
+        }
+
+    public:
+        // the world must already be generated, the scheduler listens to its block changes until uninitialized
+        void initialize(world* w, light_engine* lighting, worker_pool* workers) {
+            long long chunk_count = w->get_width() * w->get_length() * w->get_height();
+
+            m_world = w;
+            m_lighting = lighting;
+            m_workers = workers;
+            m_lists = new active_block_list[chunk_count];
+            m_active_chunks = new long long[chunk_count];
+            m_active_chunk_slots = new long long[chunk_count];
+            m_active_chunk_count = 0;
+            m_active_block_count = 0;
+            m_tick_count = 0;
+            m_edits_applied = 0;
+
+            // a few partitions per thread keeps the load even when active chunks cluster
+            m_partition_count = (workers->get_thread_count() + 1) * 4;
+            m_edit_queues = new block_edit_queue[m_partition_count];
+            for (unsigned int i = 0; i < m_partition_count; i++) {
+                m_edit_queues[i].initialize(256);
+            }
+            m_due_ticks.initialize(256);
+            m_wheel.initialize(1024);
+
+            // find the active blocks already in the world
+            for (long long i = 0; i < chunk_count; i++) {
+                m_lists[i].initialize();
+                m_active_chunk_slots[i] = -1;
+            }
+
+            for (long long x = w->get_origin_x() * 8; x < (w->get_origin_x() + w->get_width()) * 8; x++) {
+                for (long long y = w->get_origin_y() * 8; y < (w->get_origin_y() + w->get_length()) * 8; y++) {
+                    for (long long z = 0; z < w->get_height() * 8; z++) {
+                        if (is_random_ticking(w->get_block_at(x, y, z))) {
+                            track_block(x, y, z, w->get_block_at(x, y, z));
+                        }
+                    }
+                }
+            }
+
+            w->add_block_listener(on_block_changed, this);
+            w->add_region_listener(on_region_changed, this);
+        }
+
+        void set_seed(unsigned long long seed) {
+            m_seed = seed;
+        }
+
+        // chance that any one active block is picked on a given tick
+        void set_random_tick_chance(float chance) {
+            m_random_tick_chance = chance;
+        }
+
+        // schedule a delayed tick for the block at a position, in game ticks from now
+        void schedule_tick(long long x, long long y, long long z, unsigned int delay) {
+            m_wheel.schedule(x, y, z, delay);
+        }
+
+        void tick() {
+            m_tick_count++;
+
+            // delayed ticks
+            m_wheel.advance(&m_due_ticks);
+            for (unsigned long long i = 0; i < m_due_ticks.get_count(); i++) {
+                scheduled_tick_block(m_world, &m_edit_queues[0], m_due_ticks.get(i)->x, m_due_ticks.get(i)->y, m_due_ticks.get(i)->z);
+            }
+            m_due_ticks.clear();
+            apply_edits(&m_edit_queues[0]);
+
+            // random ticks
+            if (m_active_chunk_count == 0) {
+                return;
+            }
+
+            m_workers->run(tick_partition_job, this, m_partition_count);
+
+            for (unsigned int i = 0; i < m_partition_count; i++) {
+                apply_edits(&m_edit_queues[i]);
+            }
+        }
+
+        unsigned long long get_active_block_count() {
+            return m_active_block_count;
+        }
+
+        long long get_active_chunk_count() {
+            return m_active_chunk_count;
+        }
+
+        unsigned long long get_scheduled_tick_count() {
+            return m_wheel.get_count();
+        }
+
+        unsigned long long get_edits_applied() {
+            return m_edits_applied;
+        }
+
+        void uninitialize() {
+            if (m_world != 0) {
+                m_world->remove_block_listener(on_block_changed, this);
+                m_world->remove_region_listener(on_region_changed, this);
+            }
+
+            for (unsigned int i = 0; i < m_partition_count; i++) {
+                m_edit_queues[i].uninitialize();
+            }
+            m_due_ticks.uninitialize();
+            m_wheel.uninitialize();
+
+            delete[] m_edit_queues;
+            delete[] m_active_chunk_slots;
+            delete[] m_active_chunks;
+            delete[] m_lists;
+
+            m_edit_queues = 0;
+            m_active_chunk_slots = 0;
+            m_active_chunks = 0;
+            m_lists = 0;
+            m_partition_count = 0;
+            m_world = 0;
+            m_lighting = 0;
+            m_workers = 0;
+        }
+    };
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace abradinjapan::voxelize {
+    // pacing mode type
+    enum pmt {
+        pmt_vsync,
+        pmt_adaptive_sync,
+        pmt_capped,
+        pmt_uncapped
+    };
+
+    // holds frames to a maximum rate, sleeping for most of the wait and spinning for the rest since SDL_Delay can oversleep by a millisecond or two
+    class frame_limiter {
+        double m_frame_seconds = 0.0;
+        double m_spin_seconds = 0.002;
+        double m_next_frame = 0.0;
+
+    public:
+        // frames_per_second <= 0 disables the limiter
+        void initialize(double frames_per_second) {
+            m_frame_seconds = frames_per_second > 0.0 ? 1.0 / frames_per_second : 0.0;
+            m_next_frame = get_seconds() + m_frame_seconds;
+        }
+
+        void wait() {
+            double now;
+
+            if (m_frame_seconds <= 0.0) {
+                return;
+            }
+
+            now = get_seconds();
+
+            // sleep
+            if (m_next_frame - now > m_spin_seconds) {
+                SDL_Delay((Uint32)((m_next_frame - now - m_spin_seconds) * 1000.0));
+            }
+
+            // spin
+            while (get_seconds() < m_next_frame) {
+            }
+
+            // fell too far behind, do not try to catch up
+            m_next_frame += m_frame_seconds;
+            now = get_seconds();
+            if (m_next_frame < now) {
+                m_next_frame = now + m_frame_seconds;
+            }
+        }
+    };
+
+    // fixed rate simulation clock, frames feed it real time and it hands out whole ticks
+    class fixed_timestep {
+        double m_tick_seconds = 0.0;
+        double m_accumulator = 0.0;
+        unsigned long long m_tick_count = 0;
+        unsigned int m_ticks_this_frame = 0;
+        unsigned int m_max_ticks_per_frame = 8;
+
+    public:
+        void initialize(double ticks_per_second) {
+            m_tick_seconds = 1.0 / ticks_per_second;
+            m_accumulator = 0.0;
+            m_tick_count = 0;
+        }
+
+        void add_frame_time(double seconds) {
+            m_accumulator += seconds;
+            m_ticks_this_frame = 0;
+        }
+
+        // true while another tick should run this frame
+        bool tick() {
+            // after a long stall drop the backlog rather than spiral
+            if (m_ticks_this_frame == m_max_ticks_per_frame) {
+                m_accumulator = 0.0;
+            }
+
+            if (m_accumulator < m_tick_seconds) {
+                return false;
+            }
+
+            m_accumulator -= m_tick_seconds;
+            m_tick_count++;
+            m_ticks_this_frame++;
+
+            return true;
+        }
+
+        // how far the render is between the last two ticks, from 0 to 1
+        float get_alpha() {
+            return (float)(m_accumulator / m_tick_seconds);
+        }
+
+        // the wall clock time the current tick simulates up to, given when this frame started
+        double get_tick_end_time(double frame_time) {
+            return frame_time - m_accumulator;
+        }
+
+        double get_tick_seconds() {
+            return m_tick_seconds;
+        }
+
+        unsigned long long get_tick_count() {
+            return m_tick_count;
+        }
+    };
+
+    class frame_statistics {
+        unsigned long long m_frame_count = 0;
+        double m_total_seconds = 0.0;
+        double m_min_seconds = 0.0;
+        double m_max_seconds = 0.0;
+
+    public:
+        void record(double seconds) {
+            if (m_frame_count == 0 || seconds < m_min_seconds) {
+                m_min_seconds = seconds;
+            }
+            if (seconds > m_max_seconds) {
+                m_max_seconds = seconds;
+            }
+
+            m_total_seconds += seconds;
+            m_frame_count++;
+        }
+
+        void print(const char* name) {
+            if (m_frame_count == 0) {
+                return;
+            }
+
+            printf("%s: %llu samples, mean %.3f ms (%.1f per second), min %.3f ms, max %.3f ms\n", name, m_frame_count, (m_total_seconds / (double)m_frame_count) * 1000.0, (double)m_frame_count / m_total_seconds, m_min_seconds * 1000.0, m_max_seconds * 1000.0);
+            fflush(stdout);
+        }
+    };
+}
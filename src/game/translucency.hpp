@@ -0,0 +1,288 @@
+#pragma once
+
+#include "types.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace abradinjapan::voxelize {
+    // the most translucent faces a chunk can have, every side of every block
+    const unsigned long long max_translucent_faces = 512 * 6;
+
+    // how far the camera moves in render space before translucent faces are sorted again, a quarter of a block
+    // faces that swap places within that distance are close enough together that the wrong order is hard to see
+    const float translucent_resort_distance = 0.25f / 8.0f;
+
+    // keeps the translucent faces of every loaded chunk sorted back to front on a thread of its own
+    // the render thread hands over face centres and picks up finished orders in update(), which never waits, so a sort can take a few frames
+    // each world slot keeps the order from last time and sorts it again with an insertion sort, which is close to linear while the camera moves smoothly
+    class translucency_sorter {
+        unsigned long long m_slot_count = 0;
+        float* m_centres = 0; // three floats a face, max_translucent_faces a slot
+        unsigned short* m_orders = 0; // face numbers back to front, max_translucent_faces a slot
+        float* m_keys = 0; // distances of one slot's faces, only touched by the sort thread
+        unsigned long long* m_counts = 0;
+        unsigned long long* m_versions = 0; // the chunk_888 translucent version each slot's faces came from
+        bool* m_fresh = 0; // faces copied in since the last sort, still in mesh order
+        bool* m_sorted = 0; // an order waiting to be uploaded
+        float m_camera[3] = { 0.0f, 0.0f, 0.0f }; // where the last sort was for
+        bool m_has_camera = false;
+
+        // the sort thread owns everything above while m_busy is set, the render thread otherwise
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_start_signal;
+        std::condition_variable m_done_signal;
+        bool m_start = false;
+        bool m_quit = false;
+        std::atomic<bool> m_busy{false};
+
+        // statistics
+        unsigned long long m_sorts = 0;
+        unsigned long long m_camera_sorts = 0; // sorts with the camera past the resort distance, chunks meshed again or not
+        unsigned long long m_camera_skips = 0; // updates with the camera moved less than that and nothing new to sort
+        unsigned long long m_slot_sorts = 0;
+        unsigned long long m_uploads = 0;
+        unsigned long long m_faces_checked = 0;
+        unsigned long long m_faces_out_of_order = 0;
+
+        // squared distances from the camera of the last sort to each of a slot's faces
+        void set_keys(unsigned long long slot) {
+            float* centres = &m_centres[slot * max_translucent_faces * 3];
+            float dx, dy, dz;
+
+            for (unsigned long long i = 0; i < m_counts[slot]; i++) {
+                dx = centres[(i * 3) + 0] - m_camera[0];
+                dy = centres[(i * 3) + 1] - m_camera[1];
+                dz = centres[(i * 3) + 2] - m_camera[2];
+                m_keys[i] = (dx * dx) + (dy * dy) + (dz * dz);
+            }
+        }
+
+        void sort_slot(unsigned long long slot) {
+            unsigned short* order = &m_orders[slot * max_translucent_faces];
+            unsigned long long count = m_counts[slot];
+            unsigned short face;
+            float* keys = m_keys;
+            long long j;
+
+            set_keys(slot);
+
+            // new faces start from scratch, the rest are nearly in order already
+            if (m_fresh[slot]) {
+                std::sort(order, order + count, [keys](unsigned short a, unsigned short b) { return keys[a] > keys[b]; });
+                m_fresh[slot] = false;
+            } else {
+                for (unsigned long long i = 1; i < count; i++) {
+                    face = order[i];
+                    j = (long long)i - 1;
+                    while (j >= 0 && keys[order[j]] < keys[face]) {
+                        order[j + 1] = order[j];
+                        j--;
+                    }
+                    order[j + 1] = face;
+                }
+            }
+
+            m_sorted[slot] = true;
+            m_slot_sorts++;
+        }
+
+        void work() {
+            while (true) {
+                // wait for a camera
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+
+                    m_start_signal.wait(lock, [&] { return m_quit || m_start; });
+                    if (m_quit) {
+                        return;
+                    }
+
+                    m_start = false;
+                }
+
+                for (unsigned long long i = 0; i < m_slot_count; i++) {
+                    if (m_counts[i] > 1) {
+                        sort_slot(i);
+                    }
+                }
+
+                // hand everything back
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    m_busy.store(false, std::memory_order_release);
+                    m_done_signal.notify_all();
+                }
+            }
+        }
+
+    public:
+        void initialize(unsigned long long slot_count) {
+            m_slot_count = slot_count;
+            m_centres = new float[slot_count * max_translucent_faces * 3];
+            m_orders = new unsigned short[slot_count * max_translucent_faces];
+            m_keys = new float[max_translucent_faces];
+            m_counts = new unsigned long long[slot_count];
+            m_versions = new unsigned long long[slot_count];
+            m_fresh = new bool[slot_count];
+            m_sorted = new bool[slot_count];
+
+            for (unsigned long long i = 0; i < slot_count; i++) {
+                m_counts[i] = 0;
+                m_versions[i] = 0;
+                m_fresh[i] = false;
+                m_sorted[i] = false;
+            }
+            m_has_camera = false;
+            m_quit = false;
+            m_start = false;
+            m_busy = false;
+
+            g_memory_accounts.add(mtt::mtt_translucency, (long long)(slot_count * max_translucent_faces * ((3 * sizeof(float)) + sizeof(unsigned short))));
+
+            m_thread = std::thread(&translucency_sorter::work, this);
+        }
+
+        // call once a frame after remeshing, with the camera in render space
+        // uploads finished orders, takes the faces of chunks meshed since last time and starts a sort when anything changed or the camera moved far enough
+        void update(world* w, glm::vec3 camera) {
+            long long x, y, z;
+            chunk_888* chunk;
+            bool changed = false;
+            bool any = false;
+            bool moved;
+            float dx, dy, dz;
+
+            if (m_busy.load(std::memory_order_acquire)) {
+                return;
+            }
+
+            for (unsigned long long i = 0; i < m_slot_count; i++) {
+                w->get_slot_chunk(i, &x, &y, &z);
+                chunk = w->get_chunk(x, y, z);
+
+                // a chunk meshed again since its faces were taken drops whatever was sorted for it
+                if (chunk != 0 && chunk->get_translucent_version() == m_versions[i]) {
+                    if (m_sorted[i]) {
+                        chunk->upload_translucent_order(&m_orders[i * max_translucent_faces], m_counts[i]);
+                        m_uploads++;
+                    }
+                } else {
+                    m_versions[i] = chunk != 0 ? chunk->get_translucent_version() : 0;
+                    m_counts[i] = chunk != 0 ? chunk->get_translucent_centres(&m_centres[i * max_translucent_faces * 3]) : 0;
+                    for (unsigned long long j = 0; j < m_counts[i]; j++) {
+                        m_orders[(i * max_translucent_faces) + j] = (unsigned short)j;
+                    }
+                    m_fresh[i] = true;
+                    changed = changed || m_counts[i] > 1;
+                }
+                m_sorted[i] = false;
+
+                any = any || m_counts[i] > 1;
+            }
+
+            dx = camera.x - m_camera[0];
+            dy = camera.y - m_camera[1];
+            dz = camera.z - m_camera[2];
+            moved = !m_has_camera || (dx * dx) + (dy * dy) + (dz * dz) >= translucent_resort_distance * translucent_resort_distance;
+            if (!any || (!changed && !moved)) {
+                if (any && (dx != 0.0f || dy != 0.0f || dz != 0.0f)) {
+                    m_camera_skips++;
+                }
+
+                return;
+            }
+
+            // start sorting
+            m_camera[0] = camera.x;
+            m_camera[1] = camera.y;
+            m_camera[2] = camera.z;
+            if (m_has_camera && moved) {
+                m_camera_sorts++;
+            }
+            m_has_camera = true;
+            m_sorts++;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_busy.store(true, std::memory_order_relaxed);
+                m_start = true;
+            }
+            m_start_signal.notify_one();
+        }
+
+        // blocks until a running sort has finished, runs that draw the same frames every time wait once a frame
+        void wait() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            m_done_signal.wait(lock, [&] { return !m_busy.load(std::memory_order_acquire); });
+        }
+
+        // counts faces a finished sort put nearer the camera than the face after them, call between wait() and the next update()
+        void check_order() {
+            unsigned short* order;
+
+            for (unsigned long long i = 0; i < m_slot_count; i++) {
+                if (!m_sorted[i]) {
+                    continue;
+                }
+
+                set_keys(i);
+                order = &m_orders[i * max_translucent_faces];
+                for (unsigned long long j = 1; j < m_counts[i]; j++) {
+                    if (m_keys[order[j - 1]] < m_keys[order[j]]) {
+                        m_faces_out_of_order++;
+                    }
+                }
+                m_faces_checked += m_counts[i];
+            }
+        }
+
+        void print() {
+            printf("Translucency:\n");
+            printf("\tsorts: %llu, chunks sorted: %llu, orders uploaded: %llu\n", m_sorts, m_slot_sorts, m_uploads);
+            printf("\tcamera moves sorted again: %llu, too small to sort: %llu\n", m_camera_sorts, m_camera_skips);
+            if (m_faces_checked > 0) {
+                printf("\tfaces checked back to front: %llu, out of order: %llu\n", m_faces_checked, m_faces_out_of_order);
+            }
+            fflush(stdout);
+        }
+
+        void uninitialize() {
+            if (m_thread.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    m_quit = true;
+                }
+                m_start_signal.notify_one();
+                m_thread.join();
+
+                g_memory_accounts.remove(mtt::mtt_translucency, (long long)(m_slot_count * max_translucent_faces * ((3 * sizeof(float)) + sizeof(unsigned short))));
+            }
+
+            delete[] m_centres;
+            delete[] m_orders;
+            delete[] m_keys;
+            delete[] m_counts;
+            delete[] m_versions;
+            delete[] m_fresh;
+            delete[] m_sorted;
+
+            m_centres = 0;
+            m_orders = 0;
+            m_keys = 0;
+            m_counts = 0;
+            m_versions = 0;
+            m_fresh = 0;
+            m_sorted = 0;
+            m_slot_count = 0;
+        }
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lib.hpp"
+#include "memory.hpp"
 
 #include <GL/glew.h>
 #include <GL/gl.h>
@@ -14,6 +15,10 @@
 
 #include <random>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace abradinjapan::voxelize {
     // error type
     enum et {
@@ -25,12 +30,29 @@ namespace abradinjapan::voxelize {
         et_coult_not_create_sdl2_window,
         et_could_not_create_sdl2_opengl_context,
         et_could_not_initialize_glew,
+        et_could_not_create_offscreen_context,
         
         // shaders
 
         // textures
         et_could_not_load_image,
 
+        // headless runs
+        et_could_not_write_image,
+        et_image_mismatch,
+
+        // networking
+        et_could_not_start_server,
+        et_could_not_connect_to_server,
+
+        // camera paths and timings
+        et_could_not_read_camera_path,
+        et_could_not_write_camera_path,
+        et_could_not_write_timings,
+
+        // memory accounting
+        et_could_not_write_memory_log,
+
         // other
         et_error_unknown
     };
@@ -168,70 +190,187 @@ namespace abradinjapan::voxelize {
         }
     };
 
+    double get_seconds() {
+        return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+    }
+
+    // action type
+    enum at {
+        at_quit,
+        at_pitch_up,
+        at_pitch_down,
+        at_yaw_left,
+        at_yaw_right,
+        at_move_forward,
+        at_move_backward,
+        at_move_left,
+        at_move_right,
+        at_jump,
+        at_print_memory
+    };
+
+    const unsigned int at_count = 11;
+
+    // what --bind calls each action
+    const char* const at_names[at_count] = {
+        "quit",
+        "pitch_up",
+        "pitch_down",
+        "yaw_left",
+        "yaw_right",
+        "move_forward",
+        "move_backward",
+        "move_left",
+        "move_right",
+        "jump",
+        "print_memory"
+    };
+
+    // one key press or release, time is in the same seconds as get_seconds()
+    struct input_transition {
+        SDL_Scancode p_scancode;
+        bool p_pressed;
+        double p_time;
+    };
+
     class user_input {
-        // TODO: OPTIMIZE!
+        static const unsigned int m_transition_capacity = 1024;
         bool m_quit_signal = false;
-        bool m_w = false;
-        bool m_s = false;
-        bool m_a = false;
-        bool m_d = false;
+        unsigned long long m_keys[SDL_NUM_SCANCODES / 64] = {}; // what is down right now, kept even when the queue is full
+        SDL_Scancode m_bindings[at_count] = {
+            SDL_SCANCODE_ESCAPE,
+            SDL_SCANCODE_UP,
+            SDL_SCANCODE_DOWN,
+            SDL_SCANCODE_LEFT,
+            SDL_SCANCODE_RIGHT,
+            SDL_SCANCODE_W,
+            SDL_SCANCODE_S,
+            SDL_SCANCODE_A,
+            SDL_SCANCODE_D,
+            SDL_SCANCODE_SPACE,
+            SDL_SCANCODE_M
+        };
+        input_transition m_transitions[m_transition_capacity];
+        unsigned int m_transition_count = 0;
+        unsigned int m_transitions_consumed = 0;
+        unsigned long long m_transitions_dropped = 0;
+        bool m_action_held[at_count] = {};
+        bool m_action_active[at_count] = {};
+        double m_first_consumed_time = -1.0;
+
+        void set_key(SDL_Scancode scancode, bool pressed) {
+            if (pressed) {
+                m_keys[scancode / 64] |= 1ull << (scancode % 64);
+            } else {
+                m_keys[scancode / 64] &= ~(1ull << (scancode % 64));
+            }
+        }
 
     public:
+        // queue every key transition with its event time, the fixed rate update replays them in order
         void update() {
             SDL_Event e;
+            // event timestamps are milliseconds on the SDL_GetTicks clock
+            double clock_offset = get_seconds() - ((double)SDL_GetTicks() / 1000.0);
+
             while (SDL_PollEvent(&e)) {
-                if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)) {
+                if (e.type == SDL_QUIT) {
                     m_quit_signal = true;
                 }
-                if (e.type == SDL_KEYDOWN) {
-                    if (e.key.keysym.sym == SDLK_w) {
-                        m_w = true;
-                    }
-                    if (e.key.keysym.sym == SDLK_s) {
-                        m_s = true;
-                    }
-                    if (e.key.keysym.sym == SDLK_a) {
-                        m_a = true;
-                    }
-                    if (e.key.keysym.sym == SDLK_d) {
-                        m_d = true;
+                if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && e.key.repeat == 0 && e.key.keysym.scancode < SDL_NUM_SCANCODES) {
+                    set_key(e.key.keysym.scancode, e.type == SDL_KEYDOWN);
+
+                    if (m_transition_count == m_transition_capacity) {
+                        m_transitions_dropped++;
+
+                        continue;
                     }
+
+                    m_transitions[m_transition_count].p_scancode = e.key.keysym.scancode;
+                    m_transitions[m_transition_count].p_pressed = e.type == SDL_KEYDOWN;
+                    m_transitions[m_transition_count].p_time = ((double)e.key.timestamp / 1000.0) + clock_offset;
+                    m_transition_count++;
                 }
-                if (e.type == SDL_KEYUP) {
-                    if (e.key.keysym.sym == SDLK_w) {
-                        m_w = false;
-                    }
-                    if (e.key.keysym.sym == SDLK_s) {
-                        m_s = false;
-                    }
-                    if (e.key.keysym.sym == SDLK_a) {
-                        m_a = false;
-                    }
-                    if (e.key.keysym.sym == SDLK_d) {
-                        m_d = false;
+            }
+        }
+
+        // replay the transitions that happened before the end of this tick
+        // an action pressed and released between two ticks is still active for one tick
+        // once the queue is used up the held actions are taken from the keys that are down, so a dropped release never leaves an action held
+        void begin_tick(double tick_end_time) {
+            input_transition* transition;
+
+            for (unsigned int i = 0; i < at_count; i++) {
+                m_action_active[i] = m_action_held[i];
+            }
+
+            while (m_transitions_consumed < m_transition_count && m_transitions[m_transitions_consumed].p_time <= tick_end_time) {
+                transition = &m_transitions[m_transitions_consumed];
+
+                for (unsigned int i = 0; i < at_count; i++) {
+                    if (m_bindings[i] == transition->p_scancode) {
+                        m_action_held[i] = transition->p_pressed;
+                        m_action_active[i] |= transition->p_pressed;
                     }
                 }
+
+                if (m_first_consumed_time < 0.0) {
+                    m_first_consumed_time = transition->p_time;
+                }
+
+                m_transitions_consumed++;
+            }
+
+            if (m_transitions_consumed == m_transition_count) {
+                for (unsigned int i = 0; i < at_count; i++) {
+                    m_action_held[i] = is_key_down(m_bindings[i]);
+                    m_action_active[i] |= m_action_held[i];
+                }
+            }
+
+            if (m_action_active[at::at_quit]) {
+                m_quit_signal = true;
             }
         }
 
-        bool quit() {
-            return m_quit_signal;
+        // keep transitions that belong to later ticks
+        void end_frame() {
+            for (unsigned int i = m_transitions_consumed; i < m_transition_count; i++) {
+                m_transitions[i - m_transitions_consumed] = m_transitions[i];
+            }
+
+            m_transition_count -= m_transitions_consumed;
+            m_transitions_consumed = 0;
+            m_first_consumed_time = -1.0;
+        }
+
+        // the time of the oldest input handled this frame, negative when there was none
+        double get_first_consumed_time() {
+            return m_first_consumed_time;
+        }
+
+        // the action lets go of the old key, whether it is held is read from the new key once the queue is used up
+        void bind_action(at action, SDL_Scancode scancode) {
+            m_bindings[action] = scancode;
+            m_action_held[action] = false;
+            m_action_active[action] = false;
         }
 
-        bool w() {
-            return m_w;
+        bool is_action_active(at action) {
+            return m_action_active[action];
         }
 
-        bool s() {
-            return m_s;
+        bool is_key_down(SDL_Scancode scancode) {
+            return (m_keys[scancode / 64] >> (scancode % 64)) & 1;
         }
 
-        bool a() {
-            return m_a;
+        // transitions that came in while the queue was full, the keys that are down still count but their times are lost
+        unsigned long long get_transitions_dropped() {
+            return m_transitions_dropped;
         }
 
-        bool d() {
-            return m_d;
+        bool quit() {
+            return m_quit_signal;
         }
     };
 
@@ -242,6 +381,7 @@ namespace abradinjapan::voxelize {
         int p_height = 0;
         int p_nrChannels = 0;
         unsigned char* p_texture_data = 0;
+        bool p_on_gpu = false;
 
     public:
         void initialize(char* image_file_address, GLenum texture_type, et* error) {
@@ -252,6 +392,8 @@ namespace abradinjapan::voxelize {
             p_texture_data = stbi_load(image_file_address, &p_width, &p_height, &p_nrChannels, 0);
             if (p_texture_data == 0) {
                 *error = et::et_could_not_load_image;
+            } else {
+                g_memory_accounts.add(mtt::mtt_textures, (long long)p_width * p_height * p_nrChannels);
             }
 
             glGenTextures(1, &p_texture_ID);
@@ -267,6 +409,25 @@ namespace abradinjapan::voxelize {
             glTexImage2D(p_texture_type, 0, GL_RGBA, p_width, p_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, p_texture_data);
             glGenerateMipmap(p_texture_type);
             unbind();
+
+            // the driver has its own copy now, a full mipmap chain adds a third
+            g_memory_accounts.add(mtt::mtt_gpu_textures, get_gpu_bytes());
+            p_on_gpu = true;
+
+            // nothing reads the pixels again
+            free_texture_data();
+        }
+
+        long long get_gpu_bytes() {
+            return ((long long)p_width * p_height * 4 * 4) / 3;
+        }
+
+        void free_texture_data() {
+            if (p_texture_data != 0) {
+                g_memory_accounts.remove(mtt::mtt_textures, (long long)p_width * p_height * p_nrChannels);
+                stbi_image_free(p_texture_data);
+                p_texture_data = 0;
+            }
         }
 
         void bind() {
@@ -278,8 +439,12 @@ namespace abradinjapan::voxelize {
         }
 
         void uninitialize() {
+            if (p_on_gpu) {
+                g_memory_accounts.remove(mtt::mtt_gpu_textures, get_gpu_bytes());
+                p_on_gpu = false;
+            }
             glDeleteTextures(1, &p_texture_ID);
-            stbi_image_free(p_texture_data);
+            free_texture_data();
         }
     };
 
@@ -313,286 +478,316 @@ namespace abradinjapan::voxelize {
         cvt_top_left_back
     };
 
-    class chunk_888 {
-        const unsigned short m_side_length = 8;
-        const unsigned short m_block_count = 512;
-        unsigned short m_blocks[512];
-        GLuint m_vao, m_vbo, m_ebo;
-        unsigned long long m_vbo_length, m_ebo_length;
-        float* m_vbo_data;
-        unsigned int* m_ebo_data;
+    // the unit offset of the block each surface faces
+    const int st2_offsets[6][3] = {
+        { 0, 0, 1 },
+        { 0, -1, 0 },
+        { -1, 0, 0 },
+        { 0, 0, -1 },
+        { 0, 1, 0 },
+        { 1, 0, 0 }
+    };
 
-    public:
-        chunk_888() {
-            m_vao = 0;
-            m_vbo = 0;
-            m_ebo = 0;
-            m_vbo_length = 0;
-            m_ebo_length = 0;
-            m_vbo_data = 0;
-            m_ebo_data = 0;
+    // the unit direction of each cube corner from the centre of its block
+    const int cvt_directions[8][3] = {
+        { -1, -1, 1 },
+        { 1, -1, 1 },
+        { 1, 1, 1 },
+        { -1, 1, 1 },
+        { -1, -1, -1 },
+        { 1, -1, -1 },
+        { 1, 1, -1 },
+        { -1, 1, -1 }
+    };
+
+    // the corners of each surface, in tvt order
+    constexpr cvt st2_corners[6][4] = {
+        { cvt::cvt_bottom_left_front, cvt::cvt_bottom_right_front, cvt::cvt_top_left_front, cvt::cvt_top_right_front },
+        { cvt::cvt_bottom_left_front, cvt::cvt_bottom_right_front, cvt::cvt_bottom_left_back, cvt::cvt_bottom_right_back },
+        { cvt::cvt_bottom_left_front, cvt::cvt_bottom_left_back, cvt::cvt_top_left_front, cvt::cvt_top_left_back },
+        { cvt::cvt_bottom_left_back, cvt::cvt_bottom_right_back, cvt::cvt_top_left_back, cvt::cvt_top_right_back },
+        { cvt::cvt_top_left_front, cvt::cvt_top_right_front, cvt::cvt_top_left_back, cvt::cvt_top_right_back },
+        { cvt::cvt_bottom_right_front, cvt::cvt_bottom_right_back, cvt::cvt_top_right_front, cvt::cvt_top_right_back }
+    };
+
+    // block type
+    enum bt {
+        bt_air,
+        bt_stone,
+        bt_lamp,
+        bt_dirt,
+        bt_grass,
+        bt_sand,
+        bt_log,
+        bt_leaves
+    };
+
+    unsigned char get_block_emission(unsigned short block) {
+        if (block == bt::bt_lamp) {
+            return 15;
         }
 
-    private:
-        void write_vertex(float* vertices, unsigned int index, float x, float y, float z, float side_length, tvt texture_coord) {
-            vertices[index] = x;
-            vertices[index + 1] = y;
-            vertices[index + 2] = z;
-
-            if (texture_coord == tvt::tvt_bottom_left) {
-                vertices[index + 3] = 0.0f;
-                vertices[index + 4] = 0.0f;
-            } else if (texture_coord == tvt::tvt_bottom_right) {
-                vertices[index + 3] = 1.0f;
-                vertices[index + 4] = 0.0f;
-            } else if (texture_coord == tvt::tvt_top_left) {
-                vertices[index + 3] = 0.0f;
-                vertices[index + 4] = 1.0f;
-            } else if (texture_coord == tvt::tvt_top_right) {
-                vertices[index + 3] = 1.0f;
-                vertices[index + 4] = 1.0f;
-            }
-        }
-
-        void write_vertex_on_cube(float* vertices, unsigned int* index, float x, float y, float z, float l, tvt texture_vertex_type, cvt cube_vertex_type) {
-            if (cube_vertex_type == cvt::cvt_bottom_left_front) {
-                write_vertex(vertices, *index, x, y, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_bottom_right_front) {
-                write_vertex(vertices, *index, x + l, y, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_left_front) {
-                write_vertex(vertices, *index, x, y + l, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_right_front) {
-                write_vertex(vertices, *index, x + l, y + l, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_bottom_left_back) {
-                write_vertex(vertices, *index, x, y, z - l, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_bottom_right_back) {
-                write_vertex(vertices, *index, x + l, y, z - l, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_left_back) {
-                write_vertex(vertices, *index, x, y + l, z - l, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_right_back) {
-                write_vertex(vertices, *index, x + l, y + l, z - l, l, texture_vertex_type);
-            }
-
-            *index += 5;
-        }
-
-        void write_face(float* vertices, unsigned int* index, float x, float y, float z, float l, st2 surface_type) {
-            cvt front[] = {
-                cvt::cvt_bottom_left_front,
-                cvt::cvt_bottom_right_front,
-                cvt::cvt_top_left_front,
-                cvt::cvt_top_right_front
-            };
+        return 0;
+    }
 
-            cvt bottom[] = {
-                cvt::cvt_bottom_left_front,
-                cvt::cvt_bottom_right_front,
-                cvt::cvt_bottom_left_back,
-                cvt::cvt_bottom_right_back
-            };
+    // whether a block stops sunlight, light only travels through air so for now that is every solid block
+    bool is_block_opaque(unsigned short block) {
+        return block != bt::bt_air;
+    }
 
-            cvt left[] = {
-                cvt::cvt_bottom_left_front,
-                cvt::cvt_bottom_left_back,
-                cvt::cvt_top_left_front,
-                cvt::cvt_top_left_back
-            };
+    // blocks that are picked at random every so often to update themselves, see tick_scheduler
+    bool is_random_ticking(unsigned short block) {
+        return block == bt::bt_grass;
+    }
 
-            cvt back[] = {
-                cvt::cvt_bottom_left_back,
-                cvt::cvt_bottom_right_back,
-                cvt::cvt_top_left_back,
-                cvt::cvt_top_right_back
-            };
+    // fluid type
+    enum ft {
+        ft_none,
+        ft_water,
+        ft_lava
+    };
 
-            cvt top[] = {
-                cvt::cvt_top_left_front,
-                cvt::cvt_top_right_front,
-                cvt::cvt_top_left_back,
-                cvt::cvt_top_right_back
-            };
+    // fluid is packed into one byte per block, the level in the low nibble, the type in the next two bits and a source flag in the top bit
+    const unsigned char fluid_max_level = 15;
 
-            cvt right[] = {
-                cvt::cvt_bottom_right_front,
-                cvt::cvt_bottom_right_back,
-                cvt::cvt_top_right_front,
-                cvt::cvt_top_right_back
-            };
-            
-            switch (surface_type) {
-            case st2::st2_front:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, front[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, front[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, front[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, front[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, front[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, front[2]);
-                break;
-            case st2::st2_bottom:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, bottom[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, bottom[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, bottom[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, bottom[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, bottom[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, bottom[2]);
-                break;
-            case st2::st2_left:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, left[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, left[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, left[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, left[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, left[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, left[2]);
-                break;
-            case st2::st2_back:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, back[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, back[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, back[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, back[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, back[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, back[2]);
-                break;
-            case st2::st2_top:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, top[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, top[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, top[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, top[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, top[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, top[2]);
-                break;
-            case st2::st2_right:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, right[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, right[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, right[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, right[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, right[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, right[2]);
-                break;
-            }
-        }
+    unsigned char get_fluid_level(unsigned char fluid) {
+        return fluid & 0x0F;
+    }
 
-        bool bounds_check_face(int x, int y, int z, st2 face) {
-            const bool sides = false;
+    ft get_fluid_type(unsigned char fluid) {
+        return (ft)((fluid >> 4) & 0x03);
+    }
 
-            if (face == st2::st2_front) {
-                if (z % 8 == 7) {
-                    return sides;
-                }
-                if (m_blocks[x + (y * 8) + ((z + 1) * 64)] > 0) {
-                    return false;
-                }
-            }
-            if (face == st2::st2_back) {
-                if (z % 8 == 0) {
-                    return sides;
-                }
-                if (m_blocks[x + (y * 8) + ((z - 1) * 64)] > 0) {
-                    return false;
-                }
-            }
-            if (face == st2::st2_top) {
-                if (y % 8 == 7) {
-                    return sides;
-                }
-                if (m_blocks[x + ((y + 1) * 8) + (z * 64)] > 0) {
-                    return false;
-                }
-            }
-            if (face == st2::st2_bottom) {
-                if (y % 8 == 0) {
-                    return sides;
-                }
-                if (m_blocks[x + ((y - 1) * 8) + (z * 64)] > 0) {
-                    return false;
-                }
-            }
-            if (face == st2::st2_right) {
-                if (x % 8 == 7) {
-                    return sides;
-                }
-                if (m_blocks[x + 1 + (y * 8) + (z * 64)] > 0) {
-                    return false;
-                }
-            }
-            if (face == st2::st2_left) {
-                if (x % 8 == 0) {
-                    return sides;
-                }
-                if (m_blocks[x - 1 + (y * 8) + (z * 64)] > 0) {
-                    return false;
-                }
-            }
+    bool is_fluid_source(unsigned char fluid) {
+        return (fluid & 0x80) != 0;
+    }
 
-            return true;
+    // an empty level always packs to 0
+    unsigned char pack_fluid(ft type, unsigned char level, bool source) {
+        if (level == 0 || type == ft::ft_none) {
+            return 0;
         }
 
-        void render_inside(float* points, float x_offset, float y_offset, float z_offset) {
-            float side_length = 1.0f / 8.0f;
-            unsigned int points_index = 0;
-            unsigned int vbo_index = 0;
-            unsigned int ebo_index = 0;
+        return (source ? 0x80 : 0x00) | (type << 4) | level;
+    }
+
+    // light is packed into one byte per block, sunlight in the high nibble and block light in the low nibble
+    unsigned char get_sunlight(unsigned char light) {
+        return light >> 4;
+    }
+
+    unsigned char get_block_light(unsigned char light) {
+        return light & 0x0F;
+    }
+
+    unsigned char pack_light(unsigned char sunlight, unsigned char block_light) {
+        return (sunlight << 4) | block_light;
+    }
+
+    // floats per chunk vertex: position, texture coordinates, sunlight, block light, ambient occlusion
+    const unsigned int chunk_vertex_length = 8;
+
+    // bump whenever meshing changes what it writes, meshes cached on disk by an older mesher are thrown away
+    const unsigned int mesher_version = 2;
+
+    // floats per chunk side vertex: position and texture coordinates
+    const unsigned int side_vertex_length = 5;
+
+    // where each cube corner sits from the corner a face is written from, in side lengths
+    constexpr float cvt_offsets[8][3] = {
+        { 0.0f, 0.0f, 0.0f },
+        { 1.0f, 0.0f, 0.0f },
+        { 1.0f, 1.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, -1.0f },
+        { 1.0f, 0.0f, -1.0f },
+        { 1.0f, 1.0f, -1.0f },
+        { 0.0f, 1.0f, -1.0f }
+    };
 
-            // generate all points
-            for (unsigned int x = 0; x < m_side_length; x++) {
-                for (unsigned int y = 0; y < m_side_length; y++) {
-                    for (unsigned int z = 0; z < m_side_length; z++) {
-                        if (m_blocks[x + (y * 8) + (z * 64)] != 0) {
-                            if (bounds_check_face(x, y, z, st2::st2_front)) {
-                                write_face(points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_offset, side_length, st2::st2_front);
-                            }
-                            if (bounds_check_face(x, y, z, st2::st2_bottom)) {
-                                write_face(points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_offset, side_length, st2::st2_bottom);
-                            }
-                            if (bounds_check_face(x, y, z, st2::st2_left)) {
-                                write_face(points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_offset, side_length, st2::st2_left);
-                            }
-                            if (bounds_check_face(x, y, z, st2::st2_back)) {
-                                write_face(points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_offset, side_length, st2::st2_back);
-                            }
-                            if (bounds_check_face(x, y, z, st2::st2_top)) {
-                                write_face(points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_offset, side_length, st2::st2_top);
-                            }
-                            if (bounds_check_face(x, y, z, st2::st2_right)) {
-                                write_face(points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_offset, side_length, st2::st2_right);
-                            }
-                        }
-                    }
+    constexpr float tvt_coordinates[4][2] = {
+        { 0.0f, 0.0f },
+        { 1.0f, 0.0f },
+        { 0.0f, 1.0f },
+        { 1.0f, 1.0f }
+    };
+
+    // the six vertices of a face as two triangles, the second row splits the quad along the other diagonal
+    constexpr tvt tvt_triangle_orders[2][6] = {
+        { tvt::tvt_bottom_left, tvt::tvt_bottom_right, tvt::tvt_top_left, tvt::tvt_top_right, tvt::tvt_bottom_right, tvt::tvt_top_left },
+        { tvt::tvt_bottom_left, tvt::tvt_bottom_right, tvt::tvt_top_right, tvt::tvt_bottom_left, tvt::tvt_top_right, tvt::tvt_top_left }
+    };
+
+    // everything about one surface's six vertices except where the face is, per diagonal
+    struct face_vertex_table {
+        float offsets[2][6][3];
+        float coordinates[2][6][2];
+        unsigned char corners[2][6]; // which tvt each vertex takes its ambient occlusion from
+    };
+
+    constexpr face_vertex_table make_face_vertex_table(st2 surface) {
+        face_vertex_table output = {};
+        tvt corner = tvt::tvt_bottom_left;
+
+        for (unsigned int d = 0; d < 2; d++) {
+            for (unsigned int i = 0; i < 6; i++) {
+                corner = tvt_triangle_orders[d][i];
+                for (unsigned int j = 0; j < 3; j++) {
+                    output.offsets[d][i][j] = cvt_offsets[st2_corners[surface][corner]][j];
                 }
+                output.coordinates[d][i][0] = tvt_coordinates[corner][0];
+                output.coordinates[d][i][1] = tvt_coordinates[corner][1];
+                output.corners[d][i] = corner;
             }
+        }
 
-            // compress vbo and ebo data
-            // TODO
+        return output;
+    }
 
-            // write to m_vbo_data
-            m_vbo_length = points_index;
-            m_vbo_data = new float[m_vbo_length];
+    constexpr face_vertex_table face_vertex_tables[6] = {
+        make_face_vertex_table(st2::st2_front),
+        make_face_vertex_table(st2::st2_bottom),
+        make_face_vertex_table(st2::st2_left),
+        make_face_vertex_table(st2::st2_back),
+        make_face_vertex_table(st2::st2_top),
+        make_face_vertex_table(st2::st2_right)
+    };
 
-            for (unsigned int i = 0; i < m_vbo_length; i++) {
-                m_vbo_data[i] = points[i];
+    // writes the six vertices of one face at x, y and z with side length l
+    // lit faces are chunk_vertex_length floats a vertex and take their light and ambient occlusion (in tvt order), unlit faces are side_vertex_length and ignore both
+    // the quad is split along whichever diagonal has the brighter corners so the occlusion interpolates evenly, unlit faces always use the first
+    // the surface is a template argument so every table lookup is a constant, and nothing in here branches
+    template <st2 surface, bool lit>
+    void emit_face(float* vertices, unsigned int* index, float x, float y, float z, float l, unsigned char light, const unsigned char* ambient_occlusion) {
+        const face_vertex_table& table = face_vertex_tables[surface];
+        const unsigned int vertex_length = lit ? chunk_vertex_length : side_vertex_length;
+        float* vertex = vertices + *index;
+        unsigned int diagonal = 0;
+        float sunlight = 0.0f;
+        float block_light = 0.0f;
+
+        if (lit) {
+            diagonal = ambient_occlusion[tvt::tvt_bottom_left] + ambient_occlusion[tvt::tvt_top_right] > ambient_occlusion[tvt::tvt_bottom_right] + ambient_occlusion[tvt::tvt_top_left];
+            sunlight = (float)get_sunlight(light) / 15.0f;
+            block_light = (float)get_block_light(light) / 15.0f;
+        }
+
+        for (unsigned int i = 0; i < 6; i++) {
+            vertex[0] = x + (l * table.offsets[diagonal][i][0]);
+            vertex[1] = y + (l * table.offsets[diagonal][i][1]);
+            vertex[2] = z + (l * table.offsets[diagonal][i][2]);
+            vertex[3] = table.coordinates[diagonal][i][0];
+            vertex[4] = table.coordinates[diagonal][i][1];
+            if (lit) {
+                vertex[5] = sunlight;
+                vertex[6] = block_light;
+                // ambient occlusion, 1 is fully open
+                vertex[7] = (float)ambient_occlusion[table.corners[diagonal][i]] / 3.0f;
             }
+            vertex += vertex_length;
+        }
 
-            // write ebo data
-            m_ebo_length = points_index / 5;
-            m_ebo_data = new unsigned int[m_ebo_length];
+        *index += 6 * vertex_length;
+    }
 
-            for (unsigned int i = 0; i < m_ebo_length; i++) {
-                m_ebo_data[i] = i;
-            }
+    typedef void (*face_emitter)(float* vertices, unsigned int* index, float x, float y, float z, float l, unsigned char light, const unsigned char* ambient_occlusion);
+
+    // emit_face for a surface only known at run time, indexed by st2
+    constexpr face_emitter lit_face_emitters[6] = {
+        emit_face<st2::st2_front, true>,
+        emit_face<st2::st2_bottom, true>,
+        emit_face<st2::st2_left, true>,
+        emit_face<st2::st2_back, true>,
+        emit_face<st2::st2_top, true>,
+        emit_face<st2::st2_right, true>
+    };
+
+    // mixes whole 8 byte words, any tail is padded with zeros
+    unsigned long long hash_bytes(const void* data, unsigned long long length, unsigned long long seed) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        unsigned long long output = seed ^ (length * 0x9E3779B97F4A7C15ull);
+        unsigned long long word;
+
+        for (unsigned long long i = 0; i < length; i += 8) {
+            word = 0;
+            memcpy(&word, bytes + i, length - i < 8 ? length - i : 8);
+
+            output = (output ^ word) * 0xBF58476D1CE4E5B9ull;
+            output ^= output >> 31;
         }
 
-    public:
-        void set_chunk_data_as_air() {
-            for (unsigned int i = 0; i < 512; i++) {
-                m_blocks[i] = 0;
-            }
+        output = (output ^ (output >> 30)) * 0x94D049BB133111EBull;
+
+        return output ^ (output >> 31);
+    }
+
+    // level of detail type
+    enum ldt {
+        ldt_full,
+        ldt_half,
+        ldt_quarter,
+        ldt_eighth // the whole chunk as one cell
+    };
+
+    const unsigned int ldt_count = 4;
+
+    // each level of detail covers twice the distance of the one before it, a chunk has a quarter of the faces at each step so the triangles drawn per ring stay about the same as the view distance doubles
+    // past ldt_eighth there is nothing coarser, the triangle count grows with the area after that
+    ldt select_lod(float distance, float lod_distance) {
+        unsigned int output = 0;
+
+        while (output + 1 < ldt_count && distance >= lod_distance) {
+            lod_distance *= 2.0f;
+            output++;
         }
 
-        void set_chunk_data_as_random() {
-            std::random_device random_device;
-            std::mt19937 random_number_generator(random_device());
+        return (ldt)output;
+    }
 
-            for (unsigned int i = 0; i < 512; i++) {
-                m_blocks[i] = random_number_generator() % 2;
+    // draw the seam on every side whose neighbour uses a different level of detail, chunk_lods covers a width by length window of chunks
+    // the window is one chunk tall, so the top of every chunk is open and its front seam is always drawn, an ldt_eighth chunk is one cell and has nothing else to show
+    unsigned int get_seam_mask(ldt* chunk_lods, long long width, long long length, long long x, long long y) {
+        unsigned int output = 1 << st2::st2_front;
+        ldt level = chunk_lods[x + (y * width)];
+
+        if (x > 0 && chunk_lods[(x - 1) + (y * width)] != level) {
+            output |= 1 << st2::st2_left;
+        }
+        if (x < width - 1 && chunk_lods[(x + 1) + (y * width)] != level) {
+            output |= 1 << st2::st2_right;
+        }
+        if (y > 0 && chunk_lods[x + ((y - 1) * width)] != level) {
+            output |= 1 << st2::st2_bottom;
+        }
+        if (y < length - 1 && chunk_lods[x + ((y + 1) * width)] != level) {
+            output |= 1 << st2::st2_top;
+        }
+
+        return output;
+    }
+
+    // the gpu side of one chunk mesh, with the border faces ("seams") kept in separate ranges so they can be drawn only when needed
+    class chunk_mesh {
+        GLuint m_vao, m_vbo, m_ebo;
+        unsigned long long m_body_length;
+        unsigned long long m_seam_offsets[6];
+        unsigned long long m_seam_lengths[6];
+        unsigned long long m_vbo_length, m_ebo_length;
+        bool m_mapped;
+
+    public:
+        chunk_mesh() {
+            m_vao = 0;
+            m_vbo = 0;
+            m_ebo = 0;
+            m_body_length = 0;
+            m_vbo_length = 0;
+            m_ebo_length = 0;
+            m_mapped = false;
+
+            for (unsigned int i = 0; i < 6; i++) {
+                m_seam_offsets[i] = 0;
+                m_seam_lengths[i] = 0;
             }
         }
 
@@ -603,14 +798,6 @@ namespace abradinjapan::voxelize {
             glGenBuffers(1, &m_ebo);
         }
 
-        void set_block_at(unsigned int x, unsigned int y, unsigned int z, unsigned short value) {
-            m_blocks[x + (y * 8) + (z * 64)] = value;
-        }
-
-        unsigned short get_block_at(unsigned int x, unsigned int y, unsigned int z) {
-            return m_blocks[x + (y * 8) + (z * 64)];
-        }
-
         void bind() {
             glBindVertexArray(m_vao);
             glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
@@ -623,37 +810,1387 @@ namespace abradinjapan::voxelize {
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         }
 
-        void send_to_gpu(float* vertices_buffer, float x, float y, float z) {
-            render_inside(vertices_buffer, x, y, z);
+        void set_ranges(unsigned long long body_length, const unsigned long long* seam_offsets, const unsigned long long* seam_lengths) {
+            m_body_length = body_length;
+
+            for (unsigned int i = 0; i < 6; i++) {
+                m_seam_offsets[i] = seam_offsets[i];
+                m_seam_lengths[i] = seam_lengths[i];
+            }
+        }
+
+        // size the gpu buffers and hand back pointers the mesher can write into directly
+        // the buffers are mapped when the driver allows it, otherwise, or when staged is set, the data is staged in the mesh arena and copied once in end_upload
+        void begin_upload(unsigned long long vbo_length, unsigned long long ebo_length, bool staged, float** vbo_data, unsigned int** ebo_data) {
+            // the new buffers replace the old ones on the gpu
+            g_memory_accounts.remove(mtt::mtt_gpu_vertices, (long long)(m_vbo_length * sizeof(float)));
+            g_memory_accounts.remove(mtt::mtt_gpu_indices, (long long)(m_ebo_length * sizeof(unsigned int)));
+            g_memory_accounts.add(mtt::mtt_gpu_vertices, (long long)(vbo_length * sizeof(float)));
+            g_memory_accounts.add(mtt::mtt_gpu_indices, (long long)(ebo_length * sizeof(unsigned int)));
+
+            m_vbo_length = vbo_length;
+            m_ebo_length = ebo_length;
+            m_mapped = false;
+            *vbo_data = 0;
+            *ebo_data = 0;
 
             bind();
-            
-            // send data to gpu
-            glBufferData(GL_ARRAY_BUFFER, m_vbo_length * sizeof(float), m_vbo_data, GL_DYNAMIC_DRAW);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_ebo_length * sizeof(unsigned int), m_ebo_data, GL_DYNAMIC_DRAW);
-            
+
+            // allocate gpu storage
+            glBufferData(GL_ARRAY_BUFFER, vbo_length * sizeof(float), 0, GL_DYNAMIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, ebo_length * sizeof(unsigned int), 0, GL_DYNAMIC_DRAW);
+
+            if (vbo_length == 0) {
+                return;
+            }
+            if (staged) {
+                *vbo_data = get_mesh_arena()->allocate<float>(vbo_length);
+                *ebo_data = get_mesh_arena()->allocate<unsigned int>(ebo_length);
+
+                return;
+            }
+
+            // map gpu storage
+            *vbo_data = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vbo_length * sizeof(float), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            *ebo_data = (unsigned int*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, ebo_length * sizeof(unsigned int), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+            if (*vbo_data != 0 && *ebo_data != 0) {
+                m_mapped = true;
+
+                return;
+            }
+
+            // fall back to staging
+            if (*vbo_data != 0) {
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            if (*ebo_data != 0) {
+                glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+            }
+
+            *vbo_data = get_mesh_arena()->allocate<float>(vbo_length);
+            *ebo_data = get_mesh_arena()->allocate<unsigned int>(ebo_length);
+        }
+
+        // false when the driver lost a mapped buffer before it was unmapped, its contents are undefined and the mesh has to be written again with staged set
+        bool end_upload(float* vbo_data, unsigned int* ebo_data) {
+            bool output = true;
+
+            if (m_mapped) {
+                // both have to be unmapped whatever the first one says
+                output = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+                output = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE && output;
+            } else if (m_vbo_length > 0) {
+                glBufferSubData(GL_ARRAY_BUFFER, 0, m_vbo_length * sizeof(float), vbo_data);
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_ebo_length * sizeof(unsigned int), ebo_data);
+
+                get_mesh_arena()->reset();
+            }
+
             // setup vertex buffer layout
             // positions
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, chunk_vertex_length * sizeof(float), (void*)0);
             glEnableVertexAttribArray(0);
             // texture coordinates
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, chunk_vertex_length * sizeof(float), (void*)(3 * sizeof(float)));
             glEnableVertexAttribArray(1);
+            // light
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, chunk_vertex_length * sizeof(float), (void*)(5 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            // ambient occlusion
+            glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, chunk_vertex_length * sizeof(float), (void*)(7 * sizeof(float)));
+            glEnableVertexAttribArray(3);
 
             unbind();
 
-            delete[] m_vbo_data;
-            delete[] m_ebo_data;
+            return output;
         }
 
-        void draw() {
-            glDrawElements(GL_TRIANGLES, m_ebo_length, GL_UNSIGNED_INT, 0);
+        // replace the start of the index buffer without touching the vertices, for reordering faces
+        void upload_indices(const unsigned int* indices, unsigned long long length) {
+            bind();
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, length * sizeof(unsigned int), indices);
+            unbind();
+        }
+
+        // seam_mask has bit (1 << st2) set for every side whose seam should be drawn
+        void draw(unsigned int seam_mask) {
+            glDrawElements(GL_TRIANGLES, m_body_length, GL_UNSIGNED_INT, 0);
+
+            for (unsigned int i = 0; i < 6; i++) {
+                if ((seam_mask & (1 << i)) && m_seam_lengths[i] > 0) {
+                    glDrawElements(GL_TRIANGLES, m_seam_lengths[i], GL_UNSIGNED_INT, (void*)(m_seam_offsets[i] * sizeof(unsigned int)));
+                }
+            }
+        }
+
+        void uninitialize() {
+            g_memory_accounts.remove(mtt::mtt_gpu_vertices, (long long)(m_vbo_length * sizeof(float)));
+            g_memory_accounts.remove(mtt::mtt_gpu_indices, (long long)(m_ebo_length * sizeof(unsigned int)));
+            m_vbo_length = 0;
+            m_ebo_length = 0;
+
+            glDeleteBuffers(1, &m_ebo);
+            glDeleteBuffers(1, &m_vbo);
+            glDeleteVertexArrays(1, &m_vao);
+        }
+    };
+
+    // render path type
+    enum rpt {
+        rpt_vertices, // every face expanded into six full vertices
+        rpt_faces // one face_record per face, the vertex shader rebuilds the corners
+    };
+
+    // one visible face for rpt_faces, read by the vertex shader from a buffer texture
+    // geometry: cell x, y and z (3 bits each), st2 (3), ambient occlusion per corner in tvt order (2 bits each), 4 unused bits, ldt (2)
+    // appearance: packed light (8), texture layer (16), which is the block type
+    struct face_record {
+        unsigned int geometry;
+        unsigned int appearance;
+    };
+
+    static_assert(sizeof(face_record) == 8, "face records are uploaded as two 32 bit texels");
+
+    // the gpu side of one chunk drawn with rpt_faces, seams are kept in ranges like chunk_mesh
+    // there are no vertex attributes, the buffer is read through a GL_RG32UI buffer texture on texture unit 1
+    class face_mesh {
+        GLuint m_vao, m_buffer, m_texture;
+        unsigned long long m_body_length;
+        unsigned long long m_seam_offsets[6];
+        unsigned long long m_seam_lengths[6];
+        unsigned long long m_face_count;
+        bool m_mapped;
+
+    public:
+        face_mesh() {
+            m_vao = 0;
+            m_buffer = 0;
+            m_texture = 0;
+            m_body_length = 0;
+            m_face_count = 0;
+            m_mapped = false;
+
+            for (unsigned int i = 0; i < 6; i++) {
+                m_seam_offsets[i] = 0;
+                m_seam_lengths[i] = 0;
+            }
+        }
+
+        void initialize() {
+            // setup opengl objects, the vertex array stays empty but core profiles cannot draw without one
+            glGenVertexArrays(1, &m_vao);
+            glGenBuffers(1, &m_buffer);
+            glGenTextures(1, &m_texture);
+        }
+
+        void bind() {
+            glBindVertexArray(m_vao);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        void unbind() {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindVertexArray(0);
+        }
+
+        // lengths and offsets are in faces
+        void set_ranges(unsigned long long body_length, const unsigned long long* seam_offsets, const unsigned long long* seam_lengths) {
+            m_body_length = body_length;
+
+            for (unsigned int i = 0; i < 6; i++) {
+                m_seam_offsets[i] = seam_offsets[i];
+                m_seam_lengths[i] = seam_lengths[i];
+            }
+        }
+
+        // size the buffer and hand back a pointer the mesher can write into directly, mapped or staged like chunk_mesh::begin_upload
+        void begin_upload(unsigned long long face_count, bool staged, face_record** faces) {
+            g_memory_accounts.remove(mtt::mtt_gpu_vertices, (long long)(m_face_count * sizeof(face_record)));
+            g_memory_accounts.add(mtt::mtt_gpu_vertices, (long long)(face_count * sizeof(face_record)));
+
+            m_face_count = face_count;
+            m_mapped = false;
+            *faces = 0;
+
+            // allocate gpu storage
+            glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+            glBufferData(GL_TEXTURE_BUFFER, face_count * sizeof(face_record), 0, GL_DYNAMIC_DRAW);
+
+            if (face_count == 0) {
+                return;
+            }
+            if (staged) {
+                *faces = get_mesh_arena()->allocate<face_record>(face_count);
+
+                return;
+            }
+
+            // map gpu storage
+            *faces = (face_record*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, face_count * sizeof(face_record), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+            if (*faces != 0) {
+                m_mapped = true;
+
+                return;
+            }
+
+            // fall back to staging
+            *faces = get_mesh_arena()->allocate<face_record>(face_count);
+        }
+
+        // false when the mapped buffer was lost, like chunk_mesh::end_upload
+        bool end_upload(face_record* faces) {
+            bool output = true;
+
+            if (m_mapped) {
+                output = glUnmapBuffer(GL_TEXTURE_BUFFER) == GL_TRUE;
+            } else if (m_face_count > 0) {
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, m_face_count * sizeof(face_record), faces);
+
+                get_mesh_arena()->reset();
+            }
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+            // the texture views whatever storage the buffer has now
+            if (m_face_count > 0) {
+                glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+                glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_buffer);
+                glBindTexture(GL_TEXTURE_BUFFER, 0);
+            }
+
+            return output;
+        }
+
+        // seam_mask has bit (1 << st2) set for every side whose seam should be drawn, each face is six vertices
+        void draw(unsigned int seam_mask) {
+            if (m_face_count == 0) {
+                return;
+            }
+
+            glDrawArrays(GL_TRIANGLES, 0, m_body_length * 6);
+
+            for (unsigned int i = 0; i < 6; i++) {
+                if ((seam_mask & (1 << i)) && m_seam_lengths[i] > 0) {
+                    glDrawArrays(GL_TRIANGLES, m_seam_offsets[i] * 6, m_seam_lengths[i] * 6);
+                }
+            }
+        }
+
+        void uninitialize() {
+            g_memory_accounts.remove(mtt::mtt_gpu_vertices, (long long)(m_face_count * sizeof(face_record)));
+            m_face_count = 0;
+
+            glDeleteTextures(1, &m_texture);
+            glDeleteBuffers(1, &m_buffer);
+            glDeleteVertexArrays(1, &m_vao);
+        }
+    };
+
+    // counts translucent mesh uploads across every chunk, so a chunk version is never reused by another chunk in the same world slot
+    inline unsigned long long g_translucent_uploads = 0;
+
+    class chunk_888 {
+        const unsigned short m_side_length = 8;
+        const unsigned short m_block_count = 512;
+        unsigned short m_blocks[512];
+        unsigned short m_blocks_half[64];
+        unsigned short m_blocks_quarter[8];
+        unsigned short m_blocks_eighth[1];
+        unsigned char m_light[512];
+        unsigned char m_fluid[512]; // only ever set on air blocks
+        // one bit per block, a mask for each z layer with bit (x + (y * 8))
+        unsigned long long m_solid_masks[8];
+        chunk_888* m_neighbours[6];
+        bool m_dirty;
+        bool m_initialized; // whether the meshes hold gpu objects
+        rpt m_render_path; // which set of meshes is in use
+        chunk_mesh m_meshes[ldt_count];
+        face_mesh m_face_meshes[ldt_count];
+        chunk_mesh m_translucent_mesh; // fluid faces, full detail only and drawn after everything opaque
+        unsigned long long m_translucent_faces;
+        unsigned long long m_translucent_version; // changes with every upload of the translucent mesh, 0 before the first
+        float m_translucent_origin[3]; // where the translucent mesh was drawn from
+
+    public:
+        chunk_888() {
+            for (unsigned int i = 0; i < 512; i++) {
+                m_light[i] = 0;
+                m_fluid[i] = 0;
+            }
+            for (unsigned int i = 0; i < 6; i++) {
+                m_neighbours[i] = 0;
+            }
+            for (unsigned int i = 0; i < 8; i++) {
+                m_solid_masks[i] = 0;
+            }
+            m_dirty = true;
+            m_initialized = false;
+            m_render_path = rpt::rpt_vertices;
+            m_translucent_faces = 0;
+            m_translucent_version = 0;
+            for (unsigned int i = 0; i < 3; i++) {
+                m_translucent_origin[i] = 0.0f;
+            }
+        }
+
+    private:
+        // the rpt_faces counterpart of emit_face, x, y and z are the cell within the level of detail
+        // the vertex shader picks the diagonal from the ambient occlusion the same way emit_face does
+        void write_face_record(face_record* faces, unsigned int* index, int x, int y, int z, ldt level, st2 surface_type, unsigned char light, unsigned char* ambient_occlusion, unsigned short block) {
+            faces[*index].geometry = x | (y << 3) | (z << 6) | (surface_type << 9) | (ambient_occlusion[0] << 12) | (ambient_occlusion[1] << 14) | (ambient_occlusion[2] << 16) | (ambient_occlusion[3] << 18) | (level << 24);
+            faces[*index].appearance = light | (block << 8);
+            *index += 1;
+        }
+
+        bool bounds_check_face(unsigned short* blocks, int side_count, int x, int y, int z, st2 face) {
+            const bool sides = false;
+
+            if (face == st2::st2_front) {
+                if (z == side_count - 1) {
+                    return sides;
+                }
+                if (blocks[x + (y * side_count) + ((z + 1) * side_count * side_count)] > 0) {
+                    return false;
+                }
+            }
+            if (face == st2::st2_back) {
+                if (z == 0) {
+                    return sides;
+                }
+                if (blocks[x + (y * side_count) + ((z - 1) * side_count * side_count)] > 0) {
+                    return false;
+                }
+            }
+            if (face == st2::st2_top) {
+                if (y == side_count - 1) {
+                    return sides;
+                }
+                if (blocks[x + ((y + 1) * side_count) + (z * side_count * side_count)] > 0) {
+                    return false;
+                }
+            }
+            if (face == st2::st2_bottom) {
+                if (y == 0) {
+                    return sides;
+                }
+                if (blocks[x + ((y - 1) * side_count) + (z * side_count * side_count)] > 0) {
+                    return false;
+                }
+            }
+            if (face == st2::st2_right) {
+                if (x == side_count - 1) {
+                    return sides;
+                }
+                if (blocks[x + 1 + (y * side_count) + (z * side_count * side_count)] > 0) {
+                    return false;
+                }
+            }
+            if (face == st2::st2_left) {
+                if (x == 0) {
+                    return sides;
+                }
+                if (blocks[x - 1 + (y * side_count) + (z * side_count * side_count)] > 0) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool is_on_side(int side_count, int x, int y, int z, st2 face) {
+            switch (face) {
+            case st2::st2_front:
+                return z == side_count - 1;
+            case st2::st2_back:
+                return z == 0;
+            case st2::st2_top:
+                return y == side_count - 1;
+            case st2::st2_bottom:
+                return y == 0;
+            case st2::st2_right:
+                return x == side_count - 1;
+            case st2::st2_left:
+                return x == 0;
+            }
+
+            return false;
+        }
+
+        // shrink a cube of blocks by two on every axis
+        // a cell stays solid when at least half of its 8 children are solid, so ties keep thin surfaces instead of eroding them
+        // the cell takes the most common solid block among its children
+        void downsample_blocks(unsigned short* source, unsigned int source_side_count, unsigned short* destination) {
+            unsigned int destination_side_count = source_side_count / 2;
+            unsigned short children[8];
+            unsigned int solid_count;
+            unsigned int best_count;
+            unsigned int count;
+
+            for (unsigned int x = 0; x < destination_side_count; x++) {
+                for (unsigned int y = 0; y < destination_side_count; y++) {
+                    for (unsigned int z = 0; z < destination_side_count; z++) {
+                        solid_count = 0;
+
+                        // gather children
+                        for (unsigned int i = 0; i < 8; i++) {
+                            children[i] = source[((x * 2) + (i & 1)) + (((y * 2) + ((i >> 1) & 1)) * source_side_count) + (((z * 2) + ((i >> 2) & 1)) * source_side_count * source_side_count)];
+
+                            if (children[i] != 0) {
+                                solid_count++;
+                            }
+                        }
+
+                        unsigned short* cell = &destination[x + (y * destination_side_count) + (z * destination_side_count * destination_side_count)];
+
+                        // majority vote on solidity
+                        if (solid_count < 4) {
+                            *cell = 0;
+
+                            continue;
+                        }
+
+                        // most common solid block
+                        best_count = 0;
+                        for (unsigned int i = 0; i < 8; i++) {
+                            if (children[i] == 0) {
+                                continue;
+                            }
+
+                            count = 0;
+                            for (unsigned int j = 0; j < 8; j++) {
+                                if (children[j] == children[i]) {
+                                    count++;
+                                }
+                            }
+
+                            if (count > best_count) {
+                                best_count = count;
+                                *cell = children[i];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // the light of the block in front of a face, looking into the neighbouring chunk when the face is on a border
+        // anything past the edge of the world is open sky
+        unsigned char get_light_beside(int x, int y, int z, st2 face) {
+            chunk_888* chunk = this;
+
+            x += st2_offsets[face][0];
+            y += st2_offsets[face][1];
+            z += st2_offsets[face][2];
+
+            if (x < 0 || y < 0 || z < 0 || x > 7 || y > 7 || z > 7) {
+                chunk = m_neighbours[face];
+
+                if (chunk == 0) {
+                    return pack_light(15, 0);
+                }
+            }
+
+            return chunk->m_light[(x & 7) + ((y & 7) * 8) + ((z & 7) * 64)];
+        }
+
+        // coarse cells sample the full size block beside their first corner on that face
+        unsigned char get_face_light(ldt level, int x, int y, int z, st2 face) {
+            int factor = 1 << level;
+
+            x *= factor;
+            y *= factor;
+            z *= factor;
+
+            if (st2_offsets[face][0] > 0) {
+                x += factor - 1;
+            }
+            if (st2_offsets[face][1] > 0) {
+                y += factor - 1;
+            }
+            if (st2_offsets[face][2] > 0) {
+                z += factor - 1;
+            }
+
+            return get_light_beside(x, y, z, face);
+        }
+
+        // the chunk holding any full size block in or next to this one, diagonals included, 0 past the edge of the world
+        chunk_888* get_chunk_holding(int x, int y, int z) {
+            chunk_888* chunk = this;
+
+            if (x < 0) {
+                chunk = chunk->m_neighbours[st2::st2_left];
+            } else if (x > 7) {
+                chunk = chunk->m_neighbours[st2::st2_right];
+            }
+            if (chunk != 0 && y < 0) {
+                chunk = chunk->m_neighbours[st2::st2_bottom];
+            } else if (chunk != 0 && y > 7) {
+                chunk = chunk->m_neighbours[st2::st2_top];
+            }
+            if (chunk != 0 && z < 0) {
+                chunk = chunk->m_neighbours[st2::st2_back];
+            } else if (chunk != 0 && z > 7) {
+                chunk = chunk->m_neighbours[st2::st2_front];
+            }
+
+            return chunk;
+        }
+
+        // solidity of any full size block next to this chunk
+        bool is_solid_beside(int x, int y, int z) {
+            chunk_888* chunk = get_chunk_holding(x, y, z);
+
+            if (chunk == 0) {
+                return false;
+            }
+
+            return chunk->m_blocks[(x & 7) + ((y & 7) * 8) + ((z & 7) * 64)] != 0;
+        }
+
+        // classic corner occlusion from the two edge blocks and the corner block in front of each face corner, 0 is fully occluded and 3 is open
+        // coarse levels of detail are far enough away to skip it
+        void get_face_ambient_occlusion(ldt level, int x, int y, int z, st2 face, unsigned char* ambient_occlusion) {
+            int front[3];
+            int side_1[3];
+            int side_2[3];
+            int axis_1, axis_2;
+            bool solid_1, solid_2, solid_corner;
+
+            if (level != ldt::ldt_full) {
+                for (unsigned int i = 0; i < 4; i++) {
+                    ambient_occlusion[i] = 3;
+                }
+
+                return;
+            }
+
+            // the two axes along the face
+            axis_1 = st2_offsets[face][0] != 0 ? 1 : 0;
+            axis_2 = st2_offsets[face][2] != 0 ? 1 : 2;
+
+            front[0] = x + st2_offsets[face][0];
+            front[1] = y + st2_offsets[face][1];
+            front[2] = z + st2_offsets[face][2];
+
+            for (unsigned int i = 0; i < 4; i++) {
+                const int* corner = cvt_directions[st2_corners[face][i]];
+
+                for (unsigned int j = 0; j < 3; j++) {
+                    side_1[j] = front[j];
+                    side_2[j] = front[j];
+                }
+                side_1[axis_1] += corner[axis_1];
+                side_2[axis_2] += corner[axis_2];
+
+                solid_1 = is_solid_beside(side_1[0], side_1[1], side_1[2]);
+                solid_2 = is_solid_beside(side_2[0], side_2[1], side_2[2]);
+                solid_corner = is_solid_beside(side_1[0] + (side_2[0] - front[0]), side_1[1] + (side_2[1] - front[1]), side_1[2] + (side_2[2] - front[2]));
+
+                if (solid_1 && solid_2) {
+                    ambient_occlusion[i] = 0;
+                } else {
+                    ambient_occlusion[i] = 3 - (solid_1 + solid_2 + solid_corner);
+                }
+            }
+        }
+
+        // fluid of any full size block next to this chunk, 0 past the edge of the world
+        unsigned char get_fluid_beside(int x, int y, int z) {
+            chunk_888* chunk = get_chunk_holding(x, y, z);
+
+            if (chunk == 0) {
+                return 0;
+            }
+
+            return chunk->m_fluid[(x & 7) + ((y & 7) * 8) + ((z & 7) * 64)];
+        }
+
+        // a fluid face shows wherever the block beside it is neither solid nor holding fluid
+        bool is_fluid_face_visible(int x, int y, int z, st2 face) {
+            if (m_fluid[x + (y * 8) + (z * 64)] == 0) {
+                return false;
+            }
+
+            x += st2_offsets[face][0];
+            y += st2_offsets[face][1];
+            z += st2_offsets[face][2];
+
+            return !is_solid_beside(x, y, z) && get_fluid_beside(x, y, z) == 0;
+        }
+
+        // fluid is only meshed at full detail, the top of a partly filled block sits at its level
+        void render_fluid(float* points, unsigned int* points_index, float x_offset, float y_offset, float z_offset) {
+            unsigned char ambient_occlusion[4] = { 3, 3, 3, 3 };
+            float side_length = 1.0f / 8.0f;
+            float top, drop;
+            unsigned int first;
+
+            for (int x = 0; x < 8; x++) {
+                for (int y = 0; y < 8; y++) {
+                    for (int z = 0; z < 8; z++) {
+                        if (m_fluid[x + (y * 8) + (z * 64)] == 0) {
+                            continue;
+                        }
+
+                        top = side_length * (float)z + z_offset;
+                        drop = 0.0f;
+                        if (get_fluid_beside(x, y, z + 1) == 0) {
+                            drop = side_length * (1.0f - ((float)get_fluid_level(m_fluid[x + (y * 8) + (z * 64)]) / (float)fluid_max_level));
+                        }
+
+                        for (unsigned int i = 0; i < 6; i++) {
+                            if (is_fluid_face_visible(x, y, z, (st2)i)) {
+                                first = *points_index;
+                                lit_face_emitters[i](points, points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, top, side_length, get_face_light(ldt::ldt_full, x, y, z, (st2)i), ambient_occlusion);
+
+                                // lower the corners along the top of the block
+                                for (unsigned int j = first; j < *points_index; j += chunk_vertex_length) {
+                                    if (points[j + 2] == top) {
+                                        points[j + 2] -= drop;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        void build_lods() {
+            downsample_blocks(m_blocks, 8, m_blocks_half);
+            downsample_blocks(m_blocks_half, 4, m_blocks_quarter);
+            downsample_blocks(m_blocks_quarter, 2, m_blocks_eighth);
+        }
+
+        unsigned short* get_lod_blocks(ldt level) {
+            switch (level) {
+            case ldt::ldt_full:
+                return m_blocks;
+            case ldt::ldt_half:
+                return m_blocks_half;
+            case ldt::ldt_quarter:
+                return m_blocks_quarter;
+            case ldt::ldt_eighth:
+                return m_blocks_eighth;
+            }
+
+            return m_blocks;
+        }
+
+        // first pass of meshing, counts the faces so the output can be sized before anything is written
+        void count_faces(ldt level, unsigned long long* body_length, unsigned long long* seam_lengths) {
+            unsigned short* blocks = get_lod_blocks(level);
+            int side_count = m_side_length >> level;
+
+            *body_length = 0;
+            for (unsigned int i = 0; i < 6; i++) {
+                seam_lengths[i] = 0;
+            }
+
+            for (int x = 0; x < side_count; x++) {
+                for (int y = 0; y < side_count; y++) {
+                    for (int z = 0; z < side_count; z++) {
+                        if (blocks[x + (y * side_count) + (z * side_count * side_count)] != 0) {
+                            for (unsigned int i = 0; i < 6; i++) {
+                                if (bounds_check_face(blocks, side_count, x, y, z, (st2)i)) {
+                                    *body_length += 1;
+                                }
+                                if (is_on_side(side_count, x, y, z, (st2)i)) {
+                                    seam_lengths[i] += 1;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // fluid faces go in the translucent mesh instead
+        unsigned long long count_translucent_faces() {
+            unsigned long long output = 0;
+
+            for (int x = 0; x < 8; x++) {
+                for (int y = 0; y < 8; y++) {
+                    for (int z = 0; z < 8; z++) {
+                        for (unsigned int i = 0; i < 6; i++) {
+                            if (is_fluid_face_visible(x, y, z, (st2)i)) {
+                                output++;
+                            }
+                        }
+                    }
+                }
+            }
+
+            return output;
+        }
+
+        // second pass of meshing, writes every vertex exactly once into its final destination
+        void render_inside(float* points, ldt level, float x_offset, float y_offset, float z_offset) {
+            unsigned short* blocks = get_lod_blocks(level);
+            int side_count = m_side_length >> level;
+            float side_length = 1.0f / (float)side_count;
+            // faces extend toward -z from their corner, so coarse cells are anchored on their last full size block to line up with ldt_full
+            float z_anchor = side_length - (1.0f / 8.0f);
+            unsigned int points_index = 0;
+            unsigned char ambient_occlusion[4];
+            st2 sides[] = {
+                st2::st2_front,
+                st2::st2_bottom,
+                st2::st2_left,
+                st2::st2_back,
+                st2::st2_top,
+                st2::st2_right
+            };
+
+            // generate all points
+            for (int x = 0; x < side_count; x++) {
+                for (int y = 0; y < side_count; y++) {
+                    for (int z = 0; z < side_count; z++) {
+                        if (blocks[x + (y * side_count) + (z * side_count * side_count)] != 0) {
+                            for (unsigned int i = 0; i < 6; i++) {
+                                if (bounds_check_face(blocks, side_count, x, y, z, sides[i])) {
+                                    get_face_ambient_occlusion(level, x, y, z, sides[i], ambient_occlusion);
+                                    lit_face_emitters[sides[i]](points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_anchor + z_offset, side_length, get_face_light(level, x, y, z, sides[i]), ambient_occlusion);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            // generate seams
+            // every solid cell on a border gets an outward face so that cracks against a neighbour of a different level of detail are closed
+            for (unsigned int i = 0; i < 6; i++) {
+                for (int x = 0; x < side_count; x++) {
+                    for (int y = 0; y < side_count; y++) {
+                        for (int z = 0; z < side_count; z++) {
+                            if (blocks[x + (y * side_count) + (z * side_count * side_count)] != 0 && is_on_side(side_count, x, y, z, (st2)i)) {
+                                get_face_ambient_occlusion(level, x, y, z, (st2)i, ambient_occlusion);
+                                lit_face_emitters[i](points, &points_index, side_length * (float)x + x_offset, side_length * (float)y + y_offset, side_length * (float)z + z_anchor + z_offset, side_length, get_face_light(level, x, y, z, (st2)i), ambient_occlusion);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // render_inside for rpt_faces, the same faces in the same order with one record each
+        // fluid is translucent and always drawn from vertices, see send_translucent_to_gpu
+        void render_faces(face_record* faces, ldt level) {
+            unsigned short* blocks = get_lod_blocks(level);
+            int side_count = m_side_length >> level;
+            unsigned int faces_index = 0;
+            unsigned char ambient_occlusion[4];
+            unsigned short block;
+
+            for (int x = 0; x < side_count; x++) {
+                for (int y = 0; y < side_count; y++) {
+                    for (int z = 0; z < side_count; z++) {
+                        block = blocks[x + (y * side_count) + (z * side_count * side_count)];
+                        if (block != 0) {
+                            for (unsigned int i = 0; i < 6; i++) {
+                                if (bounds_check_face(blocks, side_count, x, y, z, (st2)i)) {
+                                    get_face_ambient_occlusion(level, x, y, z, (st2)i, ambient_occlusion);
+                                    write_face_record(faces, &faces_index, x, y, z, level, (st2)i, get_face_light(level, x, y, z, (st2)i), ambient_occlusion, block);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            // seams
+            for (unsigned int i = 0; i < 6; i++) {
+                for (int x = 0; x < side_count; x++) {
+                    for (int y = 0; y < side_count; y++) {
+                        for (int z = 0; z < side_count; z++) {
+                            block = blocks[x + (y * side_count) + (z * side_count * side_count)];
+                            if (block != 0 && is_on_side(side_count, x, y, z, (st2)i)) {
+                                get_face_ambient_occlusion(level, x, y, z, (st2)i, ambient_occlusion);
+                                write_face_record(faces, &faces_index, x, y, z, level, (st2)i, get_face_light(level, x, y, z, (st2)i), ambient_occlusion, block);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // refresh the solid mask of one row of blocks along x, and push fluid out of the solid ones
+        void sync_row(unsigned int y, unsigned int z) {
+            unsigned int solid = 0;
+
+#ifdef __SSE2__
+            __m128i row = _mm_loadu_si128((__m128i*)&m_blocks[(y * 8) + (z * 64)]);
+            __m128i air = _mm_cmpeq_epi16(row, _mm_setzero_si128());
+            // one byte per block, all ones where there is air
+            __m128i air_bytes = _mm_packs_epi16(air, air);
+            __m128i fluid = _mm_loadl_epi64((__m128i*)&m_fluid[(y * 8) + (z * 64)]);
+
+            solid = ~_mm_movemask_epi8(air_bytes) & 0xFF;
+            _mm_storel_epi64((__m128i*)&m_fluid[(y * 8) + (z * 64)], _mm_and_si128(fluid, air_bytes));
+#else
+            for (unsigned int x = 0; x < 8; x++) {
+                if (m_blocks[x + (y * 8) + (z * 64)] != 0) {
+                    solid |= 1 << x;
+                    m_fluid[x + (y * 8) + (z * 64)] = 0;
+                }
+            }
+#endif
+
+            m_solid_masks[z] = (m_solid_masks[z] & ~(0xFFull << (y * 8))) | ((unsigned long long)solid << (y * 8));
+        }
+
+    public:
+        void set_chunk_data_as_air() {
+            for (unsigned int i = 0; i < 512; i++) {
+                m_blocks[i] = 0;
+                m_fluid[i] = 0;
+            }
+            for (unsigned int i = 0; i < 8; i++) {
+                m_solid_masks[i] = 0;
+            }
+        }
+
+        void set_chunk_data_as_random() {
+            std::random_device random_device;
+            std::mt19937 random_number_generator(random_device());
+
+            for (unsigned int i = 0; i < 512; i++) {
+                set_block_at(i & 7, (i >> 3) & 7, i >> 6, random_number_generator() % 2);
+            }
+        }
+
+        // only the meshes of the chosen render path get gpu objects
+        void initialize(rpt render_path) {
+            m_render_path = render_path;
+
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                if (m_render_path == rpt::rpt_faces) {
+                    m_face_meshes[i].initialize();
+                } else {
+                    m_meshes[i].initialize();
+                }
+            }
+            m_translucent_mesh.initialize();
+
+            m_initialized = true;
+        }
+
+        bool is_initialized() {
+            return m_initialized;
+        }
+
+        // whole chunk fast path for bulk edits
+        void fill(unsigned short value) {
+            for (unsigned int i = 0; i < 512; i++) {
+                m_blocks[i] = value;
+            }
+            for (unsigned int i = 0; i < 8; i++) {
+                m_solid_masks[i] = value != 0 ? ~0ull : 0ull;
+            }
+            if (value != 0) {
+                for (unsigned int i = 0; i < 512; i++) {
+                    m_fluid[i] = 0;
+                }
+            }
+        }
+
+        // set blocks x1 to x2 inclusive of one row, leaving the rest of the row alone
+        void fill_row(unsigned int x1, unsigned int x2, unsigned int y, unsigned int z, unsigned short value) {
+#ifdef __SSE2__
+            __m128i* address = (__m128i*)&m_blocks[(y * 8) + (z * 64)];
+            __m128i lanes = _mm_set_epi16(7, 6, 5, 4, 3, 2, 1, 0);
+            __m128i inside = _mm_and_si128(_mm_cmpgt_epi16(lanes, _mm_set1_epi16((short)x1 - 1)), _mm_cmplt_epi16(lanes, _mm_set1_epi16((short)x2 + 1)));
+            __m128i row = _mm_loadu_si128(address);
+
+            _mm_storeu_si128(address, _mm_or_si128(_mm_and_si128(inside, _mm_set1_epi16((short)value)), _mm_andnot_si128(inside, row)));
+#else
+            for (unsigned int x = x1; x <= x2; x++) {
+                m_blocks[x + (y * 8) + (z * 64)] = value;
+            }
+#endif
+
+            sync_row(y, z);
+        }
+
+        // swap one block type for another within blocks x1 to x2 inclusive of one row
+        void replace_row(unsigned int x1, unsigned int x2, unsigned int y, unsigned int z, unsigned short from, unsigned short to) {
+#ifdef __SSE2__
+            __m128i* address = (__m128i*)&m_blocks[(y * 8) + (z * 64)];
+            __m128i lanes = _mm_set_epi16(7, 6, 5, 4, 3, 2, 1, 0);
+            __m128i row = _mm_loadu_si128(address);
+            __m128i inside = _mm_and_si128(_mm_cmpgt_epi16(lanes, _mm_set1_epi16((short)x1 - 1)), _mm_cmplt_epi16(lanes, _mm_set1_epi16((short)x2 + 1)));
+            __m128i matches = _mm_and_si128(inside, _mm_cmpeq_epi16(row, _mm_set1_epi16((short)from)));
+
+            _mm_storeu_si128(address, _mm_or_si128(_mm_and_si128(matches, _mm_set1_epi16((short)to)), _mm_andnot_si128(matches, row)));
+#else
+            for (unsigned int x = x1; x <= x2; x++) {
+                if (m_blocks[x + (y * 8) + (z * 64)] == from) {
+                    m_blocks[x + (y * 8) + (z * 64)] = to;
+                }
+            }
+#endif
+
+            sync_row(y, z);
+        }
+
+        // copy blocks x1 to x2 inclusive of one row in from source, which starts at x1
+        void paste_row(unsigned int x1, unsigned int x2, unsigned int y, unsigned int z, unsigned short* source) {
+            memcpy(&m_blocks[x1 + (y * 8) + (z * 64)], source, (x2 - x1 + 1) * sizeof(unsigned short));
+
+            sync_row(y, z);
+        }
+
+        // copy blocks x1 to x2 inclusive of one row out to destination
+        void copy_row(unsigned int x1, unsigned int x2, unsigned int y, unsigned int z, unsigned short* destination) {
+            memcpy(destination, &m_blocks[x1 + (y * 8) + (z * 64)], (x2 - x1 + 1) * sizeof(unsigned short));
+        }
+
+        void set_block_at(unsigned int x, unsigned int y, unsigned int z, unsigned short value) {
+            m_blocks[x + (y * 8) + (z * 64)] = value;
+
+            // solid blocks push out any fluid
+            if (value != 0) {
+                m_solid_masks[z] |= 1ull << (x + (y * 8));
+                m_fluid[x + (y * 8) + (z * 64)] = 0;
+            } else {
+                m_solid_masks[z] &= ~(1ull << (x + (y * 8)));
+            }
+        }
+
+        bool is_solid_at(unsigned int x, unsigned int y, unsigned int z) {
+            return (m_solid_masks[z] >> (x + (y * 8))) & 1;
+        }
+
+        // one bit per block of a z layer, bit (x + (y * 8))
+        unsigned long long get_solid_mask(unsigned int z) {
+            return m_solid_masks[z];
+        }
+
+        // true when any block in the inclusive box is solid, tests a whole x / y layer per mask operation
+        bool is_box_solid(unsigned int x1, unsigned int y1, unsigned int z1, unsigned int x2, unsigned int y2, unsigned int z2) {
+            unsigned long long row = (0xFFull >> (7 - (x2 - x1))) << x1;
+            unsigned long long box = 0;
+
+            for (unsigned int y = y1; y <= y2; y++) {
+                box |= row << (y * 8);
+            }
+
+            for (unsigned int z = z1; z <= z2; z++) {
+                if (m_solid_masks[z] & box) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        unsigned short get_block_at(unsigned int x, unsigned int y, unsigned int z) {
+            return m_blocks[x + (y * 8) + (z * 64)];
+        }
+
+        void set_fluid_at(unsigned int x, unsigned int y, unsigned int z, unsigned char value) {
+            m_fluid[x + (y * 8) + (z * 64)] = value;
+        }
+
+        unsigned char get_fluid_at(unsigned int x, unsigned int y, unsigned int z) {
+            return m_fluid[x + (y * 8) + (z * 64)];
+        }
+
+        void set_light_at(unsigned int x, unsigned int y, unsigned int z, unsigned char value) {
+            m_light[x + (y * 8) + (z * 64)] = value;
+        }
+
+        unsigned char get_light_at(unsigned int x, unsigned int y, unsigned int z) {
+            return m_light[x + (y * 8) + (z * 64)];
+        }
+
+        void set_neighbour(st2 side, chunk_888* neighbour) {
+            m_neighbours[side] = neighbour;
+        }
+
+        chunk_888* get_neighbour(st2 side) {
+            return m_neighbours[side];
+        }
+
+        // a dirty chunk needs to be remeshed
+        void mark_dirty() {
+            m_dirty = true;
+        }
+
+        bool is_dirty() {
+            return m_dirty;
+        }
+
+        void bind(ldt level) {
+            if (m_render_path == rpt::rpt_faces) {
+                m_face_meshes[level].bind();
+            } else {
+                m_meshes[level].bind();
+            }
+        }
+
+        void unbind(ldt level) {
+            if (m_render_path == rpt::rpt_faces) {
+                m_face_meshes[level].unbind();
+            } else {
+                m_meshes[level].unbind();
+            }
+        }
+
+        // everything meshing reads: this chunk's blocks, light and fluid, the solidity, light and fluid of the shell of blocks around it, and where it is drawn
+        // the same hash means the same mesh, as long as the mesher_version is the same too
+        unsigned long long get_mesh_hash(float x, float y, float z) {
+            float position[3] = { x, y, z };
+            unsigned int shell[1000 - 512];
+            unsigned int shell_count = 0;
+            chunk_888* chunk;
+            unsigned long long output;
+
+            for (int i = -1; i <= 8; i++) {
+                for (int j = -1; j <= 8; j++) {
+                    for (int k = -1; k <= 8; k++) {
+                        if (i >= 0 && j >= 0 && k >= 0 && i <= 7 && j <= 7 && k <= 7) {
+                            continue;
+                        }
+
+                        chunk = get_chunk_holding(i, j, k);
+                        if (chunk == 0) {
+                            shell[shell_count] = 0xFFFFFFFF;
+                        } else {
+                            shell[shell_count] = (chunk->m_blocks[(i & 7) + ((j & 7) * 8) + ((k & 7) * 64)] != 0 ? 1 : 0) | (chunk->m_fluid[(i & 7) + ((j & 7) * 8) + ((k & 7) * 64)] << 8) | (chunk->m_light[(i & 7) + ((j & 7) * 8) + ((k & 7) * 64)] << 16);
+                        }
+                        shell_count++;
+                    }
+                }
+            }
+
+            output = hash_bytes(position, sizeof(position), mesher_version);
+            output = hash_bytes(m_blocks, sizeof(m_blocks), output);
+            output = hash_bytes(m_light, sizeof(m_light), output);
+            output = hash_bytes(m_fluid, sizeof(m_fluid), output);
+
+            return hash_bytes(shell, sizeof(shell), output);
+        }
+
+        // the meshing half of send_to_gpu into memory from the mesh arena, so the vertices can be kept as well as uploaded
+        // lengths are in vertices with the seams following the body in st2 order, returns the vertex count and leaves the arena for the caller to reset
+        unsigned long long mesh_to_memory(ldt level, float x, float y, float z, float** vertices, unsigned long long* body_length, unsigned long long* seam_lengths) {
+            unsigned long long vertex_count;
+
+            build_lods();
+            count_faces(level, body_length, seam_lengths);
+
+            *body_length *= 6;
+            vertex_count = *body_length;
+            for (unsigned int i = 0; i < 6; i++) {
+                seam_lengths[i] *= 6;
+                vertex_count += seam_lengths[i];
+            }
+
+            *vertices = 0;
+            if (vertex_count > 0) {
+                *vertices = get_mesh_arena()->allocate<float>(vertex_count * chunk_vertex_length);
+                render_inside(*vertices, level, x, y, z);
+            }
+
+            return vertex_count;
+        }
+
+        // mesh_to_memory for rpt_faces, lengths are in faces and the records do not depend on where the chunk is drawn
+        unsigned long long faces_to_memory(ldt level, face_record** faces, unsigned long long* body_length, unsigned long long* seam_lengths) {
+            unsigned long long face_count;
+
+            build_lods();
+            count_faces(level, body_length, seam_lengths);
+
+            face_count = *body_length;
+            for (unsigned int i = 0; i < 6; i++) {
+                face_count += seam_lengths[i];
+            }
+
+            *faces = 0;
+            if (face_count > 0) {
+                *faces = get_mesh_arena()->allocate<face_record>(face_count);
+                render_faces(*faces, level);
+            }
+
+            return face_count;
+        }
+
+        // upload a mesh built earlier, by mesh_to_memory or in a previous run
+        void upload_mesh(ldt level, const float* vertices, unsigned long long vertex_count, unsigned long long body_length, const unsigned long long* seam_lengths) {
+            unsigned long long seam_offsets[6];
+            unsigned long long offset = body_length;
+            float* vbo_data;
+            unsigned int* ebo_data;
+            bool staged = false;
+
+            for (unsigned int i = 0; i < 6; i++) {
+                seam_offsets[i] = offset;
+                offset += seam_lengths[i];
+            }
+
+            m_meshes[level].set_ranges(body_length, seam_offsets, seam_lengths);
+
+            // a lost mapping is written again through the staging path
+            do {
+                m_meshes[level].begin_upload(vertex_count * chunk_vertex_length, vertex_count, staged, &vbo_data, &ebo_data);
+
+                if (vertex_count > 0) {
+                    memcpy(vbo_data, vertices, vertex_count * chunk_vertex_length * sizeof(float));
+
+                    for (unsigned int i = 0; i < vertex_count; i++) {
+                        ebo_data[i] = i;
+                    }
+                }
+
+                staged = true;
+            } while (!m_meshes[level].end_upload(vbo_data, ebo_data));
+        }
+
+        // for meshes uploaded without send_to_gpu
+        void mark_clean() {
+            m_dirty = false;
+        }
+
+        // the fluid faces in the order they are meshed, translucency_sorter puts them back to front later
+        void send_translucent_to_gpu(float x, float y, float z) {
+            unsigned long long no_seams[6] = { 0, 0, 0, 0, 0, 0 };
+            unsigned long long vertex_count = count_translucent_faces() * 6;
+            unsigned int points_index = 0;
+            float* vbo_data;
+            unsigned int* ebo_data;
+            bool staged = false;
+
+            m_translucent_mesh.set_ranges(vertex_count, no_seams, no_seams);
+
+            // a lost mapping is written again through the staging path
+            do {
+                m_translucent_mesh.begin_upload(vertex_count * chunk_vertex_length, vertex_count, staged, &vbo_data, &ebo_data);
+
+                if (vertex_count > 0) {
+                    points_index = 0;
+                    render_fluid(vbo_data, &points_index, x, y, z);
+
+                    for (unsigned int i = 0; i < vertex_count; i++) {
+                        ebo_data[i] = i;
+                    }
+                }
+
+                staged = true;
+            } while (!m_translucent_mesh.end_upload(vbo_data, ebo_data));
+
+            m_translucent_faces = vertex_count / 6;
+            m_translucent_origin[0] = x;
+            m_translucent_origin[1] = y;
+            m_translucent_origin[2] = z;
+            g_translucent_uploads++;
+            m_translucent_version = g_translucent_uploads;
+        }
+
+        // the face records of every level straight into their buffers, the shader is told where the chunk is drawn
+        void send_faces_to_gpu(float x, float y, float z) {
+            unsigned long long body_length;
+            unsigned long long seam_offsets[6];
+            unsigned long long seam_lengths[6];
+            unsigned long long face_count;
+            face_record* faces;
+            bool staged;
+
+            build_lods();
+            m_dirty = false;
+
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                count_faces((ldt)i, &body_length, seam_lengths);
+
+                face_count = body_length;
+                for (unsigned int j = 0; j < 6; j++) {
+                    seam_offsets[j] = face_count;
+                    face_count += seam_lengths[j];
+                }
+
+                m_face_meshes[i].set_ranges(body_length, seam_offsets, seam_lengths);
+
+                // a lost mapping is written again through the staging path
+                staged = false;
+                do {
+                    m_face_meshes[i].begin_upload(face_count, staged, &faces);
+
+                    if (face_count > 0) {
+                        render_faces(faces, (ldt)i);
+                    }
+
+                    staged = true;
+                } while (!m_face_meshes[i].end_upload(faces));
+            }
+
+            send_translucent_to_gpu(x, y, z);
+        }
+
+        void send_to_gpu(float x, float y, float z) {
+            unsigned long long body_length;
+            unsigned long long seam_offsets[6];
+            unsigned long long seam_lengths[6];
+            unsigned long long vertex_count;
+            float* vbo_data;
+            unsigned int* ebo_data;
+            bool staged;
+
+            if (m_render_path == rpt::rpt_faces) {
+                send_faces_to_gpu(x, y, z);
+
+                return;
+            }
+
+            build_lods();
+            m_dirty = false;
+
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                // size the mesh, seams follow the body in st2 order
+                count_faces((ldt)i, &body_length, seam_lengths);
+
+                body_length *= 6;
+                vertex_count = body_length;
+                for (unsigned int j = 0; j < 6; j++) {
+                    seam_lengths[j] *= 6;
+                    seam_offsets[j] = vertex_count;
+                    vertex_count += seam_lengths[j];
+                }
+
+                m_meshes[i].set_ranges(body_length, seam_offsets, seam_lengths);
+
+                // write the mesh straight into its buffers, again through the staging path if the mapping was lost
+                staged = false;
+                do {
+                    m_meshes[i].begin_upload(vertex_count * chunk_vertex_length, vertex_count, staged, &vbo_data, &ebo_data);
+
+                    if (vertex_count > 0) {
+                        render_inside(vbo_data, (ldt)i, x, y, z);
+
+                        for (unsigned int j = 0; j < vertex_count; j++) {
+                            ebo_data[j] = j;
+                        }
+                    }
+
+                    staged = true;
+                } while (!m_meshes[i].end_upload(vbo_data, ebo_data));
+            }
+
+            send_translucent_to_gpu(x, y, z);
+        }
+
+        void draw(ldt level, unsigned int seam_mask) {
+            if (m_render_path == rpt::rpt_faces) {
+                m_face_meshes[level].draw(seam_mask);
+            } else {
+                m_meshes[level].draw(seam_mask);
+            }
+        }
+
+        // what draw would send for a level, counted from the blocks so it works without gpu objects
+        unsigned long long triangle_count(ldt level, unsigned int seam_mask) {
+            unsigned long long body_length;
+            unsigned long long seam_lengths[6];
+
+            build_lods();
+            count_faces(level, &body_length, seam_lengths);
+            for (unsigned int i = 0; i < 6; i++) {
+                if (seam_mask & (1 << i)) {
+                    body_length += seam_lengths[i];
+                }
+            }
+
+            return body_length * 2;
+        }
+
+        unsigned long long get_translucent_faces() {
+            return m_translucent_faces;
+        }
+
+        unsigned long long get_translucent_version() {
+            return m_translucent_version;
+        }
+
+        // the middle of every translucent face in render space, in mesh order, three floats a face
+        // the faces are meshed again into the mesh arena, which is cheaper than keeping them around
+        // the fluid may have changed since the last upload, then the faces no longer line up with the uploaded ones and none are given until the chunk is meshed again
+        unsigned long long get_translucent_centres(float* centres) {
+            unsigned long long face_count = count_translucent_faces();
+            unsigned int points_index = 0;
+            float* points;
+            float low, high;
+
+            if (m_translucent_faces == 0 || face_count == 0) {
+                return 0;
+            }
+
+            // sized for the faces there are now, not the faces that were uploaded
+            points = get_mesh_arena()->allocate<float>(face_count * 6 * chunk_vertex_length);
+            render_fluid(points, &points_index, m_translucent_origin[0], m_translucent_origin[1], m_translucent_origin[2]);
+
+            face_count = points_index / (6 * chunk_vertex_length);
+            if (face_count != m_translucent_faces) {
+                get_mesh_arena()->reset();
+
+                return 0;
+            }
+
+            for (unsigned long long i = 0; i < face_count; i++) {
+                for (unsigned int j = 0; j < 3; j++) {
+                    low = points[(i * 6 * chunk_vertex_length) + j];
+                    high = low;
+                    for (unsigned int k = 1; k < 6; k++) {
+                        low = fminf(low, points[(((i * 6) + k) * chunk_vertex_length) + j]);
+                        high = fmaxf(high, points[(((i * 6) + k) * chunk_vertex_length) + j]);
+                    }
+                    centres[(i * 3) + j] = (low + high) * 0.5f;
+                }
+            }
+            get_mesh_arena()->reset();
+
+            return face_count;
+        }
+
+        // draw the translucent faces in a new order, order holds face numbers from get_translucent_centres
+        void upload_translucent_order(const unsigned short* order, unsigned long long count) {
+            unsigned int* indices = get_mesh_arena()->allocate<unsigned int>(count * 6);
+
+            for (unsigned long long i = 0; i < count; i++) {
+                for (unsigned int j = 0; j < 6; j++) {
+                    indices[(i * 6) + j] = ((unsigned int)order[i] * 6) + j;
+                }
+            }
+
+            m_translucent_mesh.upload_indices(indices, count * 6);
+            get_mesh_arena()->reset();
+        }
+
+        void draw_translucent() {
+            m_translucent_mesh.bind();
+            m_translucent_mesh.draw(0);
+            m_translucent_mesh.unbind();
         }
 
         void uninitialize() {
-            glDeleteBuffers(1, &m_ebo);
-            glDeleteBuffers(1, &m_vbo);
-            glDeleteVertexArrays(1, &m_vao);
+            for (unsigned int i = 0; i < ldt_count; i++) {
+                if (m_render_path == rpt::rpt_faces) {
+                    m_face_meshes[i].uninitialize();
+                } else {
+                    m_meshes[i].uninitialize();
+                }
+            }
+            m_translucent_mesh.uninitialize();
+            m_translucent_faces = 0;
+            m_translucent_version = 0;
+
+            m_initialized = false;
         }
     };
 
@@ -677,143 +2214,6 @@ namespace abradinjapan::voxelize {
         }
 
     private:
-        void write_vertex(float* vertices, unsigned int index, float x, float y, float z, float side_length, tvt texture_coord) {
-            vertices[index] = x;
-            vertices[index + 1] = y;
-            vertices[index + 2] = z;
-
-            if (texture_coord == tvt::tvt_bottom_left) {
-                vertices[index + 3] = 0.0f;
-                vertices[index + 4] = 0.0f;
-            } else if (texture_coord == tvt::tvt_bottom_right) {
-                vertices[index + 3] = 1.0f;
-                vertices[index + 4] = 0.0f;
-            } else if (texture_coord == tvt::tvt_top_left) {
-                vertices[index + 3] = 0.0f;
-                vertices[index + 4] = 1.0f;
-            } else if (texture_coord == tvt::tvt_top_right) {
-                vertices[index + 3] = 1.0f;
-                vertices[index + 4] = 1.0f;
-            }
-        }
-
-        void write_vertex_on_cube(float* vertices, unsigned int* index, float x, float y, float z, float l, tvt texture_vertex_type, cvt cube_vertex_type) {
-            if (cube_vertex_type == cvt::cvt_bottom_left_front) {
-                write_vertex(vertices, *index, x, y, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_bottom_right_front) {
-                write_vertex(vertices, *index, x + l, y, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_left_front) {
-                write_vertex(vertices, *index, x, y + l, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_right_front) {
-                write_vertex(vertices, *index, x + l, y + l, z, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_bottom_left_back) {
-                write_vertex(vertices, *index, x, y, z - l, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_bottom_right_back) {
-                write_vertex(vertices, *index, x + l, y, z - l, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_left_back) {
-                write_vertex(vertices, *index, x, y + l, z - l, l, texture_vertex_type);
-            } else if (cube_vertex_type == cvt::cvt_top_right_back) {
-                write_vertex(vertices, *index, x + l, y + l, z - l, l, texture_vertex_type);
-            }
-
-            *index += 5;
-        }
-
-        void write_face(float* vertices, unsigned int* index, float x, float y, float z, float l, st2 surface_type) {
-            cvt front[] = {
-                cvt::cvt_bottom_left_front,
-                cvt::cvt_bottom_right_front,
-                cvt::cvt_top_left_front,
-                cvt::cvt_top_right_front
-            };
-
-            cvt bottom[] = {
-                cvt::cvt_bottom_left_front,
-                cvt::cvt_bottom_right_front,
-                cvt::cvt_bottom_left_back,
-                cvt::cvt_bottom_right_back
-            };
-
-            cvt left[] = {
-                cvt::cvt_bottom_left_front,
-                cvt::cvt_bottom_left_back,
-                cvt::cvt_top_left_front,
-                cvt::cvt_top_left_back
-            };
-
-            cvt back[] = {
-                cvt::cvt_bottom_left_back,
-                cvt::cvt_bottom_right_back,
-                cvt::cvt_top_left_back,
-                cvt::cvt_top_right_back
-            };
-
-            cvt top[] = {
-                cvt::cvt_top_left_front,
-                cvt::cvt_top_right_front,
-                cvt::cvt_top_left_back,
-                cvt::cvt_top_right_back
-            };
-
-            cvt right[] = {
-                cvt::cvt_bottom_right_front,
-                cvt::cvt_bottom_right_back,
-                cvt::cvt_top_right_front,
-                cvt::cvt_top_right_back
-            };
-            
-            switch (surface_type) {
-            case st2::st2_front:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, front[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, front[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, front[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, front[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, front[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, front[2]);
-                break;
-            case st2::st2_bottom:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, bottom[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, bottom[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, bottom[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, bottom[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, bottom[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, bottom[2]);
-                break;
-            case st2::st2_left:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, left[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, left[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, left[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, left[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, left[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, left[2]);
-                break;
-            case st2::st2_back:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, back[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, back[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, back[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, back[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, back[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, back[2]);
-                break;
-            case st2::st2_top:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, top[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, top[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, top[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, top[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, top[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, top[2]);
-                break;
-            case st2::st2_right:
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_left, right[0]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, right[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, right[2]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_right, right[3]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_bottom_right, right[1]);
-                write_vertex_on_cube(vertices, index, x, y, z, l, tvt::tvt_top_left, right[2]);
-                break;
-            }
-        }
-
         void render_outside(float* points, chunk_888* chunk_1, chunk_888* chunk_2, st2 middle_side) {
             float side_length = 1.0f / 8.0f;
             unsigned int points_index = 0;
@@ -826,7 +2226,7 @@ namespace abradinjapan::voxelize {
                 for (unsigned int x = 0; x < m_side_length; x++) {
                     for (unsigned int y = 0; y < m_side_length; y++) {
                         if ((chunk_1->get_block_at(x, y, m_side_length - 1) > 0) != (chunk_2->get_block_at(x, y, 0) > 0)) {
-                            write_face(points, &points_index, side_length * (float)x, side_length * (float)y, 1.0f - side_length, side_length, st2::st2_front);
+                            emit_face<st2::st2_front, false>(points, &points_index, side_length * (float)x, side_length * (float)y, 1.0f - side_length, side_length, 0, 0);
                         }
                     }
                 }
@@ -835,7 +2235,7 @@ namespace abradinjapan::voxelize {
                 for (unsigned int x = 0; x < m_side_length; x++) {
                     for (unsigned int y = 0; y < m_side_length; y++) {
                         if ((chunk_1->get_block_at(x, y, 0) > 0) != (chunk_2->get_block_at(x, y, m_side_length - 1) > 0)) {
-                            write_face(points, &points_index, side_length * (float)x, side_length * (float)y, 0.0f, side_length, st2::st2_back);
+                            emit_face<st2::st2_back, false>(points, &points_index, side_length * (float)x, side_length * (float)y, 0.0f, side_length, 0, 0);
                         }
                     }
                 }
@@ -844,7 +2244,7 @@ namespace abradinjapan::voxelize {
                 for (unsigned int x = 0; x < m_side_length; x++) {
                     for (unsigned int z = 0; z < m_side_length; z++) {
                         if ((chunk_1->get_block_at(x, m_side_length - 1, z) > 0) != (chunk_2->get_block_at(x, 0, z) > 0)) {
-                            write_face(points, &points_index, side_length * (float)x, 1.0f - side_length, side_length * (float)z, side_length, st2::st2_top);
+                            emit_face<st2::st2_top, false>(points, &points_index, side_length * (float)x, 1.0f - side_length, side_length * (float)z, side_length, 0, 0);
                         }
                     }
                 }
@@ -853,7 +2253,7 @@ namespace abradinjapan::voxelize {
                 for (unsigned int x = 0; x < m_side_length; x++) {
                     for (unsigned int z = 0; z < m_side_length; z++) {
                         if ((chunk_1->get_block_at(x, 0, z) > 0) != (chunk_2->get_block_at(x, m_side_length - 1, z) > 0)) {
-                            write_face(points, &points_index, side_length * (float)x, 0.0f, side_length * (float)z, side_length, st2::st2_bottom);
+                            emit_face<st2::st2_bottom, false>(points, &points_index, side_length * (float)x, 0.0f, side_length * (float)z, side_length, 0, 0);
                         }
                     }
                 }
@@ -862,7 +2262,7 @@ namespace abradinjapan::voxelize {
                 for (unsigned int y = 0; y < m_side_length; y++) {
                     for (unsigned int z = 0; z < m_side_length; z++) {
                         if ((chunk_1->get_block_at(0, y, z) > 0) != (chunk_2->get_block_at(m_side_length - 1, y, z) > 0)) {
-                            write_face(points, &points_index, 0.0f, side_length * (float)y, side_length * (float)z, side_length, st2::st2_left);
+                            emit_face<st2::st2_left, false>(points, &points_index, 0.0f, side_length * (float)y, side_length * (float)z, side_length, 0, 0);
                         }
                     }
                 }
@@ -871,7 +2271,7 @@ namespace abradinjapan::voxelize {
                 for (unsigned int y = 0; y < m_side_length; y++) {
                     for (unsigned int z = 0; z < m_side_length; z++) {
                         if ((chunk_1->get_block_at(m_side_length - 1, y, z) > 0) != (chunk_2->get_block_at(0, y, z) > 0)) {
-                            write_face(points, &points_index, 1.0f - side_length, side_length * (float)y, side_length * (float)z, side_length, st2::st2_right);
+                            emit_face<st2::st2_right, false>(points, &points_index, 1.0f - side_length, side_length * (float)y, side_length * (float)z, side_length, 0, 0);
                         }
                     }
                 }
@@ -883,15 +2283,15 @@ namespace abradinjapan::voxelize {
 
             // write to m_vbo_data
             m_vbo_length = points_index;
-            m_vbo_data = new float[m_vbo_length];
+            m_vbo_data = get_mesh_arena()->allocate<float>(m_vbo_length);
 
             for (unsigned int i = 0; i < m_vbo_length; i++) {
                 m_vbo_data[i] = points[i];
             }
 
             // write ebo data
-            m_ebo_length = points_index / 5;
-            m_ebo_data = new unsigned int[m_ebo_length];
+            m_ebo_length = points_index / side_vertex_length;
+            m_ebo_data = get_mesh_arena()->allocate<unsigned int>(m_ebo_length);
 
             for (unsigned int i = 0; i < m_ebo_length; i++) {
                 m_ebo_data[i] = i;
@@ -919,6 +2319,9 @@ namespace abradinjapan::voxelize {
         }
 
         void send_to_gpu(float* vertices_buffer, chunk_888* chunk_1, chunk_888* chunk_2, st2 middle_side) {
+            g_memory_accounts.remove(mtt::mtt_gpu_vertices, (long long)(m_vbo_length * sizeof(float)));
+            g_memory_accounts.remove(mtt::mtt_gpu_indices, (long long)(m_ebo_length * sizeof(unsigned int)));
+
             render_outside(vertices_buffer, chunk_1, chunk_2, middle_side);
 
             bind();
@@ -937,8 +2340,13 @@ namespace abradinjapan::voxelize {
 
             unbind();
 
-            delete[] m_vbo_data;
-            delete[] m_ebo_data;
+            g_memory_accounts.add(mtt::mtt_gpu_vertices, (long long)(m_vbo_length * sizeof(float)));
+            g_memory_accounts.add(mtt::mtt_gpu_indices, (long long)(m_ebo_length * sizeof(unsigned int)));
+
+            // the staged vertices lived in the mesh arena, the gpu has the only copy now
+            get_mesh_arena()->reset();
+            m_vbo_data = 0;
+            m_ebo_data = 0;
         }
 
         void draw() {
@@ -946,6 +2354,11 @@ namespace abradinjapan::voxelize {
         }
 
         void uninitialize() {
+            g_memory_accounts.remove(mtt::mtt_gpu_vertices, (long long)(m_vbo_length * sizeof(float)));
+            g_memory_accounts.remove(mtt::mtt_gpu_indices, (long long)(m_ebo_length * sizeof(unsigned int)));
+            m_vbo_length = 0;
+            m_ebo_length = 0;
+
             glDeleteBuffers(1, &m_ebo);
             glDeleteBuffers(1, &m_vbo);
             glDeleteVertexArrays(1, &m_vao);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace abradinjapan::voxelize {
+    // job type for worker_pool::run, called once for every index in [0, count)
+    typedef void (*worker_job)(void* context, unsigned long long index);
+
+    // persistent threads for data parallel work, the calling thread helps out while it waits
+    class worker_pool {
+        std::thread* m_threads = 0;
+        unsigned int m_thread_count = 0;
+        std::mutex m_mutex;
+        std::condition_variable m_start_signal;
+        std::condition_variable m_done_signal;
+        worker_job m_job = 0;
+        void* m_context = 0;
+        unsigned long long m_job_count = 0;
+        std::atomic<unsigned long long> m_next_index{0};
+        unsigned int m_busy_count = 0;
+        unsigned long long m_generation = 0;
+        bool m_quit = false;
+
+        void take_jobs() {
+            unsigned long long index;
+
+            while ((index = m_next_index++) < m_job_count) {
+                m_job(m_context, index);
+            }
+        }
+
+        void work() {
+            unsigned long long generation = 0;
+
+            while (true) {
+                // wait for a new batch
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+
+                    m_start_signal.wait(lock, [&] { return m_quit || m_generation != generation; });
+                    if (m_quit) {
+                        return;
+                    }
+
+                    generation = m_generation;
+                }
+
+                take_jobs();
+
+                // report back
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+
+                    m_busy_count--;
+                    if (m_busy_count == 0) {
+                        m_done_signal.notify_one();
+                    }
+                }
+            }
+        }
+
+    public:
+        // thread_count of 0 picks one less than the number of cores
+        void initialize(unsigned int thread_count) {
+            if (thread_count == 0) {
+                thread_count = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+            }
+
+            m_thread_count = thread_count;
+            m_quit = false;
+            m_threads = new std::thread[thread_count];
+
+            for (unsigned int i = 0; i < thread_count; i++) {
+                m_threads[i] = std::thread(&worker_pool::work, this);
+            }
+        }
+
+        unsigned int get_thread_count() {
+            return m_thread_count;
+        }
+
+        // blocks until every job has finished
+        void run(worker_job job, void* context, unsigned long long count) {
+            if (count == 0) {
+                return;
+            }
+
+            // start batch
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_job = job;
+                m_context = context;
+                m_job_count = count;
+                m_next_index = 0;
+                m_busy_count = m_thread_count;
+                m_generation++;
+            }
+            m_start_signal.notify_all();
+
+            take_jobs();
+
+            // wait for batch
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done_signal.wait(lock, [&] { return m_busy_count == 0; });
+        }
+
+        void uninitialize() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                m_quit = true;
+            }
+            m_start_signal.notify_all();
+
+            for (unsigned int i = 0; i < m_thread_count; i++) {
+                m_threads[i].join();
+            }
+
+            delete[] m_threads;
+
+            m_threads = 0;
+            m_thread_count = 0;
+        }
+    };
+}
@@ -0,0 +1,830 @@
+#pragma once
+
+#include "types.hpp"
+#include "cache.hpp"
+#include "generation.hpp"
+#include "terrain.hpp"
+
+#include <math.h>
+
+namespace abradinjapan::voxelize {
+    // told about every block change made through world::set_block_at
+    typedef void (*block_listener)(void* context, long long x, long long y, long long z, unsigned short old_value, unsigned short new_value);
+
+    // told about every box of blocks changed by a bulk edit, in inclusive world coordinates
+    typedef void (*region_listener)(void* context, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2);
+
+    // told about every fluid change made through world::set_fluid_at
+    typedef void (*fluid_listener)(void* context, long long x, long long y, long long z, unsigned char old_value, unsigned char new_value);
+
+    // a box of blocks held outside of any world, filled by world::copy_box and written back by world::paste_box
+    class block_region {
+        unsigned short* m_blocks = 0;
+        long long m_width = 0;
+        long long m_length = 0;
+        long long m_height = 0;
+
+    public:
+        void initialize(long long width, long long length, long long height) {
+            m_blocks = new unsigned short[width * length * height];
+            m_width = width;
+            m_length = length;
+            m_height = height;
+
+            for (long long i = 0; i < width * length * height; i++) {
+                m_blocks[i] = 0;
+            }
+        }
+
+        long long get_width() {
+            return m_width;
+        }
+
+        long long get_length() {
+            return m_length;
+        }
+
+        long long get_height() {
+            return m_height;
+        }
+
+        // rows run along x
+        unsigned short* get_row(long long y, long long z) {
+            return &m_blocks[(y * m_width) + (z * m_width * m_length)];
+        }
+
+        void uninitialize() {
+            delete[] m_blocks;
+
+            m_blocks = 0;
+            m_width = 0;
+            m_length = 0;
+            m_height = 0;
+        }
+    };
+
+    // how many block listeners can be registered at once
+    const unsigned int world_listener_count = 4;
+
+    // a window of loaded chunks that slides over an unbounded plane, addressed either by chunk or by block in world coordinates
+    // the window wraps around its slots in x and y, so moving it only touches the chunks that enter or leave
+    class world {
+        chunk_888** m_chunks = 0;
+        generation_pipeline* m_generator = 0; // 0 for terrain alone
+        bool m_remote = false; // chunks start empty and are filled in by a server
+        long long m_origin_x = 0; // lowest chunk in the window
+        long long m_origin_y = 0;
+        long long m_width = 0;
+        long long m_length = 0;
+        long long m_height = 0;
+        // per block column of the window, kept by column slot like the chunks so they stay put while it moves, -1 for none
+        short* m_solid_heights = 0; // the highest solid block
+        short* m_opaque_heights = 0; // the highest block that stops sunlight, never above the solid one
+        block_listener m_listeners[world_listener_count];
+        void* m_listener_contexts[world_listener_count];
+        region_listener m_region_listeners[world_listener_count];
+        void* m_region_listener_contexts[world_listener_count];
+        fluid_listener m_fluid_listeners[world_listener_count];
+        void* m_fluid_listener_contexts[world_listener_count];
+
+        // callers are expected to check contains_block first
+        chunk_888* get_block_chunk(long long x, long long y, long long z) {
+            return m_chunks[get_chunk_slot(x >> 3, y >> 3, z >> 3)];
+        }
+
+        long long get_column_index(long long x, long long y) {
+            return (get_chunk_slot(x >> 3, y >> 3, 0) * 64) + (x & 7) + ((y & 7) * 8);
+        }
+
+        // find a column's heights again from z down, air only costs a bit of a solid mask
+        void scan_heights(long long x, long long y, long long z) {
+            long long index = get_column_index(x, y);
+            chunk_888* chunk;
+
+            m_solid_heights[index] = -1;
+            m_opaque_heights[index] = -1;
+            for (; z >= 0; z--) {
+                chunk = get_block_chunk(x, y, z);
+                if (!chunk->is_solid_at(x & 7, y & 7, z & 7)) {
+                    continue;
+                }
+
+                if (m_solid_heights[index] < 0) {
+                    m_solid_heights[index] = (short)z;
+                }
+                if (is_block_opaque(chunk->get_block_at(x & 7, y & 7, z & 7))) {
+                    m_opaque_heights[index] = (short)z;
+
+                    return;
+                }
+            }
+        }
+
+        // inclusive block columns, already clipped to the world
+        void refresh_heights(long long x1, long long y1, long long x2, long long y2) {
+            for (long long x = x1; x <= x2; x++) {
+                for (long long y = y1; y <= y2; y++) {
+                    scan_heights(x, y, (m_height * 8) - 1);
+                }
+            }
+        }
+
+        void link_neighbours() {
+            long long x, y, z;
+
+            for (long long slot = 0; slot < m_width * m_length * m_height; slot++) {
+                get_slot_chunk(slot, &x, &y, &z);
+
+                for (unsigned int i = 0; i < 6; i++) {
+                    m_chunks[slot]->set_neighbour((st2)i, get_chunk(x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2]));
+                }
+            }
+        }
+
+        // clip an inclusive block box to the world, false when nothing is left
+        bool clip_box(long long* x1, long long* y1, long long* z1, long long* x2, long long* y2, long long* z2) {
+            *x1 = *x1 < m_origin_x * 8 ? m_origin_x * 8 : *x1;
+            *y1 = *y1 < m_origin_y * 8 ? m_origin_y * 8 : *y1;
+            *z1 = *z1 < 0 ? 0 : *z1;
+            *x2 = *x2 >= (m_origin_x + m_width) * 8 ? ((m_origin_x + m_width) * 8) - 1 : *x2;
+            *y2 = *y2 >= (m_origin_y + m_length) * 8 ? ((m_origin_y + m_length) * 8) - 1 : *y2;
+            *z2 = *z2 >= m_height * 8 ? (m_height * 8) - 1 : *z2;
+
+            return *x1 <= *x2 && *y1 <= *y2 && *z1 <= *z2;
+        }
+
+        // the part of a clipped box inside one chunk, in local coordinates
+        void get_local_box(long long cx, long long cy, long long cz, long long x1, long long y1, long long z1, long long x2, long long y2, long long z2, unsigned int* local) {
+            local[0] = x1 > cx * 8 ? x1 & 7 : 0;
+            local[1] = y1 > cy * 8 ? y1 & 7 : 0;
+            local[2] = z1 > cz * 8 ? z1 & 7 : 0;
+            local[3] = x2 < (cx * 8) + 7 ? x2 & 7 : 7;
+            local[4] = y2 < (cy * 8) + 7 ? y2 & 7 : 7;
+            local[5] = z2 < (cz * 8) + 7 ? z2 & 7 : 7;
+        }
+
+        bool is_whole_chunk(unsigned int* local) {
+            return local[0] == 0 && local[1] == 0 && local[2] == 0 && local[3] == 7 && local[4] == 7 && local[5] == 7;
+        }
+
+        // every touched chunk and the neighbours facing its edited blocks are marked once, then the listeners catch up on the whole box
+        // the heights are redone first so the listeners can rely on them
+        void finish_bulk_edit(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            refresh_heights(x1, y1, x2, y2);
+
+            for (long long cx = (x1 - 1) >> 3; cx <= (x2 + 1) >> 3; cx++) {
+                for (long long cy = (y1 - 1) >> 3; cy <= (y2 + 1) >> 3; cy++) {
+                    for (long long cz = (z1 - 1) >> 3; cz <= (z2 + 1) >> 3; cz++) {
+                        if (get_chunk(cx, cy, cz) != 0) {
+                            get_chunk(cx, cy, cz)->mark_dirty();
+                        }
+                    }
+                }
+            }
+
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_region_listeners[i] != 0) {
+                    m_region_listeners[i](m_region_listener_contexts[i], x1, y1, z1, x2, y2, z2);
+                }
+            }
+        }
+
+        // a bulk edit over whole columns of chunks, inclusive chunk coordinates, for when chunks enter or leave
+        void refresh_columns(long long x1, long long y1, long long x2, long long y2) {
+            long long z1 = 0;
+            long long z2 = (m_height * 8) - 1;
+
+            x1 *= 8;
+            y1 *= 8;
+            x2 = (x2 * 8) + 7;
+            y2 = (y2 * 8) + 7;
+
+            if (clip_box(&x1, &y1, &z1, &x2, &y2, &z2)) {
+                finish_bulk_edit(x1, y1, z1, x2, y2, z2);
+            }
+        }
+
+        // chunks that are not in the cold cache come out of the generator
+        // returns 0 when the pool is full
+        chunk_888* load_chunk(slab_pool<chunk_888>* pool, long long x, long long y, long long z) {
+            chunk_888* output = 0;
+
+            if (m_remote) {
+                output = pool->allocate();
+                if (output != 0) {
+                    output->fill(bt::bt_air);
+                }
+
+                return output;
+            }
+
+            if (m_generator != 0) {
+                output = m_generator->take(x, y, z);
+            }
+            if (output == 0) {
+                output = generate_chunk(pool, x, y, z);
+            }
+
+            return output;
+        }
+
+    public:
+        // width, length and height are counted in chunks along x, y and z, the window starts with its lowest chunk at the origin
+        // generator may be 0, then chunks are plain terrain, otherwise it shares the pool and keeps its camera on the window
+        bool initialize(slab_pool<chunk_888>* pool, generation_pipeline* generator, long long width, long long length, long long height) {
+            m_generator = generator;
+            m_origin_x = 0;
+            m_origin_y = 0;
+            m_width = width;
+            m_length = length;
+            m_height = height;
+            m_chunks = new chunk_888*[width * length * height];
+            m_solid_heights = new short[width * length * 64];
+            m_opaque_heights = new short[width * length * 64];
+
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                m_listeners[i] = 0;
+                m_listener_contexts[i] = 0;
+                m_region_listeners[i] = 0;
+                m_region_listener_contexts[i] = 0;
+                m_fluid_listeners[i] = 0;
+                m_fluid_listener_contexts[i] = 0;
+            }
+
+            // generate chunks
+            for (long long i = 0; i < width * length * height; i++) {
+                m_chunks[i] = 0;
+            }
+
+            for (long long x = 0; x < width; x++) {
+                for (long long y = 0; y < length; y++) {
+                    for (long long z = 0; z < height; z++) {
+                        m_chunks[get_chunk_slot(x, y, z)] = load_chunk(pool, x, y, z);
+
+                        if (m_chunks[get_chunk_slot(x, y, z)] == 0) {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            link_neighbours();
+            refresh_heights(0, 0, (width * 8) - 1, (length * 8) - 1);
+
+            return true;
+        }
+
+        // slide the window so it is centred on a chunk
+        // chunks leaving it give up their gpu objects and are compressed into the cache, chunks entering it come back from the cache or the generator
+        // returns false when the pool runs out
+        bool recentre(slab_pool<chunk_888>* pool, chunk_cache* cache, long long centre_x, long long centre_y) {
+            long long origin_x = centre_x - (m_width / 2);
+            long long origin_y = centre_y - (m_length / 2);
+            long long old_origin_x = m_origin_x;
+            long long old_origin_y = m_origin_y;
+            long long x, y, z;
+
+            if (origin_x == m_origin_x && origin_y == m_origin_y) {
+                return true;
+            }
+
+            // evict
+            for (long long slot = 0; slot < m_width * m_length * m_height; slot++) {
+                get_slot_chunk(slot, &x, &y, &z);
+
+                if (x >= origin_x && x < origin_x + m_width && y >= origin_y && y < origin_y + m_length) {
+                    continue;
+                }
+
+                if (m_chunks[slot]->is_initialized()) {
+                    m_chunks[slot]->uninitialize();
+                }
+                cache->store(m_chunks[slot], x, y, z);
+                pool->deallocate(m_chunks[slot]);
+                m_chunks[slot] = 0;
+            }
+
+            m_origin_x = origin_x;
+            m_origin_y = origin_y;
+
+            // load, each slot freed above now maps to a chunk entering the window
+            for (long long slot = 0; slot < m_width * m_length * m_height; slot++) {
+                if (m_chunks[slot] != 0) {
+                    continue;
+                }
+
+                get_slot_chunk(slot, &x, &y, &z);
+
+                m_chunks[slot] = cache->load(pool, x, y, z);
+                if (m_chunks[slot] == 0) {
+                    m_chunks[slot] = load_chunk(pool, x, y, z);
+                }
+                if (m_chunks[slot] == 0) {
+                    return false;
+                }
+            }
+
+            link_neighbours();
+
+            // chunks that came in need light, meshes and listeners, and so do the chunks left facing the space old chunks used to fill
+            if (origin_x > old_origin_x) {
+                refresh_columns(old_origin_x + m_width, origin_y, origin_x + m_width - 1, origin_y + m_length - 1);
+                refresh_columns(origin_x, origin_y, origin_x, origin_y + m_length - 1);
+            } else if (origin_x < old_origin_x) {
+                refresh_columns(origin_x, origin_y, old_origin_x - 1, origin_y + m_length - 1);
+                refresh_columns(origin_x + m_width - 1, origin_y, origin_x + m_width - 1, origin_y + m_length - 1);
+            }
+            if (origin_y > old_origin_y) {
+                refresh_columns(origin_x, old_origin_y + m_length, origin_x + m_width - 1, origin_y + m_length - 1);
+                refresh_columns(origin_x, origin_y, origin_x + m_width - 1, origin_y);
+            } else if (origin_y < old_origin_y) {
+                refresh_columns(origin_x, origin_y, origin_x + m_width - 1, old_origin_y - 1);
+                refresh_columns(origin_x, origin_y + m_length - 1, origin_x + m_width - 1, origin_y + m_length - 1);
+            }
+
+            return true;
+        }
+
+        // a remote world never generates anything, chunks entering it are air until load_compressed_chunk fills them, must be set before initialize
+        void set_remote(bool remote) {
+            m_remote = remote;
+        }
+
+        // replace a chunk in the window with one packed by compress_chunk, it is relit and remeshed like any bulk edit
+        // returns false when the chunk is outside the window or the input is malformed, either way the chunk is left as it was
+        bool load_compressed_chunk(long long x, long long y, long long z, unsigned char* input, unsigned long long length) {
+            if (get_chunk(x, y, z) == 0 || !decompress_chunk(input, length, get_chunk(x, y, z))) {
+                return false;
+            }
+
+            finish_bulk_edit(x * 8, y * 8, z * 8, (x * 8) + 7, (y * 8) + 7, (z * 8) + 7);
+
+            return true;
+        }
+
+        long long get_origin_x() {
+            return m_origin_x;
+        }
+
+        long long get_origin_y() {
+            return m_origin_y;
+        }
+
+        long long get_width() {
+            return m_width;
+        }
+
+        long long get_length() {
+            return m_length;
+        }
+
+        long long get_height() {
+            return m_height;
+        }
+
+        // where a chunk in the window is kept, callers are expected to check get_chunk first
+        // slots stay put while the window moves, so per chunk state kept elsewhere can be indexed by slot
+        long long get_chunk_slot(long long x, long long y, long long z) {
+            long long slot_x = x % m_width;
+            long long slot_y = y % m_length;
+
+            slot_x = slot_x < 0 ? slot_x + m_width : slot_x;
+            slot_y = slot_y < 0 ? slot_y + m_length : slot_y;
+
+            return slot_x + (slot_y * m_width) + (z * m_width * m_length);
+        }
+
+        // the chunk a slot currently holds
+        void get_slot_chunk(long long slot, long long* x, long long* y, long long* z) {
+            long long offset_x = ((slot % m_width) - m_origin_x) % m_width;
+            long long offset_y = (((slot / m_width) % m_length) - m_origin_y) % m_length;
+
+            *x = m_origin_x + (offset_x < 0 ? offset_x + m_width : offset_x);
+            *y = m_origin_y + (offset_y < 0 ? offset_y + m_length : offset_y);
+            *z = slot / (m_width * m_length);
+        }
+
+        // returns 0 outside of the window
+        chunk_888* get_chunk(long long x, long long y, long long z) {
+            if (x < m_origin_x || y < m_origin_y || z < 0 || x >= m_origin_x + m_width || y >= m_origin_y + m_length || z >= m_height) {
+                return 0;
+            }
+
+            return m_chunks[get_chunk_slot(x, y, z)];
+        }
+
+        bool contains_block(long long x, long long y, long long z) {
+            return x >= m_origin_x * 8 && y >= m_origin_y * 8 && z >= 0 && x < (m_origin_x + m_width) * 8 && y < (m_origin_y + m_length) * 8 && z < m_height * 8;
+        }
+
+        // callers are expected to check contains_block first
+        unsigned short get_block_at(long long x, long long y, long long z) {
+            return get_block_chunk(x, y, z)->get_block_at(x & 7, y & 7, z & 7);
+        }
+
+        // returns false when every listener slot is taken
+        bool add_block_listener(block_listener listener, void* context) {
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_listeners[i] == 0) {
+                    m_listeners[i] = listener;
+                    m_listener_contexts[i] = context;
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void remove_block_listener(block_listener listener, void* context) {
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_listeners[i] == listener && m_listener_contexts[i] == context) {
+                    m_listeners[i] = 0;
+                    m_listener_contexts[i] = 0;
+                }
+            }
+        }
+
+        // returns false when every listener slot is taken
+        bool add_region_listener(region_listener listener, void* context) {
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_region_listeners[i] == 0) {
+                    m_region_listeners[i] = listener;
+                    m_region_listener_contexts[i] = context;
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void remove_region_listener(region_listener listener, void* context) {
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_region_listeners[i] == listener && m_region_listener_contexts[i] == context) {
+                    m_region_listeners[i] = 0;
+                    m_region_listener_contexts[i] = 0;
+                }
+            }
+        }
+
+        // returns false when every listener slot is taken
+        bool add_fluid_listener(fluid_listener listener, void* context) {
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_fluid_listeners[i] == 0) {
+                    m_fluid_listeners[i] = listener;
+                    m_fluid_listener_contexts[i] = context;
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void remove_fluid_listener(fluid_listener listener, void* context) {
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_fluid_listeners[i] == listener && m_fluid_listener_contexts[i] == context) {
+                    m_fluid_listeners[i] = 0;
+                    m_fluid_listener_contexts[i] = 0;
+                }
+            }
+        }
+
+        // bulk edits work a chunk at a time and a row of 8 blocks at a time within it, then tell the region listeners once
+        // all boxes are inclusive and clipped to the world
+        void fill_box(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2, unsigned short value) {
+            unsigned int local[6];
+            chunk_888* chunk;
+
+            if (!clip_box(&x1, &y1, &z1, &x2, &y2, &z2)) {
+                return;
+            }
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        chunk = get_chunk(cx, cy, cz);
+                        get_local_box(cx, cy, cz, x1, y1, z1, x2, y2, z2, local);
+
+                        if (is_whole_chunk(local)) {
+                            chunk->fill(value);
+
+                            continue;
+                        }
+
+                        for (unsigned int z = local[2]; z <= local[5]; z++) {
+                            for (unsigned int y = local[1]; y <= local[4]; y++) {
+                                chunk->fill_row(local[0], local[3], y, z, value);
+                            }
+                        }
+                    }
+                }
+            }
+
+            finish_bulk_edit(x1, y1, z1, x2, y2, z2);
+        }
+
+        // every block whose centre is within radius of the centre point
+        void fill_sphere(float centre_x, float centre_y, float centre_z, float radius, unsigned short value) {
+            long long x1 = (long long)floorf(centre_x - radius);
+            long long y1 = (long long)floorf(centre_y - radius);
+            long long z1 = (long long)floorf(centre_z - radius);
+            long long x2 = (long long)ceilf(centre_x + radius);
+            long long y2 = (long long)ceilf(centre_y + radius);
+            long long z2 = (long long)ceilf(centre_z + radius);
+            unsigned int local[6];
+            chunk_888* chunk;
+            float dy, dz, remaining, half_width;
+            long long row_x1, row_x2;
+            bool inside;
+
+            if (!clip_box(&x1, &y1, &z1, &x2, &y2, &z2)) {
+                return;
+            }
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        chunk = get_chunk(cx, cy, cz);
+                        get_local_box(cx, cy, cz, x1, y1, z1, x2, y2, z2, local);
+
+                        // a sphere is convex, so a chunk whose corner blocks are all inside is inside
+                        inside = true;
+                        for (unsigned int i = 0; i < 8 && inside; i++) {
+                            glm::vec3 corner = glm::vec3((float)((cx * 8) + ((i & 1) * 7)) + 0.5f - centre_x, (float)((cy * 8) + (((i >> 1) & 1) * 7)) + 0.5f - centre_y, (float)((cz * 8) + ((i >> 2) * 7)) + 0.5f - centre_z);
+
+                            inside = glm::dot(corner, corner) <= radius * radius;
+                        }
+                        if (inside) {
+                            chunk->fill(value);
+
+                            continue;
+                        }
+
+                        // each row of blocks crosses the sphere in one run
+                        for (unsigned int z = local[2]; z <= local[5]; z++) {
+                            for (unsigned int y = local[1]; y <= local[4]; y++) {
+                                dy = (float)((cy * 8) + y) + 0.5f - centre_y;
+                                dz = (float)((cz * 8) + z) + 0.5f - centre_z;
+                                remaining = (radius * radius) - (dy * dy) - (dz * dz);
+                                if (remaining < 0.0f) {
+                                    continue;
+                                }
+
+                                half_width = sqrtf(remaining);
+                                row_x1 = (long long)ceilf(centre_x - half_width - 0.5f);
+                                row_x2 = (long long)floorf(centre_x + half_width - 0.5f);
+                                row_x1 = row_x1 > (cx * 8) + local[0] ? row_x1 : (cx * 8) + local[0];
+                                row_x2 = row_x2 < (cx * 8) + local[3] ? row_x2 : (cx * 8) + local[3];
+
+                                if (row_x1 <= row_x2) {
+                                    chunk->fill_row(row_x1 & 7, row_x2 & 7, y, z, value);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            finish_bulk_edit(x1, y1, z1, x2, y2, z2);
+        }
+
+        // swap every block of one type inside the box for another
+        void replace_box(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2, unsigned short from, unsigned short to) {
+            unsigned int local[6];
+            chunk_888* chunk;
+
+            if (!clip_box(&x1, &y1, &z1, &x2, &y2, &z2)) {
+                return;
+            }
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        chunk = get_chunk(cx, cy, cz);
+                        get_local_box(cx, cy, cz, x1, y1, z1, x2, y2, z2, local);
+
+                        for (unsigned int z = local[2]; z <= local[5]; z++) {
+                            for (unsigned int y = local[1]; y <= local[4]; y++) {
+                                chunk->replace_row(local[0], local[3], y, z, from, to);
+                            }
+                        }
+                    }
+                }
+            }
+
+            finish_bulk_edit(x1, y1, z1, x2, y2, z2);
+        }
+
+        // copy the box into output, which is initialized here to the size of the box, parts outside the world read as air
+        void copy_box(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2, block_region* output) {
+            long long origin[3] = { x1, y1, z1 };
+            unsigned int local[6];
+
+            output->initialize(x2 - x1 + 1, y2 - y1 + 1, z2 - z1 + 1);
+
+            if (!clip_box(&x1, &y1, &z1, &x2, &y2, &z2)) {
+                return;
+            }
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        get_local_box(cx, cy, cz, x1, y1, z1, x2, y2, z2, local);
+
+                        for (unsigned int z = local[2]; z <= local[5]; z++) {
+                            for (unsigned int y = local[1]; y <= local[4]; y++) {
+                                get_chunk(cx, cy, cz)->copy_row(local[0], local[3], y, z, output->get_row((cy * 8) + y - origin[1], (cz * 8) + z - origin[2]) + ((cx * 8) + local[0] - origin[0]));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // write a copied region back with its lowest corner at x, y, z, parts outside the world are dropped
+        void paste_box(block_region* region, long long x, long long y, long long z) {
+            long long x1 = x, y1 = y, z1 = z;
+            long long x2 = x + region->get_width() - 1;
+            long long y2 = y + region->get_length() - 1;
+            long long z2 = z + region->get_height() - 1;
+            unsigned int local[6];
+
+            if (!clip_box(&x1, &y1, &z1, &x2, &y2, &z2)) {
+                return;
+            }
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        get_local_box(cx, cy, cz, x1, y1, z1, x2, y2, z2, local);
+
+                        for (unsigned int lz = local[2]; lz <= local[5]; lz++) {
+                            for (unsigned int ly = local[1]; ly <= local[4]; ly++) {
+                                get_chunk(cx, cy, cz)->paste_row(local[0], local[3], ly, lz, region->get_row((cy * 8) + ly - y, (cz * 8) + lz - z) + ((cx * 8) + local[0] - x));
+                            }
+                        }
+                    }
+                }
+            }
+
+            finish_bulk_edit(x1, y1, z1, x2, y2, z2);
+        }
+
+        // sets the block without any relighting, see light_engine::set_block_at for edits
+        void set_block_at(long long x, long long y, long long z, unsigned short value) {
+            chunk_888* chunk = get_block_chunk(x, y, z);
+            unsigned short old_value = chunk->get_block_at(x & 7, y & 7, z & 7);
+            long long index = get_column_index(x, y);
+
+            chunk->set_block_at(x & 7, y & 7, z & 7, value);
+            chunk->mark_dirty();
+
+            // building on top only raises the heights, taking the top away means looking down for the next one
+            if (value != bt::bt_air && z > m_solid_heights[index]) {
+                m_solid_heights[index] = (short)z;
+            }
+            if (is_block_opaque(value) && z > m_opaque_heights[index]) {
+                m_opaque_heights[index] = (short)z;
+            }
+            if ((value == bt::bt_air && z == m_solid_heights[index]) || (!is_block_opaque(value) && z == m_opaque_heights[index])) {
+                scan_heights(x, y, m_solid_heights[index]);
+            }
+
+            // faces of neighbouring chunks can depend on border blocks
+            for (unsigned int i = 0; i < 6; i++) {
+                if (chunk->get_neighbour((st2)i) != 0 && !contains_same_chunk(x, y, z, x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2])) {
+                    chunk->get_neighbour((st2)i)->mark_dirty();
+                }
+            }
+
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_listeners[i] != 0) {
+                    m_listeners[i](m_listener_contexts[i], x, y, z, old_value, value);
+                }
+            }
+        }
+
+        unsigned char get_light_at(long long x, long long y, long long z) {
+            return get_block_chunk(x, y, z)->get_light_at(x & 7, y & 7, z & 7);
+        }
+
+        void set_light_at(long long x, long long y, long long z, unsigned char value) {
+            chunk_888* chunk = get_block_chunk(x, y, z);
+
+            chunk->set_light_at(x & 7, y & 7, z & 7, value);
+            chunk->mark_dirty();
+
+            // faces of neighbouring chunks sample light across the border
+            for (unsigned int i = 0; i < 6; i++) {
+                if (chunk->get_neighbour((st2)i) != 0 && !contains_same_chunk(x, y, z, x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2])) {
+                    chunk->get_neighbour((st2)i)->mark_dirty();
+                }
+            }
+        }
+
+        unsigned char get_fluid_at(long long x, long long y, long long z) {
+            return get_block_chunk(x, y, z)->get_fluid_at(x & 7, y & 7, z & 7);
+        }
+
+        void set_fluid_at(long long x, long long y, long long z, unsigned char value) {
+            chunk_888* chunk = get_block_chunk(x, y, z);
+            unsigned char old_value = chunk->get_fluid_at(x & 7, y & 7, z & 7);
+
+            chunk->set_fluid_at(x & 7, y & 7, z & 7, value);
+            chunk->mark_dirty();
+
+            // fluid faces are culled against fluid across the border
+            for (unsigned int i = 0; i < 6; i++) {
+                if (chunk->get_neighbour((st2)i) != 0 && !contains_same_chunk(x, y, z, x + st2_offsets[i][0], y + st2_offsets[i][1], z + st2_offsets[i][2])) {
+                    chunk->get_neighbour((st2)i)->mark_dirty();
+                }
+            }
+
+            for (unsigned int i = 0; i < world_listener_count; i++) {
+                if (m_fluid_listeners[i] != 0) {
+                    m_fluid_listeners[i](m_fluid_listener_contexts[i], x, y, z, old_value, value);
+                }
+            }
+        }
+
+        // outside the world counts as solid everywhere but above it, so bodies cannot leave through the sides or the bottom
+        bool is_solid_at(long long x, long long y, long long z) {
+            if (!contains_block(x, y, z)) {
+                return z < m_height * 8;
+            }
+
+            return get_block_chunk(x, y, z)->is_solid_at(x & 7, y & 7, z & 7);
+        }
+
+        // true when any block in the inclusive box is solid, checked chunk by chunk with the solid masks
+        bool is_box_solid(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            // leaving the world
+            if (x1 < m_origin_x * 8 || y1 < m_origin_y * 8 || z1 < 0 || x2 >= (m_origin_x + m_width) * 8 || y2 >= (m_origin_y + m_length) * 8) {
+                return true;
+            }
+            if (z2 >= m_height * 8) {
+                if (z1 >= m_height * 8) {
+                    return false;
+                }
+
+                z2 = (m_height * 8) - 1;
+            }
+
+            for (long long cx = x1 >> 3; cx <= x2 >> 3; cx++) {
+                for (long long cy = y1 >> 3; cy <= y2 >> 3; cy++) {
+                    for (long long cz = z1 >> 3; cz <= z2 >> 3; cz++) {
+                        if (m_chunks[get_chunk_slot(cx, cy, cz)]->is_box_solid(
+                            x1 > cx * 8 ? x1 & 7 : 0, y1 > cy * 8 ? y1 & 7 : 0, z1 > cz * 8 ? z1 & 7 : 0,
+                            x2 < (cx * 8) + 7 ? x2 & 7 : 7, y2 < (cy * 8) + 7 ? y2 & 7 : 7, z2 < (cz * 8) + 7 ? z2 & 7 : 7
+                        )) {
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        // the highest solid block in a column, -1 when the column is empty, callers are expected to check contains_block first
+        long long get_surface_height(long long x, long long y) {
+            return m_solid_heights[get_column_index(x, y)];
+        }
+
+        // the highest block in a column that stops sunlight, everything above it is open to the sky, -1 when there is none
+        long long get_opaque_height(long long x, long long y) {
+            return m_opaque_heights[get_column_index(x, y)];
+        }
+
+        bool contains_same_chunk(long long x1, long long y1, long long z1, long long x2, long long y2, long long z2) {
+            return (x1 >> 3) == (x2 >> 3) && (y1 >> 3) == (y2 >> 3) && (z1 >> 3) == (z2 >> 3);
+        }
+
+        // also releases the gpu objects of any chunk that still has them
+        void uninitialize(slab_pool<chunk_888>* pool) {
+            for (long long i = 0; i < m_width * m_length * m_height; i++) {
+                if (m_chunks[i] != 0 && m_chunks[i]->is_initialized()) {
+                    m_chunks[i]->uninitialize();
+                }
+
+                pool->deallocate(m_chunks[i]);
+            }
+
+            delete[] m_chunks;
+            delete[] m_solid_heights;
+            delete[] m_opaque_heights;
+
+            m_chunks = 0;
+            m_solid_heights = 0;
+            m_opaque_heights = 0;
+            m_generator = 0;
+            m_origin_x = 0;
+            m_origin_y = 0;
+            m_width = 0;
+            m_length = 0;
+            m_height = 0;
+        }
+    };
+}
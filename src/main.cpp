@@ -1,14 +1,133 @@
 #include "game/game.hpp"
+#include "game/benchmark.hpp"
+#include "game/server.hpp"
+
+int main(int argc, char** argv) {
+    // ./voxelize --benchmark <name | all>
+    if (argc > 2 && strcmp(argv[1], "--benchmark") == 0) {
+        if (!abradinjapan::voxelize::run_benchmark(argv[2])) {
+            printf("Unknown benchmark: %s\n", argv[2]);
+            fflush(stdout);
+        }
+
+        return 0;
+    }
+
+    // ./voxelize --server <port> [--ticks <count>] [--bandwidth <KiB/s per client>]
+    if (argc > 2 && strcmp(argv[1], "--server") == 0) {
+        abradinjapan::voxelize::world_server server = abradinjapan::voxelize::world_server();
+        abradinjapan::voxelize::et error;
+        unsigned long long ticks = 0;
+
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+                ticks = (unsigned long long)atoll(argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--bandwidth") == 0 && i + 1 < argc) {
+                server.set_bandwidth(atof(argv[i + 1]) * 1024.0);
+                i++;
+            }
+        }
+
+        error = server.initialize((unsigned short)atoi(argv[2]));
+        if (error == abradinjapan::voxelize::et::et_no_error) {
+            error = server.run(ticks);
+            server.print();
+            abradinjapan::voxelize::g_memory_accounts.print();
+        }
+        server.uninitialize();
+
+        if (error != abradinjapan::voxelize::et::et_no_error) {
+            printf("Voxelize Server Error Code: %i\n", error);
+            fflush(stdout);
+
+            return 1;
+        }
+
+        return 0;
+    }
 
-int main() {
     abradinjapan::voxelize::game g = abradinjapan::voxelize::game();
     abradinjapan::voxelize::et error;
+    unsigned long long headless_frames = 0;
+    bool headless = false;
+    const char* play_path = 0;
+    const char* capture_path = 0;
+    const char* reference_path = 0;
+
+    // ./voxelize [--vsync | --adaptive-sync | --fps <cap> | --uncapped] [--cold-cache <MiB>] [--mesh-cache <file>] [--faces] [--connect <address> <port>] [--seed <seed>] [--flood <height>] [--bind <action> <key>]... [--record <path> | --play <path>] [--timings <csv>] [--memory-log <csv>] [--headless <frames> [--capture <ppm>] [--compare <ppm>]]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vsync") == 0) {
+            g.set_frame_pacing(abradinjapan::voxelize::pmt::pmt_vsync, 240.0);
+        } else if (strcmp(argv[i], "--adaptive-sync") == 0) {
+            g.set_frame_pacing(abradinjapan::voxelize::pmt::pmt_adaptive_sync, 240.0);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            g.set_frame_pacing(abradinjapan::voxelize::pmt::pmt_capped, atof(argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--uncapped") == 0) {
+            g.set_frame_pacing(abradinjapan::voxelize::pmt::pmt_uncapped, 0.0);
+        } else if (strcmp(argv[i], "--cold-cache") == 0 && i + 1 < argc) {
+            g.set_cold_cache_limit((unsigned long long)atoll(argv[i + 1]) * 1024 * 1024);
+            i++;
+        } else if (strcmp(argv[i], "--mesh-cache") == 0 && i + 1 < argc) {
+            g.set_mesh_cache_path(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--faces") == 0) {
+            g.set_render_path(abradinjapan::voxelize::rpt::rpt_faces);
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 2 < argc) {
+            g.set_server(argv[i + 1], (unsigned short)atoi(argv[i + 2]));
+            i += 2;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            g.set_seed(strtoull(argv[i + 1], 0, 10));
+            i++;
+        } else if (strcmp(argv[i], "--flood") == 0 && i + 1 < argc) {
+            g.set_flood(atoll(argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--bind") == 0 && i + 2 < argc) {
+            if (!g.bind_action(argv[i + 1], argv[i + 2])) {
+                printf("Error: cannot bind %s to %s, unknown action or key name\n", argv[i + 1], argv[i + 2]);
+                fflush(stdout);
+            }
+            i += 2;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            g.set_camera_recording(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            play_path = argv[i + 1];
+            g.set_camera_playback(play_path);
+            i++;
+        } else if (strcmp(argv[i], "--timings") == 0 && i + 1 < argc) {
+            g.set_frame_timings_path(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--memory-log") == 0 && i + 1 < argc) {
+            g.set_memory_log_path(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headless_frames = (unsigned long long)atoll(argv[i + 1]);
+            headless = true;
+            i++;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_path = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            reference_path = argv[i + 1];
+            i++;
+        }
+    }
+
+    // 0 frames with a camera path runs until the path ends
+    if (headless && (headless_frames > 0 || play_path != 0)) {
+        g.set_headless(headless_frames, capture_path, reference_path);
+    }
 
     error = g.play();
 
     if (error != abradinjapan::voxelize::et::et_no_error) {
         printf("Voxelize Game Error Code: %i\n", error);
         fflush(stdout);
+
+        // lets scripts fail on a headless image mismatch
+        return 1;
     }
 
     return 0;
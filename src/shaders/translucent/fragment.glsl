@@ -0,0 +1,23 @@
+#version 330 core
+
+out vec4 pass_fragment_color;
+
+in vec3 pass_color;
+in vec2 pass_texture_coordinates;
+in vec2 pass_light;
+in float pass_ambient_occlusion;
+
+uniform sampler2D u_texture_1;
+
+// how much of what is behind still shows through
+const float opacity = 0.6;
+
+void main() {
+	// x is sunlight, y is block light, keep a little ambient so unlit caves are not pitch black
+	float brightness = max(max(pass_light.x, pass_light.y), 0.05);
+
+	// darken occluded corners without ever going fully black
+	brightness *= 0.4 + (0.6 * pass_ambient_occlusion);
+
+	pass_fragment_color = vec4(texture(u_texture_1, pass_texture_coordinates).rgb * brightness, opacity);
+}
\ No newline at end of file
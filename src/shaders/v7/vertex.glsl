@@ -0,0 +1,53 @@
+#version 330 core
+
+// vertex pulling, there are no vertex attributes
+// every face is one face_record in u_faces and is drawn as six vertices, gl_VertexID picks the face and the corner
+
+out vec3 pass_color;
+out vec2 pass_texture_coordinates;
+out vec2 pass_light;
+out float pass_ambient_occlusion;
+
+uniform mat4 u_model;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+uniform vec3 u_chunk_origin;
+uniform usamplerBuffer u_faces;
+
+// the corners of each surface in tvt order, as offsets from the cell's front bottom left corner in cells, see st2_corners
+const vec3 corners[24] = vec3[24](
+	vec3(0.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0),
+	vec3(0.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(0.0, 0.0, -1.0), vec3(1.0, 0.0, -1.0),
+	vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, -1.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, -1.0),
+	vec3(0.0, 0.0, -1.0), vec3(1.0, 0.0, -1.0), vec3(0.0, 1.0, -1.0), vec3(1.0, 1.0, -1.0),
+	vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), vec3(0.0, 1.0, -1.0), vec3(1.0, 1.0, -1.0),
+	vec3(1.0, 0.0, 0.0), vec3(1.0, 0.0, -1.0), vec3(1.0, 1.0, 0.0), vec3(1.0, 1.0, -1.0)
+);
+
+// the corner of each of the six vertices, the second half splits the quad along the other diagonal
+const int orders[12] = int[12](0, 1, 2, 3, 1, 2, 0, 1, 3, 0, 3, 2);
+
+void main() {
+	uvec2 face = texelFetch(u_faces, gl_VertexID / 6).rg;
+	vec3 cell = vec3(float(face.x & 7u), float((face.x >> 3u) & 7u), float((face.x >> 6u) & 7u));
+	uint surface = (face.x >> 9u) & 7u;
+	uint level = (face.x >> 24u) & 3u;
+	uint light = face.y & 255u;
+	float side_length = 1.0 / float(8u >> level);
+	uint ambient_occlusion[4] = uint[4]((face.x >> 12u) & 3u, (face.x >> 14u) & 3u, (face.x >> 16u) & 3u, (face.x >> 18u) & 3u);
+	int flip = ambient_occlusion[0] + ambient_occlusion[3] > ambient_occlusion[1] + ambient_occlusion[2] ? 6 : 0;
+	int corner = orders[flip + (gl_VertexID % 6)];
+	vec3 offset = corners[(int(surface) * 4) + corner];
+	vec3 position;
+
+	// faces extend toward -z from their corner, coarse cells are anchored on their last full size block, see render_inside
+	position = (side_length * cell) + u_chunk_origin;
+	position.z += side_length - 0.125;
+	position += side_length * offset;
+
+	gl_Position = u_projection * u_view * u_model * vec4(position, 1.0);
+	pass_color = vec3(1.0, 1.0, 1.0);
+	pass_texture_coordinates = vec2(float(corner & 1), float(corner >> 1));
+	pass_light = vec2(float(light >> 4u), float(light & 15u)) / 15.0;
+	pass_ambient_occlusion = float(ambient_occlusion[corner]) / 3.0;
+}